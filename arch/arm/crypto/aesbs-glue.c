@@ -9,10 +9,17 @@
  */
 
 #include <asm/neon.h>
+#include <asm/simd.h>
+#include <asm/unaligned.h>
+#include <asm/crypto/ghash.h>
 #include <crypto/aes.h>
 #include <crypto/ablk_helper.h>
+#include <crypto/aead.h>
 #include <crypto/algapi.h>
+#include <crypto/cryptd.h>
+#include <crypto/scatterwalk.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 
 #include "aes_glue.h"
 
@@ -54,6 +61,20 @@ struct aesbs_xts_ctx {
 	struct AES_KEY	twkey;
 };
 
+struct aesbs_gcm_ctx {
+	struct BS_KEY		enc;
+	struct ghash_key	ghash;
+};
+
+struct aesbs_gcm_async_ctx {
+	struct cryptd_aead	*cryptd_tfm;
+};
+
+#define GCM_IV_SIZE		12
+
+/* bytes processed per kernel_neon_begin()/kernel_neon_end() section */
+#define GCM_CHUNK_SIZE		4096
+
 static int aesbs_cbc_set_key(struct crypto_tfm *tfm, const u8 *in_key,
 			     unsigned int key_len)
 {
@@ -101,6 +122,24 @@ static int aesbs_xts_set_key(struct crypto_tfm *tfm, const u8 *in_key,
 	return 0;
 }
 
+static int aesbs_gcm_set_key(struct crypto_aead *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_gcm_ctx *ctx = crypto_aead_ctx(tfm);
+	u8 h[AES_BLOCK_SIZE] = {};
+
+	if (private_AES_set_encrypt_key(in_key, key_len * 8, &ctx->enc.rk)) {
+		crypto_aead_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+	ctx->enc.converted = 0;
+
+	/* the hash key is the encryption of the all zero block */
+	AES_encrypt(h, h, &ctx->enc.rk);
+	ghash_neon_setkey(&ctx->ghash, h);
+	return 0;
+}
+
 static int aesbs_cbc_encrypt(struct blkcipher_desc *desc,
 			     struct scatterlist *dst,
 			     struct scatterlist *src, unsigned int nbytes)
@@ -297,6 +336,289 @@ static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
 	return err;
 }
 
+/* hash len bytes at src, zero padding the last block; NEON must be usable */
+static void aesbs_gcm_ghash(u64 dg[], const u8 *src, unsigned int len,
+			    struct ghash_key const *key)
+{
+	u32 blocks = len / GHASH_BLOCK_SIZE;
+	u8 buf[GHASH_BLOCK_SIZE];
+
+	if (blocks) {
+		pmull_ghash_update(blocks, dg, src, key, NULL);
+		src += blocks * GHASH_BLOCK_SIZE;
+		len %= GHASH_BLOCK_SIZE;
+	}
+	if (len) {
+		memcpy(buf, src, len);
+		memset(buf + len, 0, GHASH_BLOCK_SIZE - len);
+		pmull_ghash_update(0, dg, NULL, key, buf);
+	}
+}
+
+/*
+ * Encrypt or decrypt len bytes between linear buffers and compute the tag.
+ * The CTR keystream and the GHASH of the ciphertext are done in the same
+ * pass over each chunk, while it is still in the cache.
+ */
+static void aesbs_gcm_crypt(struct aesbs_gcm_ctx *ctx, u8 *dst, const u8 *src,
+			    unsigned int len, const u8 *assoc,
+			    unsigned int assoclen, u8 iv[], u8 tag[], bool enc)
+{
+	u64 dg[2] = {};
+	__be64 lengths[2];
+	u8 ks[AES_BLOCK_SIZE];
+
+	lengths[0] = cpu_to_be64((u64)assoclen * 8);
+	lengths[1] = cpu_to_be64((u64)len * 8);
+
+	/* the tag is masked with the encryption of J0 = IV || 1 */
+	put_unaligned_be32(1, iv + GCM_IV_SIZE);
+	AES_encrypt(iv, tag, &ctx->enc.rk);
+	put_unaligned_be32(2, iv + GCM_IV_SIZE);
+
+	if (assoclen) {
+		kernel_neon_begin();
+		aesbs_gcm_ghash(dg, assoc, assoclen, &ctx->ghash);
+		kernel_neon_end();
+	}
+
+	while (len) {
+		unsigned int n = min_t(unsigned int, len, GCM_CHUNK_SIZE);
+		u32 blocks = n / AES_BLOCK_SIZE;
+		u32 tail = n % AES_BLOCK_SIZE;
+
+		kernel_neon_begin();
+		if (!enc)
+			aesbs_gcm_ghash(dg, src, n, &ctx->ghash);
+		if (blocks) {
+			bsaes_ctr32_encrypt_blocks(src, dst, blocks, &ctx->enc,
+						   iv);
+			put_unaligned_be32(get_unaligned_be32(iv + GCM_IV_SIZE) +
+					   blocks, iv + GCM_IV_SIZE);
+		}
+		if (tail) {
+			u8 *tdst = dst + blocks * AES_BLOCK_SIZE;
+			const u8 *tsrc = src + blocks * AES_BLOCK_SIZE;
+
+			AES_encrypt(iv, ks, &ctx->enc.rk);
+			if (tdst != tsrc)
+				memcpy(tdst, tsrc, tail);
+			crypto_xor(tdst, ks, tail);
+		}
+		if (enc)
+			aesbs_gcm_ghash(dg, dst, n, &ctx->ghash);
+		kernel_neon_end();
+
+		src += n;
+		dst += n;
+		len -= n;
+	}
+
+	kernel_neon_begin();
+	pmull_ghash_update(0, dg, NULL, &ctx->ghash, (const char *)lengths);
+	kernel_neon_end();
+
+	put_unaligned_be64(dg[1], ks);
+	put_unaligned_be64(dg[0], ks + 8);
+	crypto_xor(tag, ks, AES_BLOCK_SIZE);
+}
+
+/*
+ * The first entry is all that is mapped, so it has to cover len on its own;
+ * whatever follows it, such as the ICV of an ESP packet, is not touched.
+ */
+static bool aesbs_gcm_sg_linear(struct scatterlist *sg, unsigned int len)
+{
+	return sg->length >= len && sg->offset + len <= PAGE_SIZE;
+}
+
+static int aesbs_gcm_do_crypt(struct aead_request *req, bool enc)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct aesbs_gcm_ctx *ctx = crypto_aead_ctx(tfm);
+	unsigned int authsize = crypto_aead_authsize(tfm);
+	unsigned int len = req->cryptlen;
+	struct scatter_walk src_walk, dst_walk, assoc_walk;
+	u8 iv[AES_BLOCK_SIZE] __aligned(8);
+	u8 tag[AES_BLOCK_SIZE], stag[AES_BLOCK_SIZE];
+	u8 *src, *dst, *assoc = NULL, *buf = NULL;
+	bool mapped;
+	int err = 0;
+
+	if (!enc) {
+		if (len < authsize)
+			return -EINVAL;
+		len -= authsize;
+		scatterwalk_map_and_copy(stag, req->src, len, authsize, 0);
+	}
+	memcpy(iv, req->iv, GCM_IV_SIZE);
+
+	/*
+	 * Work in place when the text and the associated data each start
+	 * with an entry covering them within one page, which is the common
+	 * case for IPsec, and on a linear copy otherwise.  The tag is always
+	 * copied to or from the scatterlist separately.
+	 */
+	mapped = aesbs_gcm_sg_linear(req->src, len) &&
+		 aesbs_gcm_sg_linear(req->dst, len);
+	if (req->assoclen)
+		mapped = mapped &&
+			 aesbs_gcm_sg_linear(req->assoc, req->assoclen);
+
+	if (mapped) {
+		scatterwalk_start(&src_walk, req->src);
+		src = scatterwalk_map(&src_walk);
+		if (req->assoclen) {
+			scatterwalk_start(&assoc_walk, req->assoc);
+			assoc = scatterwalk_map(&assoc_walk);
+		}
+		dst = src;
+		if (req->dst != req->src) {
+			scatterwalk_start(&dst_walk, req->dst);
+			dst = scatterwalk_map(&dst_walk);
+		}
+	} else {
+		buf = kmalloc(len + req->assoclen, GFP_ATOMIC);
+		if (!buf)
+			return -ENOMEM;
+		src = dst = buf;
+		assoc = buf + len;
+		scatterwalk_map_and_copy(src, req->src, 0, len, 0);
+		scatterwalk_map_and_copy(assoc, req->assoc, 0,
+					 req->assoclen, 0);
+	}
+
+	aesbs_gcm_crypt(ctx, dst, src, len, assoc, req->assoclen, iv, tag,
+			enc);
+
+	if (mapped) {
+		if (req->dst != req->src) {
+			scatterwalk_unmap(dst);
+			scatterwalk_done(&dst_walk, 1, 0);
+		}
+		if (req->assoclen) {
+			scatterwalk_unmap(assoc);
+			scatterwalk_done(&assoc_walk, 0, 0);
+		}
+		scatterwalk_unmap(src);
+		scatterwalk_done(&src_walk, req->dst == req->src, 0);
+	} else {
+		scatterwalk_map_and_copy(dst, req->dst, 0, len, 1);
+		kfree(buf);
+	}
+
+	if (enc)
+		scatterwalk_map_and_copy(tag, req->dst, len, authsize, 1);
+	else if (memcmp(stag, tag, authsize))
+		err = -EBADMSG;
+	return err;
+}
+
+static int aesbs_gcm_encrypt(struct aead_request *req)
+{
+	return aesbs_gcm_do_crypt(req, true);
+}
+
+static int aesbs_gcm_decrypt(struct aead_request *req)
+{
+	return aesbs_gcm_do_crypt(req, false);
+}
+
+static int aesbs_gcm_set_authsize(struct crypto_aead *tfm,
+				  unsigned int authsize)
+{
+	switch (authsize) {
+	case 4:
+	case 8:
+	case 12:
+	case 13:
+	case 14:
+	case 15:
+	case 16:
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * gcm(aes) calls the synchronous implementation directly when the NEON unit
+ * may be used, and defers to cryptd otherwise.  It also defers while earlier
+ * requests are still in cryptd, which would complete after it otherwise.
+ */
+static int aesbs_gcm_async_init(struct crypto_tfm *tfm)
+{
+	struct aesbs_gcm_async_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct cryptd_aead *cryptd_tfm;
+
+	cryptd_tfm = cryptd_alloc_aead("__driver-gcm-aes-neonbs", 0, 0);
+	if (IS_ERR(cryptd_tfm))
+		return PTR_ERR(cryptd_tfm);
+
+	ctx->cryptd_tfm = cryptd_tfm;
+	tfm->crt_aead.reqsize = sizeof(struct aead_request) +
+				crypto_aead_reqsize(&cryptd_tfm->base);
+	return 0;
+}
+
+static void aesbs_gcm_async_exit(struct crypto_tfm *tfm)
+{
+	struct aesbs_gcm_async_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	cryptd_free_aead(ctx->cryptd_tfm);
+}
+
+static int aesbs_gcm_async_set_key(struct crypto_aead *tfm, const u8 *key,
+				   unsigned int key_len)
+{
+	struct aesbs_gcm_async_ctx *ctx = crypto_aead_ctx(tfm);
+	struct crypto_aead *child = cryptd_aead_child(ctx->cryptd_tfm);
+	int err;
+
+	crypto_aead_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_aead_set_flags(child, crypto_aead_get_flags(tfm)
+			      & CRYPTO_TFM_REQ_MASK);
+	err = crypto_aead_setkey(child, key, key_len);
+	crypto_aead_set_flags(tfm, crypto_aead_get_flags(child)
+			      & CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static int aesbs_gcm_async_set_authsize(struct crypto_aead *tfm,
+					unsigned int authsize)
+{
+	struct aesbs_gcm_async_ctx *ctx = crypto_aead_ctx(tfm);
+
+	return crypto_aead_setauthsize(cryptd_aead_child(ctx->cryptd_tfm),
+				       authsize);
+}
+
+static struct aead_request *aesbs_gcm_async_subreq(struct aead_request *req)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct aesbs_gcm_async_ctx *ctx = crypto_aead_ctx(tfm);
+	struct aead_request *subreq = aead_request_ctx(req);
+
+	memcpy(subreq, req, sizeof(*req));
+	if (may_use_simd() && !cryptd_aead_queued(ctx->cryptd_tfm))
+		aead_request_set_tfm(subreq,
+				     cryptd_aead_child(ctx->cryptd_tfm));
+	else
+		aead_request_set_tfm(subreq, &ctx->cryptd_tfm->base);
+	return subreq;
+}
+
+static int aesbs_gcm_async_encrypt(struct aead_request *req)
+{
+	return crypto_aead_encrypt(aesbs_gcm_async_subreq(req));
+}
+
+static int aesbs_gcm_async_decrypt(struct aead_request *req)
+{
+	return crypto_aead_decrypt(aesbs_gcm_async_subreq(req));
+}
+
 static struct crypto_alg aesbs_algs[] = { {
 	.cra_name		= "__cbc-aes-neonbs",
 	.cra_driver_name	= "__driver-cbc-aes-neonbs",
@@ -333,6 +655,24 @@ static struct crypto_alg aesbs_algs[] = { {
 		.encrypt	= aesbs_ctr_encrypt,
 		.decrypt	= aesbs_ctr_encrypt,
 	},
+}, {
+	.cra_name		= "__gcm-aes-neonbs",
+	.cra_driver_name	= "__driver-gcm-aes-neonbs",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_AEAD,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_gcm_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_aead_type,
+	.cra_module		= THIS_MODULE,
+	.cra_aead = {
+		.ivsize		= AES_BLOCK_SIZE,
+		.maxauthsize	= AES_BLOCK_SIZE,
+		.setkey		= aesbs_gcm_set_key,
+		.setauthsize	= aesbs_gcm_set_authsize,
+		.encrypt	= aesbs_gcm_encrypt,
+		.decrypt	= aesbs_gcm_decrypt,
+	},
 }, {
 	.cra_name		= "__xts-aes-neonbs",
 	.cra_driver_name	= "__driver-xts-aes-neonbs",
@@ -410,6 +750,26 @@ static struct crypto_alg aesbs_algs[] = { {
 		.setkey		= ablk_set_key,
 		.encrypt	= ablk_encrypt,
 		.decrypt	= ablk_decrypt,
+	},
+}, {
+	.cra_name		= "gcm(aes)",
+	.cra_driver_name	= "gcm-aes-neonbs",
+	.cra_priority		= 400,
+	.cra_flags		= CRYPTO_ALG_TYPE_AEAD|CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_gcm_async_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_aead_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= aesbs_gcm_async_init,
+	.cra_exit		= aesbs_gcm_async_exit,
+	.cra_aead = {
+		.ivsize		= AES_BLOCK_SIZE,
+		.maxauthsize	= AES_BLOCK_SIZE,
+		.setkey		= aesbs_gcm_async_set_key,
+		.setauthsize	= aesbs_gcm_async_set_authsize,
+		.encrypt	= aesbs_gcm_async_encrypt,
+		.decrypt	= aesbs_gcm_async_decrypt,
 	}
 } };
 
@@ -429,6 +789,6 @@ static void __exit aesbs_mod_exit(void)
 module_init(aesbs_mod_init);
 module_exit(aesbs_mod_exit);
 
-MODULE_DESCRIPTION("Bit sliced AES in CBC/CTR/XTS modes using NEON");
+MODULE_DESCRIPTION("Bit sliced AES in CBC/CTR/XTS/GCM modes using NEON");
 MODULE_AUTHOR("Ard Biesheuvel <ard.biesheuvel@linaro.org>");
 MODULE_LICENSE("GPL");
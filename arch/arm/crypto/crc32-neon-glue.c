@@ -0,0 +1,258 @@
+/*
+ * Glue code for the CRC32 and CRC32C folding implementation using ARM NEON
+ * instructions.
+ *
+ * Based on crypto/crc32c.c:
+ *  Copyright (c) 2004 Cisco Systems, Inc.
+ *  Copyright (c) 2008 Herbert Xu <herbert@gondor.apana.org.au>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <crypto/internal/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/crc32.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+#define CHKSUM_BLOCK_SIZE	1
+#define CHKSUM_DIGEST_SIZE	4
+
+/*
+ * Below this the cost of saving the NEON state outweighs the gain.  Above
+ * CRC32_NEON_CHUNK the work is split so that preemption is not disabled
+ * for too long at a time.
+ */
+#define CRC32_NEON_MIN		256
+#define CRC32_NEON_CHUNK	4096
+
+asmlinkage void crc32_neon_fold_le(const u8 *buf, unsigned int len, u32 crc,
+				   u8 *out);
+asmlinkage void crc32c_neon_fold_le(const u8 *buf, unsigned int len, u32 crc,
+				    u8 *out);
+
+static u32 crc32_neon_update(u32 crc, const u8 *p, size_t len,
+	void (*fold)(const u8 *, unsigned int, u32, u8 *),
+	u32 (*base)(u32, unsigned char const *, size_t))
+{
+	u8 rem[16] __aligned(8);
+	unsigned int chunk;
+
+	if (len < CRC32_NEON_MIN || !may_use_simd() || !cpu_has_neon())
+		return base(crc, p, len);
+
+	while (len >= CRC32_NEON_MIN) {
+		chunk = min_t(size_t, len, CRC32_NEON_CHUNK) & ~15;
+
+		kernel_neon_begin();
+		fold(p, chunk, crc, rem);
+		kernel_neon_end();
+
+		/* the folded remainder carries the CRC of the whole chunk */
+		crc = base(0, rem, sizeof(rem));
+		p += chunk;
+		len -= chunk;
+	}
+
+	return base(crc, p, len);
+}
+
+/*
+ * These override the weak table driven versions in lib/crc32.c, so every
+ * user of crc32_le() and __crc32c_le() benefits, not just the crypto API.
+ */
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_neon_update(crc, p, len, crc32_neon_fold_le,
+				 crc32_le_base);
+}
+
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_neon_update(crc, p, len, crc32c_neon_fold_le,
+				 __crc32c_le_base);
+}
+
+struct chksum_ctx {
+	u32 key;
+};
+
+struct chksum_desc_ctx {
+	u32 crc;
+};
+
+static int chksum_init(struct shash_desc *desc)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = mctx->key;
+
+	return 0;
+}
+
+static int chksum_setkey(struct crypto_shash *tfm, const u8 *key,
+			 unsigned int keylen)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(tfm);
+
+	if (keylen != sizeof(mctx->key)) {
+		crypto_shash_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+	mctx->key = le32_to_cpu(*(__le32 *)key);
+	return 0;
+}
+
+static int crc32_update(struct shash_desc *desc, const u8 *data,
+			unsigned int length)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = crc32_le(ctx->crc, data, length);
+	return 0;
+}
+
+static int crc32c_update(struct shash_desc *desc, const u8 *data,
+			 unsigned int length)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = __crc32c_le(ctx->crc, data, length);
+	return 0;
+}
+
+static int crc32_final(struct shash_desc *desc, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*(__le32 *)out = cpu_to_le32p(&ctx->crc);
+	return 0;
+}
+
+static int crc32c_final(struct shash_desc *desc, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*(__le32 *)out = ~cpu_to_le32p(&ctx->crc);
+	return 0;
+}
+
+static int crc32_finup(struct shash_desc *desc, const u8 *data,
+		       unsigned int len, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*(__le32 *)out = cpu_to_le32(crc32_le(ctx->crc, data, len));
+	return 0;
+}
+
+static int crc32c_finup(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*(__le32 *)out = ~cpu_to_le32(__crc32c_le(ctx->crc, data, len));
+	return 0;
+}
+
+static int crc32_digest(struct shash_desc *desc, const u8 *data,
+			unsigned int length, u8 *out)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+
+	*(__le32 *)out = cpu_to_le32(crc32_le(mctx->key, data, length));
+	return 0;
+}
+
+static int crc32c_digest(struct shash_desc *desc, const u8 *data,
+			 unsigned int length, u8 *out)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+
+	*(__le32 *)out = ~cpu_to_le32(__crc32c_le(mctx->key, data, length));
+	return 0;
+}
+
+static int crc32_cra_init(struct crypto_tfm *tfm)
+{
+	struct chksum_ctx *mctx = crypto_tfm_ctx(tfm);
+
+	mctx->key = 0;
+	return 0;
+}
+
+static int crc32c_cra_init(struct crypto_tfm *tfm)
+{
+	struct chksum_ctx *mctx = crypto_tfm_ctx(tfm);
+
+	mctx->key = ~0;
+	return 0;
+}
+
+static struct shash_alg crc32_neon_algs[] = { {
+	.digestsize		=	CHKSUM_DIGEST_SIZE,
+	.setkey			=	chksum_setkey,
+	.init			=	chksum_init,
+	.update			=	crc32_update,
+	.final			=	crc32_final,
+	.finup			=	crc32_finup,
+	.digest			=	crc32_digest,
+	.descsize		=	sizeof(struct chksum_desc_ctx),
+	.base			=	{
+		.cra_name		=	"crc32",
+		.cra_driver_name	=	"crc32-arm-neon",
+		.cra_priority		=	200,
+		.cra_blocksize		=	CHKSUM_BLOCK_SIZE,
+		.cra_alignmask		=	3,
+		.cra_ctxsize		=	sizeof(struct chksum_ctx),
+		.cra_module		=	THIS_MODULE,
+		.cra_init		=	crc32_cra_init,
+	}
+}, {
+	.digestsize		=	CHKSUM_DIGEST_SIZE,
+	.setkey			=	chksum_setkey,
+	.init			=	chksum_init,
+	.update			=	crc32c_update,
+	.final			=	crc32c_final,
+	.finup			=	crc32c_finup,
+	.digest			=	crc32c_digest,
+	.descsize		=	sizeof(struct chksum_desc_ctx),
+	.base			=	{
+		.cra_name		=	"crc32c",
+		.cra_driver_name	=	"crc32c-arm-neon",
+		.cra_priority		=	200,
+		.cra_blocksize		=	CHKSUM_BLOCK_SIZE,
+		.cra_alignmask		=	3,
+		.cra_ctxsize		=	sizeof(struct chksum_ctx),
+		.cra_module		=	THIS_MODULE,
+		.cra_init		=	crc32c_cra_init,
+	}
+} };
+
+static int __init crc32_neon_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	return crypto_register_shashes(crc32_neon_algs,
+				       ARRAY_SIZE(crc32_neon_algs));
+}
+
+static void __exit crc32_neon_mod_fini(void)
+{
+	crypto_unregister_shashes(crc32_neon_algs,
+				  ARRAY_SIZE(crc32_neon_algs));
+}
+
+module_init(crc32_neon_mod_init);
+module_exit(crc32_neon_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("CRC32 and CRC32C, NEON accelerated");
+MODULE_ALIAS("crc32");
+MODULE_ALIAS("crc32c");
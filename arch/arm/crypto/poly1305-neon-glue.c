@@ -0,0 +1,160 @@
+/*
+ * Glue code for the Poly1305 implementation using ARM NEON instructions.
+ *
+ * Based on crypto/poly1305_generic.c:
+ *  Copyright (C) 2015 Martin Willi
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <crypto/algapi.h>
+#include <crypto/internal/hash.h>
+#include <crypto/poly1305.h>
+#include <linux/crypto.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/*
+ * Below this the cost of saving the NEON state outweighs the gain.  Above
+ * POLY1305_NEON_CHUNK the work is split so that preemption is not disabled
+ * for too long at a time.
+ */
+#define POLY1305_NEON_MIN	128
+#define POLY1305_NEON_CHUNK	4096
+
+struct poly1305_neon_desc_ctx {
+	/* must be first, the generic code works on it */
+	struct poly1305_desc_ctx base;
+	/* r^2 and r interleaved, in the layout poly1305_2block_neon() wants */
+	u32 rr[10];
+	bool rrset;
+};
+
+asmlinkage void poly1305_2block_neon(u32 *h, const u8 *src, const u32 *rr,
+				     unsigned int pairs);
+
+static int poly1305_neon_init(struct shash_desc *desc)
+{
+	struct poly1305_neon_desc_ctx *nctx = shash_desc_ctx(desc);
+
+	nctx->rrset = false;
+	return crypto_poly1305_init(desc);
+}
+
+/* r^2 with the same partial reduction the block functions use */
+static void poly1305_neon_setrr(struct poly1305_neon_desc_ctx *nctx)
+{
+	const u32 *r = nctx->base.r;
+	u32 s1 = r[1] * 5, s2 = r[2] * 5, s3 = r[3] * 5, s4 = r[4] * 5;
+	u64 d0, d1, d2, d3, d4;
+	u32 h0, h1, h2, h3, h4;
+	int i;
+
+	d0 = (u64)r[0] * r[0] + (u64)r[1] * s4 + (u64)r[2] * s3 +
+	     (u64)r[3] * s2 + (u64)r[4] * s1;
+	d1 = (u64)r[0] * r[1] + (u64)r[1] * r[0] + (u64)r[2] * s4 +
+	     (u64)r[3] * s3 + (u64)r[4] * s2;
+	d2 = (u64)r[0] * r[2] + (u64)r[1] * r[1] + (u64)r[2] * r[0] +
+	     (u64)r[3] * s4 + (u64)r[4] * s3;
+	d3 = (u64)r[0] * r[3] + (u64)r[1] * r[2] + (u64)r[2] * r[1] +
+	     (u64)r[3] * r[0] + (u64)r[4] * s4;
+	d4 = (u64)r[0] * r[4] + (u64)r[1] * r[3] + (u64)r[2] * r[2] +
+	     (u64)r[3] * r[1] + (u64)r[4] * r[0];
+
+	d1 += (u32)(d0 >> 26);     h0 = d0 & 0x3ffffff;
+	d2 += (u32)(d1 >> 26);     h1 = d1 & 0x3ffffff;
+	d3 += (u32)(d2 >> 26);     h2 = d2 & 0x3ffffff;
+	d4 += (u32)(d3 >> 26);     h3 = d3 & 0x3ffffff;
+	h0 += (u32)(d4 >> 26) * 5; h4 = d4 & 0x3ffffff;
+	h1 += h0 >> 26;            h0 = h0 & 0x3ffffff;
+
+	nctx->rr[0] = h0;
+	nctx->rr[2] = h1;
+	nctx->rr[4] = h2;
+	nctx->rr[6] = h3;
+	nctx->rr[8] = h4;
+	for (i = 0; i < 5; i++)
+		nctx->rr[2 * i + 1] = r[i];
+
+	nctx->rrset = true;
+}
+
+static int poly1305_neon_update(struct shash_desc *desc,
+				const u8 *src, unsigned int srclen)
+{
+	struct poly1305_neon_desc_ctx *nctx = shash_desc_ctx(desc);
+	struct poly1305_desc_ctx *dctx = &nctx->base;
+	unsigned int bytes;
+
+	/* let the generic code consume the key and any partial block */
+	while (srclen && (!dctx->sset || dctx->buflen)) {
+		bytes = min(srclen, POLY1305_BLOCK_SIZE - dctx->buflen);
+		crypto_poly1305_update(desc, src, bytes);
+		src += bytes;
+		srclen -= bytes;
+	}
+
+	if (srclen >= POLY1305_NEON_MIN && may_use_simd()) {
+		if (unlikely(!nctx->rrset))
+			poly1305_neon_setrr(nctx);
+
+		do {
+			bytes = round_down(min_t(unsigned int, srclen,
+						 POLY1305_NEON_CHUNK),
+					   2 * POLY1305_BLOCK_SIZE);
+
+			kernel_neon_begin();
+			poly1305_2block_neon(dctx->h, src, nctx->rr,
+					     bytes / (2 * POLY1305_BLOCK_SIZE));
+			kernel_neon_end();
+
+			src += bytes;
+			srclen -= bytes;
+		} while (srclen >= 2 * POLY1305_BLOCK_SIZE);
+	}
+
+	if (srclen)
+		crypto_poly1305_update(desc, src, srclen);
+
+	return 0;
+}
+
+static struct shash_alg alg = {
+	.digestsize	= POLY1305_DIGEST_SIZE,
+	.init		= poly1305_neon_init,
+	.update		= poly1305_neon_update,
+	.final		= crypto_poly1305_final,
+	.descsize	= sizeof(struct poly1305_neon_desc_ctx),
+	.base		= {
+		.cra_name		= "poly1305",
+		.cra_driver_name	= "poly1305-neon",
+		.cra_priority		= 200,
+		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize		= POLY1305_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	},
+};
+
+static int __init poly1305_neon_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	return crypto_register_shash(&alg);
+}
+
+static void __exit poly1305_neon_mod_exit(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(poly1305_neon_mod_init);
+module_exit(poly1305_neon_mod_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Poly1305 authenticator, NEON accelerated");
+MODULE_ALIAS("poly1305");
@@ -0,0 +1,23 @@
+#ifndef ASM_ARM_CRYPTO_GHASH_H
+#define ASM_ARM_CRYPTO_GHASH_H
+
+#include <linux/linkage.h>
+#include <linux/types.h>
+#include <crypto/b128ops.h>
+
+#define GHASH_BLOCK_SIZE	16
+#define GHASH_DIGEST_SIZE	16
+
+struct ghash_key {
+	u64	a;
+	u64	b;
+	be128	k;
+};
+
+extern void ghash_neon_setkey(struct ghash_key *key, const u8 *inkey);
+
+/* must be called between kernel_neon_begin() and kernel_neon_end() */
+asmlinkage void pmull_ghash_update(int blocks, u64 dg[], const char *src,
+				   struct ghash_key const *k, const char *head);
+
+#endif
@@ -37,8 +37,17 @@ struct comm_mode_info {
 	void *xprt_info;
 };
 
+/* Entry in one of the RCU hash tables of the router, see ipc_router.c */
+struct msm_ipc_router_hash_node {
+	struct hlist_node node[2];
+	uint32_t key;
+};
+
 struct msm_ipc_port {
 	struct list_head list;
+	struct msm_ipc_router_hash_node hnode;
+	atomic_t ref;
+	struct rcu_head rcu;
 
 	struct msm_ipc_port_addr this_port;
 	struct msm_ipc_port_name port_name;
@@ -139,6 +148,13 @@ int msm_ipc_router_read_msg(struct msm_ipc_port *port_ptr,
  */
 int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr);
 
+/**
+ * msm_ipc_router_get_bytes_copied() - Payload bytes copied by IPC Router
+ *
+ * @return: Total number of message bytes IPC Router has copied since boot.
+ */
+u64 msm_ipc_router_get_bytes_copied(void);
+
 #else
 
 struct msm_ipc_port *msm_ipc_router_create_port(
@@ -181,6 +197,11 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 	return -ENODEV;
 }
 
+static inline u64 msm_ipc_router_get_bytes_copied(void)
+{
+	return 0;
+}
+
 #endif
 
 #endif
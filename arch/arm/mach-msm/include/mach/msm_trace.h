@@ -0,0 +1,164 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef _MACH_MSM_TRACE_H
+#define _MACH_MSM_TRACE_H
+
+#include <linux/types.h>
+
+/*
+ * Binary event trace.
+ *
+ * Every CPU logs into a ring of its own: a control page followed by
+ * fixed size entries, which the debugfs files msm_trace/cpuN map to
+ * userspace.  An entry is overwritten when the ring wraps, so a reader
+ * copies entries out and only keeps those whose seq still matches the
+ * index it read them at.  msm_trace/events lists the id, name and format
+ * of every event logged so far; tools/msm_trace decodes the rings with it.
+ */
+
+#define MSM_TRACE_MAGIC		0x4d545243
+#define MSM_TRACE_VERSION	1
+#define MSM_TRACE_MAX_ARGS	4
+
+struct msm_trace_ctl {
+	__u32 magic;
+	__u32 version;
+	__u32 cpu;
+	__u32 nents;		/* entries in the ring, a power of two */
+	__u32 ent_size;
+	__u32 head;		/* entries logged so far */
+};
+
+/*
+ * seq is the index the entry was logged at plus one, or zero while it is
+ * being written.  ts is sched_clock() in nanoseconds.
+ */
+struct msm_trace_ent {
+	__u32 seq;
+	__u16 id;
+	__u16 reserved;
+	__u64 ts;
+	__u32 args[MSM_TRACE_MAX_ARGS];
+};
+
+#ifdef __KERNEL__
+
+#include <linux/list.h>
+
+/*
+ * struct msm_trace_desc - an event type, defined by MSM_TRACE_EVENTn()
+ * @name: event name
+ * @fmt:  printf format of its arguments, using %d %u %x %c and %p only
+ * @id:   id in the entries, given on first use
+ */
+struct msm_trace_desc {
+	const char *name;
+	const char *fmt;
+	u16 id;
+	int state;
+	struct list_head node;
+};
+
+#if defined(CONFIG_MSM_TRACE)
+
+extern int msm_trace_enabled;
+
+void __msm_trace_log(struct msm_trace_desc *desc, u32 a1, u32 a2, u32 a3,
+		     u32 a4);
+
+static inline void msm_trace_log(struct msm_trace_desc *desc, u32 a1, u32 a2,
+				 u32 a3, u32 a4)
+{
+	if (unlikely(msm_trace_enabled))
+		__msm_trace_log(desc, a1, a2, a3, a4);
+}
+
+/* whether events are logged, for producers that log as text otherwise */
+static inline int msm_trace_active(void)
+{
+	return msm_trace_enabled;
+}
+
+#define __MSM_TRACE_DESC(_name, _fmt)					\
+static struct msm_trace_desc msm_trace_desc_##_name = {			\
+	.name = #_name,							\
+	.fmt = _fmt,							\
+}
+
+#define __MSM_TRACE_LOG(_name, a1, a2, a3, a4)				\
+	msm_trace_log(&msm_trace_desc_##_name, (u32)(uintptr_t)(a1),	\
+		      (u32)(uintptr_t)(a2), (u32)(uintptr_t)(a3),	\
+		      (u32)(uintptr_t)(a4))
+
+#else
+
+static inline int msm_trace_active(void)
+{
+	return 0;
+}
+
+#define __MSM_TRACE_DESC(_name, _fmt)					\
+struct msm_trace_desc
+
+#define __MSM_TRACE_LOG(_name, a1, a2, a3, a4)				\
+	do { } while (0)
+
+#endif
+
+/*
+ * MSM_TRACE_EVENTn: Define an event with n arguments of the given types
+ *
+ * Defines msm_trace_<name>() to log it, taking arguments of exactly those
+ * types.  Arguments are logged as 32 bit values, so only integers of up
+ * to 32 bits and pointers will do.
+ *
+ * @_name: Event name, unique within the file
+ * @_fmt:  printf format the decoder prints the arguments with
+ */
+#define MSM_TRACE_EVENT0(_name, _fmt)					\
+__MSM_TRACE_DESC(_name, _fmt);						\
+static inline void msm_trace_##_name(void)				\
+{									\
+	__MSM_TRACE_LOG(_name, 0, 0, 0, 0);				\
+}
+
+#define MSM_TRACE_EVENT1(_name, _fmt, _t1)				\
+__MSM_TRACE_DESC(_name, _fmt);						\
+static inline void msm_trace_##_name(_t1 a1)				\
+{									\
+	__MSM_TRACE_LOG(_name, a1, 0, 0, 0);				\
+}
+
+#define MSM_TRACE_EVENT2(_name, _fmt, _t1, _t2)				\
+__MSM_TRACE_DESC(_name, _fmt);						\
+static inline void msm_trace_##_name(_t1 a1, _t2 a2)			\
+{									\
+	__MSM_TRACE_LOG(_name, a1, a2, 0, 0);				\
+}
+
+#define MSM_TRACE_EVENT3(_name, _fmt, _t1, _t2, _t3)			\
+__MSM_TRACE_DESC(_name, _fmt);						\
+static inline void msm_trace_##_name(_t1 a1, _t2 a2, _t3 a3)		\
+{									\
+	__MSM_TRACE_LOG(_name, a1, a2, a3, 0);				\
+}
+
+#define MSM_TRACE_EVENT4(_name, _fmt, _t1, _t2, _t3, _t4)		\
+__MSM_TRACE_DESC(_name, _fmt);						\
+static inline void msm_trace_##_name(_t1 a1, _t2 a2, _t3 a3, _t4 a4)	\
+{									\
+	__MSM_TRACE_LOG(_name, a1, a2, a3, a4);				\
+}
+
+#endif /* __KERNEL__ */
+
+#endif
@@ -28,6 +28,7 @@
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
 #include <linux/rwsem.h>
+#include <linux/rculist.h>
 
 #include <asm/uaccess.h>
 #include <asm/byteorder.h>
@@ -100,31 +101,72 @@ if (msm_ipc_router_debug_mask & R2R_RAW_HDR) \
 #define IPC_ROUTER_LOG_EVENT_RX         0x02
 #define IPC_ROUTER_DUMMY_DEST_NODE	0xFFFFFFFF
 
+/*
+ * Local ports, servers, routes and the remote ports of every route live in
+ * hash tables that are looked up under rcu_read_lock() on every packet and
+ * updated under the table's mutex.  A table doubles in size once it holds
+ * more entries than buckets.  Each entry has a node for the current table
+ * and one for the next, so readers keep walking the old table while the
+ * new one is built; the old table is freed after a grace period, before
+ * the next resize can reuse its nodes.
+ *
+ * Entries that are used after the lookup (ports, remote ports, routes)
+ * are reference counted and freed after a grace period once the last
+ * reference is gone.
+ */
+#define HASH_TABLE_MAX_SIZE 1024
+
+struct msm_ipc_router_hash_table {
+	unsigned int size;
+	unsigned int count;
+	int ver;
+	struct hlist_head buckets[0];
+};
+
+#define rtr_hash_bucket(t, k) (&(t)->buckets[(k) & ((t)->size - 1)])
+
+#define rtr_hash_for_each_possible(t, obj, pos, k, member) \
+	hlist_for_each_entry_rcu(obj, pos, rtr_hash_bucket(t, k), \
+				 member.node[(t)->ver])
+
+#define rtr_hash_for_each(t, obj, pos, bkt, member) \
+	for (bkt = 0; bkt < (t)->size; bkt++) \
+		hlist_for_each_entry_rcu(obj, pos, &(t)->buckets[bkt], \
+					 member.node[(t)->ver])
+
+#define rtr_hash_for_each_safe(t, obj, pos, n, bkt, member) \
+	for (bkt = 0; bkt < (t)->size; bkt++) \
+		hlist_for_each_entry_safe(obj, pos, n, &(t)->buckets[bkt], \
+					  member.node[(t)->ver])
+
 static LIST_HEAD(control_ports);
 static DECLARE_RWSEM(control_ports_lock_lha5);
 
 #define LP_HASH_SIZE 32
-static struct list_head local_ports[LP_HASH_SIZE];
-static DECLARE_RWSEM(local_ports_lock_lha2);
+static struct msm_ipc_router_hash_table __rcu *local_ports;
+static DEFINE_MUTEX(local_ports_lock_lha2);
+static DECLARE_WAIT_QUEUE_HEAD(local_port_release_wait_q);
 
 #define SRV_HASH_SIZE 32
-static struct list_head server_list[SRV_HASH_SIZE];
-static DECLARE_RWSEM(server_list_lock_lha2);
+static struct msm_ipc_router_hash_table __rcu *server_list;
+static DEFINE_MUTEX(server_list_lock_lha2);
 
 struct msm_ipc_server {
-	struct list_head list;
+	struct msm_ipc_router_hash_node hnode;
 	struct msm_ipc_port_name name;
 	char pdev_name[32];
 	int next_pdev_id;
 	int synced_sec_rule;
 	struct list_head server_port_list;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_server_port {
 	struct list_head list;
-	struct platform_device pdev;
 	struct msm_ipc_port_addr server_addr;
 	struct msm_ipc_router_xprt_info *xprt_info;
+	struct rcu_head rcu;
+	struct platform_device pdev;
 };
 
 struct msm_ipc_resume_tx_port {
@@ -135,7 +177,8 @@ struct msm_ipc_resume_tx_port {
 
 #define RP_HASH_SIZE 32
 struct msm_ipc_router_remote_port {
-	struct list_head list;
+	struct msm_ipc_router_hash_node hnode;
+	atomic_t ref;
 	uint32_t node_id;
 	uint32_t port_id;
 	uint32_t tx_quota_cnt;
@@ -143,6 +186,7 @@ struct msm_ipc_router_remote_port {
 	struct list_head resume_tx_port_list;
 	void *sec_rule;
 	struct msm_ipc_server *server;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_router_xprt_info {
@@ -160,20 +204,26 @@ struct msm_ipc_router_xprt_info {
 	struct workqueue_struct *workqueue;
 };
 
+/*
+ * The remote ports of a route are added and removed under
+ * routing_table_lock_lha3, lock_lha4 only guards the xprt_info.
+ */
 #define RT_HASH_SIZE 4
 struct msm_ipc_routing_table_entry {
-	struct list_head list;
+	struct msm_ipc_router_hash_node hnode;
+	atomic_t ref;
 	uint32_t node_id;
 	uint32_t neighbor_node_id;
-	struct list_head remote_port_list[RP_HASH_SIZE];
+	struct msm_ipc_router_hash_table __rcu *remote_ports;
 	struct msm_ipc_router_xprt_info *xprt_info;
 	struct rw_semaphore lock_lha4;
 	unsigned long num_tx_bytes;
 	unsigned long num_rx_bytes;
+	struct rcu_head rcu;
 };
 
-static struct list_head routing_table[RT_HASH_SIZE];
-static DECLARE_RWSEM(routing_table_lock_lha3);
+static struct msm_ipc_router_hash_table __rcu *routing_table;
+static DEFINE_MUTEX(routing_table_lock_lha3);
 static int routing_table_inited;
 
 static void do_read_data(struct work_struct *work);
@@ -193,62 +243,175 @@ enum {
 	UP,
 };
 
-static void init_routing_table(void)
+static struct msm_ipc_router_hash_table *rtr_hash_alloc(unsigned int size)
+{
+	struct msm_ipc_router_hash_table *table;
+	int i;
+
+	table = kmalloc(sizeof(*table) + size * sizeof(struct hlist_head),
+			GFP_KERNEL);
+	if (!table)
+		return NULL;
+
+	table->size = size;
+	table->count = 0;
+	table->ver = 0;
+	for (i = 0; i < size; i++)
+		INIT_HLIST_HEAD(&table->buckets[i]);
+	return table;
+}
+
+/*
+ * Called with the table's mutex held.  Failing to grow only makes the
+ * chains longer, so errors are not reported.
+ */
+static void rtr_hash_grow(struct msm_ipc_router_hash_table __rcu **tablep)
 {
+	struct msm_ipc_router_hash_table *old, *new;
+	struct msm_ipc_router_hash_node *hnode;
+	struct hlist_node *pos;
 	int i;
-	for (i = 0; i < RT_HASH_SIZE; i++)
-		INIT_LIST_HEAD(&routing_table[i]);
+
+	old = rcu_dereference_protected(*tablep, 1);
+	if (old->size >= HASH_TABLE_MAX_SIZE)
+		return;
+
+	new = rtr_hash_alloc(old->size * 2);
+	if (!new)
+		return;
+
+	new->ver = !old->ver;
+	new->count = old->count;
+	for (i = 0; i < old->size; i++)
+		hlist_for_each_entry(hnode, pos, &old->buckets[i],
+				     node[old->ver])
+			hlist_add_head_rcu(&hnode->node[new->ver],
+					   rtr_hash_bucket(new, hnode->key));
+	rcu_assign_pointer(*tablep, new);
+	synchronize_rcu();
+	kfree(old);
+}
+
+static void rtr_hash_add(struct msm_ipc_router_hash_table __rcu **tablep,
+			 struct msm_ipc_router_hash_node *hnode, uint32_t key)
+{
+	struct msm_ipc_router_hash_table *table;
+
+	table = rcu_dereference_protected(*tablep, 1);
+	hnode->key = key;
+	hlist_add_head_rcu(&hnode->node[table->ver],
+			   rtr_hash_bucket(table, key));
+	if (++table->count > table->size)
+		rtr_hash_grow(tablep);
+}
+
+static void rtr_hash_del(struct msm_ipc_router_hash_table __rcu **tablep,
+			 struct msm_ipc_router_hash_node *hnode)
+{
+	struct msm_ipc_router_hash_table *table;
+
+	table = rcu_dereference_protected(*tablep, 1);
+	hlist_del_rcu(&hnode->node[table->ver]);
+	table->count--;
+}
+
+static int init_routing_table(void)
+{
+	struct msm_ipc_router_hash_table *table;
+
+	table = rtr_hash_alloc(RT_HASH_SIZE);
+	if (!table)
+		return -ENOMEM;
+	rcu_assign_pointer(routing_table, table);
+	return 0;
 }
 
 static struct msm_ipc_routing_table_entry *alloc_routing_table_entry(
 	uint32_t node_id)
 {
-	int i;
 	struct msm_ipc_routing_table_entry *rt_entry;
+	struct msm_ipc_router_hash_table *remote_ports;
 
 	rt_entry = kmalloc(sizeof(struct msm_ipc_routing_table_entry),
 			   GFP_KERNEL);
-	if (!rt_entry) {
+	remote_ports = rtr_hash_alloc(RP_HASH_SIZE);
+	if (!rt_entry || !remote_ports) {
 		pr_err("%s: rt_entry allocation failed for %d\n",
 			__func__, node_id);
+		kfree(remote_ports);
+		kfree(rt_entry);
 		return NULL;
 	}
 
-	for (i = 0; i < RP_HASH_SIZE; i++)
-		INIT_LIST_HEAD(&rt_entry->remote_port_list[i]);
-
+	RCU_INIT_POINTER(rt_entry->remote_ports, remote_ports);
+	atomic_set(&rt_entry->ref, 1);
 	init_rwsem(&rt_entry->lock_lha4);
 	rt_entry->node_id = node_id;
 	rt_entry->xprt_info = NULL;
 	return rt_entry;
 }
 
-static int add_routing_table_entry(
+static void free_routing_table_entry(struct rcu_head *rcu)
+{
+	struct msm_ipc_routing_table_entry *rt_entry =
+		container_of(rcu, struct msm_ipc_routing_table_entry, rcu);
+
+	kfree(rcu_dereference_raw(rt_entry->remote_ports));
+	kfree(rt_entry);
+}
+
+static void put_routing_table_entry(
 	struct msm_ipc_routing_table_entry *rt_entry)
 {
-	uint32_t key;
+	if (atomic_dec_and_test(&rt_entry->ref))
+		call_rcu(&rt_entry->rcu, free_routing_table_entry);
+}
 
+/* Called with routing_table_lock_lha3 held */
+static int add_routing_table_entry(
+	struct msm_ipc_routing_table_entry *rt_entry)
+{
 	if (!rt_entry)
 		return -EINVAL;
 
-	key = (rt_entry->node_id % RT_HASH_SIZE);
-	list_add_tail(&rt_entry->list, &routing_table[key]);
+	rtr_hash_add(&routing_table, &rt_entry->hnode, rt_entry->node_id);
 	return 0;
 }
 
+/*
+ * Called under rcu_read_lock() or with routing_table_lock_lha3 held, no
+ * reference is taken.
+ */
 static struct msm_ipc_routing_table_entry *lookup_routing_table(
 	uint32_t node_id)
 {
-	uint32_t key = (node_id % RT_HASH_SIZE);
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_routing_table_entry *rt_entry;
+	struct hlist_node *pos;
 
-	list_for_each_entry(rt_entry, &routing_table[key], list) {
+	table = rcu_dereference_check(routing_table,
+			lockdep_is_held(&routing_table_lock_lha3));
+	rtr_hash_for_each_possible(table, rt_entry, pos, node_id, hnode) {
 		if (rt_entry->node_id == node_id)
 			return rt_entry;
 	}
 	return NULL;
 }
 
+/* Returns the route with a reference held */
+static struct msm_ipc_routing_table_entry *get_routing_table_entry(
+	uint32_t node_id)
+{
+	struct msm_ipc_routing_table_entry *rt_entry;
+
+	rcu_read_lock();
+	rt_entry = lookup_routing_table(node_id);
+	if (rt_entry && !atomic_inc_not_zero(&rt_entry->ref))
+		rt_entry = NULL;
+	rcu_read_unlock();
+	return rt_entry;
+}
+
 struct rr_packet *rr_read(struct msm_ipc_router_xprt_info *xprt_info)
 {
 	struct rr_packet *temp_pkt;
@@ -360,16 +523,110 @@ void release_pkt(struct rr_packet *pkt)
 	return;
 }
 
+/*
+ * Payload bytes IPC Router copied between buffers and skbs, on the way in
+ * from senders, to defragment packets and on the way out to readers.
+ * Reported in debugfs and used by the benchmarks to show the copies per
+ * message.
+ */
+static atomic64_t bytes_copied = ATOMIC64_INIT(0);
+
+void msm_ipc_router_count_copy(unsigned int len)
+{
+	atomic64_add(len, &bytes_copied);
+}
+
+u64 msm_ipc_router_get_bytes_copied(void)
+{
+	return atomic64_read(&bytes_copied);
+}
+
+/**
+ * msm_ipc_router_alloc_skb() - Allocate an skb for an outgoing message
+ * @len:	Length of the message payload.
+ * @gfp:	Allocation flags.
+ *
+ * @return: skb holding @len bytes of (uninitialized) payload, NULL on error.
+ *
+ * The skb has IPC_ROUTER_HDR_SIZE bytes of headroom for the router header
+ * and room for the alignment padding behind the payload.  A payload that
+ * does not fit in a single page goes into page fragments, so that large
+ * messages need neither a high order allocation nor a split over several
+ * skbs; the linear part then only holds the header.  Callers fill in the
+ * payload with skb_store_bits() or skb_copy_datagram_from_iovec().
+ */
+struct sk_buff *msm_ipc_router_alloc_skb(unsigned int len, gfp_t gfp)
+{
+	unsigned int pad = ALIGN_SIZE(len);
+	unsigned int frag_len;
+	struct sk_buff *skb;
+	struct page *page;
+	int i, nr_frags;
+
+	if (len + pad <= SKB_MAX_ORDER(IPC_ROUTER_HDR_SIZE, 0)) {
+		skb = alloc_skb(IPC_ROUTER_HDR_SIZE + len + pad, gfp);
+		if (skb) {
+			skb_reserve(skb, IPC_ROUTER_HDR_SIZE);
+			skb_put(skb, len);
+		}
+		return skb;
+	}
+
+	/* the padding never crosses a page, see msm_ipc_router_pad_skb() */
+	nr_frags = DIV_ROUND_UP(len, PAGE_SIZE);
+	if (nr_frags > MAX_SKB_FRAGS)
+		return NULL;
+
+	skb = alloc_skb(IPC_ROUTER_HDR_SIZE, gfp);
+	if (!skb)
+		return NULL;
+	skb_reserve(skb, IPC_ROUTER_HDR_SIZE);
+
+	for (i = 0; i < nr_frags; i++) {
+		page = alloc_page(gfp);
+		if (!page) {
+			kfree_skb(skb);
+			return NULL;
+		}
+		frag_len = min_t(unsigned int, len - i * PAGE_SIZE, PAGE_SIZE);
+		skb_fill_page_desc(skb, i, page, 0, frag_len);
+	}
+	skb->len += len;
+	skb->data_len += len;
+	skb->truesize += nr_frags * PAGE_SIZE;
+	return skb;
+}
+
+/*
+ * Append the alignment padding the transports expect to an skb from
+ * msm_ipc_router_alloc_skb() or defragment_pkt(), both of which leave room
+ * for it.  Router headers are a multiple of 4 bytes, so padding is only
+ * needed when the payload ends inside a word, which for a paged skb is
+ * never at the end of its last page.
+ */
+static void msm_ipc_router_pad_skb(struct sk_buff *skb, int pad)
+{
+	skb_frag_t *frag;
+
+	if (!pad)
+		return;
+
+	if (!skb_is_nonlinear(skb)) {
+		skb_put(skb, pad);
+		return;
+	}
+
+	frag = &skb_shinfo(skb)->frags[skb_shinfo(skb)->nr_frags - 1];
+	skb_frag_size_add(frag, pad);
+	skb->len += pad;
+	skb->data_len += pad;
+}
+
 static struct sk_buff_head *msm_ipc_router_buf_to_skb(void *buf,
 						unsigned int buf_len)
 {
 	struct sk_buff_head *skb_head;
 	struct sk_buff *skb;
-	int first = 1, offset = 0;
-	int skb_size, data_size;
-	void *data;
-	int last = 1;
-	int align_size;
 
 	skb_head = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
 	if (!skb_head) {
@@ -378,47 +635,16 @@ static struct sk_buff_head *msm_ipc_router_buf_to_skb(void *buf,
 	}
 	skb_queue_head_init(skb_head);
 
-	data_size = buf_len;
-	align_size = ALIGN_SIZE(data_size);
-	while (offset != buf_len) {
-		skb_size = data_size;
-		if (first)
-			skb_size += IPC_ROUTER_HDR_SIZE;
-		if (last)
-			skb_size += align_size;
-
-		skb = alloc_skb(skb_size, GFP_KERNEL);
-		if (!skb) {
-			if (skb_size <= (PAGE_SIZE/2)) {
-				pr_err("%s: cannot allocate skb\n", __func__);
-				goto buf_to_skb_error;
-			}
-			data_size = data_size / 2;
-			last = 0;
-			continue;
-		}
-
-		if (first) {
-			skb_reserve(skb, IPC_ROUTER_HDR_SIZE);
-			first = 0;
-		}
-
-		data = skb_put(skb, data_size);
-		memcpy(skb->data, buf + offset, data_size);
-		skb_queue_tail(skb_head, skb);
-		offset += data_size;
-		data_size = buf_len - offset;
-		last = 1;
+	skb = msm_ipc_router_alloc_skb(buf_len, GFP_KERNEL);
+	if (!skb) {
+		pr_err("%s: cannot allocate skb\n", __func__);
+		kfree(skb_head);
+		return NULL;
 	}
+	skb_store_bits(skb, 0, buf, buf_len);
+	msm_ipc_router_count_copy(buf_len);
+	skb_queue_tail(skb_head, skb);
 	return skb_head;
-
-buf_to_skb_error:
-	while (!skb_queue_empty(skb_head)) {
-		skb = skb_dequeue(skb_head);
-		kfree_skb(skb);
-	}
-	kfree(skb_head);
-	return NULL;
 }
 
 static void *msm_ipc_router_skb_to_buf(struct sk_buff_head *skb_head,
@@ -433,7 +659,6 @@ static void *msm_ipc_router_skb_to_buf(struct sk_buff_head *skb_head,
 		return NULL;
 	}
 
-	temp = skb_peek(skb_head);
 	buf_len = len;
 	buf = kmalloc(buf_len, GFP_KERNEL);
 	if (!buf) {
@@ -442,10 +667,11 @@ static void *msm_ipc_router_skb_to_buf(struct sk_buff_head *skb_head,
 	}
 	skb_queue_walk(skb_head, temp) {
 		copy_len = buf_len < temp->len ? buf_len : temp->len;
-		memcpy(buf + offset, temp->data, copy_len);
+		skb_copy_bits(temp, 0, buf + offset, copy_len);
 		offset += copy_len;
 		buf_len -= copy_len;
 	}
+	msm_ipc_router_count_copy(offset);
 	return buf;
 }
 
@@ -687,7 +913,8 @@ static int defragment_pkt(struct rr_packet *pkt)
 		return -EINVAL;
 	}
 
-	if (skb_queue_len(pkt->pkt_fragment_q) == 1)
+	if (skb_queue_len(pkt->pkt_fragment_q) == 1 &&
+	    !skb_is_nonlinear(skb_peek(pkt->pkt_fragment_q)))
 		return 0;
 
 	align_size = ALIGN_SIZE(pkt->length);
@@ -702,10 +929,11 @@ static int defragment_pkt(struct rr_packet *pkt)
 
 	skb_queue_walk(pkt->pkt_fragment_q, src_skb) {
 		copy_len =  buf_len < src_skb->len ? buf_len : src_skb->len;
-		memcpy(buf + offset, src_skb->data, copy_len);
+		skb_copy_bits(src_skb, 0, buf + offset, copy_len);
 		offset += copy_len;
 		buf_len -= copy_len;
 	}
+	msm_ipc_router_count_copy(offset);
 
 	while (!skb_queue_empty(pkt->pkt_fragment_q)) {
 		temp_skb = skb_dequeue(pkt->pkt_fragment_q);
@@ -762,37 +990,44 @@ static int post_control_ports(struct rr_packet *pkt)
 	return 0;
 }
 
-static uint32_t allocate_port_id(void)
+/*
+ * Called under rcu_read_lock() or with local_ports_lock_lha2 held, no
+ * reference is taken.
+ */
+static struct msm_ipc_port *__msm_ipc_router_lookup_local_port(
+	uint32_t port_id)
 {
-	uint32_t port_id = 0, prev_port_id, key;
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_port *port_ptr;
+	struct hlist_node *pos;
+
+	table = rcu_dereference_check(local_ports,
+			lockdep_is_held(&local_ports_lock_lha2));
+	rtr_hash_for_each_possible(table, port_ptr, pos, port_id, hnode) {
+		if (port_ptr->this_port.port_id == port_id)
+			return port_ptr;
+	}
+	return NULL;
+}
+
+static uint32_t allocate_port_id(void)
+{
+	uint32_t port_id = 0, prev_port_id;
 
 	mutex_lock(&next_port_id_lock_lha1);
 	prev_port_id = next_port_id;
-	down_read(&local_ports_lock_lha2);
+	mutex_lock(&local_ports_lock_lha2);
 	do {
 		next_port_id++;
 		if ((next_port_id & IPC_ROUTER_ADDRESS) == IPC_ROUTER_ADDRESS)
 			next_port_id = 1;
 
-		key = (next_port_id & (LP_HASH_SIZE - 1));
-		if (list_empty(&local_ports[key])) {
-			port_id = next_port_id;
-			break;
-		}
-		list_for_each_entry(port_ptr, &local_ports[key], list) {
-			if (port_ptr->this_port.port_id == next_port_id) {
-				port_id = next_port_id;
-				break;
-			}
-		}
-		if (!port_id) {
+		if (!__msm_ipc_router_lookup_local_port(next_port_id)) {
 			port_id = next_port_id;
 			break;
 		}
-		port_id = 0;
 	} while (next_port_id != prev_port_id);
-	up_read(&local_ports_lock_lha2);
+	mutex_unlock(&local_ports_lock_lha2);
 	mutex_unlock(&next_port_id_lock_lha1);
 
 	return port_id;
@@ -800,15 +1035,20 @@ static uint32_t allocate_port_id(void)
 
 void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 {
-	uint32_t key;
-
 	if (!port_ptr)
 		return;
 
-	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
-	down_write(&local_ports_lock_lha2);
-	list_add_tail(&port_ptr->list, &local_ports[key]);
-	up_write(&local_ports_lock_lha2);
+	mutex_lock(&local_ports_lock_lha2);
+	rtr_hash_add(&local_ports, &port_ptr->hnode,
+		     port_ptr->this_port.port_id);
+	mutex_unlock(&local_ports_lock_lha2);
+}
+
+static void msm_ipc_router_del_local_port(struct msm_ipc_port *port_ptr)
+{
+	mutex_lock(&local_ports_lock_lha2);
+	rtr_hash_del(&local_ports, &port_ptr->hnode);
+	mutex_unlock(&local_ports_lock_lha2);
 }
 
 struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
@@ -829,6 +1069,7 @@ struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
 		return NULL;
 	}
 
+	atomic_set(&port_ptr->ref, 1);
 	spin_lock_init(&port_ptr->port_lock);
 	INIT_LIST_HEAD(&port_ptr->port_rx_q);
 	mutex_init(&port_ptr->port_rx_q_lock_lhb3);
@@ -848,26 +1089,41 @@ struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
 	return port_ptr;
 }
 
+/*
+ * Returns the port with a reference held.  msm_ipc_router_close_port()
+ * waits for all references to be dropped with
+ * msm_ipc_router_put_local_port().
+ */
 static struct msm_ipc_port *msm_ipc_router_lookup_local_port(uint32_t port_id)
 {
-	int key = (port_id & (LP_HASH_SIZE - 1));
 	struct msm_ipc_port *port_ptr;
 
-	list_for_each_entry(port_ptr, &local_ports[key], list) {
-		if (port_ptr->this_port.port_id == port_id) {
-			return port_ptr;
-		}
-	}
-	return NULL;
+	rcu_read_lock();
+	port_ptr = __msm_ipc_router_lookup_local_port(port_id);
+	if (port_ptr && !atomic_inc_not_zero(&port_ptr->ref))
+		port_ptr = NULL;
+	rcu_read_unlock();
+	return port_ptr;
 }
 
-static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
+static void msm_ipc_router_put_local_port(struct msm_ipc_port *port_ptr)
+{
+	if (atomic_dec_and_test(&port_ptr->ref))
+		wake_up(&local_port_release_wait_q);
+}
+
+/*
+ * Called under rcu_read_lock() or with routing_table_lock_lha3 held, no
+ * reference is taken.
+ */
+static struct msm_ipc_router_remote_port *__msm_ipc_router_lookup_remote_port(
 						uint32_t node_id,
 						uint32_t port_id)
 {
 	struct msm_ipc_router_remote_port *rport_ptr;
 	struct msm_ipc_routing_table_entry *rt_entry;
-	int key = (port_id & (RP_HASH_SIZE - 1));
+	struct msm_ipc_router_hash_table *table;
+	struct hlist_node *pos;
 
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
@@ -875,25 +1131,37 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 		return NULL;
 	}
 
-	down_read(&rt_entry->lock_lha4);
-	list_for_each_entry(rport_ptr,
-			    &rt_entry->remote_port_list[key], list) {
-		if (rport_ptr->port_id == port_id) {
-			up_read(&rt_entry->lock_lha4);
+	table = rcu_dereference_check(rt_entry->remote_ports,
+			lockdep_is_held(&routing_table_lock_lha3));
+	rtr_hash_for_each_possible(table, rport_ptr, pos, port_id, hnode) {
+		if (rport_ptr->port_id == port_id)
 			return rport_ptr;
-		}
 	}
-	up_read(&rt_entry->lock_lha4);
 	return NULL;
 }
 
+/* Returns the remote port with a reference held */
+static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
+						uint32_t node_id,
+						uint32_t port_id)
+{
+	struct msm_ipc_router_remote_port *rport_ptr;
+
+	rcu_read_lock();
+	rport_ptr = __msm_ipc_router_lookup_remote_port(node_id, port_id);
+	if (rport_ptr && !atomic_inc_not_zero(&rport_ptr->ref))
+		rport_ptr = NULL;
+	rcu_read_unlock();
+	return rport_ptr;
+}
+
+/* Called with routing_table_lock_lha3 held */
 static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 						uint32_t node_id,
 						uint32_t port_id)
 {
 	struct msm_ipc_router_remote_port *rport_ptr;
 	struct msm_ipc_routing_table_entry *rt_entry;
-	int key = (port_id & (RP_HASH_SIZE - 1));
 
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
@@ -907,6 +1175,7 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 		pr_err("%s: Remote port alloc failed\n", __func__);
 		return NULL;
 	}
+	atomic_set(&rport_ptr->ref, 1);
 	rport_ptr->port_id = port_id;
 	rport_ptr->node_id = node_id;
 	rport_ptr->sec_rule = NULL;
@@ -914,10 +1183,7 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 	rport_ptr->tx_quota_cnt = 0;
 	mutex_init(&rport_ptr->quota_lock_lhb2);
 	INIT_LIST_HEAD(&rport_ptr->resume_tx_port_list);
-	down_write(&rt_entry->lock_lha4);
-	list_add_tail(&rport_ptr->list,
-		      &rt_entry->remote_port_list[key]);
-	up_write(&rt_entry->lock_lha4);
+	rtr_hash_add(&rt_entry->remote_ports, &rport_ptr->hnode, port_id);
 	return rport_ptr;
 }
 
@@ -963,11 +1229,24 @@ static void post_resume_tx(struct msm_ipc_router_remote_port *rport_ptr,
 		else
 			pr_err("%s: Local Port %d not Found",
 				__func__, rtx_port->port_id);
+		if (local_port)
+			msm_ipc_router_put_local_port(local_port);
 		list_del(&rtx_port->list);
 		kfree(rtx_port);
 	}
 }
 
+static void msm_ipc_router_put_remote_port(
+	struct msm_ipc_router_remote_port *rport_ptr)
+{
+	if (!atomic_dec_and_test(&rport_ptr->ref))
+		return;
+
+	msm_ipc_router_free_resume_tx_port(rport_ptr);
+	kfree_rcu(rport_ptr, rcu);
+}
+
+/* Called with routing_table_lock_lha3 held */
 static void msm_ipc_router_destroy_remote_port(
 	struct msm_ipc_router_remote_port *rport_ptr)
 {
@@ -983,34 +1262,33 @@ static void msm_ipc_router_destroy_remote_port(
 		pr_err("%s: Node %d is not up\n", __func__, node_id);
 		return;
 	}
-	down_write(&rt_entry->lock_lha4);
-	list_del(&rport_ptr->list);
-	up_write(&rt_entry->lock_lha4);
-	mutex_lock(&rport_ptr->quota_lock_lhb2);
-	msm_ipc_router_free_resume_tx_port(rport_ptr);
-	mutex_unlock(&rport_ptr->quota_lock_lhb2);
-	kfree(rport_ptr);
+	rtr_hash_del(&rt_entry->remote_ports, &rport_ptr->hnode);
+	msm_ipc_router_put_remote_port(rport_ptr);
 	return;
 }
 
+/* Called under rcu_read_lock() or with server_list_lock_lha2 held */
 static struct msm_ipc_server *msm_ipc_router_lookup_server(
 				uint32_t service,
 				uint32_t instance,
 				uint32_t node_id,
 				uint32_t port_id)
 {
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
-	int key = (service & (SRV_HASH_SIZE - 1));
+	struct hlist_node *pos;
 
-	list_for_each_entry(server, &server_list[key], list) {
+	table = rcu_dereference_check(server_list,
+			lockdep_is_held(&server_list_lock_lha2));
+	rtr_hash_for_each_possible(table, server, pos, service, hnode) {
 		if ((server->name.service != service) ||
 		    (server->name.instance != instance))
 			continue;
 		if ((node_id == 0) && (port_id == 0))
 			return server;
-		list_for_each_entry(server_port, &server->server_port_list,
-				    list) {
+		list_for_each_entry_rcu(server_port,
+					&server->server_port_list, list) {
 			if ((server_port->server_addr.node_id == node_id) &&
 			    (server_port->server_addr.port_id == port_id))
 				return server;
@@ -1032,13 +1310,10 @@ static struct msm_ipc_server *msm_ipc_router_create_server(
 {
 	struct msm_ipc_server *server = NULL;
 	struct msm_ipc_server_port *server_port;
-	int key = (service & (SRV_HASH_SIZE - 1));
 
-	list_for_each_entry(server, &server_list[key], list) {
-		if ((server->name.service == service) &&
-		    (server->name.instance == instance))
-			goto create_srv_port;
-	}
+	server = msm_ipc_router_lookup_server(service, instance, 0, 0);
+	if (server)
+		goto create_srv_port;
 
 	server = kzalloc(sizeof(struct msm_ipc_server), GFP_KERNEL);
 	if (!server) {
@@ -1049,17 +1324,17 @@ static struct msm_ipc_server *msm_ipc_router_create_server(
 	server->name.instance = instance;
 	server->synced_sec_rule = 0;
 	INIT_LIST_HEAD(&server->server_port_list);
-	list_add_tail(&server->list, &server_list[key]);
 	scnprintf(server->pdev_name, sizeof(server->pdev_name),
 		  "QMI%08x:%08x", service, instance);
 	server->next_pdev_id = 1;
+	rtr_hash_add(&server_list, &server->hnode, service);
 
 create_srv_port:
 	server_port = kzalloc(sizeof(struct msm_ipc_server_port), GFP_KERNEL);
 	if (!server_port) {
 		if (list_empty(&server->server_port_list)) {
-			list_del(&server->list);
-			kfree(server);
+			rtr_hash_del(&server_list, &server->hnode);
+			kfree_rcu(server, rcu);
 		}
 		pr_err("%s: Server Port allocation failed\n", __func__);
 		return NULL;
@@ -1067,7 +1342,7 @@ create_srv_port:
 	server_port->server_addr.node_id = node_id;
 	server_port->server_addr.port_id = port_id;
 	server_port->xprt_info = xprt_info;
-	list_add_tail(&server_port->list, &server->server_port_list);
+	list_add_tail_rcu(&server_port->list, &server->server_port_list);
 
 	server_port->pdev.name = server->pdev_name;
 	server_port->pdev.id = server->next_pdev_id++;
@@ -1087,17 +1362,16 @@ static void msm_ipc_router_destroy_server(struct msm_ipc_server *server,
 
 	list_for_each_entry(server_port, &server->server_port_list, list) {
 		if ((server_port->server_addr.node_id == node_id) &&
-		    (server_port->server_addr.port_id == port_id))
+		    (server_port->server_addr.port_id == port_id)) {
+			platform_device_unregister(&server_port->pdev);
+			list_del_rcu(&server_port->list);
+			kfree_rcu(server_port, rcu);
 			break;
-	}
-	if (server_port) {
-		platform_device_unregister(&server_port->pdev);
-		list_del(&server_port->list);
-		kfree(server_port);
+		}
 	}
 	if (list_empty(&server->server_port_list)) {
-		list_del(&server->list);
-		kfree(server);
+		rtr_hash_del(&server_list, &server->hnode);
+		kfree_rcu(server, rcu);
 	}
 	return;
 }
@@ -1187,8 +1461,10 @@ static int msm_ipc_router_send_server_list(uint32_t node_id,
 		struct msm_ipc_router_xprt_info *xprt_info)
 {
 	union rr_control_msg ctl;
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
+	struct hlist_node *pos;
 	int i;
 
 	if (!xprt_info || !xprt_info->initialized) {
@@ -1199,23 +1475,20 @@ static int msm_ipc_router_send_server_list(uint32_t node_id,
 	memset(&ctl, 0, sizeof(ctl));
 	ctl.cmd = IPC_ROUTER_CTRL_CMD_NEW_SERVER;
 
-	for (i = 0; i < SRV_HASH_SIZE; i++) {
-		list_for_each_entry(server, &server_list[i], list) {
-			ctl.srv.service = server->name.service;
-			ctl.srv.instance = server->name.instance;
-			list_for_each_entry(server_port,
-					    &server->server_port_list, list) {
-				if (server_port->server_addr.node_id !=
-				    node_id)
-					continue;
-
-				ctl.srv.node_id =
-					server_port->server_addr.node_id;
-				ctl.srv.port_id =
-					server_port->server_addr.port_id;
-				msm_ipc_router_send_control_msg(xprt_info,
-					&ctl, IPC_ROUTER_DUMMY_DEST_NODE);
-			}
+	table = rcu_dereference_protected(server_list,
+			lockdep_is_held(&server_list_lock_lha2));
+	rtr_hash_for_each(table, server, pos, i, hnode) {
+		ctl.srv.service = server->name.service;
+		ctl.srv.instance = server->name.instance;
+		list_for_each_entry(server_port,
+				    &server->server_port_list, list) {
+			if (server_port->server_addr.node_id != node_id)
+				continue;
+
+			ctl.srv.node_id = server_port->server_addr.node_id;
+			ctl.srv.port_id = server_port->server_addr.port_id;
+			msm_ipc_router_send_control_msg(xprt_info,
+				&ctl, IPC_ROUTER_DUMMY_DEST_NODE);
 		}
 	}
 
@@ -1347,16 +1620,19 @@ static int forward_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		return -EINVAL;
 
 	hdr = &(pkt->hdr);
-	down_read(&routing_table_lock_lha3);
-	rt_entry = lookup_routing_table(hdr->dst_node_id);
-	if (!(rt_entry) || !(rt_entry->xprt_info)) {
+	rt_entry = get_routing_table_entry(hdr->dst_node_id);
+	if (!rt_entry) {
 		pr_err("%s: Routing table not initialized\n", __func__);
-		ret = -ENODEV;
-		goto fm_error1;
+		return -ENODEV;
 	}
 
 	down_read(&rt_entry->lock_lha4);
 	fwd_xprt_info = rt_entry->xprt_info;
+	if (!fwd_xprt_info) {
+		pr_err("%s: Routing table not initialized\n", __func__);
+		ret = -ENODEV;
+		goto fm_error2;
+	}
 	ret = prepend_header(pkt, fwd_xprt_info);
 	if (ret < 0) {
 		pr_err("%s: Prepend Header failed\n", __func__);
@@ -1387,8 +1663,7 @@ fm_error3:
 	mutex_unlock(&fwd_xprt_info->tx_lock_lhb2);
 fm_error2:
 	up_read(&rt_entry->lock_lha4);
-fm_error1:
-	up_read(&routing_table_lock_lha3);
+	put_routing_table_entry(rt_entry);
 
 	return ret;
 }
@@ -1480,29 +1755,27 @@ static void cleanup_rmt_server(struct msm_ipc_router_xprt_info *xprt_info,
 static void cleanup_rmt_ports(struct msm_ipc_router_xprt_info *xprt_info,
 			      struct msm_ipc_routing_table_entry *rt_entry)
 {
-	struct msm_ipc_router_remote_port *rport_ptr, *tmp_rport_ptr;
+	struct msm_ipc_router_remote_port *rport_ptr;
+	struct msm_ipc_router_hash_table *table;
+	struct hlist_node *pos, *n;
 	union rr_control_msg ctl;
 	int j;
 
 	memset(&ctl, 0, sizeof(ctl));
-	for (j = 0; j < RP_HASH_SIZE; j++) {
-		list_for_each_entry_safe(rport_ptr, tmp_rport_ptr,
-				&rt_entry->remote_port_list[j], list) {
-			list_del(&rport_ptr->list);
-			mutex_lock(&rport_ptr->quota_lock_lhb2);
-			msm_ipc_router_free_resume_tx_port(rport_ptr);
-			mutex_unlock(&rport_ptr->quota_lock_lhb2);
+	table = rcu_dereference_protected(rt_entry->remote_ports,
+			lockdep_is_held(&routing_table_lock_lha3));
+	rtr_hash_for_each_safe(table, rport_ptr, pos, n, j, hnode) {
+		rtr_hash_del(&rt_entry->remote_ports, &rport_ptr->hnode);
 
-			if (rport_ptr->server)
-				cleanup_rmt_server(xprt_info, rport_ptr);
+		if (rport_ptr->server)
+			cleanup_rmt_server(xprt_info, rport_ptr);
 
-			ctl.cmd = IPC_ROUTER_CTRL_CMD_REMOVE_CLIENT;
-			ctl.cli.node_id = rport_ptr->node_id;
-			ctl.cli.port_id = rport_ptr->port_id;
-			relay_ctl_msg(xprt_info, &ctl);
-			broadcast_ctl_msg_locally(&ctl);
-			kfree(rport_ptr);
-		}
+		ctl.cmd = IPC_ROUTER_CTRL_CMD_REMOVE_CLIENT;
+		ctl.cli.node_id = rport_ptr->node_id;
+		ctl.cli.port_id = rport_ptr->port_id;
+		relay_ctl_msg(xprt_info, &ctl);
+		broadcast_ctl_msg_locally(&ctl);
+		msm_ipc_router_put_remote_port(rport_ptr);
 	}
 }
 
@@ -1510,32 +1783,33 @@ static void msm_ipc_cleanup_routing_table(
 	struct msm_ipc_router_xprt_info *xprt_info)
 {
 	int i;
-	struct msm_ipc_routing_table_entry *rt_entry, *tmp_rt_entry;
+	struct msm_ipc_routing_table_entry *rt_entry;
+	struct msm_ipc_router_hash_table *table;
+	struct hlist_node *pos, *n;
 
 	if (!xprt_info) {
 		pr_err("%s: Invalid xprt_info\n", __func__);
 		return;
 	}
 
-	down_write(&server_list_lock_lha2);
-	down_write(&routing_table_lock_lha3);
-	for (i = 0; i < RT_HASH_SIZE; i++) {
-		list_for_each_entry_safe(rt_entry, tmp_rt_entry,
-					 &routing_table[i], list) {
-			down_write(&rt_entry->lock_lha4);
-			if (rt_entry->xprt_info != xprt_info) {
-				up_write(&rt_entry->lock_lha4);
-				continue;
-			}
-			cleanup_rmt_ports(xprt_info, rt_entry);
-			rt_entry->xprt_info = NULL;
+	mutex_lock(&server_list_lock_lha2);
+	mutex_lock(&routing_table_lock_lha3);
+	table = rcu_dereference_protected(routing_table,
+			lockdep_is_held(&routing_table_lock_lha3));
+	rtr_hash_for_each_safe(table, rt_entry, pos, n, i, hnode) {
+		down_write(&rt_entry->lock_lha4);
+		if (rt_entry->xprt_info != xprt_info) {
 			up_write(&rt_entry->lock_lha4);
-			list_del(&rt_entry->list);
-			kfree(rt_entry);
+			continue;
 		}
+		cleanup_rmt_ports(xprt_info, rt_entry);
+		rt_entry->xprt_info = NULL;
+		up_write(&rt_entry->lock_lha4);
+		rtr_hash_del(&routing_table, &rt_entry->hnode);
+		put_routing_table_entry(rt_entry);
 	}
-	up_write(&routing_table_lock_lha3);
-	up_write(&server_list_lock_lha2);
+	mutex_unlock(&routing_table_lock_lha3);
+	mutex_unlock(&server_list_lock_lha2);
 }
 
 static void sync_sec_rule(struct msm_ipc_server *server, void *rule)
@@ -1543,26 +1817,29 @@ static void sync_sec_rule(struct msm_ipc_server *server, void *rule)
 	struct msm_ipc_server_port *server_port;
 	struct msm_ipc_router_remote_port *rport_ptr = NULL;
 
-	down_read(&routing_table_lock_lha3);
+	mutex_lock(&routing_table_lock_lha3);
 	list_for_each_entry(server_port, &server->server_port_list, list) {
-		rport_ptr = msm_ipc_router_lookup_remote_port(
+		rport_ptr = __msm_ipc_router_lookup_remote_port(
 				server_port->server_addr.node_id,
 				server_port->server_addr.port_id);
 		if (!rport_ptr)
 			continue;
 		rport_ptr->sec_rule = rule;
 	}
-	up_read(&routing_table_lock_lha3);
+	mutex_unlock(&routing_table_lock_lha3);
 	server->synced_sec_rule = 1;
 }
 
 void msm_ipc_sync_sec_rule(uint32_t service, uint32_t instance, void *rule)
 {
-	int key = (service & (SRV_HASH_SIZE - 1));
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_server *server;
+	struct hlist_node *pos;
 
-	down_write(&server_list_lock_lha2);
-	list_for_each_entry(server, &server_list[key], list) {
+	mutex_lock(&server_list_lock_lha2);
+	table = rcu_dereference_protected(server_list,
+			lockdep_is_held(&server_list_lock_lha2));
+	rtr_hash_for_each_possible(table, server, pos, service, hnode) {
 		if (server->name.service != service)
 			continue;
 
@@ -1575,24 +1852,26 @@ void msm_ipc_sync_sec_rule(uint32_t service, uint32_t instance, void *rule)
 
 		sync_sec_rule(server, rule);
 	}
-	up_write(&server_list_lock_lha2);
+	mutex_unlock(&server_list_lock_lha2);
 }
 
 void msm_ipc_sync_default_sec_rule(void *rule)
 {
 	int key;
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_server *server;
+	struct hlist_node *pos;
 
-	down_write(&server_list_lock_lha2);
-	for (key = 0; key < SRV_HASH_SIZE; key++) {
-		list_for_each_entry(server, &server_list[key], list) {
-			if (server->synced_sec_rule)
-				continue;
+	mutex_lock(&server_list_lock_lha2);
+	table = rcu_dereference_protected(server_list,
+			lockdep_is_held(&server_list_lock_lha2));
+	rtr_hash_for_each(table, server, pos, key, hnode) {
+		if (server->synced_sec_rule)
+			continue;
 
-			sync_sec_rule(server, rule);
-		}
+		sync_sec_rule(server, rule);
 	}
-	up_write(&server_list_lock_lha2);
+	mutex_unlock(&server_list_lock_lha2);
 }
 
 static int process_hello_msg(struct msm_ipc_router_xprt_info *xprt_info,
@@ -1601,6 +1880,8 @@ static int process_hello_msg(struct msm_ipc_router_xprt_info *xprt_info,
 	int i, rc = 0;
 	union rr_control_msg ctl;
 	struct msm_ipc_routing_table_entry *rt_entry;
+	struct msm_ipc_router_hash_table *table;
+	struct hlist_node *pos;
 
 	if (!hdr)
 		return -EINVAL;
@@ -1608,12 +1889,12 @@ static int process_hello_msg(struct msm_ipc_router_xprt_info *xprt_info,
 	RR("o HELLO NID %d\n", hdr->src_node_id);
 
 	xprt_info->remote_node_id = hdr->src_node_id;
-	down_write(&routing_table_lock_lha3);
+	mutex_lock(&routing_table_lock_lha3);
 	rt_entry = lookup_routing_table(hdr->src_node_id);
 	if (!rt_entry) {
 		rt_entry = alloc_routing_table_entry(hdr->src_node_id);
 		if (!rt_entry) {
-			up_write(&routing_table_lock_lha3);
+			mutex_unlock(&routing_table_lock_lha3);
 			pr_err("%s: rt_entry allocation failed\n", __func__);
 			return -ENOMEM;
 		}
@@ -1623,7 +1904,7 @@ static int process_hello_msg(struct msm_ipc_router_xprt_info *xprt_info,
 	rt_entry->neighbor_node_id = xprt_info->remote_node_id;
 	rt_entry->xprt_info = xprt_info;
 	up_write(&rt_entry->lock_lha4);
-	up_write(&routing_table_lock_lha3);
+	mutex_unlock(&routing_table_lock_lha3);
 
 	
 	memset(&ctl, 0, sizeof(ctl));
@@ -1636,26 +1917,25 @@ static int process_hello_msg(struct msm_ipc_router_xprt_info *xprt_info,
 	}
 	xprt_info->initialized = 1;
 
-	down_read(&server_list_lock_lha2);
-	down_read(&routing_table_lock_lha3);
-	for (i = 0; i < RT_HASH_SIZE; i++) {
-		list_for_each_entry(rt_entry, &routing_table[i], list) {
-			if ((rt_entry->node_id != IPC_ROUTER_NID_LOCAL) &&
-			    (!rt_entry->xprt_info ||
-			     (rt_entry->xprt_info->xprt->link_id ==
-			      xprt_info->xprt->link_id)))
-				continue;
-			rc = msm_ipc_router_send_server_list(rt_entry->node_id,
-							     xprt_info);
-			if (rc < 0) {
-				up_read(&routing_table_lock_lha3);
-				up_read(&server_list_lock_lha2);
-				return rc;
-			}
-		}
+	mutex_lock(&server_list_lock_lha2);
+	mutex_lock(&routing_table_lock_lha3);
+	table = rcu_dereference_protected(routing_table,
+			lockdep_is_held(&routing_table_lock_lha3));
+	rtr_hash_for_each(table, rt_entry, pos, i, hnode) {
+		if ((rt_entry->node_id != IPC_ROUTER_NID_LOCAL) &&
+		    (!rt_entry->xprt_info ||
+		     (rt_entry->xprt_info->xprt->link_id ==
+		      xprt_info->xprt->link_id)))
+			continue;
+		rc = msm_ipc_router_send_server_list(rt_entry->node_id,
+						     xprt_info);
+		if (rc < 0)
+			break;
 	}
-	up_read(&routing_table_lock_lha3);
-	up_read(&server_list_lock_lha2);
+	mutex_unlock(&routing_table_lock_lha3);
+	mutex_unlock(&server_list_lock_lha2);
+	if (rc < 0)
+		return rc;
 	RR("HELLO message processed\n");
 	return rc;
 }
@@ -1668,8 +1948,6 @@ static int process_resume_tx_msg(union rr_control_msg *msg,
 
 	RR("o RESUME_TX id=%d:%08x\n", msg->cli.node_id, msg->cli.port_id);
 
-	down_read(&local_ports_lock_lha2);
-	down_read(&routing_table_lock_lha3);
 	rport_ptr = msm_ipc_router_lookup_remote_port(msg->cli.node_id,
 						      msg->cli.port_id);
 	if (!rport_ptr) {
@@ -1681,9 +1959,8 @@ static int process_resume_tx_msg(union rr_control_msg *msg,
 	rport_ptr->tx_quota_cnt = 0;
 	post_resume_tx(rport_ptr, pkt);
 	mutex_unlock(&rport_ptr->quota_lock_lhb2);
+	msm_ipc_router_put_remote_port(rport_ptr);
 prtm_out:
-	up_read(&routing_table_lock_lha3);
-	up_read(&local_ports_lock_lha2);
 	return 0;
 }
 
@@ -1702,12 +1979,12 @@ static int process_new_server_msg(struct msm_ipc_router_xprt_info *xprt_info,
 
 	RR("o NEW_SERVER id=%d:%08x service=%08x:%08x\n", msg->srv.node_id,
 	    msg->srv.port_id, msg->srv.service, msg->srv.instance);
-	down_write(&routing_table_lock_lha3);
+	mutex_lock(&routing_table_lock_lha3);
 	rt_entry = lookup_routing_table(msg->srv.node_id);
 	if (!rt_entry) {
 		rt_entry = alloc_routing_table_entry(msg->srv.node_id);
 		if (!rt_entry) {
-			up_write(&routing_table_lock_lha3);
+			mutex_unlock(&routing_table_lock_lha3);
 			pr_err("%s: rt_entry allocation failed\n", __func__);
 			return -ENOMEM;
 		}
@@ -1717,9 +1994,9 @@ static int process_new_server_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		up_write(&rt_entry->lock_lha4);
 		add_routing_table_entry(rt_entry);
 	}
-	up_write(&routing_table_lock_lha3);
+	mutex_unlock(&routing_table_lock_lha3);
 
-	down_write(&server_list_lock_lha2);
+	mutex_lock(&server_list_lock_lha2);
 	server = msm_ipc_router_lookup_server(msg->srv.service,
 			msg->srv.instance, msg->srv.node_id, msg->srv.port_id);
 	if (!server) {
@@ -1727,19 +2004,19 @@ static int process_new_server_msg(struct msm_ipc_router_xprt_info *xprt_info,
 				msg->srv.service, msg->srv.instance,
 				msg->srv.node_id, msg->srv.port_id, xprt_info);
 		if (!server) {
-			up_write(&server_list_lock_lha2);
+			mutex_unlock(&server_list_lock_lha2);
 			pr_err("%s: Server Create failed\n", __func__);
 			return -ENOMEM;
 		}
 
-		down_read(&routing_table_lock_lha3);
-		if (!msm_ipc_router_lookup_remote_port(
+		mutex_lock(&routing_table_lock_lha3);
+		if (!__msm_ipc_router_lookup_remote_port(
 				msg->srv.node_id, msg->srv.port_id)) {
 			rport_ptr = msm_ipc_router_create_remote_port(
 					msg->srv.node_id, msg->srv.port_id);
 			if (!rport_ptr) {
-				up_read(&routing_table_lock_lha3);
-				up_write(&server_list_lock_lha2);
+				mutex_unlock(&routing_table_lock_lha3);
+				mutex_unlock(&server_list_lock_lha2);
 				return -ENOMEM;
 			}
 			rport_ptr->server = server;
@@ -1747,9 +2024,9 @@ static int process_new_server_msg(struct msm_ipc_router_xprt_info *xprt_info,
 						msg->srv.service,
 						msg->srv.instance);
 		}
-		up_read(&routing_table_lock_lha3);
+		mutex_unlock(&routing_table_lock_lha3);
 	}
-	up_write(&server_list_lock_lha2);
+	mutex_unlock(&server_list_lock_lha2);
 
 	relay_ctl_msg(xprt_info, msg);
 	post_control_ports(pkt);
@@ -1763,7 +2040,7 @@ static int process_rmv_server_msg(struct msm_ipc_router_xprt_info *xprt_info,
 
 	RR("o REMOVE_SERVER service=%08x:%d\n",
 	    msg->srv.service, msg->srv.instance);
-	down_write(&server_list_lock_lha2);
+	mutex_lock(&server_list_lock_lha2);
 	server = msm_ipc_router_lookup_server(msg->srv.service,
 			msg->srv.instance, msg->srv.node_id, msg->srv.port_id);
 	if (server) {
@@ -1772,7 +2049,7 @@ static int process_rmv_server_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		relay_ctl_msg(xprt_info, msg);
 		post_control_ports(pkt);
 	}
-	up_write(&server_list_lock_lha2);
+	mutex_unlock(&server_list_lock_lha2);
 	return 0;
 }
 
@@ -1782,12 +2059,12 @@ static int process_rmv_client_msg(struct msm_ipc_router_xprt_info *xprt_info,
 	struct msm_ipc_router_remote_port *rport_ptr;
 
 	RR("o REMOVE_CLIENT id=%d:%08x\n", msg->cli.node_id, msg->cli.port_id);
-	down_write(&routing_table_lock_lha3);
-	rport_ptr = msm_ipc_router_lookup_remote_port(msg->cli.node_id,
-						      msg->cli.port_id);
+	mutex_lock(&routing_table_lock_lha3);
+	rport_ptr = __msm_ipc_router_lookup_remote_port(msg->cli.node_id,
+							msg->cli.port_id);
 	if (rport_ptr)
 		msm_ipc_router_destroy_remote_port(rport_ptr);
-	up_write(&routing_table_lock_lha3);
+	mutex_unlock(&routing_table_lock_lha3);
 
 	relay_ctl_msg(xprt_info, msg);
 	post_control_ports(pkt);
@@ -1901,36 +2178,38 @@ static void do_read_data(struct work_struct *work)
 #endif
 #endif
 
-		down_read(&local_ports_lock_lha2);
 		port_ptr = msm_ipc_router_lookup_local_port(hdr->dst_port_id);
 		if (!port_ptr) {
 			pr_err("%s: No local port id %08x\n", __func__,
 				hdr->dst_port_id);
-			up_read(&local_ports_lock_lha2);
 			release_pkt(pkt);
 			return;
 		}
 
-		down_read(&routing_table_lock_lha3);
-		rport_ptr = msm_ipc_router_lookup_remote_port(hdr->src_node_id,
-							hdr->src_port_id);
+		rcu_read_lock();
+		rport_ptr = __msm_ipc_router_lookup_remote_port(
+				hdr->src_node_id, hdr->src_port_id);
+		rcu_read_unlock();
 		if (!rport_ptr) {
-			rport_ptr = msm_ipc_router_create_remote_port(
+			mutex_lock(&routing_table_lock_lha3);
+			rport_ptr = __msm_ipc_router_lookup_remote_port(
+					hdr->src_node_id, hdr->src_port_id);
+			if (!rport_ptr)
+				rport_ptr = msm_ipc_router_create_remote_port(
 							hdr->src_node_id,
 							hdr->src_port_id);
+			mutex_unlock(&routing_table_lock_lha3);
 			if (!rport_ptr) {
 				pr_err("%s: Rmt Prt %08x:%08x create failed\n",
 					__func__, hdr->src_node_id,
 					hdr->src_port_id);
-				up_read(&routing_table_lock_lha3);
-				up_read(&local_ports_lock_lha2);
+				msm_ipc_router_put_local_port(port_ptr);
 				release_pkt(pkt);
 				return;
 			}
 		}
-		up_read(&routing_table_lock_lha3);
 		post_pkt_to_port(port_ptr, pkt, 0);
-		up_read(&local_ports_lock_lha2);
+		msm_ipc_router_put_local_port(port_ptr);
 	}
 	return;
 
@@ -1952,13 +2231,13 @@ int msm_ipc_router_register_server(struct msm_ipc_port *port_ptr,
 	if (name->addrtype != MSM_IPC_ADDR_NAME)
 		return -EINVAL;
 
-	down_write(&server_list_lock_lha2);
+	mutex_lock(&server_list_lock_lha2);
 	server = msm_ipc_router_lookup_server(name->addr.port_name.service,
 					      name->addr.port_name.instance,
 					      IPC_ROUTER_NID_LOCAL,
 					      port_ptr->this_port.port_id);
 	if (server) {
-		up_write(&server_list_lock_lha2);
+		mutex_unlock(&server_list_lock_lha2);
 		pr_err("%s: Server already present\n", __func__);
 		return -EINVAL;
 	}
@@ -1969,7 +2248,7 @@ int msm_ipc_router_register_server(struct msm_ipc_port *port_ptr,
 					      port_ptr->this_port.port_id,
 					      NULL);
 	if (!server) {
-		up_write(&server_list_lock_lha2);
+		mutex_unlock(&server_list_lock_lha2);
 		pr_err("%s: Server Creation failed\n", __func__);
 		return -EINVAL;
 	}
@@ -1980,7 +2259,7 @@ int msm_ipc_router_register_server(struct msm_ipc_port *port_ptr,
 	ctl.srv.instance = server->name.instance;
 	ctl.srv.node_id = IPC_ROUTER_NID_LOCAL;
 	ctl.srv.port_id = port_ptr->this_port.port_id;
-	up_write(&server_list_lock_lha2);
+	mutex_unlock(&server_list_lock_lha2);
 	broadcast_ctl_msg(&ctl);
 	broadcast_ctl_msg_locally(&ctl);
 	spin_lock_irqsave(&port_ptr->port_lock, flags);
@@ -2013,13 +2292,13 @@ int msm_ipc_router_unregister_server(struct msm_ipc_port *port_ptr)
 		return -EINVAL;
 	}
 
-	down_write(&server_list_lock_lha2);
+	mutex_lock(&server_list_lock_lha2);
 	server = msm_ipc_router_lookup_server(port_ptr->port_name.service,
 					      port_ptr->port_name.instance,
 					      port_ptr->this_port.node_id,
 					      port_ptr->this_port.port_id);
 	if (!server) {
-		up_write(&server_list_lock_lha2);
+		mutex_unlock(&server_list_lock_lha2);
 		pr_err("%s: Server lookup failed\n", __func__);
 		return -ENODEV;
 	}
@@ -2032,7 +2311,7 @@ int msm_ipc_router_unregister_server(struct msm_ipc_port *port_ptr)
 	ctl.srv.port_id = port_ptr->this_port.port_id;
 	msm_ipc_router_destroy_server(server, port_ptr->this_port.node_id,
 				      port_ptr->this_port.port_id);
-	up_write(&server_list_lock_lha2);
+	mutex_unlock(&server_list_lock_lha2);
 	broadcast_ctl_msg(&ctl);
 	broadcast_ctl_msg_locally(&ctl);
 	spin_lock_irqsave(&port_ptr->port_lock, flags);
@@ -2070,11 +2349,9 @@ static int loopback_data(struct msm_ipc_port *src,
 	hdr->dst_node_id = IPC_ROUTER_NID_LOCAL;
 	hdr->dst_port_id = port_id;
 
-	down_read(&local_ports_lock_lha2);
 	port_ptr = msm_ipc_router_lookup_local_port(port_id);
 	if (!port_ptr) {
 		pr_err("%s: Local port %d not present\n", __func__, port_id);
-		up_read(&local_ports_lock_lha2);
 		pkt->pkt_fragment_q = NULL;
 		release_pkt(pkt);
 		return -ENODEV;
@@ -2083,7 +2360,7 @@ static int loopback_data(struct msm_ipc_port *src,
 	ret_len = pkt->length;
 	post_pkt_to_port(port_ptr, pkt, 0);
 	update_comm_mode_info(&src->mode_info, NULL);
-	up_read(&local_ports_lock_lha2);
+	msm_ipc_router_put_local_port(port_ptr);
 
 	return ret_len;
 }
@@ -2142,43 +2419,48 @@ static int msm_ipc_router_write_pkt(struct msm_ipc_port *src,
 		hdr->control_flag |= CONTROL_FLAG_CONFIRM_RX;
 	mutex_unlock(&rport_ptr->quota_lock_lhb2);
 
-	rt_entry = lookup_routing_table(hdr->dst_node_id);
-	if (!rt_entry || !rt_entry->xprt_info) {
+	rt_entry = get_routing_table_entry(hdr->dst_node_id);
+	if (!rt_entry) {
 		pr_err("%s: Remote node %d not up\n",
 			__func__, hdr->dst_node_id);
 		return -ENODEV;
 	}
 	down_read(&rt_entry->lock_lha4);
 	xprt_info = rt_entry->xprt_info;
+	if (!xprt_info) {
+		pr_err("%s: Remote node %d not up\n",
+			__func__, hdr->dst_node_id);
+		ret = -ENODEV;
+		goto out_write_pkt;
+	}
 	ret = prepend_header(pkt, xprt_info);
 	if (ret < 0) {
-		up_read(&rt_entry->lock_lha4);
 		pr_err("%s: Prepend Header failed\n", __func__);
-		return ret;
+		goto out_write_pkt;
 	}
 	xprt_option = xprt_info->xprt->get_option(xprt_info->xprt);
 	if (!(xprt_option & FRAG_PKT_WRITE_ENABLE)) {
 		ret = defragment_pkt(pkt);
-		if (ret < 0) {
-			up_read(&rt_entry->lock_lha4);
-			return ret;
-		}
+		if (ret < 0)
+			goto out_write_pkt;
 	}
 
 	temp_skb = skb_peek_tail(pkt->pkt_fragment_q);
 	align_size = ALIGN_SIZE(pkt->length);
-	skb_put(temp_skb, align_size);
+	msm_ipc_router_pad_skb(temp_skb, align_size);
 	pkt->length += align_size;
 	mutex_lock(&xprt_info->tx_lock_lhb2);
 	ret = xprt_info->xprt->write(pkt, pkt->length, xprt_info->xprt);
 	mutex_unlock(&xprt_info->tx_lock_lhb2);
-	up_read(&rt_entry->lock_lha4);
-
-	if (ret < 0) {
+	if (ret < 0)
 		pr_err("%s: Write on XPRT failed\n", __func__);
+	else
+		update_comm_mode_info(&src->mode_info, xprt_info);
+out_write_pkt:
+	up_read(&rt_entry->lock_lha4);
+	put_routing_table_entry(rt_entry);
+	if (ret < 0)
 		return ret;
-	}
-	update_comm_mode_info(&src->mode_info, xprt_info);
 
 	RAW_HDR("[w rr_h] "
 		"ver=%i,type=%s,src_nid=%08x,src_port_id=%08x,"
@@ -2228,33 +2510,32 @@ int msm_ipc_router_send_to(struct msm_ipc_port *src,
 		dst_node_id = dest->addr.port_addr.node_id;
 		dst_port_id = dest->addr.port_addr.port_id;
 	} else if (dest->addrtype == MSM_IPC_ADDR_NAME) {
-		down_read(&server_list_lock_lha2);
+		rcu_read_lock();
 		server = msm_ipc_router_lookup_server(
 					dest->addr.port_name.service,
 					dest->addr.port_name.instance,
 					0, 0);
-		if (!server) {
-			up_read(&server_list_lock_lha2);
+		server_port = server ? list_first_or_null_rcu(
+					&server->server_port_list,
+					struct msm_ipc_server_port,
+					list) : NULL;
+		if (!server_port) {
+			rcu_read_unlock();
 			pr_err("%s: Destination not reachable\n", __func__);
 			return -ENODEV;
 		}
-		server_port = list_first_entry(&server->server_port_list,
-					       struct msm_ipc_server_port,
-					       list);
 		dst_node_id = server_port->server_addr.node_id;
 		dst_port_id = server_port->server_addr.port_id;
-		up_read(&server_list_lock_lha2);
+		rcu_read_unlock();
 	}
 	if (dst_node_id == IPC_ROUTER_NID_LOCAL) {
 		ret = loopback_data(src, dst_port_id, data);
 		return ret;
 	}
 
-	down_read(&routing_table_lock_lha3);
 	rport_ptr = msm_ipc_router_lookup_remote_port(dst_node_id,
 						      dst_port_id);
 	if (!rport_ptr) {
-		up_read(&routing_table_lock_lha3);
 		pr_err("%s: Remote port not found\n", __func__);
 		return -ENODEV;
 	}
@@ -2262,7 +2543,7 @@ int msm_ipc_router_send_to(struct msm_ipc_port *src,
 	if (src->check_send_permissions) {
 		ret = src->check_send_permissions(rport_ptr->sec_rule);
 		if (ret <= 0) {
-			up_read(&routing_table_lock_lha3);
+			msm_ipc_router_put_remote_port(rport_ptr);
 			pr_err("%s: permission failure for %s\n",
 				__func__, current->comm);
 			return -EPERM;
@@ -2271,13 +2552,13 @@ int msm_ipc_router_send_to(struct msm_ipc_port *src,
 
 	pkt = create_pkt(data);
 	if (!pkt) {
-		up_read(&routing_table_lock_lha3);
+		msm_ipc_router_put_remote_port(rport_ptr);
 		pr_err("%s: Pkt creation failed\n", __func__);
 		return -ENOMEM;
 	}
 
 	ret = msm_ipc_router_write_pkt(src, rport_ptr, pkt);
-	up_read(&routing_table_lock_lha3);
+	msm_ipc_router_put_remote_port(rport_ptr);
 	if (ret < 0)
 		pkt->pkt_fragment_q = NULL;
 	release_pkt(pkt);
@@ -2320,19 +2601,19 @@ static int msm_ipc_router_send_resume_tx(void *data)
 	msg.cmd = IPC_ROUTER_CTRL_CMD_RESUME_TX;
 	msg.cli.node_id = hdr->dst_node_id;
 	msg.cli.port_id = hdr->dst_port_id;
-	down_read(&routing_table_lock_lha3);
-	rt_entry = lookup_routing_table(hdr->src_node_id);
+	rt_entry = get_routing_table_entry(hdr->src_node_id);
 	if (!rt_entry) {
 		pr_err("%s: %d Node is not present",
 				__func__, hdr->src_node_id);
-		up_read(&routing_table_lock_lha3);
 		return -ENODEV;
 	}
 	RR("x RESUME_TX id=%d:%08x\n",
 			msg.cli.node_id, msg.cli.port_id);
+	down_read(&rt_entry->lock_lha4);
 	ret = msm_ipc_router_send_control_msg(rt_entry->xprt_info, &msg,
 						hdr->src_node_id);
-	up_read(&routing_table_lock_lha3);
+	up_read(&rt_entry->lock_lha4);
+	put_routing_table_entry(rt_entry);
 	if (ret < 0)
 		pr_err("%s: Send Resume_Tx Failed SRC_NODE: %d SRC_PORT: %d DEST_NODE: %d",
 			__func__, hdr->dst_node_id, hdr->dst_port_id,
@@ -2433,11 +2714,13 @@ int msm_ipc_router_recv_from(struct msm_ipc_port *port_ptr,
 		src->addr.port_addr.port_id = hdr->src_port_id;
 	}
 
+	/* locally looped back packets never got padded */
 	data_len = hdr->size;
-	align_size = ALIGN_SIZE(data_len);
-	if (align_size) {
+	align_size = (*pkt)->length - data_len;
+	if (align_size > 0) {
 		temp_skb = skb_peek_tail((*pkt)->pkt_fragment_q);
-		skb_trim(temp_skb, (temp_skb->len - align_size));
+		pskb_trim(temp_skb, (temp_skb->len - align_size));
+		(*pkt)->length = data_len;
 	}
 	return data_len;
 }
@@ -2497,9 +2780,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		return -EINVAL;
 
 	if (port_ptr->type == SERVER_PORT || port_ptr->type == CLIENT_PORT) {
-		down_write(&local_ports_lock_lha2);
-		list_del(&port_ptr->list);
-		up_write(&local_ports_lock_lha2);
+		msm_ipc_router_del_local_port(port_ptr);
 
 		if (port_ptr->type == SERVER_PORT) {
 			memset(&msg, 0, sizeof(msg));
@@ -2525,12 +2806,14 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		list_del(&port_ptr->list);
 		up_write(&control_ports_lock_lha5);
 	} else if (port_ptr->type == IRSC_PORT) {
-		down_write(&local_ports_lock_lha2);
-		list_del(&port_ptr->list);
-		up_write(&local_ports_lock_lha2);
+		msm_ipc_router_del_local_port(port_ptr);
 		signal_irsc_completion();
 	}
 
+	/* wait for the packets being posted to the port */
+	msm_ipc_router_put_local_port(port_ptr);
+	wait_event(local_port_release_wait_q, !atomic_read(&port_ptr->ref));
+
 	mutex_lock(&port_ptr->port_rx_q_lock_lhb3);
 	list_for_each_entry_safe(pkt, temp_pkt, &port_ptr->port_rx_q, list) {
 		list_del(&pkt->list);
@@ -2539,7 +2822,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 	mutex_unlock(&port_ptr->port_rx_q_lock_lhb3);
 
 	if (port_ptr->type == SERVER_PORT) {
-		down_write(&server_list_lock_lha2);
+		mutex_lock(&server_list_lock_lha2);
 		server = msm_ipc_router_lookup_server(
 				port_ptr->port_name.service,
 				port_ptr->port_name.instance,
@@ -2549,11 +2832,11 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 			msm_ipc_router_destroy_server(server,
 				port_ptr->this_port.node_id,
 				port_ptr->this_port.port_id);
-		up_write(&server_list_lock_lha2);
+		mutex_unlock(&server_list_lock_lha2);
 	}
 
 	wake_lock_destroy(&port_ptr->port_rx_wake_lock);
-	kfree(port_ptr);
+	kfree_rcu(port_ptr, rcu);
 	return 0;
 }
 
@@ -2581,9 +2864,7 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 	if (unlikely(!port_ptr || port_ptr->type != CLIENT_PORT))
 		return -EINVAL;
 
-	down_write(&local_ports_lock_lha2);
-	list_del(&port_ptr->list);
-	up_write(&local_ports_lock_lha2);
+	msm_ipc_router_del_local_port(port_ptr);
 	port_ptr->type = CONTROL_PORT;
 	down_write(&control_ports_lock_lha5);
 	list_add_tail(&port_ptr->list, &control_ports);
@@ -2597,9 +2878,11 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 				int num_entries_in_array,
 				uint32_t lookup_mask)
 {
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
-	int key, i = 0; 
+	struct hlist_node *pos;
+	int i = 0;
 
 	if (!srv_name) {
 		pr_err("%s: Invalid srv_name\n", __func__);
@@ -2611,17 +2894,18 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 		return -EINVAL;
 	}
 
-	down_read(&server_list_lock_lha2);
+	rcu_read_lock();
 	if (!lookup_mask)
 		lookup_mask = 0xFFFFFFFF;
-	key = (srv_name->service & (SRV_HASH_SIZE - 1));
-	list_for_each_entry(server, &server_list[key], list) {
+	table = rcu_dereference(server_list);
+	rtr_hash_for_each_possible(table, server, pos, srv_name->service,
+				   hnode) {
 		if ((server->name.service != srv_name->service) ||
 		    ((server->name.instance & lookup_mask) !=
 			srv_name->instance))
 			continue;
 
-		list_for_each_entry(server_port,
+		list_for_each_entry_rcu(server_port,
 			&server->server_port_list, list) {
 			if (i < num_entries_in_array) {
 				srv_info[i].node_id =
@@ -2634,7 +2918,7 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 			i++;
 		}
 	}
-	up_read(&server_list_lock_lha2);
+	rcu_read_unlock();
 
 	return i;
 }
@@ -2659,31 +2943,33 @@ static int dump_routing_table(char *buf, int max)
 {
 	int i = 0, j;
 	struct msm_ipc_routing_table_entry *rt_entry;
-
-	for (j = 0; j < RT_HASH_SIZE; j++) {
-		down_read(&routing_table_lock_lha3);
-		list_for_each_entry(rt_entry, &routing_table[j], list) {
-			down_read(&rt_entry->lock_lha4);
+	struct msm_ipc_router_hash_table *table;
+	struct hlist_node *pos;
+
+	mutex_lock(&routing_table_lock_lha3);
+	table = rcu_dereference_protected(routing_table,
+			lockdep_is_held(&routing_table_lock_lha3));
+	rtr_hash_for_each(table, rt_entry, pos, j, hnode) {
+		down_read(&rt_entry->lock_lha4);
+		i += scnprintf(buf + i, max - i,
+			       "Node Id: 0x%08x\n", rt_entry->node_id);
+		if (rt_entry->node_id == IPC_ROUTER_NID_LOCAL) {
 			i += scnprintf(buf + i, max - i,
-				       "Node Id: 0x%08x\n", rt_entry->node_id);
-			if (rt_entry->node_id == IPC_ROUTER_NID_LOCAL) {
-				i += scnprintf(buf + i, max - i,
-				       "XPRT Name: Loopback\n");
-				i += scnprintf(buf + i, max - i,
-				       "Next Hop: %d\n", rt_entry->node_id);
-			} else {
-				i += scnprintf(buf + i, max - i,
-					"XPRT Name: %s\n",
-					rt_entry->xprt_info->xprt->name);
-				i += scnprintf(buf + i, max - i,
-					"Next Hop: 0x%08x\n",
-					rt_entry->xprt_info->remote_node_id);
-			}
-			i += scnprintf(buf + i, max - i, "\n");
-			up_read(&rt_entry->lock_lha4);
+			       "XPRT Name: Loopback\n");
+			i += scnprintf(buf + i, max - i,
+			       "Next Hop: %d\n", rt_entry->node_id);
+		} else {
+			i += scnprintf(buf + i, max - i,
+				"XPRT Name: %s\n",
+				rt_entry->xprt_info->xprt->name);
+			i += scnprintf(buf + i, max - i,
+				"Next Hop: 0x%08x\n",
+				rt_entry->xprt_info->remote_node_id);
 		}
-		up_read(&routing_table_lock_lha3);
+		i += scnprintf(buf + i, max - i, "\n");
+		up_read(&rt_entry->lock_lha4);
 	}
+	mutex_unlock(&routing_table_lock_lha3);
 
 	return i;
 }
@@ -2713,30 +2999,32 @@ static int dump_xprt_info(char *buf, int max)
 static int dump_servers(char *buf, int max)
 {
 	int i = 0, j;
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
+	struct hlist_node *pos;
 
-	down_read(&server_list_lock_lha2);
-	for (j = 0; j < SRV_HASH_SIZE; j++) {
-		list_for_each_entry(server, &server_list[j], list) {
-			list_for_each_entry(server_port,
-					    &server->server_port_list,
-					    list) {
-				i += scnprintf(buf + i, max - i, "Service: "
-					"0x%08x\n", server->name.service);
-				i += scnprintf(buf + i, max - i, "Instance: "
-					"0x%08x\n", server->name.instance);
-				i += scnprintf(buf + i, max - i,
-					"Node_id: 0x%08x\n",
-					server_port->server_addr.node_id);
-				i += scnprintf(buf + i, max - i,
-					"Port_id: 0x%08x\n",
-					server_port->server_addr.port_id);
-				i += scnprintf(buf + i, max - i, "\n");
-			}
+	mutex_lock(&server_list_lock_lha2);
+	table = rcu_dereference_protected(server_list,
+			lockdep_is_held(&server_list_lock_lha2));
+	rtr_hash_for_each(table, server, pos, j, hnode) {
+		list_for_each_entry(server_port,
+				    &server->server_port_list,
+				    list) {
+			i += scnprintf(buf + i, max - i, "Service: "
+				"0x%08x\n", server->name.service);
+			i += scnprintf(buf + i, max - i, "Instance: "
+				"0x%08x\n", server->name.instance);
+			i += scnprintf(buf + i, max - i,
+				"Node_id: 0x%08x\n",
+				server_port->server_addr.node_id);
+			i += scnprintf(buf + i, max - i,
+				"Port_id: 0x%08x\n",
+				server_port->server_addr.port_id);
+			i += scnprintf(buf + i, max - i, "\n");
 		}
 	}
-	up_read(&server_list_lock_lha2);
+	mutex_unlock(&server_list_lock_lha2);
 
 	return i;
 }
@@ -2746,31 +3034,29 @@ static int dump_remote_ports(char *buf, int max)
 	int i = 0, j, k;
 	struct msm_ipc_router_remote_port *rport_ptr;
 	struct msm_ipc_routing_table_entry *rt_entry;
-
-	for (j = 0; j < RT_HASH_SIZE; j++) {
-		down_read(&routing_table_lock_lha3);
-		list_for_each_entry(rt_entry, &routing_table[j], list) {
-			down_read(&rt_entry->lock_lha4);
-			for (k = 0; k < RP_HASH_SIZE; k++) {
-				list_for_each_entry(rport_ptr,
-					&rt_entry->remote_port_list[k],
-					list) {
-					i += scnprintf(buf + i, max - i,
-						"Node_id: 0x%08x\n",
-						rport_ptr->node_id);
-					i += scnprintf(buf + i, max - i,
-						"Port_id: 0x%08x\n",
-						rport_ptr->port_id);
-					i += scnprintf(buf + i, max - i,
-						"Quota_cnt: %d\n",
-						rport_ptr->tx_quota_cnt);
-				i += scnprintf(buf + i, max - i, "\n");
-				}
-			}
-			up_read(&rt_entry->lock_lha4);
+	struct msm_ipc_router_hash_table *table, *rp_table;
+	struct hlist_node *pos, *rp_pos;
+
+	mutex_lock(&routing_table_lock_lha3);
+	table = rcu_dereference_protected(routing_table,
+			lockdep_is_held(&routing_table_lock_lha3));
+	rtr_hash_for_each(table, rt_entry, pos, j, hnode) {
+		rp_table = rcu_dereference_protected(rt_entry->remote_ports,
+				lockdep_is_held(&routing_table_lock_lha3));
+		rtr_hash_for_each(rp_table, rport_ptr, rp_pos, k, hnode) {
+			i += scnprintf(buf + i, max - i,
+				"Node_id: 0x%08x\n",
+				rport_ptr->node_id);
+			i += scnprintf(buf + i, max - i,
+				"Port_id: 0x%08x\n",
+				rport_ptr->port_id);
+			i += scnprintf(buf + i, max - i,
+				"Quota_cnt: %d\n",
+				rport_ptr->tx_quota_cnt);
+			i += scnprintf(buf + i, max - i, "\n");
 		}
-		up_read(&routing_table_lock_lha3);
 	}
+	mutex_unlock(&routing_table_lock_lha3);
 
 	return i;
 }
@@ -2797,33 +3083,41 @@ static int dump_local_ports(char *buf, int max)
 {
 	int i = 0, j;
 	unsigned long flags;
+	struct msm_ipc_router_hash_table *table;
 	struct msm_ipc_port *port_ptr;
+	struct hlist_node *pos;
 
-	down_read(&local_ports_lock_lha2);
-	for (j = 0; j < LP_HASH_SIZE; j++) {
-		list_for_each_entry(port_ptr, &local_ports[j], list) {
-			spin_lock_irqsave(&port_ptr->port_lock, flags);
-			i += scnprintf(buf + i, max - i, "Node_id: 0x%08x\n",
-				       port_ptr->this_port.node_id);
-			i += scnprintf(buf + i, max - i, "Port_id: 0x%08x\n",
-				       port_ptr->this_port.port_id);
-			i += scnprintf(buf + i, max - i, "# pkts tx'd %d\n",
-				       port_ptr->num_tx);
-			i += scnprintf(buf + i, max - i, "# pkts rx'd %d\n",
-				       port_ptr->num_rx);
-			i += scnprintf(buf + i, max - i, "# bytes tx'd %ld\n",
-				       port_ptr->num_tx_bytes);
-			i += scnprintf(buf + i, max - i, "# bytes rx'd %ld\n",
-				       port_ptr->num_rx_bytes);
-			spin_unlock_irqrestore(&port_ptr->port_lock, flags);
-			i += scnprintf(buf + i, max - i, "\n");
-		}
+	mutex_lock(&local_ports_lock_lha2);
+	table = rcu_dereference_protected(local_ports,
+			lockdep_is_held(&local_ports_lock_lha2));
+	rtr_hash_for_each(table, port_ptr, pos, j, hnode) {
+		spin_lock_irqsave(&port_ptr->port_lock, flags);
+		i += scnprintf(buf + i, max - i, "Node_id: 0x%08x\n",
+			       port_ptr->this_port.node_id);
+		i += scnprintf(buf + i, max - i, "Port_id: 0x%08x\n",
+			       port_ptr->this_port.port_id);
+		i += scnprintf(buf + i, max - i, "# pkts tx'd %d\n",
+			       port_ptr->num_tx);
+		i += scnprintf(buf + i, max - i, "# pkts rx'd %d\n",
+			       port_ptr->num_rx);
+		i += scnprintf(buf + i, max - i, "# bytes tx'd %ld\n",
+			       port_ptr->num_tx_bytes);
+		i += scnprintf(buf + i, max - i, "# bytes rx'd %ld\n",
+			       port_ptr->num_rx_bytes);
+		spin_unlock_irqrestore(&port_ptr->port_lock, flags);
+		i += scnprintf(buf + i, max - i, "\n");
 	}
-	up_read(&local_ports_lock_lha2);
+	mutex_unlock(&local_ports_lock_lha2);
 
 	return i;
 }
 
+static int dump_bytes_copied(char *buf, int max)
+{
+	return scnprintf(buf, max, "%llu\n",
+			 msm_ipc_router_get_bytes_copied());
+}
+
 #define DEBUG_BUFMAX 4096
 static char debug_buffer[DEBUG_BUFMAX];
 
@@ -2873,6 +3167,8 @@ static void debugfs_init(void)
 		      dump_xprt_info);
 	debug_create("dump_routing_table", 0444, dent,
 		      dump_routing_table);
+	debug_create("bytes_copied", 0444, dent,
+		      dump_bytes_copied);
 }
 
 #else
@@ -2917,14 +3213,13 @@ static int msm_ipc_router_add_xprt(struct msm_ipc_router_xprt *xprt)
 	list_add_tail(&xprt_info->list, &xprt_info_list);
 	up_write(&xprt_info_list_lock_lha5);
 
-	down_write(&routing_table_lock_lha3);
-	if (!routing_table_inited) {
-		init_routing_table();
+	mutex_lock(&routing_table_lock_lha3);
+	if (!routing_table_inited && !init_routing_table()) {
 		rt_entry = alloc_routing_table_entry(IPC_ROUTER_NID_LOCAL);
 		add_routing_table_entry(rt_entry);
 		routing_table_inited = 1;
 	}
-	up_write(&routing_table_lock_lha3);
+	mutex_unlock(&routing_table_lock_lha3);
 
 	xprt->priv = xprt_info;
 
@@ -3050,8 +3345,9 @@ void msm_ipc_router_xprt_notify(struct msm_ipc_router_xprt *xprt,
 
 static int __init msm_ipc_router_init(void)
 {
-	int i, ret;
+	int ret;
 	struct msm_ipc_routing_table_entry *rt_entry;
+	struct msm_ipc_router_hash_table *table;
 
 	msm_ipc_router_debug_mask |= SMEM_LOG;
 	ipc_rtr_log_ctxt = ipc_log_context_create(IPC_RTR_LOG_PAGES,
@@ -3067,20 +3363,23 @@ static int __init msm_ipc_router_init(void)
 
 	debugfs_init();
 
-	for (i = 0; i < SRV_HASH_SIZE; i++)
-		INIT_LIST_HEAD(&server_list[i]);
+	table = rtr_hash_alloc(SRV_HASH_SIZE);
+	if (!table)
+		return -ENOMEM;
+	rcu_assign_pointer(server_list, table);
 
-	for (i = 0; i < LP_HASH_SIZE; i++)
-		INIT_LIST_HEAD(&local_ports[i]);
+	table = rtr_hash_alloc(LP_HASH_SIZE);
+	if (!table)
+		return -ENOMEM;
+	rcu_assign_pointer(local_ports, table);
 
-	down_write(&routing_table_lock_lha3);
-	if (!routing_table_inited) {
-		init_routing_table();
+	mutex_lock(&routing_table_lock_lha3);
+	if (!routing_table_inited && !init_routing_table()) {
 		rt_entry = alloc_routing_table_entry(IPC_ROUTER_NID_LOCAL);
 		add_routing_table_entry(rt_entry);
 		routing_table_inited = 1;
 	}
-	up_write(&routing_table_lock_lha3);
+	mutex_unlock(&routing_table_lock_lha3);
 
 	ret = msm_ipc_router_init_sockets();
 	if (ret < 0)
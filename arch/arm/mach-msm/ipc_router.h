@@ -63,6 +63,11 @@
 #define CONTROL_FLAG_CONFIRM_RX 0x1
 #define CONTROL_FLAG_OPT_HDR 0x2
 
+/*
+ * The transport takes a packet spread over several skbs, which may carry
+ * part of their payload in page fragments.  Other transports are handed a
+ * single linear skb.
+ */
 #define FRAG_PKT_WRITE_ENABLE 0x1
 
 enum {
@@ -257,5 +262,7 @@ static inline void *msm_ipc_load_default_node(void)
 static inline void msm_ipc_unload_default_node(void *pil) { }
 #endif
 
+struct sk_buff *msm_ipc_router_alloc_skb(unsigned int len, gfp_t gfp);
+void msm_ipc_router_count_copy(unsigned int len);
 void msm_ipc_router_free_skb(struct sk_buff_head *skb_head);
 #endif
@@ -0,0 +1,469 @@
+/* Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * IPC Router benchmark.
+ *
+ * Bounces messages off an echo server, by default the one of the loopback
+ * transport, through the kernel client API.  For every message size the
+ * round trip latency, the message rate, the CPU time spent per round
+ * trip on all CPUs and the payload bytes IPC Router copied per round trip
+ * are measured.  Writing "run" to the debugfs file starts
+ * a run, reading it gives the results of the last one.
+ *
+ * Writing "clients" measures how the router scales with concurrent
+ * clients: for 1, 2, 4... up to the clients parameter, every client thread
+ * first looks up the echo server by name in a loop, then bounces mt_size
+ * byte messages off it through a port of its own.  Reported are the total
+ * lookup rate, the time per lookup and the total message rate.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/errno.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/wait.h>
+#include <linux/kernel_stat.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+
+#include <asm/uaccess.h>
+
+#include <mach/msm_ipc_router.h>
+
+#define BENCH_RESULTS_SZ PAGE_SIZE
+#define BENCH_RX_TIMEOUT (5 * HZ)
+#define BENCH_MAX_CLIENTS 16
+
+static uint bench_service = 4096;
+module_param_named(service, bench_service, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_instance = 1;
+module_param_named(instance, bench_instance, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_duration_ms = 1000;
+module_param_named(duration_ms, bench_duration_ms, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_sizes[16] = { 16, 64, 256, 1024, 4096, 16384, 65536 };
+static int bench_nr_sizes = 7;
+module_param_array_named(sizes, bench_sizes, uint, &bench_nr_sizes,
+			 S_IRUGO | S_IWUSR);
+
+static uint bench_clients = 4;
+module_param_named(clients, bench_clients, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_mt_size = 64;
+module_param_named(mt_size, bench_mt_size, uint, S_IRUGO | S_IWUSR);
+
+static struct dentry *bench_dent;
+static DEFINE_MUTEX(bench_lock);
+static char *bench_results;
+static size_t bench_results_len;
+
+struct bench_client {
+	struct msm_ipc_port *port;
+	struct msm_ipc_addr dest;
+	wait_queue_head_t wait_q;
+	atomic_t rx_pending;
+	atomic_t resume_tx;
+	int (*fn)(struct bench_client *client);
+	struct completion done;
+	u64 count;
+	s64 elapsed;
+	int ret;
+};
+
+static void bench_notify(unsigned event, void *priv)
+{
+	struct bench_client *client = priv;
+
+	if (event == MSM_IPC_ROUTER_READ_CB)
+		atomic_inc(&client->rx_pending);
+	else if (event == MSM_IPC_ROUTER_RESUME_TX)
+		atomic_set(&client->resume_tx, 1);
+	else
+		return;
+	wake_up(&client->wait_q);
+}
+
+static int bench_open_client(struct bench_client *client,
+			     struct msm_ipc_addr *dest)
+{
+	init_waitqueue_head(&client->wait_q);
+	atomic_set(&client->rx_pending, 0);
+	atomic_set(&client->resume_tx, 0);
+	init_completion(&client->done);
+	client->dest = *dest;
+	client->port = msm_ipc_router_create_port(bench_notify, client);
+	return client->port ? 0 : -ENOMEM;
+}
+
+/* busy time of all CPUs, in microseconds */
+static u64 bench_cpu_busy_us(void)
+{
+	u64 busy = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+		busy += cpustat[CPUTIME_USER] + cpustat[CPUTIME_NICE] +
+			cpustat[CPUTIME_SYSTEM] + cpustat[CPUTIME_IRQ] +
+			cpustat[CPUTIME_SOFTIRQ];
+	}
+	return cputime64_to_jiffies64(busy) * (USEC_PER_SEC / HZ);
+}
+
+static int bench_send(struct bench_client *client, void *buf,
+		      unsigned int len)
+{
+	int ret;
+
+	while ((ret = msm_ipc_router_send_msg(client->port, &client->dest,
+					      buf, len)) == -EAGAIN) {
+		if (!wait_event_timeout(client->wait_q,
+				atomic_xchg(&client->resume_tx, 0),
+				BENCH_RX_TIMEOUT))
+			return -ETIMEDOUT;
+	}
+	return ret;
+}
+
+static int bench_recv(struct bench_client *client, unsigned int len)
+{
+	unsigned char *data = NULL;
+	unsigned int data_len;
+	int ret;
+
+	if (!wait_event_timeout(client->wait_q,
+				atomic_add_unless(&client->rx_pending, -1, 0),
+				BENCH_RX_TIMEOUT))
+		return -ETIMEDOUT;
+
+	ret = msm_ipc_router_read_msg(client->port, NULL, &data, &data_len);
+	if (ret < 0)
+		return ret;
+	kfree(data);
+	return data_len == len ? 0 : -EIO;
+}
+
+static int bench_one_size(struct bench_client *client, unsigned int len,
+			  char *out, size_t out_len)
+{
+	s64 start, t0, rtt, rtt_min = LLONG_MAX, rtt_max = 0, elapsed;
+	u64 busy, copied, count = 0;
+	void *buf;
+	int ret = 0;
+
+	buf = kzalloc(len, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	busy = bench_cpu_busy_us();
+	copied = msm_ipc_router_get_bytes_copied();
+	start = ktime_to_ns(ktime_get());
+	do {
+		t0 = ktime_to_ns(ktime_get());
+		ret = bench_send(client, buf, len);
+		if (ret < 0)
+			break;
+		ret = bench_recv(client, len);
+		if (ret < 0)
+			break;
+		rtt = ktime_to_ns(ktime_get()) - t0;
+		rtt_min = min(rtt_min, rtt);
+		rtt_max = max(rtt_max, rtt);
+		count++;
+		elapsed = ktime_to_ns(ktime_get()) - start;
+	} while (elapsed < (s64)bench_duration_ms * NSEC_PER_MSEC);
+	busy = bench_cpu_busy_us() - busy;
+	copied = msm_ipc_router_get_bytes_copied() - copied;
+	kfree(buf);
+
+	if (ret < 0)
+		return scnprintf(out, out_len, "%8u error %d\n", len, ret);
+
+	return scnprintf(out, out_len,
+		"%8u %10llu %10lld %10lld %10lld %10llu %10llu\n",
+		len, div64_u64(count * NSEC_PER_SEC, elapsed),
+		div_s64(rtt_min, NSEC_PER_USEC),
+		div_s64(div64_u64(elapsed, count), NSEC_PER_USEC),
+		div_s64(rtt_max, NSEC_PER_USEC),
+		div64_u64(busy, count), div64_u64(copied, count));
+}
+
+static int bench_lookup_dest(struct msm_ipc_addr *dest)
+{
+	struct msm_ipc_port_name name;
+	struct msm_ipc_server_info srv_info;
+	int ret;
+
+	name.service = bench_service;
+	name.instance = bench_instance;
+	ret = msm_ipc_router_lookup_server_name(&name, &srv_info, 1, 0);
+	if (ret <= 0) {
+		pr_err("%s: Server %08x:%08x not found\n",
+			__func__, bench_service, bench_instance);
+		return -ENODEV;
+	}
+	dest->addrtype = MSM_IPC_ADDR_ID;
+	dest->addr.port_addr.node_id = srv_info.node_id;
+	dest->addr.port_addr.port_id = srv_info.port_id;
+	return 0;
+}
+
+static int bench_run(void)
+{
+	struct bench_client client;
+	struct msm_ipc_addr dest;
+	size_t len;
+	int i, ret;
+
+	ret = bench_lookup_dest(&dest);
+	if (ret < 0)
+		return ret;
+	ret = bench_open_client(&client, &dest);
+	if (ret < 0)
+		return ret;
+
+	len = scnprintf(bench_results, BENCH_RESULTS_SZ,
+			"server %d:%08x\n%8s %10s %10s %10s %10s %10s %10s\n",
+			dest.addr.port_addr.node_id,
+			dest.addr.port_addr.port_id, "size", "msgs/s",
+			"min_us", "avg_us", "max_us", "cpu_us", "copied_b");
+	for (i = 0; i < bench_nr_sizes; i++)
+		len += bench_one_size(&client, bench_sizes[i],
+				      bench_results + len,
+				      BENCH_RESULTS_SZ - len);
+	bench_results_len = len;
+
+	msm_ipc_router_close_port(client.port);
+	return 0;
+}
+
+static int bench_lookup_loop(struct bench_client *client)
+{
+	struct msm_ipc_port_name name;
+	struct msm_ipc_server_info srv_info;
+	s64 start = ktime_to_ns(ktime_get());
+	int i;
+
+	name.service = bench_service;
+	name.instance = bench_instance;
+	do {
+		for (i = 0; i < 64; i++) {
+			if (msm_ipc_router_lookup_server_name(&name, &srv_info,
+							      1, 0) <= 0)
+				return -ENODEV;
+		}
+		client->count += i;
+		client->elapsed = ktime_to_ns(ktime_get()) - start;
+	} while (client->elapsed < (s64)bench_duration_ms * NSEC_PER_MSEC);
+	return 0;
+}
+
+static int bench_echo_loop(struct bench_client *client)
+{
+	s64 start = ktime_to_ns(ktime_get());
+	void *buf;
+	int ret;
+
+	buf = kzalloc(bench_mt_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	do {
+		ret = bench_send(client, buf, bench_mt_size);
+		if (ret < 0)
+			break;
+		ret = bench_recv(client, bench_mt_size);
+		if (ret < 0)
+			break;
+		client->count++;
+		client->elapsed = ktime_to_ns(ktime_get()) - start;
+	} while (client->elapsed < (s64)bench_duration_ms * NSEC_PER_MSEC);
+	kfree(buf);
+	return ret;
+}
+
+static int bench_client_thread(void *data)
+{
+	struct bench_client *client = data;
+
+	client->ret = client->fn(client);
+	complete(&client->done);
+	return 0;
+}
+
+/*
+ * Runs fn on nr clients at once and returns the sum of their rates in
+ * operations per second, or a negative error.
+ */
+static s64 bench_clients_run(struct bench_client *clients, int nr,
+			     int (*fn)(struct bench_client *client))
+{
+	struct task_struct *task;
+	u64 rate = 0;
+	int i, ret = 0;
+
+	for (i = 0; i < nr; i++) {
+		clients[i].fn = fn;
+		clients[i].count = 0;
+		clients[i].elapsed = 0;
+		clients[i].ret = 0;
+		INIT_COMPLETION(clients[i].done);
+	}
+	for (i = 0; i < nr; i++) {
+		task = kthread_run(bench_client_thread, &clients[i],
+				   "ipc_bench/%d", i);
+		if (IS_ERR(task)) {
+			clients[i].ret = PTR_ERR(task);
+			complete(&clients[i].done);
+		}
+	}
+	for (i = 0; i < nr; i++) {
+		wait_for_completion(&clients[i].done);
+		if (clients[i].ret < 0)
+			ret = clients[i].ret;
+		else if (clients[i].elapsed)
+			rate += div64_u64(clients[i].count * NSEC_PER_SEC,
+					  clients[i].elapsed);
+	}
+	return ret < 0 ? ret : (s64)rate;
+}
+
+static int bench_run_clients(void)
+{
+	struct bench_client *clients;
+	struct msm_ipc_addr dest;
+	s64 lookups, msgs;
+	unsigned int i, nr, nr_clients;
+	size_t len;
+	int ret;
+
+	nr_clients = clamp(bench_clients, 1U, (unsigned int)BENCH_MAX_CLIENTS);
+	ret = bench_lookup_dest(&dest);
+	if (ret < 0)
+		return ret;
+
+	clients = kzalloc(nr_clients * sizeof(*clients), GFP_KERNEL);
+	if (!clients)
+		return -ENOMEM;
+	for (i = 0; i < nr_clients; i++) {
+		ret = bench_open_client(&clients[i], &dest);
+		if (ret < 0)
+			goto out;
+	}
+
+	len = scnprintf(bench_results, BENCH_RESULTS_SZ,
+			"server %d:%08x, %u byte messages\n%8s %12s %10s %10s\n",
+			dest.addr.port_addr.node_id,
+			dest.addr.port_addr.port_id, bench_mt_size,
+			"clients", "lookups/s", "lookup_ns", "msgs/s");
+	for (nr = 1; ; nr = min(2 * nr, nr_clients)) {
+		lookups = bench_clients_run(clients, nr, bench_lookup_loop);
+		msgs = bench_clients_run(clients, nr, bench_echo_loop);
+		if (lookups <= 0 || msgs < 0)
+			len += scnprintf(bench_results + len,
+					 BENCH_RESULTS_SZ - len,
+					 "%8u error %lld\n", nr,
+					 lookups <= 0 ? lookups : msgs);
+		else
+			len += scnprintf(bench_results + len,
+					 BENCH_RESULTS_SZ - len,
+					 "%8u %12lld %10llu %10lld\n", nr,
+					 lookups, div64_u64((u64)nr *
+						NSEC_PER_SEC, lookups), msgs);
+		if (nr == nr_clients)
+			break;
+	}
+	bench_results_len = len;
+	ret = 0;
+
+out:
+	for (i = 0; i < nr_clients; i++)
+		if (clients[i].port)
+			msm_ipc_router_close_port(clients[i].port);
+	kfree(clients);
+	return ret;
+}
+
+static ssize_t bench_read(struct file *file, char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&bench_lock);
+	ret = simple_read_from_buffer(buf, count, ppos, bench_results,
+				      bench_results_len);
+	mutex_unlock(&bench_lock);
+	return ret;
+}
+
+static ssize_t bench_write(struct file *file, const char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	char cmd[16];
+	size_t len = min(count, sizeof(cmd) - 1);
+	int ret;
+
+	if (copy_from_user(cmd, buf, len))
+		return -EFAULT;
+	cmd[len] = 0;
+
+	mutex_lock(&bench_lock);
+	if (!strcmp(strim(cmd), "run"))
+		ret = bench_run();
+	else if (!strcmp(strim(cmd), "clients"))
+		ret = bench_run_clients();
+	else
+		ret = -EINVAL;
+	mutex_unlock(&bench_lock);
+	return ret < 0 ? ret : count;
+}
+
+static const struct file_operations bench_ops = {
+	.owner = THIS_MODULE,
+	.read = bench_read,
+	.write = bench_write,
+};
+
+static int __init ipc_router_bench_init(void)
+{
+	bench_results = kzalloc(BENCH_RESULTS_SZ, GFP_KERNEL);
+	if (!bench_results)
+		return -ENOMEM;
+
+	bench_dent = debugfs_create_file("ipc_router_bench", 0644, NULL,
+					 NULL, &bench_ops);
+	if (IS_ERR_OR_NULL(bench_dent)) {
+		pr_err("%s: unable to create debugfs\n", __func__);
+		kfree(bench_results);
+		return -EFAULT;
+	}
+	return 0;
+}
+
+static void __exit ipc_router_bench_exit(void)
+{
+	debugfs_remove(bench_dent);
+	kfree(bench_results);
+}
+
+module_init(ipc_router_bench_init);
+module_exit(ipc_router_bench_exit);
+
+MODULE_DESCRIPTION("IPC Router benchmark");
+MODULE_LICENSE("GPL v2");
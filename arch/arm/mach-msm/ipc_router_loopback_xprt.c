@@ -0,0 +1,477 @@
+/* Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * IPC ROUTER LOOPBACK XPRT module.
+ *
+ * Emulates a remote processor at the far end of a transport, so that IPC
+ * Router can be exercised and measured without a modem.  The emulated node
+ * says HELLO, announces a single echo server and sends every data message
+ * addressed to that server back to its sender.  Each direction of the link
+ * can be given a latency and a bandwidth: a packet leaves once the link is
+ * free, occupies it for its transmission time and arrives latency_us later.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/skbuff.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/math64.h>
+
+#include "ipc_router.h"
+
+static int msm_ipc_router_loopback_xprt_debug_mask;
+module_param_named(debug_mask, msm_ipc_router_loopback_xprt_debug_mask,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+#if defined(DEBUG)
+#define D(x...) do { \
+if (msm_ipc_router_loopback_xprt_debug_mask) \
+	pr_info(x); \
+} while (0)
+#else
+#define D(x...) do { } while (0)
+#endif
+
+/*
+ * Must not be "msm_ipc_router_loopback_xprt", which IPC Router treats as
+ * a link to the local node.
+ */
+#define LOOPBACK_XPRT_NAME "ipc_rtr_loopback"
+#define LOOPBACK_LINK_ID 7
+#define LOOPBACK_ECHO_PORT 1
+
+static uint node_id = 64;
+module_param(node_id, uint, S_IRUGO);
+MODULE_PARM_DESC(node_id, "Node ID of the emulated remote processor");
+
+static uint service = 4096;
+module_param(service, uint, S_IRUGO);
+MODULE_PARM_DESC(service, "Service ID of the echo server");
+
+static uint instance = 1;
+module_param(instance, uint, S_IRUGO);
+MODULE_PARM_DESC(instance, "Instance ID of the echo server");
+
+static uint latency_us;
+module_param(latency_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(latency_us, "One way latency of the link in microseconds");
+
+static uint rate_kbps;
+module_param(rate_kbps, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rate_kbps, "Bandwidth of the link in kbit/s, 0 for unlimited");
+
+/**
+ * loopback_rx_pkt - Packet on its way from the emulated node to IPC Router
+ * @list: Entry in the in-flight queue, ordered by @due.
+ * @due: Time of arrival in ns.
+ * @pkt: The packet.
+ */
+struct loopback_rx_pkt {
+	struct list_head list;
+	s64 due;
+	struct rr_packet *pkt;
+};
+
+/**
+ * msm_ipc_router_loopback_xprt - IPC Router's loopback XPRT structure
+ * @xprt: IPC Router XPRT structure.
+ * @wq: Workqueue delivering packets to IPC Router.
+ * @open_work: Work to register the XPRT and greet IPC Router.
+ * @rx_work: Work to deliver the packets in @rx_q when they are due.
+ * @lock: Lock protecting @rx_q, @tx_free and @rx_free.
+ * @rx_q: Packets in flight towards IPC Router.
+ * @tx_free: Time in ns at which the link towards the node becomes free.
+ * @rx_free: Time in ns at which the link from the node becomes free.
+ * @sft_close_complete: Signalled when IPC Router is done with a close.
+ */
+struct msm_ipc_router_loopback_xprt {
+	struct msm_ipc_router_xprt xprt;
+	struct workqueue_struct *wq;
+	struct work_struct open_work;
+	struct delayed_work rx_work;
+	spinlock_t lock;
+	struct list_head rx_q;
+	s64 tx_free;
+	s64 rx_free;
+	struct completion sft_close_complete;
+};
+
+static struct msm_ipc_router_loopback_xprt loopback_xprt;
+
+static int msm_ipc_router_loopback_get_xprt_version(
+	struct msm_ipc_router_xprt *xprt)
+{
+	return IPC_ROUTER_V1;
+}
+
+static int msm_ipc_router_loopback_get_xprt_option(
+	struct msm_ipc_router_xprt *xprt)
+{
+	return FRAG_PKT_WRITE_ENABLE;
+}
+
+static int msm_ipc_router_loopback_write_avail(
+	struct msm_ipc_router_xprt *xprt)
+{
+	return MAX_IPC_PKT_SIZE;
+}
+
+/*
+ * Account for a packet of @len bytes that is ready to be sent at @start over
+ * the direction of the link that becomes free at *@free.
+ *
+ * @return: Time of arrival in ns.
+ */
+static s64 loopback_link_xmit(s64 *free, s64 start, unsigned int len)
+{
+	unsigned int kbps = ACCESS_ONCE(rate_kbps);
+
+	if (*free > start)
+		start = *free;
+	if (kbps)
+		start += div_u64((u64)len * 8 * USEC_PER_SEC, kbps);
+	*free = start;
+	return start + (s64)ACCESS_ONCE(latency_us) * NSEC_PER_USEC;
+}
+
+/**
+ * loopback_alloc_pkt() - Allocate a packet as the remote node would send it
+ * @hdr: Router header of the packet; @hdr->size is the payload length.
+ *
+ * @return: Packet with the header in place and room for the payload behind
+ *          it, NULL on failure.
+ */
+static struct rr_packet *loopback_alloc_pkt(struct rr_header_v1 *hdr)
+{
+	unsigned int len = sizeof(*hdr) + hdr->size + ALIGN_SIZE(hdr->size);
+	struct rr_packet *pkt;
+	struct sk_buff *skb;
+
+	pkt = kzalloc(sizeof(struct rr_packet), GFP_KERNEL);
+	if (!pkt)
+		return NULL;
+
+	pkt->pkt_fragment_q = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
+	if (!pkt->pkt_fragment_q) {
+		kfree(pkt);
+		return NULL;
+	}
+	skb_queue_head_init(pkt->pkt_fragment_q);
+
+	skb = alloc_skb(len, GFP_KERNEL);
+	if (!skb) {
+		release_pkt(pkt);
+		return NULL;
+	}
+	memcpy(skb_put(skb, len), hdr, sizeof(*hdr));
+	skb_queue_tail(pkt->pkt_fragment_q, skb);
+	pkt->length = len;
+	return pkt;
+}
+
+static int loopback_queue_rx(struct msm_ipc_router_loopback_xprt *lb_xprtp,
+			     struct rr_packet *pkt, s64 start)
+{
+	struct loopback_rx_pkt *rx_pkt;
+
+	rx_pkt = kmalloc(sizeof(*rx_pkt), GFP_KERNEL);
+	if (!rx_pkt) {
+		release_pkt(pkt);
+		return -ENOMEM;
+	}
+	rx_pkt->pkt = pkt;
+
+	spin_lock(&lb_xprtp->lock);
+	rx_pkt->due = loopback_link_xmit(&lb_xprtp->rx_free, start,
+					 pkt->length);
+	list_add_tail(&rx_pkt->list, &lb_xprtp->rx_q);
+	spin_unlock(&lb_xprtp->lock);
+
+	queue_delayed_work(lb_xprtp->wq, &lb_xprtp->rx_work, 0);
+	return 0;
+}
+
+static int loopback_send_ctl(struct msm_ipc_router_loopback_xprt *lb_xprtp,
+			     union rr_control_msg *msg, s64 start)
+{
+	struct rr_header_v1 hdr;
+	struct rr_packet *pkt;
+
+	hdr.version = IPC_ROUTER_V1;
+	hdr.type = msg->cmd;
+	hdr.src_node_id = node_id;
+	hdr.src_port_id = IPC_ROUTER_ADDRESS;
+	hdr.control_flag = 0;
+	hdr.size = sizeof(*msg);
+	hdr.dst_node_id = IPC_ROUTER_NID_LOCAL;
+	hdr.dst_port_id = IPC_ROUTER_ADDRESS;
+
+	pkt = loopback_alloc_pkt(&hdr);
+	if (!pkt)
+		return -ENOMEM;
+	skb_store_bits(skb_peek(pkt->pkt_fragment_q), sizeof(hdr),
+		       msg, sizeof(*msg));
+	return loopback_queue_rx(lb_xprtp, pkt, start);
+}
+
+/*
+ * Send the payload of a data packet back to where it came from, copying it
+ * the way a real transport would.  The sender has used up its quota when it
+ * asks for a CONFIRM_RX, so that gets a RESUME_TX ahead of the reply.
+ */
+static int loopback_echo(struct msm_ipc_router_loopback_xprt *lb_xprtp,
+			 struct rr_packet *pkt, struct rr_header_v1 *hdr,
+			 s64 start)
+{
+	struct rr_header_v1 reply_hdr;
+	union rr_control_msg msg;
+	struct rr_packet *reply;
+	struct sk_buff *skb;
+	unsigned int offset, copy_len, len;
+	int ret;
+
+	if (hdr->control_flag & CONTROL_FLAG_CONFIRM_RX) {
+		memset(&msg, 0, sizeof(msg));
+		msg.cli.cmd = IPC_ROUTER_CTRL_CMD_RESUME_TX;
+		msg.cli.node_id = node_id;
+		msg.cli.port_id = LOOPBACK_ECHO_PORT;
+		ret = loopback_send_ctl(lb_xprtp, &msg, start);
+		if (ret < 0)
+			return ret;
+	}
+
+	reply_hdr.version = IPC_ROUTER_V1;
+	reply_hdr.type = IPC_ROUTER_CTRL_CMD_DATA;
+	reply_hdr.src_node_id = node_id;
+	reply_hdr.src_port_id = LOOPBACK_ECHO_PORT;
+	reply_hdr.control_flag = 0;
+	reply_hdr.size = hdr->size;
+	reply_hdr.dst_node_id = hdr->src_node_id;
+	reply_hdr.dst_port_id = hdr->src_port_id;
+
+	reply = loopback_alloc_pkt(&reply_hdr);
+	if (!reply)
+		return -ENOMEM;
+
+	/* the payload starts right behind the header in the first skb */
+	offset = sizeof(*hdr);
+	len = sizeof(*hdr);
+	skb_queue_walk(pkt->pkt_fragment_q, skb) {
+		copy_len = min(skb->len - offset, reply->length - len);
+		skb_copy_bits(skb, offset, skb_peek(reply->pkt_fragment_q)->data
+			      + len, copy_len);
+		len += copy_len;
+		offset = 0;
+	}
+	return loopback_queue_rx(lb_xprtp, reply, start);
+}
+
+static int msm_ipc_router_loopback_write(void *data, uint32_t len,
+					 struct msm_ipc_router_xprt *xprt)
+{
+	struct rr_packet *pkt = (struct rr_packet *)data;
+	struct msm_ipc_router_loopback_xprt *lb_xprtp =
+		container_of(xprt, struct msm_ipc_router_loopback_xprt, xprt);
+	struct rr_header_v1 hdr;
+	s64 arrival;
+	int ret = 0;
+
+	if (!pkt || pkt->length != len || len < sizeof(hdr))
+		return -EINVAL;
+
+	if (skb_copy_bits(skb_peek(pkt->pkt_fragment_q), 0, &hdr,
+			  sizeof(hdr)) < 0)
+		return -EINVAL;
+
+	spin_lock(&lb_xprtp->lock);
+	arrival = loopback_link_xmit(&lb_xprtp->tx_free,
+				     ktime_to_ns(ktime_get()), len);
+	spin_unlock(&lb_xprtp->lock);
+
+	D("%s: type %d size %d to %d:%08x\n", __func__, hdr.type, hdr.size,
+	  hdr.dst_node_id, hdr.dst_port_id);
+
+	/*
+	 * HELLO replies, server announcements and client removals need no
+	 * answer from a node without clients of its own.
+	 */
+	if (hdr.type == IPC_ROUTER_CTRL_CMD_DATA &&
+	    hdr.dst_node_id == node_id &&
+	    hdr.dst_port_id == LOOPBACK_ECHO_PORT &&
+	    hdr.size <= len - sizeof(hdr))
+		ret = loopback_echo(lb_xprtp, pkt, &hdr, arrival);
+
+	if (ret < 0) {
+		pr_err("%s: Error %d echoing %d bytes\n", __func__, ret, len);
+		return ret;
+	}
+	return len;
+}
+
+static void loopback_xprt_rx(struct work_struct *work)
+{
+	struct delayed_work *rwork = to_delayed_work(work);
+	struct msm_ipc_router_loopback_xprt *lb_xprtp =
+		container_of(rwork, struct msm_ipc_router_loopback_xprt,
+			     rx_work);
+	struct loopback_rx_pkt *rx_pkt;
+	s64 delay;
+
+	while (1) {
+		spin_lock(&lb_xprtp->lock);
+		if (list_empty(&lb_xprtp->rx_q)) {
+			spin_unlock(&lb_xprtp->lock);
+			return;
+		}
+		rx_pkt = list_first_entry(&lb_xprtp->rx_q,
+					  struct loopback_rx_pkt, list);
+		delay = rx_pkt->due - ktime_to_ns(ktime_get());
+		if (delay <= 0)
+			list_del(&rx_pkt->list);
+		spin_unlock(&lb_xprtp->lock);
+
+		if (delay > 0) {
+			delay = div_s64(delay, NSEC_PER_USEC);
+			if (delay >= 2 * jiffies_to_usecs(1)) {
+				queue_delayed_work(lb_xprtp->wq,
+					&lb_xprtp->rx_work,
+					usecs_to_jiffies(delay) - 1);
+				return;
+			}
+			usleep_range(delay, delay + 10);
+			continue;
+		}
+
+		msm_ipc_router_xprt_notify(&lb_xprtp->xprt,
+			IPC_ROUTER_XPRT_EVENT_DATA, (void *)rx_pkt->pkt);
+		release_pkt(rx_pkt->pkt);
+		kfree(rx_pkt);
+	}
+}
+
+static int msm_ipc_router_loopback_close(struct msm_ipc_router_xprt *xprt)
+{
+	return 0;
+}
+
+static void loopback_xprt_sft_close_done(struct msm_ipc_router_xprt *xprt)
+{
+	struct msm_ipc_router_loopback_xprt *lb_xprtp =
+		container_of(xprt, struct msm_ipc_router_loopback_xprt, xprt);
+
+	complete_all(&lb_xprtp->sft_close_complete);
+}
+
+static void loopback_xprt_open(struct work_struct *work)
+{
+	struct msm_ipc_router_loopback_xprt *lb_xprtp =
+		container_of(work, struct msm_ipc_router_loopback_xprt,
+			     open_work);
+	union rr_control_msg msg;
+	s64 now;
+
+	msm_ipc_router_xprt_notify(&lb_xprtp->xprt,
+				   IPC_ROUTER_XPRT_EVENT_OPEN, NULL);
+	D("%s: Notified IPC Router of %s OPEN\n",
+	  __func__, lb_xprtp->xprt.name);
+
+	now = ktime_to_ns(ktime_get());
+	memset(&msg, 0, sizeof(msg));
+	msg.hello.cmd = IPC_ROUTER_CTRL_CMD_HELLO;
+	if (loopback_send_ctl(lb_xprtp, &msg, now) < 0)
+		goto fail;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.srv.cmd = IPC_ROUTER_CTRL_CMD_NEW_SERVER;
+	msg.srv.service = service;
+	msg.srv.instance = instance;
+	msg.srv.node_id = node_id;
+	msg.srv.port_id = LOOPBACK_ECHO_PORT;
+	if (loopback_send_ctl(lb_xprtp, &msg, now) < 0)
+		goto fail;
+	return;
+
+fail:
+	pr_err("%s: Could not greet IPC Router\n", __func__);
+}
+
+static int __init msm_ipc_router_loopback_init(void)
+{
+	struct msm_ipc_router_loopback_xprt *lb_xprtp = &loopback_xprt;
+
+	if (node_id == IPC_ROUTER_NID_LOCAL || !instance) {
+		pr_err("%s: Invalid node %d or instance %d\n",
+			__func__, node_id, instance);
+		return -EINVAL;
+	}
+
+	lb_xprtp->wq = create_singlethread_workqueue(LOOPBACK_XPRT_NAME);
+	if (!lb_xprtp->wq)
+		return -ENOMEM;
+
+	lb_xprtp->xprt.name = LOOPBACK_XPRT_NAME;
+	lb_xprtp->xprt.link_id = LOOPBACK_LINK_ID;
+	lb_xprtp->xprt.get_version = msm_ipc_router_loopback_get_xprt_version;
+	lb_xprtp->xprt.get_option = msm_ipc_router_loopback_get_xprt_option;
+	lb_xprtp->xprt.read_avail = NULL;
+	lb_xprtp->xprt.read = NULL;
+	lb_xprtp->xprt.write_avail = msm_ipc_router_loopback_write_avail;
+	lb_xprtp->xprt.write = msm_ipc_router_loopback_write;
+	lb_xprtp->xprt.close = msm_ipc_router_loopback_close;
+	lb_xprtp->xprt.sft_close_done = loopback_xprt_sft_close_done;
+	lb_xprtp->xprt.priv = NULL;
+
+	INIT_WORK(&lb_xprtp->open_work, loopback_xprt_open);
+	INIT_DELAYED_WORK(&lb_xprtp->rx_work, loopback_xprt_rx);
+	spin_lock_init(&lb_xprtp->lock);
+	INIT_LIST_HEAD(&lb_xprtp->rx_q);
+	init_completion(&lb_xprtp->sft_close_complete);
+
+	/* OPEN waits for IPC Router to come up, so not from an initcall */
+	queue_work(lb_xprtp->wq, &lb_xprtp->open_work);
+	return 0;
+}
+
+static void __exit msm_ipc_router_loopback_exit(void)
+{
+	struct msm_ipc_router_loopback_xprt *lb_xprtp = &loopback_xprt;
+	struct loopback_rx_pkt *rx_pkt, *tmp;
+
+	flush_work(&lb_xprtp->open_work);
+	cancel_delayed_work_sync(&lb_xprtp->rx_work);
+
+	msm_ipc_router_xprt_notify(&lb_xprtp->xprt,
+				   IPC_ROUTER_XPRT_EVENT_CLOSE, NULL);
+	D("%s: Notified IPC Router of %s CLOSE\n",
+	  __func__, lb_xprtp->xprt.name);
+	wait_for_completion(&lb_xprtp->sft_close_complete);
+
+	/* echoes of messages written until IPC Router let go of the XPRT */
+	cancel_delayed_work_sync(&lb_xprtp->rx_work);
+	destroy_workqueue(lb_xprtp->wq);
+	list_for_each_entry_safe(rx_pkt, tmp, &lb_xprtp->rx_q, list) {
+		list_del(&rx_pkt->list);
+		release_pkt(rx_pkt->pkt);
+		kfree(rx_pkt);
+	}
+}
+
+module_init(msm_ipc_router_loopback_init);
+module_exit(msm_ipc_router_loopback_exit);
+MODULE_DESCRIPTION("IPC Router LOOPBACK XPRT");
+MODULE_LICENSE("GPL v2");
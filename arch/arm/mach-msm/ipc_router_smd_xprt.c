@@ -18,6 +18,8 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/types.h>
+#include <linux/skbuff.h>
+#include <linux/highmem.h>
 
 #include <mach/msm_smd.h>
 #include <mach/subsystem_restart.h>
@@ -129,14 +131,46 @@ static int msm_ipc_router_smd_remote_write_avail(
 	return smd_write_avail(smd_xprtp->channel);
 }
 
+static int smd_xprt_write_buf(struct msm_ipc_router_smd_xprt *smd_xprtp,
+			      const void *buf, int len)
+{
+	int offset = 0, sz_written;
+	unsigned long flags;
+
+	while (offset < len) {
+		if (!smd_write_segment_avail(smd_xprtp->channel))
+			smd_enable_read_intr(smd_xprtp->channel);
+
+		wait_event(smd_xprtp->write_avail_wait_q,
+			(smd_write_segment_avail(smd_xprtp->channel) ||
+			smd_xprtp->ss_reset));
+		smd_disable_read_intr(smd_xprtp->channel);
+		spin_lock_irqsave(&smd_xprtp->ss_reset_lock, flags);
+		if (smd_xprtp->ss_reset) {
+			spin_unlock_irqrestore(&smd_xprtp->ss_reset_lock,
+						flags);
+			pr_err("%s: %s chnl reset\n",
+				__func__, smd_xprtp->xprt.name);
+			return -ENETRESET;
+		}
+		spin_unlock_irqrestore(&smd_xprtp->ss_reset_lock, flags);
+
+		sz_written = smd_write_segment(smd_xprtp->channel,
+				(void *)buf + offset, len - offset, 0);
+		offset += sz_written;
+	}
+	return offset;
+}
+
 static int msm_ipc_router_smd_remote_write(void *data,
 					   uint32_t len,
 					   struct msm_ipc_router_xprt *xprt)
 {
 	struct rr_packet *pkt = (struct rr_packet *)data;
 	struct sk_buff *ipc_rtr_pkt;
-	int offset, sz_written = 0;
-	int ret, num_retries = 0;
+	skb_frag_t *frag;
+	void *vaddr;
+	int ret, i, num_retries = 0;
 	unsigned long flags;
 	struct msm_ipc_router_smd_xprt *smd_xprtp =
 		container_of(xprt, struct msm_ipc_router_smd_xprt, xprt);
@@ -167,34 +201,24 @@ static int msm_ipc_router_smd_remote_write(void *data,
 
 	D("%s: Ready to write %d bytes\n", __func__, len);
 	skb_queue_walk(pkt->pkt_fragment_q, ipc_rtr_pkt) {
-		offset = 0;
-		while (offset < ipc_rtr_pkt->len) {
-			if (!smd_write_segment_avail(smd_xprtp->channel))
-				smd_enable_read_intr(smd_xprtp->channel);
-
-			wait_event(smd_xprtp->write_avail_wait_q,
-				(smd_write_segment_avail(smd_xprtp->channel) ||
-				smd_xprtp->ss_reset));
-			smd_disable_read_intr(smd_xprtp->channel);
-			spin_lock_irqsave(&smd_xprtp->ss_reset_lock, flags);
-			if (smd_xprtp->ss_reset) {
-				spin_unlock_irqrestore(
-					&smd_xprtp->ss_reset_lock, flags);
-				pr_err("%s: %s chnl reset\n",
-					__func__, xprt->name);
-				return -ENETRESET;
-			}
-			spin_unlock_irqrestore(&smd_xprtp->ss_reset_lock,
-						flags);
+		ret = smd_xprt_write_buf(smd_xprtp, ipc_rtr_pkt->data,
+					 skb_headlen(ipc_rtr_pkt));
+		if (ret < 0)
+			return ret;
 
-			sz_written = smd_write_segment(smd_xprtp->channel,
-					ipc_rtr_pkt->data + offset,
-					(ipc_rtr_pkt->len - offset), 0);
-			offset += sz_written;
-			sz_written = 0;
+		/* paged payload goes to the channel straight from the pages */
+		for (i = 0; i < skb_shinfo(ipc_rtr_pkt)->nr_frags; i++) {
+			frag = &skb_shinfo(ipc_rtr_pkt)->frags[i];
+			vaddr = kmap(skb_frag_page(frag));
+			ret = smd_xprt_write_buf(smd_xprtp,
+					vaddr + frag->page_offset,
+					skb_frag_size(frag));
+			kunmap(skb_frag_page(frag));
+			if (ret < 0)
+				return ret;
 		}
 		D("%s: Wrote %d bytes over %s\n",
-		  __func__, offset, xprt->name);
+		  __func__, ipc_rtr_pkt->len, xprt->name);
 	}
 
 	if (!smd_write_end(smd_xprtp->channel))
@@ -80,7 +80,11 @@ static void *ipc_ind_log_txt;
 static void msm_ipc_router_ipc_log(uint8_t tran,
 			struct sk_buff *ipc_buf, struct msm_ipc_port *port_ptr)
 {
-	struct qmi_header *hdr = (struct qmi_header *)ipc_buf->data;
+	struct qmi_header *hdr, _hdr;
+
+	hdr = skb_header_pointer(ipc_buf, 0, sizeof(_hdr), &_hdr);
+	if (!hdr)
+		return;
 
 	/*
 	 * IPC Logging format is as below:-
@@ -122,24 +126,24 @@ static void msm_ipc_router_ipc_log(uint8_t tran,
 	}
 }
 
+/*
+ * The message is copied straight from user space into a single skb, in
+ * page fragments unless it is small, which the router then passes on to
+ * the transport without copying it again.
+ */
 static struct sk_buff_head *msm_ipc_router_build_msg(unsigned int num_sect,
 					  struct iovec const *msg_sect,
 					  size_t total_len)
 {
 	struct sk_buff_head *msg_head;
 	struct sk_buff *msg;
-	int i, copied, first = 1;
-	int data_size = 0, request_size, offset;
-	void *data;
-	int last = 0;
-	int align_size;
+	int i, data_size = 0;
 
 	for (i = 0; i < num_sect; i++)
 		data_size += msg_sect[i].iov_len;
 
 	if (!data_size)
 		return NULL;
-	align_size = ALIGN_SIZE(data_size);
 
 	msg_head = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
 	if (!msg_head) {
@@ -148,59 +152,22 @@ static struct sk_buff_head *msm_ipc_router_build_msg(unsigned int num_sect,
 	}
 	skb_queue_head_init(msg_head);
 
-	for (copied = 1, i = 0; copied && (i < num_sect); i++) {
-		data_size = msg_sect[i].iov_len;
-		offset = 0;
-		if (i == (num_sect - 1))
-			last = 1;
-		while (offset != msg_sect[i].iov_len) {
-			request_size = data_size;
-			if (first)
-				request_size += IPC_ROUTER_HDR_SIZE;
-			if (last)
-				request_size += align_size;
-
-			msg = alloc_skb(request_size, GFP_KERNEL);
-			if (!msg) {
-				if (request_size <= (PAGE_SIZE/2)) {
-					pr_err("%s: cannot allocated skb\n",
-						__func__);
-					goto msg_build_failure;
-				}
-				data_size = data_size / 2;
-				last = 0;
-				continue;
-			}
-
-			if (first) {
-				skb_reserve(msg, IPC_ROUTER_HDR_SIZE);
-				first = 0;
-			}
+	msg = msm_ipc_router_alloc_skb(data_size, GFP_KERNEL);
+	if (!msg) {
+		pr_err("%s: cannot allocated skb\n", __func__);
+		goto msg_build_failure;
+	}
 
-			data = skb_put(msg, data_size);
-			copied = !copy_from_user(msg->data,
-					msg_sect[i].iov_base + offset,
-					data_size);
-			if (!copied) {
-				pr_err("%s: copy_from_user failed\n",
-					__func__);
-				kfree_skb(msg);
-				goto msg_build_failure;
-			}
-			skb_queue_tail(msg_head, msg);
-			offset += data_size;
-			data_size = msg_sect[i].iov_len - offset;
-			if (i == (num_sect - 1))
-				last = 1;
-		}
+	if (skb_copy_datagram_from_iovec(msg, 0, msg_sect, 0, data_size)) {
+		pr_err("%s: copy_from_user failed\n", __func__);
+		kfree_skb(msg);
+		goto msg_build_failure;
 	}
+	msm_ipc_router_count_copy(data_size);
+	skb_queue_tail(msg_head, msg);
 	return msg_head;
 
 msg_build_failure:
-	while (!skb_queue_empty(msg_head)) {
-		msg = skb_dequeue(msg_head);
-		kfree_skb(msg);
-	}
 	kfree(msg_head);
 	return NULL;
 }
@@ -242,14 +209,15 @@ static int msm_ipc_router_extract_msg(struct msghdr *m,
 	data_len = hdr->size;
 	skb_queue_walk(pkt->pkt_fragment_q, temp) {
 		copy_len = data_len < temp->len ? data_len : temp->len;
-		if (copy_to_user(m->msg_iov->iov_base + offset, temp->data,
-				 copy_len)) {
+		if (skb_copy_datagram_const_iovec(temp, 0, m->msg_iov, offset,
+						  copy_len)) {
 			pr_err("%s: Copy to user failed\n", __func__);
 			return -EFAULT;
 		}
 		offset += copy_len;
 		data_len -= copy_len;
 	}
+	msm_ipc_router_count_copy(offset);
 	return offset;
 }
 
@@ -27,6 +27,7 @@
 #include <asm-generic/sizes.h>
 #include <mach/memory.h>
 #include <mach/msm_rtb.h>
+#include <mach/msm_trace.h>
 #include <mach/system.h>
 
 #define SENTINEL_BYTE_1 0xFF
@@ -51,6 +52,7 @@ struct msm_rtb_state {
 	int size;
 	int enabled;
 	int initialized;
+	int trace;
 	uint32_t filter;
 	int step_size;
 };
@@ -68,6 +70,8 @@ struct msm_rtb_state msm_rtb = {
 
 module_param_named(filter, msm_rtb.filter, uint, 0644);
 module_param_named(enable, msm_rtb.enabled, int, 0644);
+/* also put the logged events on the msm_trace timeline */
+module_param_named(trace, msm_rtb.trace, int, 0644);
 
 static int msm_rtb_panic_notifier(struct notifier_block *this,
 					unsigned long event, void *ptr)
@@ -190,6 +194,8 @@ static int msm_rtb_get_idx(void)
 }
 #endif
 
+MSM_TRACE_EVENT3(rtb, "type %u caller %p data %p", int, void *, void *);
+
 int notrace uncached_logk_pc(enum logk_event_type log_type, void *caller,
 				void *data)
 {
@@ -198,6 +204,9 @@ int notrace uncached_logk_pc(enum logk_event_type log_type, void *caller,
 	if (!msm_rtb_event_should_log(log_type))
 		return 0;
 
+	if (msm_rtb.trace)
+		msm_trace_rtb(log_type & ~LOGTYPE_NOPC, caller, data);
+
 	i = msm_rtb_get_idx();
 
 	uncached_logk_pc_idx(log_type, caller, data, i);
@@ -0,0 +1,323 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/uaccess.h>
+#include <linux/spinlock.h>
+#include <linux/notifier.h>
+
+#include <mach/msm_trace.h>
+#include <mach/msm_ipc_logging.h>
+
+#define MSM_TRACE_MAX_ID	0xffff
+#define MSM_TRACE_RESULTS_SZ	256
+
+struct msm_trace_cpu {
+	struct msm_trace_ctl *ctl;
+	struct msm_trace_ent *ents;
+	u32 mask;
+	u32 seq;
+};
+
+static DEFINE_PER_CPU(struct msm_trace_cpu, msm_trace_cpu);
+
+int msm_trace_enabled __read_mostly;
+EXPORT_SYMBOL(msm_trace_enabled);
+
+static int msm_trace_enable = 1;
+module_param_named(enable, msm_trace_enable, int, S_IRUGO);
+
+/* entries per CPU, rounded down to a power of two */
+static uint msm_trace_nents = 512;
+module_param_named(nents, msm_trace_nents, uint, S_IRUGO);
+
+static atomic_t msm_trace_next_id = ATOMIC_INIT(0);
+static LIST_HEAD(msm_trace_descs);
+/* taken from any context, events being logged from interrupts too */
+static DEFINE_SPINLOCK(msm_trace_descs_lock);
+static struct dentry *msm_trace_dent;
+
+/*
+ * Give desc its id on first use.  Only the first CPU to get here adds it
+ * to the list, any other logging it at the same time drops its event.
+ */
+static int msm_trace_register(struct msm_trace_desc *desc)
+{
+	unsigned long flags;
+	int id;
+
+	if (cmpxchg(&desc->state, 0, 1) != 0)
+		return ACCESS_ONCE(desc->id) ? 0 : -EBUSY;
+
+	id = atomic_inc_return(&msm_trace_next_id);
+	if (id > MSM_TRACE_MAX_ID)
+		return -ENOSPC;
+
+	spin_lock_irqsave(&msm_trace_descs_lock, flags);
+	desc->id = id;
+	list_add(&desc->node, &msm_trace_descs);
+	spin_unlock_irqrestore(&msm_trace_descs_lock, flags);
+	return 0;
+}
+
+#ifdef CONFIG_MODULES
+/*
+ * Events of a module going away leave the list with it.  Their ids are
+ * not reused, so entries still in the rings just go unnamed.
+ */
+static int msm_trace_module_notify(struct notifier_block *nb,
+				   unsigned long action, void *data)
+{
+	struct module *mod = data;
+	struct msm_trace_desc *desc, *tmp;
+	unsigned long flags;
+
+	if (action != MODULE_STATE_GOING)
+		return NOTIFY_DONE;
+
+	spin_lock_irqsave(&msm_trace_descs_lock, flags);
+	list_for_each_entry_safe(desc, tmp, &msm_trace_descs, node)
+		if (within_module_core((unsigned long)desc, mod))
+			list_del(&desc->node);
+	spin_unlock_irqrestore(&msm_trace_descs_lock, flags);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block msm_trace_module_nb = {
+	.notifier_call = msm_trace_module_notify,
+};
+#endif
+
+void notrace __msm_trace_log(struct msm_trace_desc *desc, u32 a1, u32 a2,
+			     u32 a3, u32 a4)
+{
+	struct msm_trace_cpu *tc;
+	struct msm_trace_ent *ent;
+	unsigned long flags;
+	u32 seq;
+
+	if (unlikely(!ACCESS_ONCE(desc->id)) && msm_trace_register(desc))
+		return;
+
+	/* an interrupt logging on this CPU must not come in between */
+	local_irq_save(flags);
+	tc = &__get_cpu_var(msm_trace_cpu);
+	if (unlikely(!tc->ctl))
+		goto out;
+
+	seq = tc->seq++;
+	ent = &tc->ents[seq & tc->mask];
+	ent->seq = 0;
+	smp_wmb();
+	ent->id = desc->id;
+	ent->ts = sched_clock();
+	ent->args[0] = a1;
+	ent->args[1] = a2;
+	ent->args[2] = a3;
+	ent->args[3] = a4;
+	smp_wmb();
+	ent->seq = seq + 1;
+	tc->ctl->head = seq + 1;
+out:
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(__msm_trace_log);
+
+static int msm_trace_events_show(struct seq_file *s, void *unused)
+{
+	struct msm_trace_desc *desc;
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_trace_descs_lock, flags);
+	list_for_each_entry(desc, &msm_trace_descs, node)
+		seq_printf(s, "%u %s %s\n", desc->id, desc->name, desc->fmt);
+	spin_unlock_irqrestore(&msm_trace_descs_lock, flags);
+	return 0;
+}
+
+static int msm_trace_events_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_trace_events_show, NULL);
+}
+
+static const struct file_operations msm_trace_events_fops = {
+	.owner = THIS_MODULE,
+	.open = msm_trace_events_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static size_t msm_trace_ring_size(void)
+{
+	return PAGE_ALIGN(PAGE_SIZE +
+			  msm_trace_nents * sizeof(struct msm_trace_ent));
+}
+
+/* A copy of the ring, for saving it with cat */
+static ssize_t msm_trace_cpu_read(struct file *file, char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct msm_trace_cpu *tc = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, tc->ctl,
+				       msm_trace_ring_size());
+}
+
+static int msm_trace_cpu_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct msm_trace_cpu *tc = file->private_data;
+
+	if (vma->vm_pgoff || (vma->vm_flags & VM_WRITE))
+		return -EINVAL;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, tc->ctl, 0);
+}
+
+static const struct file_operations msm_trace_cpu_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = msm_trace_cpu_read,
+	.mmap = msm_trace_cpu_mmap,
+	.llseek = default_llseek,
+};
+
+#if defined(CONFIG_MSM_IPC_LOGGING)
+MSM_TRACE_EVENT2(trace_bench, "i %u v %x", int, u32);
+
+static void *msm_trace_bench_ctx;
+
+/*
+ * Cost of an event here against a two argument ipc_log_string(), in
+ * nanoseconds per event on this CPU, with interrupts and preemption left
+ * alone.  The ipc_logging context is kept, as destroying one leaves its
+ * debugfs file behind.
+ */
+static ssize_t msm_trace_bench_read(struct file *file, char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	static const int loops = 100000;
+	char *results;
+	s64 t0, trace_ns, ipc_ns;
+	ssize_t ret;
+	int i, len;
+
+	if (*ppos)
+		return 0;
+	if (!msm_trace_enabled)
+		return -ENODEV;
+
+	if (!msm_trace_bench_ctx)
+		msm_trace_bench_ctx = ipc_log_context_create(4,
+							     "msm_trace_bench");
+	results = kmalloc(MSM_TRACE_RESULTS_SZ, GFP_KERNEL);
+	if (!results || !msm_trace_bench_ctx) {
+		kfree(results);
+		return -ENOMEM;
+	}
+
+	t0 = ktime_to_ns(ktime_get());
+	for (i = 0; i < loops; i++)
+		msm_trace_trace_bench(i, 0x5a5a5a5a);
+	trace_ns = ktime_to_ns(ktime_get()) - t0;
+
+	t0 = ktime_to_ns(ktime_get());
+	for (i = 0; i < loops; i++)
+		ipc_log_string(msm_trace_bench_ctx, "i %u v %x", i,
+			       0x5a5a5a5a);
+	ipc_ns = ktime_to_ns(ktime_get()) - t0;
+
+	len = scnprintf(results, MSM_TRACE_RESULTS_SZ,
+			"msm_trace:       %lld ns/event, %u bytes/event\n"
+			"ipc_log_string:  %lld ns/event\n",
+			div_s64(trace_ns, loops),
+			(unsigned)sizeof(struct msm_trace_ent),
+			div_s64(ipc_ns, loops));
+	ret = simple_read_from_buffer(buf, count, ppos, results, len);
+	kfree(results);
+	return ret;
+}
+
+static const struct file_operations msm_trace_bench_fops = {
+	.owner = THIS_MODULE,
+	.read = msm_trace_bench_read,
+};
+#endif
+
+static int __init msm_trace_alloc_cpu(int cpu)
+{
+	struct msm_trace_cpu *tc = &per_cpu(msm_trace_cpu, cpu);
+	struct msm_trace_ctl *ctl;
+	char name[16];
+
+	ctl = vmalloc_user(msm_trace_ring_size());
+	if (!ctl)
+		return -ENOMEM;
+
+	ctl->magic = MSM_TRACE_MAGIC;
+	ctl->version = MSM_TRACE_VERSION;
+	ctl->cpu = cpu;
+	ctl->nents = msm_trace_nents;
+	ctl->ent_size = sizeof(struct msm_trace_ent);
+	tc->ents = (struct msm_trace_ent *)((char *)ctl + PAGE_SIZE);
+	tc->mask = msm_trace_nents - 1;
+	tc->ctl = ctl;
+
+	snprintf(name, sizeof(name), "cpu%d", cpu);
+	debugfs_create_file(name, S_IRUSR, msm_trace_dent, tc,
+			    &msm_trace_cpu_fops);
+	return 0;
+}
+
+static int __init msm_trace_init(void)
+{
+	int cpu;
+
+	if (!msm_trace_enable || msm_trace_nents < 2)
+		return 0;
+	msm_trace_nents = rounddown_pow_of_two(msm_trace_nents);
+
+	msm_trace_dent = debugfs_create_dir("msm_trace", NULL);
+	if (IS_ERR_OR_NULL(msm_trace_dent)) {
+		pr_err("%s: unable to create debugfs\n", __func__);
+		return -ENOMEM;
+	}
+	debugfs_create_file("events", S_IRUSR, msm_trace_dent, NULL,
+			    &msm_trace_events_fops);
+#if defined(CONFIG_MSM_IPC_LOGGING)
+	debugfs_create_file("bench", S_IRUSR, msm_trace_dent, NULL,
+			    &msm_trace_bench_fops);
+#endif
+
+	for_each_possible_cpu(cpu)
+		if (msm_trace_alloc_cpu(cpu))
+			pr_err("%s: no ring for cpu%d\n", __func__, cpu);
+#ifdef CONFIG_MODULES
+	register_module_notifier(&msm_trace_module_nb);
+#endif
+
+	msm_trace_enabled = 1;
+	return 0;
+}
+postcore_initcall(msm_trace_init);
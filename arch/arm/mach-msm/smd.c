@@ -32,6 +32,7 @@
 #include <linux/remote_spinlock.h>
 #include <linux/uaccess.h>
 #include <linux/kfifo.h>
+#include <linux/hrtimer.h>
 #include <linux/wakelock.h>
 #include <linux/notifier.h>
 #include <linux/suspend.h>
@@ -45,11 +46,13 @@
 #include <mach/socinfo.h>
 #include <mach/proc_comm.h>
 #include <mach/msm_ipc_logging.h>
+#include <mach/msm_trace.h>
 #include <mach/ramdump.h>
 #include <mach/board.h>
 #include <mach/msm_smem.h>
 
 #include <asm/cacheflush.h>
+#include <asm/unaligned.h>
 
 #include "smd_private.h"
 #include "modem_notifier.h"
@@ -141,6 +144,20 @@ int msm_smd_debug_mask = MSM_SMD_POWER_INFO | MSM_SMD_INFO |
 							MSM_SMSM_POWER_INFO;
 module_param_named(debug_mask, msm_smd_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/*
+ * With a nonzero intr_coalesce_bytes, reads and writes only signal the
+ * remote once that many bytes have moved on a channel, or intr_coalesce_us
+ * after the first transfer left unsignalled, or right away when the FIFO
+ * is about to fill up and the writer has to wait for room.
+ */
+unsigned smd_intr_coalesce_bytes;
+module_param_named(intr_coalesce_bytes, smd_intr_coalesce_bytes,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+unsigned smd_intr_coalesce_us = 100;
+module_param_named(intr_coalesce_us, smd_intr_coalesce_us,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 void *smd_log_ctx;
 void *smsm_log_ctx;
 #define NUM_LOG_PAGES 4
@@ -238,12 +255,26 @@ static inline void smd_write_intr(unsigned int val,
 	__raw_writel(val, addr);
 }
 
+MSM_TRACE_EVENT4(smd_notify, "edge %u ch %d tx %d rx %d", uint32_t, int, int,
+		 int);
+MSM_TRACE_EVENT1(smd_irq, "edge %u", uint32_t);
+
 static inline void log_notify(uint32_t subsystem, smd_channel_t *ch)
 {
 	const char *subsys = smd_edge_to_subsystem(subsystem);
 
 	(void) subsys;
 
+	if (msm_trace_active()) {
+		if (!ch)
+			msm_trace_smd_notify(subsystem, -1, 0, 0);
+		else
+			msm_trace_smd_notify(subsystem, ch->n,
+				ch->fifo_size - (smd_stream_write_avail(ch) + 1),
+				smd_stream_read_avail(ch));
+		return;
+	}
+
 	if (!ch)
 		SMD_POWER_INFO("Apps->%s\n", subsys);
 	else
@@ -920,23 +951,71 @@ static int ch_is_open(struct smd_channel *ch)
 		&& (ch->half_ch->get_state(ch->send) == SMD_SS_OPENED);
 }
 
-static unsigned ch_read_buffer(struct smd_channel *ch, void **ptr)
+/*
+ * The FIFOs are in shared memory, which most targets map as device memory
+ * where every access is a bus transaction of its own.  Only copy single
+ * bytes up to the next word boundary in the FIFO and move the rest a word
+ * at a time, four words per iteration, whatever the alignment of the local
+ * buffer.
+ */
+static void smd_copy_from_fifo(void *dst, const void *fifo, unsigned len)
+{
+	const unsigned char *s = fifo;
+	unsigned char *d = dst;
+	const u32 *w;
+	u32 *o;
+
+	for (; len && ((uintptr_t)s & 3); len--)
+		*d++ = *s++;
+
+	w = (const u32 *)s;
+	if (!((uintptr_t)d & 3)) {
+		for (o = (u32 *)d; len >= 16; len -= 16, w += 4, o += 4) {
+			o[0] = w[0];
+			o[1] = w[1];
+			o[2] = w[2];
+			o[3] = w[3];
+		}
+		for (; len >= 4; len -= 4)
+			*o++ = *w++;
+		d = (unsigned char *)o;
+	} else {
+		for (; len >= 4; len -= 4, d += 4)
+			put_unaligned(*w++, (u32 *)d);
+	}
+
+	for (s = (const unsigned char *)w; len; len--)
+		*d++ = *s++;
+}
+
+static void smd_copy_to_fifo(void *fifo, const void *src, unsigned len)
 {
-	unsigned head = ch->half_ch->get_head(ch->recv);
-	unsigned tail = ch->half_ch->get_tail(ch->recv);
-	unsigned fifo_size = ch->fifo_size;
+	const unsigned char *s = src;
+	unsigned char *d = fifo;
+	const u32 *i;
+	u32 *w;
 
-	BUG_ON(fifo_size >= SZ_1M);
-	BUG_ON(head >= fifo_size);
-	BUG_ON(tail >= fifo_size);
-	BUG_ON(OVERFLOW_ADD_UNSIGNED(uintptr_t, (uintptr_t)ch->recv_data,
-								 tail));
+	for (; len && ((uintptr_t)d & 3); len--)
+		*d++ = *s++;
 
-	*ptr = (void *) (ch->recv_data + tail);
-	if (tail <= head)
-		return head - tail;
-	else
-		return fifo_size - tail;
+	w = (u32 *)d;
+	if (!((uintptr_t)s & 3)) {
+		for (i = (const u32 *)s; len >= 16; len -= 16, w += 4, i += 4) {
+			w[0] = i[0];
+			w[1] = i[1];
+			w[2] = i[2];
+			w[3] = i[3];
+		}
+		for (; len >= 4; len -= 4)
+			*w++ = *i++;
+		s = (const unsigned char *)i;
+	} else {
+		for (; len >= 4; len -= 4, s += 4)
+			*w++ = get_unaligned((const u32 *)s);
+	}
+
+	for (d = (unsigned char *)w; len; len--)
+		*d++ = *s++;
 }
 
 static int read_intr_blocked(struct smd_channel *ch)
@@ -953,41 +1032,61 @@ static void ch_read_done(struct smd_channel *ch, unsigned count)
 	ch->half_ch->set_fTAIL(ch->send,  1);
 }
 
+static void ch_read_segment(void *data, const void *ptr, unsigned n,
+			    int user_buf)
+{
+	int r;
+
+	if (user_buf) {
+		r = copy_to_user(data, ptr, n);
+		if (r > 0) {
+			pr_err("%s: "
+				"copy_to_user could not copy "
+				"%i bytes.\n",
+				__func__,
+				r);
+		}
+	} else
+		smd_copy_from_fifo(data, ptr, n);
+}
+
+/*
+ * Read up to len bytes in one pass: the data up to the end of the FIFO
+ * and, if it wraps, the rest from its start, with a single update of the
+ * read index.  A NULL _data discards the bytes.
+ */
 static int ch_read(struct smd_channel *ch, void *_data, int len, int user_buf)
 {
-	void *ptr;
-	unsigned n;
+	unsigned head = ch->half_ch->get_head(ch->recv);
+	unsigned tail = ch->half_ch->get_tail(ch->recv);
+	unsigned fifo_size = ch->fifo_size;
 	unsigned char *data = _data;
-	int orig_len = len;
-	int r = 0;
+	unsigned n, first;
 
-	while (len > 0) {
-		n = ch_read_buffer(ch, &ptr);
-		if (n == 0)
-			break;
+	BUG_ON(fifo_size >= SZ_1M);
+	BUG_ON(head >= fifo_size);
+	BUG_ON(tail >= fifo_size);
+	BUG_ON(OVERFLOW_ADD_UNSIGNED(uintptr_t, (uintptr_t)ch->recv_data,
+								 tail));
 
-		if (n > len)
-			n = len;
-		if (_data) {
-			if (user_buf) {
-				r = copy_to_user(data, ptr, n);
-				if (r > 0) {
-					pr_err("%s: "
-						"copy_to_user could not copy "
-						"%i bytes.\n",
-						__func__,
-						r);
-				}
-			} else
-				memcpy(data, ptr, n);
-		}
+	if (len <= 0)
+		return 0;
+	n = (head - tail) & ch->fifo_mask;
+	if (n > len)
+		n = len;
+	if (n == 0)
+		return 0;
 
-		data += n;
-		len -= n;
-		ch_read_done(ch, n);
+	first = min(n, fifo_size - tail);
+	if (_data) {
+		ch_read_segment(data, ch->recv_data + tail, first, user_buf);
+		if (n > first)
+			ch_read_segment(data + first, ch->recv_data,
+					n - first, user_buf);
 	}
 
-	return orig_len - len;
+	ch_read_done(ch, n);
+	return n;
 }
 
 static void update_stream_state(struct smd_channel *ch)
@@ -1015,23 +1114,46 @@ static void update_packet_state(struct smd_channel *ch)
 	}
 }
 
-/**
- * ch_write_buffer() - Provide a pointer and length for the next segment of
- * free space in the FIFO.
- * @ch: channel
- * @ptr: Address to pointer for the next segment write
- * @returns: Maximum size that can be written until the FIFO is either full
- *           or the end of the FIFO has been reached.
- *
- * The returned pointer and length are passed to memcpy, so the next segment is
- * defined as either the space available between the read index (tail) and the
- * write index (head) or the space available to the end of the FIFO.
+static void ch_write_done(struct smd_channel *ch, unsigned count)
+{
+	BUG_ON(count > smd_stream_write_avail(ch));
+	ch->half_ch->set_head(ch->send,
+		(ch->half_ch->get_head(ch->send) + count) & ch->fifo_mask);
+	wmb();
+	ch->half_ch->set_fHEAD(ch->send, 1);
+}
+
+static void ch_write_segment(void *ptr, const void *data, unsigned n,
+			     int user_buf)
+{
+	int r;
+
+	if (user_buf) {
+		r = copy_from_user(ptr, data, n);
+		if (r > 0) {
+			pr_err("%s: "
+				"copy_from_user could not copy %i "
+				"bytes.\n",
+				__func__,
+				r);
+		}
+	} else
+		smd_copy_to_fifo(ptr, data, n);
+}
+
+/*
+ * Write as much of len bytes as there is room for in one pass, wrapping
+ * around the end of the FIFO if needed, with a single update of the write
+ * index.  The remote is not signalled; that is up to the caller.
  */
-static unsigned ch_write_buffer(struct smd_channel *ch, void **ptr)
+static int ch_write(struct smd_channel *ch, const void *_data, int len,
+		    int user_buf)
 {
 	unsigned head = ch->half_ch->get_head(ch->send);
 	unsigned tail = ch->half_ch->get_tail(ch->send);
 	unsigned fifo_size = ch->fifo_size;
+	const unsigned char *data = _data;
+	unsigned n, first;
 
 	BUG_ON(fifo_size >= SZ_1M);
 	BUG_ON(head >= fifo_size);
@@ -1039,25 +1161,72 @@ static unsigned ch_write_buffer(struct smd_channel *ch, void **ptr)
 	BUG_ON(OVERFLOW_ADD_UNSIGNED(uintptr_t, (uintptr_t)ch->send_data,
 								head));
 
-	*ptr = (void *) (ch->send_data + head);
-	if (head < tail) {
-		return tail - head - SMD_FIFO_FULL_RESERVE;
-	} else {
-		if (tail < SMD_FIFO_FULL_RESERVE)
-			return fifo_size + tail - head
-					- SMD_FIFO_FULL_RESERVE;
-		else
-			return fifo_size - head;
+	n = fifo_size - ((head - tail) & ch->fifo_mask);
+	n = n > SMD_FIFO_FULL_RESERVE ? n - SMD_FIFO_FULL_RESERVE : 0;
+	if (n > len)
+		n = len;
+	if (n == 0 || !ch_is_open(ch))
+		return 0;
+
+	first = min(n, fifo_size - head);
+	ch_write_segment(ch->send_data + head, data, first, user_buf);
+	if (n > first)
+		ch_write_segment(ch->send_data, data + first, n - first,
+				 user_buf);
+
+	ch_write_done(ch, n);
+	return n;
+}
+
+static enum hrtimer_restart smd_intr_timer_fn(struct hrtimer *timer)
+{
+	struct smd_channel *ch = container_of(timer, struct smd_channel,
+					      intr_timer);
+
+	if (atomic_xchg(&ch->intr_pending, 0))
+		ch->notify_other_cpu(ch);
+	return HRTIMER_NORESTART;
+}
+
+static void smd_intr_init(struct smd_channel *ch)
+{
+	hrtimer_init(&ch->intr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ch->intr_timer.function = smd_intr_timer_fn;
+	atomic_set(&ch->intr_pending, 0);
+}
+
+/*
+ * Tell the remote that count bytes were written to or read from ch, with
+ * room bytes of free space in the FIFO concerned after the write or, for
+ * a read, before it.  With coalescing, the signal is held back until
+ * enough bytes have moved or the timeout expires, unless the FIFO is so
+ * full that the writer could be waiting for this very read, which is
+ * why a read passes the room it found, or about to wait for room itself.
+ */
+static void smd_signal_remote(struct smd_channel *ch, unsigned count,
+			      unsigned room)
+{
+	unsigned threshold = ACCESS_ONCE(smd_intr_coalesce_bytes);
+
+	if (!threshold || room < threshold ||
+	    atomic_add_return(count, &ch->intr_pending) >= threshold) {
+		atomic_set(&ch->intr_pending, 0);
+		ch->notify_other_cpu(ch);
+		return;
 	}
+
+	/* a timer that is only running its callback may have missed count */
+	if (!hrtimer_is_queued(&ch->intr_timer))
+		hrtimer_start(&ch->intr_timer,
+			ns_to_ktime((u64)smd_intr_coalesce_us * NSEC_PER_USEC),
+			HRTIMER_MODE_REL);
 }
 
-static void ch_write_done(struct smd_channel *ch, unsigned count)
+static unsigned smd_recv_room(struct smd_channel *ch)
 {
-	BUG_ON(count > smd_stream_write_avail(ch));
-	ch->half_ch->set_head(ch->send,
-		(ch->half_ch->get_head(ch->send) + count) & ch->fifo_mask);
-	wmb();
-	ch->half_ch->set_fHEAD(ch->send, 1);
+	return ch->fifo_size - SMD_FIFO_FULL_RESERVE -
+		min_t(unsigned, smd_stream_read_avail(ch),
+		      ch->fifo_size - SMD_FIFO_FULL_RESERVE);
 }
 
 static void ch_set_state(struct smd_channel *ch, unsigned n)
@@ -1228,6 +1397,10 @@ static inline void log_irq(uint32_t subsystem)
 
 	(void) subsys;
 
+	if (msm_trace_active()) {
+		msm_trace_smd_irq(subsystem);
+		return;
+	}
 	SMD_POWER_INFO("SMD Int %s->Apps\n", subsys);
 }
 
@@ -1366,11 +1539,7 @@ static int smd_is_packet(struct smd_alloc_elm *alloc_elm)
 static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 				int user_buf)
 {
-	void *ptr;
-	const unsigned char *buf = _data;
-	unsigned xfer;
-	int orig_len = len;
-	int r = 0;
+	int r;
 
 	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
 	if (len < 0)
@@ -1378,35 +1547,11 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	else if (len == 0)
 		return 0;
 
-	while ((xfer = ch_write_buffer(ch, &ptr)) != 0) {
-		if (!ch_is_open(ch)) {
-			len = orig_len;
-			break;
-		}
-		if (xfer > len)
-			xfer = len;
-		if (user_buf) {
-			r = copy_from_user(ptr, buf, xfer);
-			if (r > 0) {
-				pr_err("%s: "
-					"copy_from_user could not copy %i "
-					"bytes.\n",
-					__func__,
-					r);
-			}
-		} else
-			memcpy(ptr, buf, xfer);
-		ch_write_done(ch, xfer);
-		len -= xfer;
-		buf += xfer;
-		if (len == 0)
-			break;
-	}
-
-	if (orig_len - len)
-		ch->notify_other_cpu(ch);
+	r = ch_write(ch, _data, len, user_buf);
+	if (r)
+		smd_signal_remote(ch, r, smd_stream_write_avail(ch));
 
-	return orig_len - len;
+	return r;
 }
 
 static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
@@ -1427,8 +1572,8 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
-
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	/* header and data go out under a single signal to the remote */
+	ret = ch_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		SMD_DBG("%s failed to write pkt header: "
 			"%d returned\n", __func__, ret);
@@ -1436,7 +1581,8 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	}
 
 
-	ret = smd_stream_write(ch, _data, len, user_buf);
+	ret = ch_write(ch, _data, len, user_buf);
+	smd_signal_remote(ch, sizeof(hdr) + ret, smd_stream_write_avail(ch));
 	if (ret < 0 || ret != len) {
 		SMD_DBG("%s failed to write pkt data: "
 			"%d returned\n", __func__, ret);
@@ -1448,15 +1594,17 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 
 static int smd_stream_read(smd_channel_t *ch, void *data, int len, int user_buf)
 {
+	unsigned room;
 	int r;
 
 	if (len < 0)
 		return -EINVAL;
 
+	room = smd_recv_room(ch);
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu(ch);
+			smd_signal_remote(ch, r, room);
 
 	return r;
 }
@@ -1464,6 +1612,7 @@ static int smd_stream_read(smd_channel_t *ch, void *data, int len, int user_buf)
 static int smd_packet_read(smd_channel_t *ch, void *data, int len, int user_buf)
 {
 	unsigned long flags;
+	unsigned room;
 	int r;
 
 	if (len < 0)
@@ -1472,10 +1621,11 @@ static int smd_packet_read(smd_channel_t *ch, void *data, int len, int user_buf)
 	if (len > ch->current_packet)
 		len = ch->current_packet;
 
+	room = smd_recv_room(ch);
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu(ch);
+			smd_signal_remote(ch, r, room);
 
 	spin_lock_irqsave(&smd_lock, flags);
 	ch->current_packet -= r;
@@ -1488,6 +1638,7 @@ static int smd_packet_read(smd_channel_t *ch, void *data, int len, int user_buf)
 static int smd_packet_read_from_cb(smd_channel_t *ch, void *data, int len,
 					int user_buf)
 {
+	unsigned room;
 	int r;
 
 	if (len < 0)
@@ -1496,10 +1647,11 @@ static int smd_packet_read_from_cb(smd_channel_t *ch, void *data, int len,
 	if (len > ch->current_packet)
 		len = ch->current_packet;
 
+	room = smd_recv_room(ch);
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu(ch);
+			smd_signal_remote(ch, r, room);
 
 	ch->current_packet -= r;
 	update_packet_state(ch);
@@ -1636,6 +1788,7 @@ static int smd_alloc_channel(struct smd_alloc_elm *alloc_elm, int table_id,
 		ch->notify_other_cpu = notify_wcnss_smd;
 	else if (ch->type == SMD_APPS_RPM)
 		ch->notify_other_cpu = notify_rpm_smd;
+	smd_intr_init(ch);
 
 	if (smd_is_packet(alloc_elm)) {
 		ch->read = smd_packet_read;
@@ -1687,14 +1840,23 @@ static inline void notify_loopback_smd(smd_channel_t *ch_notif)
 	spin_unlock_irqrestore(&smd_lock, flags);
 }
 
-static int smd_alloc_loopback_channel(void)
+int smd_alloc_loopback_channel(void)
 {
 	static struct smd_half_channel smd_loopback_ctl;
-	static char smd_loopback_data[SMD_BUF_SIZE];
+	static char smd_loopback_data[SMD_BUF_SIZE] __aligned(8);
+	static DEFINE_MUTEX(smd_loopback_lock);
+	static bool allocated;
 	struct smd_channel *ch;
 
+	mutex_lock(&smd_loopback_lock);
+	if (allocated) {
+		mutex_unlock(&smd_loopback_lock);
+		return 0;
+	}
+
 	ch = kzalloc(sizeof(struct smd_channel), GFP_KERNEL);
 	if (ch == 0) {
+		mutex_unlock(&smd_loopback_lock);
 		pr_err("%s: out of memory\n", __func__);
 		return -1;
 	}
@@ -1709,6 +1871,7 @@ static int smd_alloc_loopback_channel(void)
 	ch->fifo_mask = ch->fifo_size - 1;
 	ch->type = SMD_LOOPBACK_TYPE;
 	ch->notify_other_cpu = notify_loopback_smd;
+	smd_intr_init(ch);
 
 	ch->read = smd_stream_read;
 	ch->write = smd_stream_write;
@@ -1730,6 +1893,8 @@ static int smd_alloc_loopback_channel(void)
 	mutex_unlock(&smd_creation_mutex);
 
 	platform_device_register(&ch->pdev);
+	allocated = true;
+	mutex_unlock(&smd_loopback_lock);
 	return 0;
 }
 
@@ -1780,7 +1945,8 @@ int smd_named_open_on_edge(const char *name, uint32_t edge,
 	struct smd_channel *ch;
 	unsigned long flags;
 
-	if (smd_initialized == 0 && !smd_edge_inited(edge)) {
+	if (smd_initialized == 0 && edge != SMD_LOOPBACK_TYPE &&
+	    !smd_edge_inited(edge)) {
 		SMD_INFO("smd_open() before smd_init()\n");
 		return -ENODEV;
 	}
@@ -1873,6 +2039,9 @@ int smd_close(smd_channel_t *ch)
 
 	SMD_INFO("smd_close(%s)\n", ch->name);
 
+	hrtimer_cancel(&ch->intr_timer);
+	atomic_set(&ch->intr_pending, 0);
+
 	spin_lock_irqsave(&smd_lock, flags);
 	list_del(&ch->ch_list);
 	if (ch->n == SMD_LOOPBACK_CID) {
@@ -1933,12 +2102,17 @@ int smd_write_start(smd_channel_t *ch, int len)
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
 
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	ret = ch_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		ch->pending_pkt_sz = 0;
 		pr_err("%s: packet header failed to write\n", __func__);
 		return -EPERM;
 	}
+	/*
+	 * The caller may wait for room before writing the first segment,
+	 * and the remote may be the one to make it, so tell it now.
+	 */
+	smd_signal_remote(ch, sizeof(hdr), smd_stream_write_avail(ch));
 	return 0;
 }
 EXPORT_SYMBOL(smd_write_start);
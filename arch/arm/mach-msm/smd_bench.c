@@ -0,0 +1,275 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * SMD benchmark.
+ *
+ * Streams packets through the local loopback channel, which stands in for
+ * a remote processor: its FIFO is written by this side and read back by a
+ * reader thread one packet at a time, the way a packet client drains a
+ * channel, and every signal either side sends the "remote" comes back as a
+ * data event.  For every packet size, a run first with signal coalescing
+ * off and then with a threshold of coalesce_bytes reports the packet rate,
+ * the throughput and the signals sent per second and per packet.  Writing
+ * "run" to the debugfs file starts a run, reading it gives the results of
+ * the last one.
+ *
+ * The coalescing threshold is switched for all channels while a run is in
+ * progress, so this is best done with no remote processor up.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/errno.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/wait.h>
+#include <linux/kthread.h>
+
+#include <asm/uaccess.h>
+
+#include <mach/msm_smd.h>
+
+#include "smd_private.h"
+
+#define BENCH_RESULTS_SZ PAGE_SIZE
+#define BENCH_TIMEOUT (5 * HZ)
+#define BENCH_MAX_PKT (SMD_BUF_SIZE / 2)
+
+static uint bench_duration_ms = 1000;
+module_param_named(duration_ms, bench_duration_ms, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_sizes[16] = { 16, 64, 256, 1024, 4096 };
+static int bench_nr_sizes = 5;
+module_param_array_named(sizes, bench_sizes, uint, &bench_nr_sizes,
+			 S_IRUGO | S_IWUSR);
+
+static uint bench_coalesce_bytes = 2048;
+module_param_named(coalesce_bytes, bench_coalesce_bytes, uint,
+		   S_IRUGO | S_IWUSR);
+
+static struct dentry *bench_dent;
+static DEFINE_MUTEX(bench_lock);
+static char *bench_results;
+static size_t bench_results_len;
+
+static smd_channel_t *bench_ch;
+static DECLARE_WAIT_QUEUE_HEAD(bench_wait_q);
+static atomic_t bench_signals;
+static atomic_t bench_rx_pkts;
+static unsigned int bench_len;
+static void *bench_tx_buf;
+static void *bench_rx_buf;
+
+/* every signal to the loopback "remote" ends up here */
+static void bench_notify(void *priv, unsigned event)
+{
+	if (event != SMD_EVENT_DATA)
+		return;
+	atomic_inc(&bench_signals);
+	wake_up(&bench_wait_q);
+}
+
+static int bench_reader(void *data)
+{
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(bench_wait_q,
+				smd_read_avail(bench_ch) >= bench_len ||
+				kthread_should_stop());
+
+		while (smd_read_avail(bench_ch) >= bench_len) {
+			smd_read(bench_ch, bench_rx_buf, bench_len);
+			atomic_inc(&bench_rx_pkts);
+		}
+	}
+	return 0;
+}
+
+static int bench_one_size(unsigned int len, unsigned int coalesce,
+			  char *out, size_t out_len)
+{
+	struct task_struct *reader;
+	s64 start, end, elapsed;
+	u64 count = 0, signals;
+	int ret = 0;
+
+	bench_len = len;
+	smd_intr_coalesce_bytes = coalesce;
+	atomic_set(&bench_signals, 0);
+	atomic_set(&bench_rx_pkts, 0);
+
+	reader = kthread_run(bench_reader, NULL, "smd_bench");
+	if (IS_ERR(reader))
+		return scnprintf(out, out_len, "%8u %8u error %ld\n", len,
+				 coalesce, PTR_ERR(reader));
+
+	start = ktime_to_ns(ktime_get());
+	end = start + (s64)bench_duration_ms * NSEC_PER_MSEC;
+	while (ktime_to_ns(ktime_get()) < end) {
+		if (smd_write_avail(bench_ch) < len) {
+			if (!wait_event_timeout(bench_wait_q,
+					smd_write_avail(bench_ch) >= len,
+					BENCH_TIMEOUT)) {
+				ret = -ETIMEDOUT;
+				break;
+			}
+			continue;
+		}
+		ret = smd_write(bench_ch, bench_tx_buf, len);
+		if (ret != len) {
+			ret = ret < 0 ? ret : -EIO;
+			break;
+		}
+		count++;
+	}
+
+	/* the last packets may only be signalled when the timeout expires */
+	if (ret >= 0 && !wait_event_timeout(bench_wait_q,
+				atomic_read(&bench_rx_pkts) == count,
+				BENCH_TIMEOUT))
+		ret = -ETIMEDOUT;
+	elapsed = ktime_to_ns(ktime_get()) - start;
+	kthread_stop(reader);
+
+	/* drop what a failed run left behind */
+	smd_read(bench_ch, NULL, smd_read_avail(bench_ch));
+
+	if (ret < 0 || !count)
+		return scnprintf(out, out_len, "%8u %8u error %d\n", len,
+				 coalesce, ret);
+
+	signals = atomic_read(&bench_signals);
+	return scnprintf(out, out_len,
+		"%8u %8u %10llu %10llu %10llu %6llu.%02llu\n",
+		len, coalesce, div64_u64(count * NSEC_PER_SEC, elapsed),
+		div64_u64(count * len * NSEC_PER_SEC, (u64)elapsed * 1024),
+		div64_u64(signals * NSEC_PER_SEC, elapsed),
+		div64_u64(signals, count),
+		div64_u64(signals * 100, count) % 100);
+}
+
+static int bench_run(void)
+{
+	unsigned int saved = smd_intr_coalesce_bytes;
+	size_t len;
+	int i, ret;
+
+	for (i = 0; i < bench_nr_sizes; i++)
+		if (!bench_sizes[i] || bench_sizes[i] > BENCH_MAX_PKT)
+			return -EINVAL;
+
+	ret = smd_alloc_loopback_channel();
+	if (ret)
+		return -ENOMEM;
+	ret = smd_named_open_on_edge("local_loopback", SMD_LOOPBACK_TYPE,
+				     &bench_ch, NULL, bench_notify);
+	if (ret)
+		return ret;
+
+	len = scnprintf(bench_results, BENCH_RESULTS_SZ,
+			"loopback fifo %u, timeout %u us, %u ms per size\n"
+			"    size coalesce     pkts/s       KB/s  signals/s"
+			" signals/pkt\n",
+			SMD_BUF_SIZE, smd_intr_coalesce_us,
+			bench_duration_ms);
+	for (i = 0; i < bench_nr_sizes; i++) {
+		len += bench_one_size(bench_sizes[i], 0, bench_results + len,
+				      BENCH_RESULTS_SZ - len);
+		if (bench_coalesce_bytes)
+			len += bench_one_size(bench_sizes[i],
+					      bench_coalesce_bytes,
+					      bench_results + len,
+					      BENCH_RESULTS_SZ - len);
+	}
+	bench_results_len = len;
+
+	smd_intr_coalesce_bytes = saved;
+	smd_close(bench_ch);
+	bench_ch = NULL;
+	return 0;
+}
+
+static ssize_t bench_read(struct file *file, char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&bench_lock);
+	ret = simple_read_from_buffer(buf, count, ppos, bench_results,
+				      bench_results_len);
+	mutex_unlock(&bench_lock);
+	return ret;
+}
+
+static ssize_t bench_write(struct file *file, const char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	char cmd[16];
+	size_t len = min(count, sizeof(cmd) - 1);
+	int ret;
+
+	if (copy_from_user(cmd, buf, len))
+		return -EFAULT;
+	cmd[len] = 0;
+
+	mutex_lock(&bench_lock);
+	if (!strcmp(strim(cmd), "run"))
+		ret = bench_run();
+	else
+		ret = -EINVAL;
+	mutex_unlock(&bench_lock);
+	return ret < 0 ? ret : count;
+}
+
+static const struct file_operations bench_ops = {
+	.owner = THIS_MODULE,
+	.read = bench_read,
+	.write = bench_write,
+};
+
+static int __init smd_bench_init(void)
+{
+	bench_results = kzalloc(BENCH_RESULTS_SZ, GFP_KERNEL);
+	bench_tx_buf = kzalloc(BENCH_MAX_PKT, GFP_KERNEL);
+	bench_rx_buf = kzalloc(BENCH_MAX_PKT, GFP_KERNEL);
+	if (!bench_results || !bench_tx_buf || !bench_rx_buf)
+		goto fail;
+
+	bench_dent = debugfs_create_file("smd_bench", 0644, NULL, NULL,
+					 &bench_ops);
+	if (IS_ERR_OR_NULL(bench_dent)) {
+		pr_err("%s: unable to create debugfs\n", __func__);
+		goto fail;
+	}
+	return 0;
+
+fail:
+	kfree(bench_rx_buf);
+	kfree(bench_tx_buf);
+	kfree(bench_results);
+	return -ENOMEM;
+}
+
+static void __exit smd_bench_exit(void)
+{
+	debugfs_remove(bench_dent);
+	kfree(bench_rx_buf);
+	kfree(bench_tx_buf);
+	kfree(bench_results);
+}
+
+module_init(smd_bench_init);
+module_exit(smd_bench_exit);
+
+MODULE_DESCRIPTION("MSM SMD Benchmark");
+MODULE_LICENSE("GPL v2");
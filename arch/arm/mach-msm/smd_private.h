@@ -22,6 +22,7 @@
 #include <linux/remote_spinlock.h>
 #include <linux/platform_device.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
 #include <mach/msm_smsm.h>
 #include <mach/msm_smd.h>
 
@@ -190,6 +191,10 @@ struct smd_channel {
 
 	char is_pkt_ch;
 
+	/* remote signals held back until enough data has moved */
+	struct hrtimer intr_timer;
+	atomic_t intr_pending;
+
 	/*
 	 * private internal functions to access *send and *recv.
 	 * never to be exported outside of smd
@@ -199,6 +204,11 @@ struct smd_channel {
 
 extern spinlock_t smem_lock;
 
+extern unsigned smd_intr_coalesce_bytes;
+extern unsigned smd_intr_coalesce_us;
+
+int smd_alloc_loopback_channel(void);
+
 
 void smd_diag(void);
 int smd_smsm_erase_efs(void);
@@ -0,0 +1,467 @@
+/*
+ * ChaCha20-Poly1305 AEAD, RFC7539
+ *
+ * Copyright (C) 2015 Martin Willi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <crypto/internal/aead.h>
+#include <crypto/internal/hash.h>
+#include <crypto/scatterwalk.h>
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+#include "internal.h"
+
+#define CHACHAPOLY_IV_SIZE	12
+
+/*
+ * Both halves are instantiated synchronously: the ChaCha20 spawn is a plain
+ * blkcipher and Poly1305 an shash, so a request completes in the caller's
+ * context and needs no callback plumbing between the two steps.
+ */
+struct chachapoly_instance_ctx {
+	struct crypto_spawn chacha;
+	struct crypto_shash_spawn poly;
+	unsigned int saltlen;
+};
+
+struct chachapoly_ctx {
+	struct crypto_blkcipher *chacha;
+	struct crypto_shash *poly;
+	/* key bytes we use for the ChaCha20 IV */
+	unsigned int saltlen;
+	u8 salt[];
+};
+
+struct chachapoly_req_ctx {
+	/* the key we generate for Poly1305 using Chacha20 */
+	u8 key[POLY1305_KEY_SIZE];
+	/* calculated Poly1305 tag */
+	u8 tag[POLY1305_DIGEST_SIZE];
+	/* tag found in the source of a decryption */
+	u8 check[POLY1305_DIGEST_SIZE];
+	/* ChaCha20 IV: little endian block counter followed by the nonce */
+	u8 iv[CHACHA20_IV_SIZE];
+	/* final block of the MAC input */
+	struct {
+		__le64 assoclen;
+		__le64 cryptlen;
+	} tail;
+	/* must be last, followed by the Poly1305 descriptor context */
+	struct shash_desc desc;
+};
+
+static const u8 chachapoly_pad[POLY1305_BLOCK_SIZE];
+
+static void chachapoly_iv(struct aead_request *req, u32 icb)
+{
+	struct chachapoly_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct chachapoly_req_ctx *rctx = aead_request_ctx(req);
+	__le32 leicb = cpu_to_le32(icb);
+
+	memcpy(rctx->iv, &leicb, sizeof(leicb));
+	memcpy(rctx->iv + sizeof(leicb), ctx->salt, ctx->saltlen);
+	memcpy(rctx->iv + sizeof(leicb) + ctx->saltlen, req->iv,
+	       CHACHA20_IV_SIZE - sizeof(leicb) - ctx->saltlen);
+}
+
+static int chachapoly_crypt(struct aead_request *req, struct scatterlist *dst,
+			    struct scatterlist *src, unsigned int len, u32 icb)
+{
+	struct chachapoly_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct chachapoly_req_ctx *rctx = aead_request_ctx(req);
+	struct blkcipher_desc desc = {
+		.tfm	= ctx->chacha,
+		.info	= rctx->iv,
+		.flags	= req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP,
+	};
+
+	chachapoly_iv(req, icb);
+
+	return crypto_blkcipher_encrypt_iv(&desc, dst, src, len);
+}
+
+static int chachapoly_hash_sg(struct shash_desc *desc, struct scatterlist *sg,
+			      unsigned int len)
+{
+	struct scatter_walk walk;
+	unsigned int n;
+	u8 *data;
+	int err = 0;
+
+	if (!len)
+		return 0;
+
+	scatterwalk_start(&walk, sg);
+
+	while (len && !err) {
+		n = scatterwalk_clamp(&walk, len);
+		if (!n) {
+			scatterwalk_start(&walk, sg_next(walk.sg));
+			n = scatterwalk_clamp(&walk, len);
+		}
+		data = scatterwalk_map(&walk);
+
+		err = crypto_shash_update(desc, data, n);
+		len -= n;
+
+		scatterwalk_unmap(data);
+		scatterwalk_advance(&walk, n);
+		scatterwalk_done(&walk, 0, len);
+		if (len)
+			crypto_yield(desc->flags);
+	}
+
+	return err;
+}
+
+static int chachapoly_hash_pad(struct shash_desc *desc, unsigned int len)
+{
+	unsigned int padlen = -len % POLY1305_BLOCK_SIZE;
+
+	if (!padlen)
+		return 0;
+	return crypto_shash_update(desc, chachapoly_pad, padlen);
+}
+
+/*
+ * Derive the one-time Poly1305 key from the first ChaCha20 block and
+ * compute the tag over the associated data and the ciphertext at crypt.
+ */
+static int chachapoly_mac(struct aead_request *req, struct scatterlist *crypt,
+			  unsigned int cryptlen)
+{
+	struct chachapoly_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct chachapoly_req_ctx *rctx = aead_request_ctx(req);
+	struct shash_desc *desc = &rctx->desc;
+	struct scatterlist sg;
+	int err;
+
+	memset(rctx->key, 0, sizeof(rctx->key));
+	sg_init_one(&sg, rctx->key, sizeof(rctx->key));
+	err = chachapoly_crypt(req, &sg, &sg, sizeof(rctx->key), 0);
+	if (err)
+		return err;
+
+	desc->tfm = ctx->poly;
+	desc->flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	err = crypto_shash_init(desc);
+	if (!err)
+		err = crypto_shash_update(desc, rctx->key, sizeof(rctx->key));
+	if (!err)
+		err = chachapoly_hash_sg(desc, req->assoc, req->assoclen);
+	if (!err)
+		err = chachapoly_hash_pad(desc, req->assoclen);
+	if (!err)
+		err = chachapoly_hash_sg(desc, crypt, cryptlen);
+	if (!err)
+		err = chachapoly_hash_pad(desc, cryptlen);
+	if (err)
+		return err;
+
+	rctx->tail.assoclen = cpu_to_le64(req->assoclen);
+	rctx->tail.cryptlen = cpu_to_le64(cryptlen);
+	err = crypto_shash_update(desc, (u8 *)&rctx->tail, sizeof(rctx->tail));
+	if (err)
+		return err;
+
+	return crypto_shash_final(desc, rctx->tag);
+}
+
+static int chachapoly_encrypt(struct aead_request *req)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct chachapoly_req_ctx *rctx = aead_request_ctx(req);
+	int err;
+
+	err = chachapoly_crypt(req, req->dst, req->src, req->cryptlen, 1);
+	if (err)
+		return err;
+
+	err = chachapoly_mac(req, req->dst, req->cryptlen);
+	if (err)
+		return err;
+
+	scatterwalk_map_and_copy(rctx->tag, req->dst, req->cryptlen,
+				 crypto_aead_authsize(tfm), 1);
+	return 0;
+}
+
+static int chachapoly_decrypt(struct aead_request *req)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct chachapoly_req_ctx *rctx = aead_request_ctx(req);
+	unsigned int authsize = crypto_aead_authsize(tfm);
+	unsigned int cryptlen;
+	int err;
+
+	if (req->cryptlen < authsize)
+		return -EINVAL;
+	cryptlen = req->cryptlen - authsize;
+
+	err = chachapoly_mac(req, req->src, cryptlen);
+	if (err)
+		return err;
+
+	scatterwalk_map_and_copy(rctx->check, req->src, cryptlen, authsize, 0);
+	if (memcmp(rctx->tag, rctx->check, authsize))
+		return -EBADMSG;
+
+	return chachapoly_crypt(req, req->dst, req->src, cryptlen, 1);
+}
+
+static int chachapoly_setkey(struct crypto_aead *aead, const u8 *key,
+			     unsigned int keylen)
+{
+	struct chachapoly_ctx *ctx = crypto_aead_ctx(aead);
+	struct crypto_blkcipher *chacha = ctx->chacha;
+	int err;
+
+	if (keylen != ctx->saltlen + CHACHA20_KEY_SIZE) {
+		crypto_aead_set_flags(aead, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+
+	keylen -= ctx->saltlen;
+	memcpy(ctx->salt, key + keylen, ctx->saltlen);
+
+	crypto_blkcipher_clear_flags(chacha, CRYPTO_TFM_REQ_MASK);
+	crypto_blkcipher_set_flags(chacha, crypto_aead_get_flags(aead) &
+					   CRYPTO_TFM_REQ_MASK);
+	err = crypto_blkcipher_setkey(chacha, key, keylen);
+	crypto_aead_set_flags(aead, crypto_blkcipher_get_flags(chacha) &
+				    CRYPTO_TFM_RES_MASK);
+
+	return err;
+}
+
+static int chachapoly_setauthsize(struct crypto_aead *tfm,
+				  unsigned int authsize)
+{
+	if (authsize != POLY1305_DIGEST_SIZE)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int chachapoly_init(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = (void *)tfm->__crt_alg;
+	struct chachapoly_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct chachapoly_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_blkcipher *chacha;
+	struct crypto_shash *poly;
+
+	poly = crypto_spawn_shash(&ictx->poly);
+	if (IS_ERR(poly))
+		return PTR_ERR(poly);
+
+	chacha = crypto_spawn_blkcipher(&ictx->chacha);
+	if (IS_ERR(chacha)) {
+		crypto_free_shash(poly);
+		return PTR_ERR(chacha);
+	}
+
+	ctx->chacha = chacha;
+	ctx->poly = poly;
+	ctx->saltlen = ictx->saltlen;
+
+	tfm->crt_aead.reqsize = sizeof(struct chachapoly_req_ctx) +
+				crypto_shash_descsize(poly);
+
+	return 0;
+}
+
+static void chachapoly_exit(struct crypto_tfm *tfm)
+{
+	struct chachapoly_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_shash(ctx->poly);
+	crypto_free_blkcipher(ctx->chacha);
+}
+
+static struct crypto_instance *chachapoly_alloc(struct rtattr **tb,
+						const char *name,
+						unsigned int ivsize)
+{
+	struct crypto_attr_type *algt;
+	struct crypto_instance *inst;
+	struct crypto_alg *chacha;
+	struct crypto_alg *poly;
+	struct shash_alg *poly_hash;
+	struct chachapoly_instance_ctx *ctx;
+	int err;
+
+	if (ivsize > CHACHAPOLY_IV_SIZE)
+		return ERR_PTR(-EINVAL);
+
+	algt = crypto_get_attr_type(tb);
+	if (IS_ERR(algt))
+		return ERR_CAST(algt);
+
+	if ((algt->type ^ CRYPTO_ALG_TYPE_AEAD) & algt->mask)
+		return ERR_PTR(-EINVAL);
+
+	chacha = crypto_attr_alg(tb[1], CRYPTO_ALG_TYPE_BLKCIPHER,
+				 CRYPTO_ALG_TYPE_MASK);
+	if (IS_ERR(chacha))
+		return ERR_CAST(chacha);
+
+	poly_hash = shash_attr_alg(tb[2], 0, 0);
+	inst = ERR_CAST(poly_hash);
+	if (IS_ERR(poly_hash))
+		goto out_put_chacha;
+
+	poly = &poly_hash->base;
+
+	inst = ERR_PTR(-EINVAL);
+	if (poly_hash->digestsize != POLY1305_DIGEST_SIZE)
+		goto out_put_poly;
+	/* Need 16-byte IV size, including Initial Block Counter value */
+	if (chacha->cra_blkcipher.ivsize != CHACHA20_IV_SIZE)
+		goto out_put_poly;
+	/* Not a stream cipher? */
+	if (chacha->cra_blocksize != 1)
+		goto out_put_poly;
+
+	inst = kzalloc(sizeof(*inst) + sizeof(*ctx), GFP_KERNEL);
+	if (!inst) {
+		inst = ERR_PTR(-ENOMEM);
+		goto out_put_poly;
+	}
+
+	ctx = crypto_instance_ctx(inst);
+	ctx->saltlen = CHACHAPOLY_IV_SIZE - ivsize;
+
+	err = crypto_init_spawn(&ctx->chacha, chacha, inst,
+				CRYPTO_ALG_TYPE_MASK);
+	if (err)
+		goto err_free_inst;
+
+	err = crypto_init_shash_spawn(&ctx->poly, poly_hash, inst);
+	if (err)
+		goto err_drop_chacha;
+
+	err = -ENAMETOOLONG;
+	if (snprintf(inst->alg.cra_name, CRYPTO_MAX_ALG_NAME,
+		     "%s(%s,%s)", name, chacha->cra_name,
+		     poly->cra_name) >= CRYPTO_MAX_ALG_NAME)
+		goto err_drop_poly;
+	if (snprintf(inst->alg.cra_driver_name, CRYPTO_MAX_ALG_NAME,
+		     "%s(%s,%s)", name, chacha->cra_driver_name,
+		     poly->cra_driver_name) >= CRYPTO_MAX_ALG_NAME)
+		goto err_drop_poly;
+
+	inst->alg.cra_flags = CRYPTO_ALG_TYPE_AEAD;
+	inst->alg.cra_priority = (chacha->cra_priority +
+				  poly->cra_priority) / 2;
+	inst->alg.cra_blocksize = 1;
+	inst->alg.cra_alignmask = chacha->cra_alignmask | poly->cra_alignmask;
+	inst->alg.cra_ctxsize = sizeof(struct chachapoly_ctx) + ctx->saltlen;
+	inst->alg.cra_init = chachapoly_init;
+	inst->alg.cra_exit = chachapoly_exit;
+
+	inst->alg.cra_aead.ivsize = ivsize;
+	inst->alg.cra_aead.maxauthsize = POLY1305_DIGEST_SIZE;
+	inst->alg.cra_aead.setkey = chachapoly_setkey;
+	inst->alg.cra_aead.setauthsize = chachapoly_setauthsize;
+	inst->alg.cra_aead.encrypt = chachapoly_encrypt;
+	inst->alg.cra_aead.decrypt = chachapoly_decrypt;
+
+	if (ctx->saltlen) {
+		/* the IPsec flavour gets its IV from the sequence number */
+		inst->alg.cra_type = &crypto_nivaead_type;
+		inst->alg.cra_aead.geniv = "seqiv";
+	} else {
+		inst->alg.cra_type = &crypto_aead_type;
+	}
+
+out_put_poly:
+	crypto_mod_put(poly);
+out_put_chacha:
+	crypto_mod_put(chacha);
+	return inst;
+
+err_drop_poly:
+	crypto_drop_shash(&ctx->poly);
+err_drop_chacha:
+	crypto_drop_spawn(&ctx->chacha);
+err_free_inst:
+	kfree(inst);
+	inst = ERR_PTR(err);
+	goto out_put_poly;
+}
+
+static void chachapoly_free(struct crypto_instance *inst)
+{
+	struct chachapoly_instance_ctx *ctx = crypto_instance_ctx(inst);
+
+	crypto_drop_spawn(&ctx->chacha);
+	crypto_drop_shash(&ctx->poly);
+	kfree(inst);
+}
+
+static struct crypto_instance *rfc7539_alloc(struct rtattr **tb)
+{
+	return chachapoly_alloc(tb, "rfc7539", 12);
+}
+
+static struct crypto_instance *rfc7539esp_alloc(struct rtattr **tb)
+{
+	return chachapoly_alloc(tb, "rfc7539esp", 8);
+}
+
+static struct crypto_template rfc7539_tmpl = {
+	.name = "rfc7539",
+	.alloc = rfc7539_alloc,
+	.free = chachapoly_free,
+	.module = THIS_MODULE,
+};
+
+static struct crypto_template rfc7539esp_tmpl = {
+	.name = "rfc7539esp",
+	.alloc = rfc7539esp_alloc,
+	.free = chachapoly_free,
+	.module = THIS_MODULE,
+};
+
+static int __init chacha20poly1305_module_init(void)
+{
+	int err;
+
+	err = crypto_register_template(&rfc7539_tmpl);
+	if (err)
+		return err;
+
+	err = crypto_register_template(&rfc7539esp_tmpl);
+	if (err)
+		crypto_unregister_template(&rfc7539_tmpl);
+
+	return err;
+}
+
+static void __exit chacha20poly1305_module_exit(void)
+{
+	crypto_unregister_template(&rfc7539esp_tmpl);
+	crypto_unregister_template(&rfc7539_tmpl);
+}
+
+module_init(chacha20poly1305_module_init);
+module_exit(chacha20poly1305_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Martin Willi <martin@strongswan.org>");
+MODULE_DESCRIPTION("ChaCha20-Poly1305 AEAD");
+MODULE_ALIAS("rfc7539");
+MODULE_ALIAS("rfc7539esp");
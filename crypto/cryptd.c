@@ -75,6 +75,8 @@ struct cryptd_hash_request_ctx {
 };
 
 struct cryptd_aead_ctx {
+	/* one for cryptd_alloc_aead(), one per request in cryptd */
+	atomic_t refcnt;
 	struct crypto_aead *child;
 };
 
@@ -633,17 +635,31 @@ static void cryptd_aead_crypt(struct aead_request *req,
 			int (*crypt)(struct aead_request *req))
 {
 	struct cryptd_aead_request_ctx *rctx;
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct cryptd_aead_ctx *ctx = crypto_aead_ctx(tfm);
+	crypto_completion_t compl;
+	int refcnt;
+
 	rctx = aead_request_ctx(req);
+	/* the child takes the request context over */
+	compl = rctx->complete;
 
 	if (unlikely(err == -EINPROGRESS))
 		goto out;
 	aead_request_set_tfm(req, child);
 	err = crypt( req );
-	req->base.complete = rctx->complete;
+	req->base.complete = compl;
 out:
+	refcnt = atomic_read(&ctx->refcnt);
+
 	local_bh_disable();
-	rctx->complete(&req->base, err);
+	compl(&req->base, err);
 	local_bh_enable();
+
+	/* the request leaves the queue only once its owner was told */
+	if (err != -EINPROGRESS && refcnt &&
+	    atomic_dec_and_test(&ctx->refcnt))
+		crypto_free_aead(tfm);
 }
 
 static void cryptd_aead_encrypt(struct crypto_async_request *areq, int err)
@@ -671,11 +687,22 @@ static int cryptd_aead_enqueue(struct aead_request *req,
 {
 	struct cryptd_aead_request_ctx *rctx = aead_request_ctx(req);
 	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct cryptd_aead_ctx *ctx = crypto_aead_ctx(tfm);
 	struct cryptd_queue *queue = cryptd_get_queue(crypto_aead_tfm(tfm));
+	bool counted = atomic_read(&ctx->refcnt);
+	int err;
 
 	rctx->complete = req->base.complete;
 	req->base.complete = complete;
-	return cryptd_enqueue_request(queue, &req->base);
+
+	if (counted)
+		atomic_inc(&ctx->refcnt);
+	err = cryptd_enqueue_request(queue, &req->base);
+	/* refused rather than backlogged */
+	if (counted && err == -EBUSY &&
+	    !(req->base.flags & CRYPTO_TFM_REQ_MAY_BACKLOG))
+		atomic_dec(&ctx->refcnt);
+	return err;
 }
 
 static int cryptd_aead_encrypt_enqueue(struct aead_request *req)
@@ -899,6 +926,7 @@ struct cryptd_aead *cryptd_alloc_aead(const char *alg_name,
 						  u32 type, u32 mask)
 {
 	char cryptd_alg_name[CRYPTO_MAX_ALG_NAME];
+	struct cryptd_aead_ctx *ctx;
 	struct crypto_aead *tfm;
 
 	if (snprintf(cryptd_alg_name, CRYPTO_MAX_ALG_NAME,
@@ -911,6 +939,10 @@ struct cryptd_aead *cryptd_alloc_aead(const char *alg_name,
 		crypto_free_aead(tfm);
 		return ERR_PTR(-EINVAL);
 	}
+
+	ctx = crypto_aead_ctx(tfm);
+	atomic_set(&ctx->refcnt, 1);
+
 	return __cryptd_aead_cast(tfm);
 }
 EXPORT_SYMBOL_GPL(cryptd_alloc_aead);
@@ -923,9 +955,25 @@ struct crypto_aead *cryptd_aead_child(struct cryptd_aead *tfm)
 }
 EXPORT_SYMBOL_GPL(cryptd_aead_child);
 
+/*
+ * Whether requests of @tfm are still in cryptd; until they are out, a
+ * request that bypasses cryptd could complete ahead of them.
+ */
+bool cryptd_aead_queued(struct cryptd_aead *tfm)
+{
+	struct cryptd_aead_ctx *ctx = crypto_aead_ctx(&tfm->base);
+
+	return atomic_read(&ctx->refcnt) - 1;
+}
+EXPORT_SYMBOL_GPL(cryptd_aead_queued);
+
 void cryptd_free_aead(struct cryptd_aead *tfm)
 {
-	crypto_free_aead(&tfm->base);
+	struct cryptd_aead_ctx *ctx = crypto_aead_ctx(&tfm->base);
+
+	/* the last request out of cryptd frees it otherwise */
+	if (atomic_dec_and_test(&ctx->refcnt))
+		crypto_free_aead(&tfm->base);
 }
 EXPORT_SYMBOL_GPL(cryptd_free_aead);
 
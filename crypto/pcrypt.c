@@ -20,6 +20,8 @@
 
 #include <crypto/algapi.h>
 #include <crypto/internal/aead.h>
+#include <crypto/internal/hash.h>
+#include <crypto/internal/skcipher.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/module.h>
@@ -27,12 +29,23 @@
 #include <linux/notifier.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/workqueue.h>
 #include <crypto/pcrypt.h>
 
 struct padata_pcrypt {
 	struct padata_instance *pinst;
 	struct workqueue_struct *wq;
 
+	/*
+	 * Cipher and hash requests that may be backlogged wait here, in
+	 * submission order, while padata is saturated.  They are handed to
+	 * padata as in-flight requests complete, or from backlog_work when
+	 * padata refused them for another reason, like a cpumask change.
+	 */
+	spinlock_t backlog_lock;
+	struct list_head backlog;
+	struct delayed_work backlog_work;
+
 	/*
 	 * Cpumask for callback CPUs. It should be
 	 * equal to serial cpumask of corresponding padata instance,
@@ -64,11 +77,43 @@ struct pcrypt_instance_ctx {
 	unsigned int tfm_count;
 };
 
+struct pcrypt_ahash_instance_ctx {
+	struct crypto_ahash_spawn spawn;
+	unsigned int tfm_count;
+};
+
 struct pcrypt_aead_ctx {
 	struct crypto_aead *child;
 	unsigned int cb_cpu;
 };
 
+struct pcrypt_ablkcipher_ctx {
+	struct crypto_ablkcipher *child;
+	unsigned int cb_cpu;
+};
+
+struct pcrypt_ahash_ctx {
+	struct crypto_ahash *child;
+	unsigned int cb_cpu;
+};
+
+/*
+ * Spread the callback CPUs of the transforms of one instance round robin
+ * over the online CPUs.
+ */
+static unsigned int pcrypt_tfm_cb_cpu(unsigned int tfm_count)
+{
+	unsigned int cpu, cpu_index, cb_cpu;
+
+	cpu_index = tfm_count % cpumask_weight(cpu_online_mask);
+
+	cb_cpu = cpumask_first(cpu_online_mask);
+	for (cpu = 0; cpu < cpu_index; cpu++)
+		cb_cpu = cpumask_next(cb_cpu, cpu_online_mask);
+
+	return cb_cpu;
+}
+
 static int pcrypt_do_parallel(struct padata_priv *padata, unsigned int *cb_cpu,
 			      struct padata_pcrypt *pcrypt)
 {
@@ -98,6 +143,100 @@ out:
 	return padata_do_parallel(pcrypt->pinst, padata, cpu);
 }
 
+/*
+ * Move backlogged requests into padata for as long as it takes them.  Each
+ * submitter is told with -EINPROGRESS, once, that its request has left the
+ * backlog; that is done before the request can possibly complete.
+ */
+static void pcrypt_backlog_run(struct padata_pcrypt *pcrypt)
+{
+	struct crypto_async_request *req;
+	struct padata_priv *padata;
+	unsigned int cpu;
+
+	spin_lock_bh(&pcrypt->backlog_lock);
+	while (!list_empty(&pcrypt->backlog)) {
+		padata = list_first_entry(&pcrypt->backlog,
+					  struct padata_priv, list);
+		if (!padata->info) {
+			/* every child request starts with its async request */
+			req = pcrypt_request_ctx(pcrypt_padata_request(padata));
+			req = req->data;
+			padata->info = -EINPROGRESS;
+			spin_unlock_bh(&pcrypt->backlog_lock);
+			req->complete(req, -EINPROGRESS);
+			spin_lock_bh(&pcrypt->backlog_lock);
+			continue;
+		}
+
+		list_del(&padata->list);
+		cpu = padata->cb_cpu;
+		if (pcrypt_do_parallel(padata, &cpu, pcrypt)) {
+			list_add(&padata->list, &pcrypt->backlog);
+			queue_delayed_work(pcrypt->wq, &pcrypt->backlog_work, 1);
+			break;
+		}
+	}
+	spin_unlock_bh(&pcrypt->backlog_lock);
+}
+
+static void pcrypt_backlog_worker(struct work_struct *work)
+{
+	struct padata_pcrypt *pcrypt = container_of(to_delayed_work(work),
+						    struct padata_pcrypt,
+						    backlog_work);
+
+	pcrypt_backlog_run(pcrypt);
+}
+
+static void pcrypt_backlog_kick(void)
+{
+	if (!list_empty(&pencrypt.backlog))
+		pcrypt_backlog_run(&pencrypt);
+	if (!list_empty(&pdecrypt.backlog))
+		pcrypt_backlog_run(&pdecrypt);
+}
+
+/*
+ * Queue a cipher or hash request behind any backlogged ones.  When padata
+ * is saturated, a request that may be backlogged is kept back, still in
+ * order, and -EBUSY tells the submitter so; others are refused with -EBUSY.
+ */
+static int pcrypt_do_parallel_ordered(struct padata_priv *padata,
+				      unsigned int *cb_cpu,
+				      struct padata_pcrypt *pcrypt, u32 flags)
+{
+	int err = -EBUSY;
+
+	if (!list_empty(&pcrypt->backlog))
+		pcrypt_backlog_run(pcrypt);
+
+	spin_lock_bh(&pcrypt->backlog_lock);
+	if (list_empty(&pcrypt->backlog)) {
+		err = pcrypt_do_parallel(padata, cb_cpu, pcrypt);
+		if (err != -EBUSY)
+			goto out;
+	}
+	if (flags & CRYPTO_TFM_REQ_MAY_BACKLOG) {
+		padata->cb_cpu = *cb_cpu;
+		list_add_tail(&padata->list, &pcrypt->backlog);
+		queue_delayed_work(pcrypt->wq, &pcrypt->backlog_work, 1);
+	}
+out:
+	spin_unlock_bh(&pcrypt->backlog_lock);
+	return err;
+}
+
+/*
+ * A child request that returned -EBUSY was backlogged, and completes later,
+ * only if it may be; otherwise it was refused and has to complete here.
+ */
+static bool pcrypt_child_queued(int err, u32 flags)
+{
+	return err == -EINPROGRESS ||
+	       (err == -EBUSY && (flags & CRYPTO_TFM_REQ_MAY_BACKLOG));
+}
+
 static int pcrypt_aead_setkey(struct crypto_aead *parent,
 			      const u8 *key, unsigned int keylen)
 {
@@ -272,19 +411,13 @@ static int pcrypt_aead_givencrypt(struct aead_givcrypt_request *req)
 
 static int pcrypt_aead_init_tfm(struct crypto_tfm *tfm)
 {
-	int cpu, cpu_index;
 	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
 	struct pcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
 	struct pcrypt_aead_ctx *ctx = crypto_tfm_ctx(tfm);
 	struct crypto_aead *cipher;
 
 	ictx->tfm_count++;
-
-	cpu_index = ictx->tfm_count % cpumask_weight(cpu_online_mask);
-
-	ctx->cb_cpu = cpumask_first(cpu_online_mask);
-	for (cpu = 0; cpu < cpu_index; cpu++)
-		ctx->cb_cpu = cpumask_next(ctx->cb_cpu, cpu_online_mask);
+	ctx->cb_cpu = pcrypt_tfm_cb_cpu(ictx->tfm_count);
 
 	cipher = crypto_spawn_aead(crypto_instance_ctx(inst));
 
@@ -306,17 +439,356 @@ static void pcrypt_aead_exit_tfm(struct crypto_tfm *tfm)
 	crypto_free_aead(ctx->child);
 }
 
-static struct crypto_instance *pcrypt_alloc_instance(struct crypto_alg *alg)
+static int pcrypt_ablkcipher_setkey(struct crypto_ablkcipher *parent,
+				    const u8 *key, unsigned int keylen)
+{
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_ablkcipher_ctx(parent);
+	struct crypto_ablkcipher *child = ctx->child;
+	int err;
+
+	crypto_ablkcipher_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_ablkcipher_set_flags(child, crypto_ablkcipher_get_flags(parent) &
+					   CRYPTO_TFM_REQ_MASK);
+	err = crypto_ablkcipher_setkey(child, key, keylen);
+	crypto_ablkcipher_set_flags(parent, crypto_ablkcipher_get_flags(child) &
+					    CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static void pcrypt_ablkcipher_serial(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+
+	ablkcipher_request_complete(req->base.data, padata->info);
+	pcrypt_backlog_kick();
+}
+
+static void pcrypt_ablkcipher_done(struct crypto_async_request *areq, int err)
+{
+	struct ablkcipher_request *req = areq->data;
+	struct pcrypt_request *preq = ablkcipher_request_ctx(req);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+
+	/* a backlogged child request has only been queued */
+	if (err == -EINPROGRESS)
+		return;
+
+	padata->info = err;
+	req->base.flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ablkcipher_enc(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ablkcipher_encrypt(req);
+
+	if (pcrypt_child_queued(padata->info, req->base.flags))
+		return;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ablkcipher_dec(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ablkcipher_decrypt(req);
+
+	if (pcrypt_child_queued(padata->info, req->base.flags))
+		return;
+
+	padata_do_serial(padata);
+}
+
+static int pcrypt_ablkcipher_crypt(struct ablkcipher_request *req,
+				   void (*parallel)(struct padata_priv *padata),
+				   struct padata_pcrypt *pcrypt)
+{
+	int err;
+	struct pcrypt_request *preq = ablkcipher_request_ctx(req);
+	struct ablkcipher_request *creq = pcrypt_request_ctx(preq);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	u32 flags = ablkcipher_request_flags(req);
+
+	memset(padata, 0, sizeof(struct padata_priv));
+
+	padata->parallel = parallel;
+	padata->serial = pcrypt_ablkcipher_serial;
+
+	ablkcipher_request_set_tfm(creq, ctx->child);
+	ablkcipher_request_set_callback(creq, flags & ~CRYPTO_TFM_REQ_MAY_SLEEP,
+					pcrypt_ablkcipher_done, req);
+	ablkcipher_request_set_crypt(creq, req->src, req->dst,
+				     req->nbytes, req->info);
+
+	err = pcrypt_do_parallel_ordered(padata, &ctx->cb_cpu, pcrypt, flags);
+	if (!err)
+		return -EINPROGRESS;
+
+	return err;
+}
+
+static int pcrypt_ablkcipher_encrypt(struct ablkcipher_request *req)
+{
+	return pcrypt_ablkcipher_crypt(req, pcrypt_ablkcipher_enc, &pencrypt);
+}
+
+static int pcrypt_ablkcipher_decrypt(struct ablkcipher_request *req)
+{
+	return pcrypt_ablkcipher_crypt(req, pcrypt_ablkcipher_dec, &pdecrypt);
+}
+
+static int pcrypt_ablkcipher_init_tfm(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
+	struct pcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_ablkcipher *cipher;
+
+	ictx->tfm_count++;
+	ctx->cb_cpu = pcrypt_tfm_cb_cpu(ictx->tfm_count);
+
+	cipher = __crypto_ablkcipher_cast(
+		crypto_spawn_tfm(&ictx->spawn, crypto_skcipher_type(0),
+				 crypto_skcipher_mask(0)));
+	if (IS_ERR(cipher))
+		return PTR_ERR(cipher);
+
+	ctx->child = cipher;
+	tfm->crt_ablkcipher.reqsize = sizeof(struct pcrypt_request)
+		+ sizeof(struct ablkcipher_request)
+		+ crypto_ablkcipher_reqsize(cipher);
+
+	return 0;
+}
+
+static void pcrypt_ablkcipher_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_ablkcipher(ctx->child);
+}
+
+static int pcrypt_ahash_setkey(struct crypto_ahash *parent,
+			       const u8 *key, unsigned int keylen)
 {
+	struct pcrypt_ahash_ctx *ctx = crypto_ahash_ctx(parent);
+	struct crypto_ahash *child = ctx->child;
+	int err;
+
+	crypto_ahash_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_ahash_set_flags(child, crypto_ahash_get_flags(parent) &
+				      CRYPTO_TFM_REQ_MASK);
+	err = crypto_ahash_setkey(child, key, keylen);
+	crypto_ahash_set_flags(parent, crypto_ahash_get_flags(child) &
+				       CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static void pcrypt_ahash_serial(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ahash_request *req = pcrypt_request_ctx(preq);
+	struct ahash_request *parent = req->base.data;
+
+	parent->base.complete(&parent->base, padata->info);
+	pcrypt_backlog_kick();
+}
+
+static void pcrypt_ahash_done(struct crypto_async_request *areq, int err)
+{
+	struct ahash_request *req = areq->data;
+	struct pcrypt_request *preq = ahash_request_ctx(req);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+
+	if (err == -EINPROGRESS)
+		return;
+
+	padata->info = err;
+	req->base.flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ahash_complete(struct crypto_async_request *areq, int err)
+{
+	struct ahash_request *req = areq->data;
+
+	req->base.complete(&req->base, err);
+}
+
+/* point the child request at the parent's data */
+static struct ahash_request *pcrypt_ahash_child(struct ahash_request *req,
+						crypto_completion_t complete,
+						u32 flags)
+{
+	struct pcrypt_request *preq = ahash_request_ctx(req);
+	struct ahash_request *creq = pcrypt_request_ctx(preq);
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct pcrypt_ahash_ctx *ctx = crypto_ahash_ctx(tfm);
+
+	ahash_request_set_tfm(creq, ctx->child);
+	ahash_request_set_callback(creq, flags, complete, req);
+	ahash_request_set_crypt(creq, req->src, req->result, req->nbytes);
+
+	return creq;
+}
+
+static void pcrypt_ahash_run(struct padata_priv *padata,
+			     int (*op)(struct ahash_request *req))
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ahash_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = op(req);
+
+	if (pcrypt_child_queued(padata->info, req->base.flags))
+		return;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ahash_update_par(struct padata_priv *padata)
+{
+	pcrypt_ahash_run(padata, crypto_ahash_update);
+}
+
+static void pcrypt_ahash_final_par(struct padata_priv *padata)
+{
+	pcrypt_ahash_run(padata, crypto_ahash_final);
+}
+
+static void pcrypt_ahash_finup_par(struct padata_priv *padata)
+{
+	pcrypt_ahash_run(padata, crypto_ahash_finup);
+}
+
+static void pcrypt_ahash_digest_par(struct padata_priv *padata)
+{
+	pcrypt_ahash_run(padata, crypto_ahash_digest);
+}
+
+/*
+ * Hash requests share the encryption instance: they carry no direction
+ * and only need to complete in the order they were submitted in.
+ */
+static int pcrypt_ahash_queue(struct ahash_request *req,
+			      void (*parallel)(struct padata_priv *padata))
+{
+	int err;
+	struct pcrypt_request *preq = ahash_request_ctx(req);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct pcrypt_ahash_ctx *ctx = crypto_ahash_ctx(tfm);
+	u32 flags = req->base.flags;
+
+	memset(padata, 0, sizeof(struct padata_priv));
+
+	padata->parallel = parallel;
+	padata->serial = pcrypt_ahash_serial;
+
+	pcrypt_ahash_child(req, pcrypt_ahash_done,
+			   flags & ~CRYPTO_TFM_REQ_MAY_SLEEP);
+
+	err = pcrypt_do_parallel_ordered(padata, &ctx->cb_cpu, &pencrypt,
+					 flags);
+	if (!err)
+		return -EINPROGRESS;
+
+	return err;
+}
+
+static int pcrypt_ahash_init(struct ahash_request *req)
+{
+	/* nothing to gain from running the initialisation in parallel */
+	return crypto_ahash_init(pcrypt_ahash_child(req, pcrypt_ahash_complete,
+						    req->base.flags));
+}
+
+static int pcrypt_ahash_update(struct ahash_request *req)
+{
+	return pcrypt_ahash_queue(req, pcrypt_ahash_update_par);
+}
+
+static int pcrypt_ahash_final(struct ahash_request *req)
+{
+	return pcrypt_ahash_queue(req, pcrypt_ahash_final_par);
+}
+
+static int pcrypt_ahash_finup(struct ahash_request *req)
+{
+	return pcrypt_ahash_queue(req, pcrypt_ahash_finup_par);
+}
+
+static int pcrypt_ahash_digest(struct ahash_request *req)
+{
+	return pcrypt_ahash_queue(req, pcrypt_ahash_digest_par);
+}
+
+static int pcrypt_ahash_export(struct ahash_request *req, void *out)
+{
+	return crypto_ahash_export(pcrypt_ahash_child(req,
+						      pcrypt_ahash_complete,
+						      req->base.flags), out);
+}
+
+static int pcrypt_ahash_import(struct ahash_request *req, const void *in)
+{
+	return crypto_ahash_import(pcrypt_ahash_child(req,
+						      pcrypt_ahash_complete,
+						      req->base.flags), in);
+}
+
+static int pcrypt_ahash_init_tfm(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
+	struct pcrypt_ahash_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct pcrypt_ahash_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_ahash *hash;
+
+	ictx->tfm_count++;
+	ctx->cb_cpu = pcrypt_tfm_cb_cpu(ictx->tfm_count);
+
+	hash = crypto_spawn_ahash(&ictx->spawn);
+	if (IS_ERR(hash))
+		return PTR_ERR(hash);
+
+	ctx->child = hash;
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+				 sizeof(struct pcrypt_request) +
+				 sizeof(struct ahash_request) +
+				 crypto_ahash_reqsize(hash));
+
+	return 0;
+}
+
+static void pcrypt_ahash_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct pcrypt_ahash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_ahash(ctx->child);
+}
+
+static void *pcrypt_alloc_instance(struct crypto_alg *alg,
+				   unsigned int head, unsigned int tail)
+{
+	char *p;
 	struct crypto_instance *inst;
-	struct pcrypt_instance_ctx *ctx;
 	int err;
 
-	inst = kzalloc(sizeof(*inst) + sizeof(*ctx), GFP_KERNEL);
-	if (!inst) {
-		inst = ERR_PTR(-ENOMEM);
-		goto out;
-	}
+	p = kzalloc(head + sizeof(*inst) + tail, GFP_KERNEL);
+	if (!p)
+		return ERR_PTR(-ENOMEM);
+
+	inst = (void *)(p + head);
 
 	err = -ENAMETOOLONG;
 	if (snprintf(inst->alg.cra_driver_name, CRYPTO_MAX_ALG_NAME,
@@ -325,39 +797,42 @@ static struct crypto_instance *pcrypt_alloc_instance(struct crypto_alg *alg)
 
 	memcpy(inst->alg.cra_name, alg->cra_name, CRYPTO_MAX_ALG_NAME);
 
-	ctx = crypto_instance_ctx(inst);
-	err = crypto_init_spawn(&ctx->spawn, alg, inst,
-				CRYPTO_ALG_TYPE_MASK);
-	if (err)
-		goto out_free_inst;
-
 	inst->alg.cra_priority = alg->cra_priority + 100;
 	inst->alg.cra_blocksize = alg->cra_blocksize;
 	inst->alg.cra_alignmask = alg->cra_alignmask;
 
 out:
-	return inst;
+	return p;
 
 out_free_inst:
-	kfree(inst);
-	inst = ERR_PTR(err);
+	kfree(p);
+	p = ERR_PTR(err);
 	goto out;
 }
 
-static struct crypto_instance *pcrypt_alloc_aead(struct rtattr **tb,
-						 u32 type, u32 mask)
+static int pcrypt_create_aead(struct crypto_template *tmpl, struct rtattr **tb,
+			      u32 type, u32 mask)
 {
+	struct pcrypt_instance_ctx *ctx;
 	struct crypto_instance *inst;
 	struct crypto_alg *alg;
+	int err;
 
 	alg = crypto_get_attr_alg(tb, type, (mask & CRYPTO_ALG_TYPE_MASK));
 	if (IS_ERR(alg))
-		return ERR_CAST(alg);
+		return PTR_ERR(alg);
 
-	inst = pcrypt_alloc_instance(alg);
+	inst = pcrypt_alloc_instance(alg, 0, sizeof(*ctx));
+	err = PTR_ERR(inst);
 	if (IS_ERR(inst))
 		goto out_put_alg;
 
+	ctx = crypto_instance_ctx(inst);
+	err = crypto_init_spawn(&ctx->spawn, alg, inst,
+				CRYPTO_ALG_TYPE_MASK);
+	if (err)
+		goto out_free_inst;
+
 	inst->alg.cra_flags = CRYPTO_ALG_TYPE_AEAD | CRYPTO_ALG_ASYNC;
 	inst->alg.cra_type = &crypto_aead_type;
 
@@ -376,33 +851,175 @@ static struct crypto_instance *pcrypt_alloc_aead(struct rtattr **tb,
 	inst->alg.cra_aead.decrypt = pcrypt_aead_decrypt;
 	inst->alg.cra_aead.givencrypt = pcrypt_aead_givencrypt;
 
+	err = crypto_register_instance(tmpl, inst);
+	if (err) {
+		crypto_drop_spawn(&ctx->spawn);
+out_free_inst:
+		kfree(inst);
+	}
+
 out_put_alg:
 	crypto_mod_put(alg);
-	return inst;
+	return err;
 }
 
-static struct crypto_instance *pcrypt_alloc(struct rtattr **tb)
+/* wraps synchronous blkciphers as well as ablkciphers */
+static int pcrypt_create_ablkcipher(struct crypto_template *tmpl,
+				    struct rtattr **tb)
+{
+	struct pcrypt_instance_ctx *ctx;
+	struct crypto_instance *inst;
+	struct crypto_alg *alg;
+	int err;
+
+	alg = crypto_get_attr_alg(tb, CRYPTO_ALG_TYPE_BLKCIPHER,
+				  CRYPTO_ALG_TYPE_BLKCIPHER_MASK);
+	if (IS_ERR(alg))
+		return PTR_ERR(alg);
+
+	inst = pcrypt_alloc_instance(alg, 0, sizeof(*ctx));
+	err = PTR_ERR(inst);
+	if (IS_ERR(inst))
+		goto out_put_alg;
+
+	ctx = crypto_instance_ctx(inst);
+	err = crypto_init_spawn(&ctx->spawn, alg, inst,
+				CRYPTO_ALG_TYPE_BLKCIPHER_MASK);
+	if (err)
+		goto out_free_inst;
+
+	inst->alg.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC;
+	inst->alg.cra_type = &crypto_ablkcipher_type;
+
+	if ((alg->cra_flags & CRYPTO_ALG_TYPE_MASK) ==
+	    CRYPTO_ALG_TYPE_BLKCIPHER) {
+		inst->alg.cra_ablkcipher.ivsize = alg->cra_blkcipher.ivsize;
+		inst->alg.cra_ablkcipher.min_keysize =
+			alg->cra_blkcipher.min_keysize;
+		inst->alg.cra_ablkcipher.max_keysize =
+			alg->cra_blkcipher.max_keysize;
+		inst->alg.cra_ablkcipher.geniv = alg->cra_blkcipher.geniv;
+	} else {
+		inst->alg.cra_ablkcipher.ivsize = alg->cra_ablkcipher.ivsize;
+		inst->alg.cra_ablkcipher.min_keysize =
+			alg->cra_ablkcipher.min_keysize;
+		inst->alg.cra_ablkcipher.max_keysize =
+			alg->cra_ablkcipher.max_keysize;
+		inst->alg.cra_ablkcipher.geniv = alg->cra_ablkcipher.geniv;
+	}
+
+	inst->alg.cra_ctxsize = sizeof(struct pcrypt_ablkcipher_ctx);
+
+	inst->alg.cra_init = pcrypt_ablkcipher_init_tfm;
+	inst->alg.cra_exit = pcrypt_ablkcipher_exit_tfm;
+
+	inst->alg.cra_ablkcipher.setkey = pcrypt_ablkcipher_setkey;
+	inst->alg.cra_ablkcipher.encrypt = pcrypt_ablkcipher_encrypt;
+	inst->alg.cra_ablkcipher.decrypt = pcrypt_ablkcipher_decrypt;
+
+	err = crypto_register_instance(tmpl, inst);
+	if (err) {
+		crypto_drop_spawn(&ctx->spawn);
+out_free_inst:
+		kfree(inst);
+	}
+
+out_put_alg:
+	crypto_mod_put(alg);
+	return err;
+}
+
+static int pcrypt_create_ahash(struct crypto_template *tmpl,
+			       struct rtattr **tb)
+{
+	struct pcrypt_ahash_instance_ctx *ctx;
+	struct ahash_instance *inst;
+	struct hash_alg_common *halg;
+	struct crypto_alg *alg;
+	int err;
+
+	halg = ahash_attr_alg(tb[1], 0, 0);
+	if (IS_ERR(halg))
+		return PTR_ERR(halg);
+
+	alg = &halg->base;
+	inst = pcrypt_alloc_instance(alg, ahash_instance_headroom(),
+				     sizeof(*ctx));
+	err = PTR_ERR(inst);
+	if (IS_ERR(inst))
+		goto out_put_alg;
+
+	ctx = ahash_instance_ctx(inst);
+	err = crypto_init_ahash_spawn(&ctx->spawn, halg,
+				      ahash_crypto_instance(inst));
+	if (err)
+		goto out_free_inst;
+
+	inst->alg.halg.base.cra_flags = CRYPTO_ALG_ASYNC;
+
+	inst->alg.halg.digestsize = halg->digestsize;
+	inst->alg.halg.statesize = halg->statesize;
+	inst->alg.halg.base.cra_ctxsize = sizeof(struct pcrypt_ahash_ctx);
+
+	inst->alg.halg.base.cra_init = pcrypt_ahash_init_tfm;
+	inst->alg.halg.base.cra_exit = pcrypt_ahash_exit_tfm;
+
+	inst->alg.init   = pcrypt_ahash_init;
+	inst->alg.update = pcrypt_ahash_update;
+	inst->alg.final  = pcrypt_ahash_final;
+	inst->alg.finup  = pcrypt_ahash_finup;
+	inst->alg.digest = pcrypt_ahash_digest;
+	inst->alg.export = pcrypt_ahash_export;
+	inst->alg.import = pcrypt_ahash_import;
+	inst->alg.setkey = pcrypt_ahash_setkey;
+
+	err = ahash_register_instance(tmpl, inst);
+	if (err) {
+		crypto_drop_ahash(&ctx->spawn);
+out_free_inst:
+		kfree(inst);
+	}
+
+out_put_alg:
+	crypto_mod_put(alg);
+	return err;
+}
+
+static int pcrypt_create(struct crypto_template *tmpl, struct rtattr **tb)
 {
 	struct crypto_attr_type *algt;
 
 	algt = crypto_get_attr_type(tb);
 	if (IS_ERR(algt))
-		return ERR_CAST(algt);
+		return PTR_ERR(algt);
 
 	switch (algt->type & algt->mask & CRYPTO_ALG_TYPE_MASK) {
 	case CRYPTO_ALG_TYPE_AEAD:
-		return pcrypt_alloc_aead(tb, algt->type, algt->mask);
+		return pcrypt_create_aead(tmpl, tb, algt->type, algt->mask);
+	case CRYPTO_ALG_TYPE_BLKCIPHER:
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		return pcrypt_create_ablkcipher(tmpl, tb);
+	case CRYPTO_ALG_TYPE_DIGEST:
+		return pcrypt_create_ahash(tmpl, tb);
 	}
 
-	return ERR_PTR(-EINVAL);
+	return -EINVAL;
 }
 
 static void pcrypt_free(struct crypto_instance *inst)
 {
 	struct pcrypt_instance_ctx *ctx = crypto_instance_ctx(inst);
+	struct pcrypt_ahash_instance_ctx *hctx = crypto_instance_ctx(inst);
 
-	crypto_drop_spawn(&ctx->spawn);
-	kfree(inst);
+	switch (inst->alg.cra_flags & CRYPTO_ALG_TYPE_MASK) {
+	case CRYPTO_ALG_TYPE_AHASH:
+		crypto_drop_ahash(&hctx->spawn);
+		kfree(ahash_instance(inst));
+		return;
+	default:
+		crypto_drop_spawn(&ctx->spawn);
+		kfree(inst);
+	}
 }
 
 static int pcrypt_cpumask_change_notify(struct notifier_block *self,
@@ -453,6 +1070,10 @@ static int pcrypt_init_padata(struct padata_pcrypt *pcrypt,
 	int ret = -ENOMEM;
 	struct pcrypt_cpumask *mask;
 
+	spin_lock_init(&pcrypt->backlog_lock);
+	INIT_LIST_HEAD(&pcrypt->backlog);
+	INIT_DELAYED_WORK(&pcrypt->backlog_work, pcrypt_backlog_worker);
+
 	get_online_cpus();
 
 	pcrypt->wq = alloc_workqueue(name,
@@ -509,6 +1130,7 @@ static void pcrypt_fini_padata(struct padata_pcrypt *pcrypt)
 	kfree(pcrypt->cb_cpumask);
 
 	padata_stop(pcrypt->pinst);
+	cancel_delayed_work_sync(&pcrypt->backlog_work);
 	padata_unregister_cpumask_notifier(pcrypt->pinst, &pcrypt->nblock);
 	destroy_workqueue(pcrypt->wq);
 	padata_free(pcrypt->pinst);
@@ -516,7 +1138,7 @@ static void pcrypt_fini_padata(struct padata_pcrypt *pcrypt)
 
 static struct crypto_template pcrypt_tmpl = {
 	.name = "pcrypt",
-	.alloc = pcrypt_alloc,
+	.create = pcrypt_create,
 	.free = pcrypt_free,
 	.module = THIS_MODULE,
 };
@@ -22,6 +22,7 @@
  *
  */
 
+#include <crypto/aead.h>
 #include <crypto/hash.h>
 #include <linux/err.h>
 #include <linux/init.h>
@@ -47,6 +48,11 @@
 #define ENCRYPT 1
 #define DECRYPT 0
 
+/*
+ * Used by test_aead_speed()
+ */
+#define AEAD_ASSOC_SIZE	16
+
 /*
  * Used by test_cipher_speed()
  */
@@ -56,6 +62,7 @@ static char *alg = NULL;
 static u32 type;
 static u32 mask;
 static int mode;
+static unsigned int num_mb = 8;
 static char *tvmem[TVMEMSIZE];
 
 static char *check[] = {
@@ -64,7 +71,7 @@ static char *check[] = {
 	"cast6", "arc4", "michael_mic", "deflate", "crc32c", "tea", "xtea",
 	"khazad", "wp512", "wp384", "wp256", "tnepres", "xeta",  "fcrypt",
 	"camellia", "seed", "salsa20", "rmd128", "rmd160", "rmd256", "rmd320",
-	"lzo", "cts", "zlib", NULL
+	"lzo", "cts", "zlib", "crc32", NULL
 };
 
 static int test_cipher_jiffies(struct blkcipher_desc *desc, int enc,
@@ -920,6 +927,353 @@ out:
 	crypto_free_ablkcipher(tfm);
 }
 
+/*
+ * Used by test_mb_acipher_speed(): num_mb requests are in flight at the
+ * same time, so that a parallelizing implementation such as pcrypt can
+ * spread them over several CPUs.
+ */
+struct test_mb_acipher_data {
+	struct scatterlist sg;
+	struct ablkcipher_request *req;
+	struct tcrypt_result tresult;
+	char iv[128];
+	char *buf;
+	int ret;
+};
+
+static int do_mult_acipher_op(struct test_mb_acipher_data *data, int enc,
+			      unsigned int num_mb)
+{
+	unsigned int i;
+	int err = 0;
+
+	/* fire up a bunch of concurrent requests */
+	for (i = 0; i < num_mb; i++) {
+		if (enc == ENCRYPT)
+			data[i].ret = crypto_ablkcipher_encrypt(data[i].req);
+		else
+			data[i].ret = crypto_ablkcipher_decrypt(data[i].req);
+	}
+
+	/* wait for all requests to complete */
+	for (i = 0; i < num_mb; i++) {
+		data[i].ret = do_one_acipher_op(data[i].req, data[i].ret);
+		if (data[i].ret)
+			err = data[i].ret;
+	}
+
+	return err;
+}
+
+static int test_mb_acipher_jiffies(struct test_mb_acipher_data *data, int enc,
+				   int blen, int sec, unsigned int num_mb)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = do_mult_acipher_op(data, enc, num_mb);
+		if (ret)
+			return ret;
+	}
+
+	pr_cont("%d operations in %d seconds (%ld bytes)\n",
+		bcount * num_mb, sec, (long)bcount * blen * num_mb);
+	return 0;
+}
+
+static void test_mb_acipher_speed(const char *algo, int enc, unsigned int sec,
+				  unsigned int num_mb, u8 *keysize)
+{
+	struct test_mb_acipher_data *data;
+	struct crypto_ablkcipher *tfm;
+	unsigned int i, j, iv_len;
+	const char *e;
+	u32 *b_size;
+	int ret;
+
+	if (enc == ENCRYPT)
+		e = "encryption";
+	else
+		e = "decryption";
+
+	/* there is no point in counting cycles of work spread over CPUs */
+	if (!sec)
+		sec = 1;
+
+	data = kcalloc(num_mb, sizeof(*data), GFP_KERNEL);
+	if (!data)
+		return;
+
+	tfm = crypto_alloc_ablkcipher(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		goto out_free_data;
+	}
+
+	pr_info("\ntesting speed of %u concurrent async %s (%s) %s\n", num_mb,
+		algo, crypto_tfm_alg_driver_name(crypto_ablkcipher_tfm(tfm)), e);
+
+	for (i = 0; i < num_mb; i++) {
+		data[i].buf = kmalloc(TVMEMSIZE * PAGE_SIZE, GFP_KERNEL);
+		if (!data[i].buf)
+			goto out_free_req;
+
+		data[i].req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!data[i].req) {
+			pr_err("tcrypt: skcipher: Failed to allocate request for %s\n",
+			       algo);
+			goto out_free_req;
+		}
+
+		init_completion(&data[i].tresult.completion);
+		ablkcipher_request_set_callback(data[i].req,
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						tcrypt_complete,
+						&data[i].tresult);
+		memset(data[i].buf, 0xff, TVMEMSIZE * PAGE_SIZE);
+	}
+
+	i = 0;
+	do {
+		b_size = block_sizes;
+
+		do {
+			if (*b_size > TVMEMSIZE * PAGE_SIZE) {
+				pr_err("template (%u) too big for buffer (%lu)\n",
+				       *b_size, TVMEMSIZE * PAGE_SIZE);
+				goto out_free_req;
+			}
+
+			pr_info("test %u (%d bit key, %d byte blocks): ", i,
+				*keysize * 8, *b_size);
+
+			memset(tvmem[0], 0xff, PAGE_SIZE);
+
+			crypto_ablkcipher_clear_flags(tfm, ~0);
+
+			ret = crypto_ablkcipher_setkey(tfm, tvmem[0], *keysize);
+			if (ret) {
+				pr_err("setkey() failed flags=%x\n",
+					crypto_ablkcipher_get_flags(tfm));
+				goto out_free_req;
+			}
+
+			iv_len = crypto_ablkcipher_ivsize(tfm);
+
+			for (j = 0; j < num_mb; j++) {
+				if (iv_len)
+					memset(data[j].iv, 0xff, iv_len);
+				sg_init_one(&data[j].sg, data[j].buf, *b_size);
+				ablkcipher_request_set_crypt(data[j].req,
+							     &data[j].sg,
+							     &data[j].sg,
+							     *b_size,
+							     data[j].iv);
+			}
+
+			ret = test_mb_acipher_jiffies(data, enc, *b_size, sec,
+						      num_mb);
+			if (ret) {
+				pr_err("%s() failed flags=%x\n", e,
+					crypto_ablkcipher_get_flags(tfm));
+				goto out_free_req;
+			}
+			b_size++;
+			i++;
+		} while (*b_size);
+		keysize++;
+	} while (*keysize);
+
+out_free_req:
+	for (i = 0; i < num_mb; i++) {
+		ablkcipher_request_free(data[i].req);
+		kfree(data[i].buf);
+	}
+	crypto_free_ablkcipher(tfm);
+out_free_data:
+	kfree(data);
+}
+
+static inline int do_one_aead_op(struct aead_request *req, int ret)
+{
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		struct tcrypt_result *tr = req->base.data;
+
+		ret = wait_for_completion_interruptible(&tr->completion);
+		if (!ret)
+			ret = tr->err;
+		INIT_COMPLETION(tr->completion);
+	}
+
+	return ret;
+}
+
+static int test_aead_jiffies(struct aead_request *req, int blen, int sec)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = do_one_aead_op(req, crypto_aead_encrypt(req));
+		if (ret)
+			return ret;
+	}
+
+	pr_cont("%d operations in %d seconds (%ld bytes)\n",
+		bcount, sec, (long)bcount * blen);
+	return 0;
+}
+
+static int test_aead_cycles(struct aead_request *req, int blen)
+{
+	unsigned long cycles = 0;
+	int ret = 0;
+	int i;
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = do_one_aead_op(req, crypto_aead_encrypt(req));
+		if (ret)
+			goto out;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = do_one_aead_op(req, crypto_aead_encrypt(req));
+		end = get_cycles();
+
+		if (ret)
+			goto out;
+
+		cycles += end - start;
+	}
+
+out:
+	if (ret == 0)
+		pr_cont("1 operation in %lu cycles (%d bytes)\n",
+			(cycles + 4) / 8, blen);
+
+	return ret;
+}
+
+/*
+ * Only encryption is timed: the buffer is processed in place over and
+ * over, so a decryption would fail authentication after the first pass.
+ */
+static void test_aead_speed(const char *algo, unsigned int sec,
+			    unsigned int authsize, u8 *keysize)
+{
+	unsigned int ret, i, j;
+	struct tcrypt_result tresult;
+	char iv[128];
+	struct aead_request *req;
+	struct crypto_aead *tfm;
+	u32 *b_size;
+
+	pr_info("\ntesting speed of %s encryption\n", algo);
+
+	init_completion(&tresult.completion);
+
+	tfm = crypto_alloc_aead(algo, 0, 0);
+
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	ret = crypto_aead_setauthsize(tfm, authsize);
+	if (ret) {
+		pr_err("setauthsize(%u) failed for %s\n", authsize, algo);
+		goto out;
+	}
+
+	req = aead_request_alloc(tfm, GFP_KERNEL);
+	if (!req) {
+		pr_err("tcrypt: aead: Failed to allocate request for %s\n",
+		       algo);
+		goto out;
+	}
+
+	aead_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				  tcrypt_complete, &tresult);
+
+	i = 0;
+	do {
+		b_size = block_sizes;
+
+		do {
+			struct scatterlist asg[1];
+			struct scatterlist sg[TVMEMSIZE];
+
+			if (*keysize + AEAD_ASSOC_SIZE + *b_size + authsize >
+			    TVMEMSIZE * PAGE_SIZE) {
+				pr_err("template (%u) too big for "
+				       "tvmem (%lu)\n", *keysize + *b_size,
+				       TVMEMSIZE * PAGE_SIZE);
+				goto out_free_req;
+			}
+
+			pr_info("test %u (%d bit key, %d byte blocks): ", i,
+				*keysize * 8, *b_size);
+
+			memset(tvmem[0], 0xff, PAGE_SIZE);
+
+			crypto_aead_clear_flags(tfm, ~0);
+
+			ret = crypto_aead_setkey(tfm, tvmem[0], *keysize);
+			if (ret) {
+				pr_err("setkey() failed flags=%x\n",
+					crypto_aead_get_flags(tfm));
+				goto out_free_req;
+			}
+
+			sg_init_one(asg, tvmem[0] + *keysize, AEAD_ASSOC_SIZE);
+
+			sg_init_table(sg, TVMEMSIZE);
+			sg_set_buf(sg, tvmem[0] + *keysize + AEAD_ASSOC_SIZE,
+				   PAGE_SIZE - *keysize - AEAD_ASSOC_SIZE);
+			for (j = 1; j < TVMEMSIZE; j++) {
+				sg_set_buf(sg + j, tvmem[j], PAGE_SIZE);
+				memset(tvmem[j], 0xff, PAGE_SIZE);
+			}
+
+			memset(&iv, 0xff, crypto_aead_ivsize(tfm));
+
+			aead_request_set_assoc(req, asg, AEAD_ASSOC_SIZE);
+			aead_request_set_crypt(req, sg, sg, *b_size, iv);
+
+			if (sec)
+				ret = test_aead_jiffies(req, *b_size, sec);
+			else
+				ret = test_aead_cycles(req, *b_size);
+
+			if (ret) {
+				pr_err("encryption failed flags=%x\n",
+					crypto_aead_get_flags(tfm));
+				break;
+			}
+			b_size++;
+			i++;
+		} while (*b_size);
+		keysize++;
+	} while (*keysize);
+
+out_free_req:
+	aead_request_free(req);
+out:
+	crypto_free_aead(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1153,6 +1507,26 @@ static int do_test(int m)
 		ret += tcrypt_test("rfc4309(ccm(aes))");
 		break;
 
+	case 46:
+		ret += tcrypt_test("crc32");
+		break;
+
+	case 47:
+		ret += tcrypt_test("chacha20");
+		break;
+
+	case 48:
+		ret += tcrypt_test("poly1305");
+		break;
+
+	case 49:
+		ret += tcrypt_test("rfc7539(chacha20,poly1305)");
+		break;
+
+	case 50:
+		ret += tcrypt_test("rfc7539esp(chacha20,poly1305)");
+		break;
+
 	case 100:
 		ret += tcrypt_test("hmac(md5)");
 		break;
@@ -1339,6 +1713,20 @@ static int do_test(int m)
 				  speed_template_32_64);
 		break;
 
+	case 208:
+		test_aead_speed("gcm(aes)", sec, 16, speed_template_16_24_32);
+		break;
+
+	case 209:
+		test_cipher_speed("chacha20", ENCRYPT, sec, NULL, 0,
+				  speed_template_32);
+		break;
+
+	case 210:
+		test_aead_speed("rfc7539(chacha20,poly1305)", sec, 16,
+				speed_template_32);
+		break;
+
 	case 300:
 		/* fall through */
 
@@ -1414,6 +1802,18 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		test_hash_speed("crc32c", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
+	case 320:
+		test_hash_speed("crc32", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
+	case 321:
+		test_hash_speed("poly1305", sec, poly1305_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -1563,6 +1963,22 @@ static int do_test(int m)
 				   speed_template_32_64);
 		break;
 
+	case 504:
+		test_acipher_speed("chacha20", ENCRYPT, sec, NULL, 0,
+				   speed_template_32);
+		break;
+
+	case 600:
+		test_mb_acipher_speed("cbc(aes)", ENCRYPT, sec, num_mb,
+				      speed_template_16_32);
+		test_mb_acipher_speed("cbc(aes)", DECRYPT, sec, num_mb,
+				      speed_template_16_32);
+		test_mb_acipher_speed("xts(aes)", ENCRYPT, sec, num_mb,
+				      speed_template_32_64);
+		test_mb_acipher_speed("xts(aes)", DECRYPT, sec, num_mb,
+				      speed_template_32_64);
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -1631,6 +2047,9 @@ module_param(mode, int, 0);
 module_param(sec, uint, 0);
 MODULE_PARM_DESC(sec, "Length in seconds of speed tests "
 		      "(defaults to zero which uses CPU cycles instead)");
+module_param(num_mb, uint, 0);
+MODULE_PARM_DESC(num_mb, "Number of concurrent requests of the multi "
+			 "request speed tests (defaults to 8)");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
@@ -41,7 +41,7 @@ struct hash_testvec {
 	char *plaintext;
 	char *digest;
 	unsigned char tap[MAX_TAP];
-	unsigned char psize;
+	unsigned short psize;
 	unsigned char np;
 	unsigned char ksize;
 };
@@ -1040,7 +1040,7 @@ static struct hash_testvec tgr128_tv_template[] = {
 	},
 };
 
-#define GHASH_TEST_VECTORS 1
+#define GHASH_TEST_VECTORS 4
 
 static struct hash_testvec ghash_tv_template[] =
 {
@@ -1052,6 +1052,230 @@ static struct hash_testvec ghash_tv_template[] =
 		.psize	= 16,
 		.digest	= "\xda\x53\xeb\x0a\xd2\xc5\x5b\xb6"
 			  "\x4f\xc4\x80\x2c\xc3\xfe\xda\x60",
+	}, {
+		.key	= "\xe9\xfa\x23\x70\x8e\x4c\x7b\xe3"
+			  "\xf5\x7c\x61\x38\x72\x54\x93\xbb",
+		.ksize	= 16,
+		.plaintext = "\x61\xe0\xe9\xfa\xe0\x35\xb9\x33"
+			     "\x0e\x7e\xfd\xcc\x8c\x73\x99\x17"
+			     "\x8a\x57\x84\x4b\xee\x6a\x45\x8b"
+			     "\x24\x18\xff\xa5\x42\xf2\x47\xfb"
+			     "\x70\x96\xe5\x09\x60\xad\x03\x5c"
+			     "\x44\x00\x3a\xba\x05\x2b\xe4\xe8"
+			     "\xbb\xe1\x22\x61\x3e\xf1\xfb\x06"
+			     "\xb3\x35\x72\x61\x94\x2d\xfb\x70",
+		.psize	= 64,
+		.digest	= "\x31\xef\x7a\x3d\xdc\x11\x16\xc7"
+			  "\x14\x4f\xd7\xfb\xa3\x11\x6c\xd7",
+	}, {
+		.key	= "\x3d\x3e\xa1\x98\x04\xa5\x7c\x8e"
+			  "\x3c\xd0\x57\xf7\x64\x6b\x6d\x63",
+		.ksize	= 16,
+		.plaintext = "\xe4\xf0\x5d\x8d\x04\xd9\xd6\x79"
+			     "\xec\xf9\xd7\x76\x4b\x37\x5a\x7b"
+			     "\xc4\x49\x14\xe3\x0e\xa7\x81\x72"
+			     "\x3a\x81\x76\xe8\x28\xed\xf6\xc7"
+			     "\x7f\x97\x58\x80\x4e",
+		.psize	= 37,
+		.digest	= "\x69\xf9\x14\x24\x86\x92\xe7\xdb"
+			  "\x55\xd7\x3b\x46\xe5\x3e\x7f\x5d",
+	}, {
+		.key	= "\x51\x46\xc5\xc8\xe7\xcc\xea\xca"
+			  "\x0b\xee\x18\x9a\x51\x62\x66\x6b",
+		.ksize	= 16,
+		.plaintext = "\x66\x22\x6e\x5d\x51\x7c\x6f\xdd"
+			     "\xbe\x93\xc9\x19\x24\x89\x8e\x56"
+			     "\x76\xce\xef\xd6\x40\x98\xec\xa8"
+			     "\x21\x6b\x57\x47\xb5\xcd\x20\xc5"
+			     "\x81\x8e\xb4\xee\xd5\xd1\x4b\xb2"
+			     "\x49\x1b\x77\xf5\xca\x18\xfd\x33"
+			     "\x97\x1f\x27\x2d\xe4\xb3\x3e\x8e"
+			     "\x46\x20\x30\x33\xa1\xbe\x55\x51"
+			     "\x51\x37\x2d\xcd\x6d\x42\x95\x16"
+			     "\xf5\x85\xd3\xbc\x09\x01\x05\xa0"
+			     "\xca\x2f\x4c\xde\x76\x78\xe3\x57"
+			     "\x71\x55\xd2\x13\x3a\x09\xe4\x80"
+			     "\x62\x7e\xe2\x28\x36\x1d\x68\x72"
+			     "\xc3\xeb\x97\x0e\x63\xab\x94\xee"
+			     "\x3c\x4c\xbe\x5e\x0a\x8d\xa5\x3b"
+			     "\x63\x07\x68\x26\x6c\xe4\x86\x6d"
+			     "\x04\xe0\x15\x2b\x8d\xc0\xc7\x3a"
+			     "\x63\x5d\xaa\xbe\x03\xff\x1d\xfb"
+			     "\x2a\xce\x46\x1d\x7d\xa3",
+		.psize	= 150,
+		.digest	= "\xa3\x2a\xa8\xe5\xd7\xf9\xf5\xe3"
+			  "\x55\x0e\x3e\xeb\x0b\x13\x06\xec",
+		.np	= 3,
+		.tap	= { 7, 63, 80 },
+	},
+};
+
+#define POLY1305_TEST_VECTORS 6
+
+static struct hash_testvec poly1305_tv_template[] = {
+	{ /* RFC7539 2.5.2. Test Vector */
+		.plaintext = "\x85\xd6\xbe\x78\x57\x55\x6d\x33"
+			     "\x7f\x44\x52\xfe\x42\xd5\x06\xa8"
+			     "\x01\x03\x80\x8a\xfb\x0d\xb2\xfd"
+			     "\x4a\xbf\xf6\xaf\x41\x49\xf5\x1b"
+			     "\x43\x72\x79\x70\x74\x6f\x67\x72"
+			     "\x61\x70\x68\x69\x63\x20\x46\x6f"
+			     "\x72\x75\x6d\x20\x52\x65\x73\x65"
+			     "\x61\x72\x63\x68\x20\x47\x72\x6f"
+			     "\x75\x70",
+		.psize	= 66,
+		.digest	= "\xa8\x06\x1d\xc1\x30\x51\x36\xc6"
+			  "\xc2\x2b\x8b\xaf\x0c\x01\x27\xa9",
+	}, { /* RFC7539 A.3. Test Vector #1 */
+		.plaintext = "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.psize	= 96,
+		.digest	= "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00",
+	}, { /* RFC7539 A.3. Test Vector #2 */
+		.plaintext = "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x36\xe5\xf6\xb5\xc5\xe0\x60\x70"
+			     "\xf0\xef\xca\x96\x22\x7a\x86\x3e"
+			     "\x41\x6e\x79\x20\x73\x75\x62\x6d"
+			     "\x69\x73\x73\x69\x6f\x6e\x20\x74"
+			     "\x6f\x20\x74\x68\x65\x20\x49\x45"
+			     "\x54\x46\x20\x69\x6e\x74\x65\x6e"
+			     "\x64\x65\x64\x20\x62\x79\x20\x74"
+			     "\x68\x65\x20\x43\x6f\x6e\x74\x72"
+			     "\x69\x62\x75\x74\x6f\x72\x20\x66"
+			     "\x6f\x72\x20\x70\x75\x62\x6c\x69"
+			     "\x63\x61\x74\x69\x6f\x6e\x20\x61"
+			     "\x73\x20\x61\x6c\x6c\x20\x6f\x72"
+			     "\x20\x70\x61\x72\x74\x20\x6f\x66"
+			     "\x20\x61\x6e\x20\x49\x45\x54\x46"
+			     "\x20\x49\x6e\x74\x65\x72\x6e\x65"
+			     "\x74\x2d\x44\x72\x61\x66\x74\x20"
+			     "\x6f\x72\x20\x52\x46\x43\x20\x61"
+			     "\x6e\x64\x20\x61\x6e\x79\x20\x73"
+			     "\x74\x61\x74\x65\x6d\x65\x6e\x74"
+			     "\x20\x6d\x61\x64\x65\x20\x77\x69"
+			     "\x74\x68\x69\x6e\x20\x74\x68\x65"
+			     "\x20\x63\x6f\x6e\x74\x65\x78\x74"
+			     "\x20\x6f\x66\x20\x61\x6e\x20\x49"
+			     "\x45\x54\x46\x20\x61\x63\x74\x69"
+			     "\x76\x69\x74\x79\x20\x69\x73\x20"
+			     "\x63\x6f\x6e\x73\x69\x64\x65\x72"
+			     "\x65\x64\x20\x61\x6e\x20\x22\x49"
+			     "\x45\x54\x46\x20\x43\x6f\x6e\x74"
+			     "\x72\x69\x62\x75\x74\x69\x6f\x6e"
+			     "\x22\x2e\x20\x53\x75\x63\x68\x20"
+			     "\x73\x74\x61\x74\x65\x6d\x65\x6e"
+			     "\x74\x73\x20\x69\x6e\x63\x6c\x75"
+			     "\x64\x65\x20\x6f\x72\x61\x6c\x20"
+			     "\x73\x74\x61\x74\x65\x6d\x65\x6e"
+			     "\x74\x73\x20\x69\x6e\x20\x49\x45"
+			     "\x54\x46\x20\x73\x65\x73\x73\x69"
+			     "\x6f\x6e\x73\x2c\x20\x61\x73\x20"
+			     "\x77\x65\x6c\x6c\x20\x61\x73\x20"
+			     "\x77\x72\x69\x74\x74\x65\x6e\x20"
+			     "\x61\x6e\x64\x20\x65\x6c\x65\x63"
+			     "\x74\x72\x6f\x6e\x69\x63\x20\x63"
+			     "\x6f\x6d\x6d\x75\x6e\x69\x63\x61"
+			     "\x74\x69\x6f\x6e\x73\x20\x6d\x61"
+			     "\x64\x65\x20\x61\x74\x20\x61\x6e"
+			     "\x79\x20\x74\x69\x6d\x65\x20\x6f"
+			     "\x72\x20\x70\x6c\x61\x63\x65\x2c"
+			     "\x20\x77\x68\x69\x63\x68\x20\x61"
+			     "\x72\x65\x20\x61\x64\x64\x72\x65"
+			     "\x73\x73\x65\x64\x20\x74\x6f",
+		.psize	= 407,
+		.digest	= "\x36\xe5\xf6\xb5\xc5\xe0\x60\x70"
+			  "\xf0\xef\xca\x96\x22\x7a\x86\x3e",
+	}, { /* RFC7539 A.3. Test Vector #3 */
+		.plaintext = "\x36\xe5\xf6\xb5\xc5\xe0\x60\x70"
+			     "\xf0\xef\xca\x96\x22\x7a\x86\x3e"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x41\x6e\x79\x20\x73\x75\x62\x6d"
+			     "\x69\x73\x73\x69\x6f\x6e\x20\x74"
+			     "\x6f\x20\x74\x68\x65\x20\x49\x45"
+			     "\x54\x46\x20\x69\x6e\x74\x65\x6e"
+			     "\x64\x65\x64\x20\x62\x79\x20\x74"
+			     "\x68\x65\x20\x43\x6f\x6e\x74\x72"
+			     "\x69\x62\x75\x74\x6f\x72\x20\x66"
+			     "\x6f\x72\x20\x70\x75\x62\x6c\x69"
+			     "\x63\x61\x74\x69\x6f\x6e\x20\x61"
+			     "\x73\x20\x61\x6c\x6c\x20\x6f\x72"
+			     "\x20\x70\x61\x72\x74\x20\x6f\x66"
+			     "\x20\x61\x6e\x20\x49\x45\x54\x46"
+			     "\x20\x49\x6e\x74\x65\x72\x6e\x65"
+			     "\x74\x2d\x44\x72\x61\x66\x74\x20"
+			     "\x6f\x72\x20\x52\x46\x43\x20\x61"
+			     "\x6e\x64\x20\x61\x6e\x79\x20\x73"
+			     "\x74\x61\x74\x65\x6d\x65\x6e\x74"
+			     "\x20\x6d\x61\x64\x65\x20\x77\x69"
+			     "\x74\x68\x69\x6e\x20\x74\x68\x65"
+			     "\x20\x63\x6f\x6e\x74\x65\x78\x74"
+			     "\x20\x6f\x66\x20\x61\x6e\x20\x49"
+			     "\x45\x54\x46\x20\x61\x63\x74\x69"
+			     "\x76\x69\x74\x79\x20\x69\x73\x20"
+			     "\x63\x6f\x6e\x73\x69\x64\x65\x72"
+			     "\x65\x64\x20\x61\x6e\x20\x22\x49"
+			     "\x45\x54\x46\x20\x43\x6f\x6e\x74"
+			     "\x72\x69\x62\x75\x74\x69\x6f\x6e"
+			     "\x22\x2e\x20\x53\x75\x63\x68\x20"
+			     "\x73\x74\x61\x74\x65\x6d\x65\x6e"
+			     "\x74\x73\x20\x69\x6e\x63\x6c\x75"
+			     "\x64\x65\x20\x6f\x72\x61\x6c\x20"
+			     "\x73\x74\x61\x74\x65\x6d\x65\x6e"
+			     "\x74\x73\x20\x69\x6e\x20\x49\x45"
+			     "\x54\x46\x20\x73\x65\x73\x73\x69"
+			     "\x6f\x6e\x73\x2c\x20\x61\x73\x20"
+			     "\x77\x65\x6c\x6c\x20\x61\x73\x20"
+			     "\x77\x72\x69\x74\x74\x65\x6e\x20"
+			     "\x61\x6e\x64\x20\x65\x6c\x65\x63"
+			     "\x74\x72\x6f\x6e\x69\x63\x20\x63"
+			     "\x6f\x6d\x6d\x75\x6e\x69\x63\x61"
+			     "\x74\x69\x6f\x6e\x73\x20\x6d\x61"
+			     "\x64\x65\x20\x61\x74\x20\x61\x6e"
+			     "\x79\x20\x74\x69\x6d\x65\x20\x6f"
+			     "\x72\x20\x70\x6c\x61\x63\x65\x2c"
+			     "\x20\x77\x68\x69\x63\x68\x20\x61"
+			     "\x72\x65\x20\x61\x64\x64\x72\x65"
+			     "\x73\x73\x65\x64\x20\x74\x6f",
+		.psize	= 407,
+		.digest	= "\xf3\x47\x7e\x7c\xd9\x54\x17\xaf"
+			  "\x89\xa6\xb8\x79\x4c\x31\x0c\xf0",
+	}, { /* RFC7539 A.3. Test Vector #5 */
+		.plaintext = "\x02\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\xff\xff\xff\xff\xff\xff\xff\xff"
+			     "\xff\xff\xff\xff\xff\xff\xff\xff",
+		.psize	= 48,
+		.digest	= "\x03\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00",
+	}, { /* RFC7539 A.3. Test Vector #7 */
+		.plaintext = "\x01\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00"
+			     "\xff\xff\xff\xff\xff\xff\xff\xff"
+			     "\xff\xff\xff\xff\xff\xff\xff\xff"
+			     "\xf0\xff\xff\xff\xff\xff\xff\xff"
+			     "\xff\xff\xff\xff\xff\xff\xff\xff"
+			     "\x11\x00\x00\x00\x00\x00\x00\x00"
+			     "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.psize	= 80,
+		.digest	= "\x05\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00",
 	},
 };
 
@@ -10330,6 +10554,206 @@ static struct aead_testvec aes_ccm_rfc4309_dec_tv_template[] = {
 	},
 };
 
+#define RFC7539_ENC_TEST_VECTORS 1
+static struct aead_testvec rfc7539_enc_tv_template[] = {
+	{ /* RFC7539 2.8.2. */
+		.key	= "\x80\x81\x82\x83\x84\x85\x86\x87"
+			  "\x88\x89\x8a\x8b\x8c\x8d\x8e\x8f"
+			  "\x90\x91\x92\x93\x94\x95\x96\x97"
+			  "\x98\x99\x9a\x9b\x9c\x9d\x9e\x9f",
+		.klen	= 32,
+		.iv	= "\x07\x00\x00\x00\x40\x41\x42\x43"
+			  "\x44\x45\x46\x47",
+		.assoc	= "\x50\x51\x52\x53\xc0\xc1\xc2\xc3"
+			  "\xc4\xc5\xc6\xc7",
+		.alen	= 12,
+		.input	= "\x4c\x61\x64\x69\x65\x73\x20\x61"
+			  "\x6e\x64\x20\x47\x65\x6e\x74\x6c"
+			  "\x65\x6d\x65\x6e\x20\x6f\x66\x20"
+			  "\x74\x68\x65\x20\x63\x6c\x61\x73"
+			  "\x73\x20\x6f\x66\x20\x27\x39\x39"
+			  "\x3a\x20\x49\x66\x20\x49\x20\x63"
+			  "\x6f\x75\x6c\x64\x20\x6f\x66\x66"
+			  "\x65\x72\x20\x79\x6f\x75\x20\x6f"
+			  "\x6e\x6c\x79\x20\x6f\x6e\x65\x20"
+			  "\x74\x69\x70\x20\x66\x6f\x72\x20"
+			  "\x74\x68\x65\x20\x66\x75\x74\x75"
+			  "\x72\x65\x2c\x20\x73\x75\x6e\x73"
+			  "\x63\x72\x65\x65\x6e\x20\x77\x6f"
+			  "\x75\x6c\x64\x20\x62\x65\x20\x69"
+			  "\x74\x2e",
+		.ilen	= 114,
+		.result	= "\xd3\x1a\x8d\x34\x64\x8e\x60\xdb"
+			  "\x7b\x86\xaf\xbc\x53\xef\x7e\xc2"
+			  "\xa4\xad\xed\x51\x29\x6e\x08\xfe"
+			  "\xa9\xe2\xb5\xa7\x36\xee\x62\xd6"
+			  "\x3d\xbe\xa4\x5e\x8c\xa9\x67\x12"
+			  "\x82\xfa\xfb\x69\xda\x92\x72\x8b"
+			  "\x1a\x71\xde\x0a\x9e\x06\x0b\x29"
+			  "\x05\xd6\xa5\xb6\x7e\xcd\x3b\x36"
+			  "\x92\xdd\xbd\x7f\x2d\x77\x8b\x8c"
+			  "\x98\x03\xae\xe3\x28\x09\x1b\x58"
+			  "\xfa\xb3\x24\xe4\xfa\xd6\x75\x94"
+			  "\x55\x85\x80\x8b\x48\x31\xd7\xbc"
+			  "\x3f\xf4\xde\xf0\x8e\x4b\x7a\x9d"
+			  "\xe5\x76\xd2\x65\x86\xce\xc6\x4b"
+			  "\x61\x16\x1a\xe1\x0b\x59\x4f\x09"
+			  "\xe2\x6a\x7e\x90\x2e\xcb\xd0\x60"
+			  "\x06\x91",
+		.rlen	= 130,
+	},
+};
+
+#define RFC7539_DEC_TEST_VECTORS 1
+static struct aead_testvec rfc7539_dec_tv_template[] = {
+	{ /* RFC7539 2.8.2. */
+		.key	= "\x80\x81\x82\x83\x84\x85\x86\x87"
+			  "\x88\x89\x8a\x8b\x8c\x8d\x8e\x8f"
+			  "\x90\x91\x92\x93\x94\x95\x96\x97"
+			  "\x98\x99\x9a\x9b\x9c\x9d\x9e\x9f",
+		.klen	= 32,
+		.iv	= "\x07\x00\x00\x00\x40\x41\x42\x43"
+			  "\x44\x45\x46\x47",
+		.assoc	= "\x50\x51\x52\x53\xc0\xc1\xc2\xc3"
+			  "\xc4\xc5\xc6\xc7",
+		.alen	= 12,
+		.input	= "\xd3\x1a\x8d\x34\x64\x8e\x60\xdb"
+			  "\x7b\x86\xaf\xbc\x53\xef\x7e\xc2"
+			  "\xa4\xad\xed\x51\x29\x6e\x08\xfe"
+			  "\xa9\xe2\xb5\xa7\x36\xee\x62\xd6"
+			  "\x3d\xbe\xa4\x5e\x8c\xa9\x67\x12"
+			  "\x82\xfa\xfb\x69\xda\x92\x72\x8b"
+			  "\x1a\x71\xde\x0a\x9e\x06\x0b\x29"
+			  "\x05\xd6\xa5\xb6\x7e\xcd\x3b\x36"
+			  "\x92\xdd\xbd\x7f\x2d\x77\x8b\x8c"
+			  "\x98\x03\xae\xe3\x28\x09\x1b\x58"
+			  "\xfa\xb3\x24\xe4\xfa\xd6\x75\x94"
+			  "\x55\x85\x80\x8b\x48\x31\xd7\xbc"
+			  "\x3f\xf4\xde\xf0\x8e\x4b\x7a\x9d"
+			  "\xe5\x76\xd2\x65\x86\xce\xc6\x4b"
+			  "\x61\x16\x1a\xe1\x0b\x59\x4f\x09"
+			  "\xe2\x6a\x7e\x90\x2e\xcb\xd0\x60"
+			  "\x06\x91",
+		.ilen	= 130,
+		.result	= "\x4c\x61\x64\x69\x65\x73\x20\x61"
+			  "\x6e\x64\x20\x47\x65\x6e\x74\x6c"
+			  "\x65\x6d\x65\x6e\x20\x6f\x66\x20"
+			  "\x74\x68\x65\x20\x63\x6c\x61\x73"
+			  "\x73\x20\x6f\x66\x20\x27\x39\x39"
+			  "\x3a\x20\x49\x66\x20\x49\x20\x63"
+			  "\x6f\x75\x6c\x64\x20\x6f\x66\x66"
+			  "\x65\x72\x20\x79\x6f\x75\x20\x6f"
+			  "\x6e\x6c\x79\x20\x6f\x6e\x65\x20"
+			  "\x74\x69\x70\x20\x66\x6f\x72\x20"
+			  "\x74\x68\x65\x20\x66\x75\x74\x75"
+			  "\x72\x65\x2c\x20\x73\x75\x6e\x73"
+			  "\x63\x72\x65\x65\x6e\x20\x77\x6f"
+			  "\x75\x6c\x64\x20\x62\x65\x20\x69"
+			  "\x74\x2e",
+		.rlen	= 114,
+	},
+};
+
+#define RFC7539ESP_ENC_TEST_VECTORS 1
+static struct aead_testvec rfc7539esp_enc_tv_template[] = {
+	{ /* RFC7539 2.8.2. */
+		.key	= "\x80\x81\x82\x83\x84\x85\x86\x87"
+			  "\x88\x89\x8a\x8b\x8c\x8d\x8e\x8f"
+			  "\x90\x91\x92\x93\x94\x95\x96\x97"
+			  "\x98\x99\x9a\x9b\x9c\x9d\x9e\x9f"
+			  "\x07\x00\x00\x00",
+		.klen	= 36,
+		.iv	= "\x40\x41\x42\x43\x44\x45\x46\x47",
+		.assoc	= "\x50\x51\x52\x53\xc0\xc1\xc2\xc3"
+			  "\xc4\xc5\xc6\xc7",
+		.alen	= 12,
+		.input	= "\x4c\x61\x64\x69\x65\x73\x20\x61"
+			  "\x6e\x64\x20\x47\x65\x6e\x74\x6c"
+			  "\x65\x6d\x65\x6e\x20\x6f\x66\x20"
+			  "\x74\x68\x65\x20\x63\x6c\x61\x73"
+			  "\x73\x20\x6f\x66\x20\x27\x39\x39"
+			  "\x3a\x20\x49\x66\x20\x49\x20\x63"
+			  "\x6f\x75\x6c\x64\x20\x6f\x66\x66"
+			  "\x65\x72\x20\x79\x6f\x75\x20\x6f"
+			  "\x6e\x6c\x79\x20\x6f\x6e\x65\x20"
+			  "\x74\x69\x70\x20\x66\x6f\x72\x20"
+			  "\x74\x68\x65\x20\x66\x75\x74\x75"
+			  "\x72\x65\x2c\x20\x73\x75\x6e\x73"
+			  "\x63\x72\x65\x65\x6e\x20\x77\x6f"
+			  "\x75\x6c\x64\x20\x62\x65\x20\x69"
+			  "\x74\x2e",
+		.ilen	= 114,
+		.result	= "\xd3\x1a\x8d\x34\x64\x8e\x60\xdb"
+			  "\x7b\x86\xaf\xbc\x53\xef\x7e\xc2"
+			  "\xa4\xad\xed\x51\x29\x6e\x08\xfe"
+			  "\xa9\xe2\xb5\xa7\x36\xee\x62\xd6"
+			  "\x3d\xbe\xa4\x5e\x8c\xa9\x67\x12"
+			  "\x82\xfa\xfb\x69\xda\x92\x72\x8b"
+			  "\x1a\x71\xde\x0a\x9e\x06\x0b\x29"
+			  "\x05\xd6\xa5\xb6\x7e\xcd\x3b\x36"
+			  "\x92\xdd\xbd\x7f\x2d\x77\x8b\x8c"
+			  "\x98\x03\xae\xe3\x28\x09\x1b\x58"
+			  "\xfa\xb3\x24\xe4\xfa\xd6\x75\x94"
+			  "\x55\x85\x80\x8b\x48\x31\xd7\xbc"
+			  "\x3f\xf4\xde\xf0\x8e\x4b\x7a\x9d"
+			  "\xe5\x76\xd2\x65\x86\xce\xc6\x4b"
+			  "\x61\x16\x1a\xe1\x0b\x59\x4f\x09"
+			  "\xe2\x6a\x7e\x90\x2e\xcb\xd0\x60"
+			  "\x06\x91",
+		.rlen	= 130,
+	},
+};
+
+#define RFC7539ESP_DEC_TEST_VECTORS 1
+static struct aead_testvec rfc7539esp_dec_tv_template[] = {
+	{ /* RFC7539 2.8.2. */
+		.key	= "\x80\x81\x82\x83\x84\x85\x86\x87"
+			  "\x88\x89\x8a\x8b\x8c\x8d\x8e\x8f"
+			  "\x90\x91\x92\x93\x94\x95\x96\x97"
+			  "\x98\x99\x9a\x9b\x9c\x9d\x9e\x9f"
+			  "\x07\x00\x00\x00",
+		.klen	= 36,
+		.iv	= "\x40\x41\x42\x43\x44\x45\x46\x47",
+		.assoc	= "\x50\x51\x52\x53\xc0\xc1\xc2\xc3"
+			  "\xc4\xc5\xc6\xc7",
+		.alen	= 12,
+		.input	= "\xd3\x1a\x8d\x34\x64\x8e\x60\xdb"
+			  "\x7b\x86\xaf\xbc\x53\xef\x7e\xc2"
+			  "\xa4\xad\xed\x51\x29\x6e\x08\xfe"
+			  "\xa9\xe2\xb5\xa7\x36\xee\x62\xd6"
+			  "\x3d\xbe\xa4\x5e\x8c\xa9\x67\x12"
+			  "\x82\xfa\xfb\x69\xda\x92\x72\x8b"
+			  "\x1a\x71\xde\x0a\x9e\x06\x0b\x29"
+			  "\x05\xd6\xa5\xb6\x7e\xcd\x3b\x36"
+			  "\x92\xdd\xbd\x7f\x2d\x77\x8b\x8c"
+			  "\x98\x03\xae\xe3\x28\x09\x1b\x58"
+			  "\xfa\xb3\x24\xe4\xfa\xd6\x75\x94"
+			  "\x55\x85\x80\x8b\x48\x31\xd7\xbc"
+			  "\x3f\xf4\xde\xf0\x8e\x4b\x7a\x9d"
+			  "\xe5\x76\xd2\x65\x86\xce\xc6\x4b"
+			  "\x61\x16\x1a\xe1\x0b\x59\x4f\x09"
+			  "\xe2\x6a\x7e\x90\x2e\xcb\xd0\x60"
+			  "\x06\x91",
+		.ilen	= 130,
+		.result	= "\x4c\x61\x64\x69\x65\x73\x20\x61"
+			  "\x6e\x64\x20\x47\x65\x6e\x74\x6c"
+			  "\x65\x6d\x65\x6e\x20\x6f\x66\x20"
+			  "\x74\x68\x65\x20\x63\x6c\x61\x73"
+			  "\x73\x20\x6f\x66\x20\x27\x39\x39"
+			  "\x3a\x20\x49\x66\x20\x49\x20\x63"
+			  "\x6f\x75\x6c\x64\x20\x6f\x66\x66"
+			  "\x65\x72\x20\x79\x6f\x75\x20\x6f"
+			  "\x6e\x6c\x79\x20\x6f\x6e\x65\x20"
+			  "\x74\x69\x70\x20\x66\x6f\x72\x20"
+			  "\x74\x68\x65\x20\x66\x75\x74\x75"
+			  "\x72\x65\x2c\x20\x73\x75\x6e\x73"
+			  "\x63\x72\x65\x65\x6e\x20\x77\x6f"
+			  "\x75\x6c\x64\x20\x62\x65\x20\x69"
+			  "\x74\x2e",
+		.rlen	= 114,
+	},
+};
+
 /*
  * ANSI X9.31 Continuous Pseudo-Random Number Generator (AES mode)
  * test vectors, taken from Appendix B.2.9 and B.2.10:
@@ -14108,6 +14532,182 @@ static struct cipher_testvec salsa20_stream_enc_tv_template[] = {
 	},
 };
 
+#define CHACHA20_ENC_TEST_VECTORS 3
+
+static struct cipher_testvec chacha20_enc_tv_template[] = {
+	{ /* RFC7539 A.2. Test Vector #1 */
+		.key	= "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.klen	= 32,
+		.iv	= "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.input	= "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.ilen	= 64,
+		.result	= "\x76\xb8\xe0\xad\xa0\xf1\x3d\x90"
+			  "\x40\x5d\x6a\xe5\x53\x86\xbd\x28"
+			  "\xbd\xd2\x19\xb8\xa0\x8d\xed\x1a"
+			  "\xa8\x36\xef\xcc\x8b\x77\x0d\xc7"
+			  "\xda\x41\x59\x7c\x51\x57\x48\x8d"
+			  "\x77\x24\xe0\x3f\xb8\xd8\x4a\x37"
+			  "\x6a\x43\xb8\xf4\x15\x18\xa1\x1c"
+			  "\xc3\x87\xb6\x69\xb2\xee\x65\x86",
+		.rlen	= 64,
+	}, { /* RFC7539 A.2. Test Vector #2 */
+		.key	= "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x01",
+		.klen	= 32,
+		.iv	= "\x01\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x00\x00\x00\x00\x02",
+		.input	= "\x41\x6e\x79\x20\x73\x75\x62\x6d"
+			  "\x69\x73\x73\x69\x6f\x6e\x20\x74"
+			  "\x6f\x20\x74\x68\x65\x20\x49\x45"
+			  "\x54\x46\x20\x69\x6e\x74\x65\x6e"
+			  "\x64\x65\x64\x20\x62\x79\x20\x74"
+			  "\x68\x65\x20\x43\x6f\x6e\x74\x72"
+			  "\x69\x62\x75\x74\x6f\x72\x20\x66"
+			  "\x6f\x72\x20\x70\x75\x62\x6c\x69"
+			  "\x63\x61\x74\x69\x6f\x6e\x20\x61"
+			  "\x73\x20\x61\x6c\x6c\x20\x6f\x72"
+			  "\x20\x70\x61\x72\x74\x20\x6f\x66"
+			  "\x20\x61\x6e\x20\x49\x45\x54\x46"
+			  "\x20\x49\x6e\x74\x65\x72\x6e\x65"
+			  "\x74\x2d\x44\x72\x61\x66\x74\x20"
+			  "\x6f\x72\x20\x52\x46\x43\x20\x61"
+			  "\x6e\x64\x20\x61\x6e\x79\x20\x73"
+			  "\x74\x61\x74\x65\x6d\x65\x6e\x74"
+			  "\x20\x6d\x61\x64\x65\x20\x77\x69"
+			  "\x74\x68\x69\x6e\x20\x74\x68\x65"
+			  "\x20\x63\x6f\x6e\x74\x65\x78\x74"
+			  "\x20\x6f\x66\x20\x61\x6e\x20\x49"
+			  "\x45\x54\x46\x20\x61\x63\x74\x69"
+			  "\x76\x69\x74\x79\x20\x69\x73\x20"
+			  "\x63\x6f\x6e\x73\x69\x64\x65\x72"
+			  "\x65\x64\x20\x61\x6e\x20\x22\x49"
+			  "\x45\x54\x46\x20\x43\x6f\x6e\x74"
+			  "\x72\x69\x62\x75\x74\x69\x6f\x6e"
+			  "\x22\x2e\x20\x53\x75\x63\x68\x20"
+			  "\x73\x74\x61\x74\x65\x6d\x65\x6e"
+			  "\x74\x73\x20\x69\x6e\x63\x6c\x75"
+			  "\x64\x65\x20\x6f\x72\x61\x6c\x20"
+			  "\x73\x74\x61\x74\x65\x6d\x65\x6e"
+			  "\x74\x73\x20\x69\x6e\x20\x49\x45"
+			  "\x54\x46\x20\x73\x65\x73\x73\x69"
+			  "\x6f\x6e\x73\x2c\x20\x61\x73\x20"
+			  "\x77\x65\x6c\x6c\x20\x61\x73\x20"
+			  "\x77\x72\x69\x74\x74\x65\x6e\x20"
+			  "\x61\x6e\x64\x20\x65\x6c\x65\x63"
+			  "\x74\x72\x6f\x6e\x69\x63\x20\x63"
+			  "\x6f\x6d\x6d\x75\x6e\x69\x63\x61"
+			  "\x74\x69\x6f\x6e\x73\x20\x6d\x61"
+			  "\x64\x65\x20\x61\x74\x20\x61\x6e"
+			  "\x79\x20\x74\x69\x6d\x65\x20\x6f"
+			  "\x72\x20\x70\x6c\x61\x63\x65\x2c"
+			  "\x20\x77\x68\x69\x63\x68\x20\x61"
+			  "\x72\x65\x20\x61\x64\x64\x72\x65"
+			  "\x73\x73\x65\x64\x20\x74\x6f",
+		.ilen	= 375,
+		.result	= "\xa3\xfb\xf0\x7d\xf3\xfa\x2f\xde"
+			  "\x4f\x37\x6c\xa2\x3e\x82\x73\x70"
+			  "\x41\x60\x5d\x9f\x4f\x4f\x57\xbd"
+			  "\x8c\xff\x2c\x1d\x4b\x79\x55\xec"
+			  "\x2a\x97\x94\x8b\xd3\x72\x29\x15"
+			  "\xc8\xf3\xd3\x37\xf7\xd3\x70\x05"
+			  "\x0e\x9e\x96\xd6\x47\xb7\xc3\x9f"
+			  "\x56\xe0\x31\xca\x5e\xb6\x25\x0d"
+			  "\x40\x42\xe0\x27\x85\xec\xec\xfa"
+			  "\x4b\x4b\xb5\xe8\xea\xd0\x44\x0e"
+			  "\x20\xb6\xe8\xdb\x09\xd8\x81\xa7"
+			  "\xc6\x13\x2f\x42\x0e\x52\x79\x50"
+			  "\x42\xbd\xfa\x77\x73\xd8\xa9\x05"
+			  "\x14\x47\xb3\x29\x1c\xe1\x41\x1c"
+			  "\x68\x04\x65\x55\x2a\xa6\xc4\x05"
+			  "\xb7\x76\x4d\x5e\x87\xbe\xa8\x5a"
+			  "\xd0\x0f\x84\x49\xed\x8f\x72\xd0"
+			  "\xd6\x62\xab\x05\x26\x91\xca\x66"
+			  "\x42\x4b\xc8\x6d\x2d\xf8\x0e\xa4"
+			  "\x1f\x43\xab\xf9\x37\xd3\x25\x9d"
+			  "\xc4\xb2\xd0\xdf\xb4\x8a\x6c\x91"
+			  "\x39\xdd\xd7\xf7\x69\x66\xe9\x28"
+			  "\xe6\x35\x55\x3b\xa7\x6c\x5c\x87"
+			  "\x9d\x7b\x35\xd4\x9e\xb2\xe6\x2b"
+			  "\x08\x71\xcd\xac\x63\x89\x39\xe2"
+			  "\x5e\x8a\x1e\x0e\xf9\xd5\x28\x0f"
+			  "\xa8\xca\x32\x8b\x35\x1c\x3c\x76"
+			  "\x59\x89\xcb\xcf\x3d\xaa\x8b\x6c"
+			  "\xcc\x3a\xaf\x9f\x39\x79\xc9\x2b"
+			  "\x37\x20\xfc\x88\xdc\x95\xed\x84"
+			  "\xa1\xbe\x05\x9c\x64\x99\xb9\xfd"
+			  "\xa2\x36\xe7\xe8\x18\xb0\x4b\x0b"
+			  "\xc3\x9c\x1e\x87\x6b\x19\x3b\xfe"
+			  "\x55\x69\x75\x3f\x88\x12\x8c\xc0"
+			  "\x8a\xaa\x9b\x63\xd1\xa1\x6f\x80"
+			  "\xef\x25\x54\xd7\x18\x9c\x41\x1f"
+			  "\x58\x69\xca\x52\xc5\xb8\x3f\xa3"
+			  "\x6f\xf2\x16\xb9\xc1\xd3\x00\x62"
+			  "\xbe\xbc\xfd\x2d\xc5\xbc\xe0\x91"
+			  "\x19\x34\xfd\xa7\x9a\x86\xf6\xe6"
+			  "\x98\xce\xd7\x59\xc3\xff\x9b\x64"
+			  "\x77\x33\x8f\x3d\xa4\xf9\xcd\x85"
+			  "\x14\xea\x99\x82\xcc\xaf\xb3\x41"
+			  "\xb2\x38\x4d\xd9\x02\xf3\xd1\xab"
+			  "\x7a\xc6\x1d\xd2\x9c\x6f\x21\xba"
+			  "\x5b\x86\x2f\x37\x30\xe3\x7c\xfd"
+			  "\xc4\xfd\x80\x6c\x22\xf2\x21",
+		.rlen	= 375,
+	}, { /* RFC7539 2.4.2. Test Vector */
+		.key	= "\x00\x01\x02\x03\x04\x05\x06\x07"
+			  "\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+			  "\x10\x11\x12\x13\x14\x15\x16\x17"
+			  "\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f",
+		.klen	= 32,
+		.iv	= "\x01\x00\x00\x00\x00\x00\x00\x00"
+			  "\x00\x00\x00\x4a\x00\x00\x00\x00",
+		.input	= "\x4c\x61\x64\x69\x65\x73\x20\x61"
+			  "\x6e\x64\x20\x47\x65\x6e\x74\x6c"
+			  "\x65\x6d\x65\x6e\x20\x6f\x66\x20"
+			  "\x74\x68\x65\x20\x63\x6c\x61\x73"
+			  "\x73\x20\x6f\x66\x20\x27\x39\x39"
+			  "\x3a\x20\x49\x66\x20\x49\x20\x63"
+			  "\x6f\x75\x6c\x64\x20\x6f\x66\x66"
+			  "\x65\x72\x20\x79\x6f\x75\x20\x6f"
+			  "\x6e\x6c\x79\x20\x6f\x6e\x65\x20"
+			  "\x74\x69\x70\x20\x66\x6f\x72\x20"
+			  "\x74\x68\x65\x20\x66\x75\x74\x75"
+			  "\x72\x65\x2c\x20\x73\x75\x6e\x73"
+			  "\x63\x72\x65\x65\x6e\x20\x77\x6f"
+			  "\x75\x6c\x64\x20\x62\x65\x20\x69"
+			  "\x74\x2e",
+		.ilen	= 114,
+		.result	= "\x6e\x2e\x35\x9a\x25\x68\xf9\x80"
+			  "\x41\xba\x07\x28\xdd\x0d\x69\x81"
+			  "\xe9\x7e\x7a\xec\x1d\x43\x60\xc2"
+			  "\x0a\x27\xaf\xcc\xfd\x9f\xae\x0b"
+			  "\xf9\x1b\x65\xc5\x52\x47\x33\xab"
+			  "\x8f\x59\x3d\xab\xcd\x62\xb3\x57"
+			  "\x16\x39\xd6\x24\xe6\x51\x52\xab"
+			  "\x8f\x53\x0c\x35\x9f\x08\x61\xd8"
+			  "\x07\xca\x0d\xbf\x50\x0d\x6a\x61"
+			  "\x56\xa3\x8e\x08\x8a\x22\xb6\x5e"
+			  "\x52\xbc\x51\x4d\x16\xcc\xf8\x06"
+			  "\x81\x8c\xe9\x1a\xb7\x79\x37\x36"
+			  "\x5a\xf9\x0b\xbf\x74\xa3\x5b\xe6"
+			  "\xb4\x0b\x8e\xed\xf2\x78\x5e\x42"
+			  "\x87\x4d",
+		.rlen	= 114,
+	},
+};
+
 /*
  * CTS (Cipher Text Stealing) mode tests
  */
@@ -14683,10 +15283,252 @@ static struct hash_testvec michael_mic_tv_template[] = {
 	}
 };
 
+/*
+ * CRC32 test vectors.  crc32_long_string is long enough to be folded by
+ * the accelerated implementations, and is not a multiple of their block
+ * size so that the tail is covered as well.
+ */
+static char crc32_long_string[] =
+	"\x5a\xf7\x94\x31\xce\x6b\x08\xa5"
+	"\x42\xdf\x7c\x19\xb6\x53\xf0\x8d"
+	"\x2a\xc7\x64\x01\x9e\x3b\xd8\x75"
+	"\x12\xaf\x4c\xe9\x86\x23\xc0\x5d"
+	"\xfa\x97\x34\xd1\x6e\x0b\xa8\x45"
+	"\xe2\x7f\x1c\xb9\x56\xf3\x90\x2d"
+	"\xca\x67\x04\xa1\x3e\xdb\x78\x15"
+	"\xb2\x4f\xec\x89\x26\xc3\x60\xfd"
+	"\x9a\x37\xd4\x71\x0e\xab\x48\xe5"
+	"\x82\x1f\xbc\x59\xf6\x93\x30\xcd"
+	"\x6a\x07\xa4\x41\xde\x7b\x18\xb5"
+	"\x52\xef\x8c\x29\xc6\x63\x00\x9d"
+	"\x3a\xd7\x74\x11\xae\x4b\xe8\x85"
+	"\x22\xbf\x5c\xf9\x96\x33\xd0\x6d"
+	"\x0a\xa7\x44\xe1\x7e\x1b\xb8\x55"
+	"\xf2\x8f\x2c\xc9\x66\x03\xa0\x3d"
+	"\xda\x77\x14\xb1\x4e\xeb\x88\x25"
+	"\xc2\x5f\xfc\x99\x36\xd3\x70\x0d"
+	"\xaa\x47\xe4\x81\x1e\xbb\x58\xf5"
+	"\x92\x2f\xcc\x69\x06\xa3\x40\xdd"
+	"\x7a\x17\xb4\x51\xee\x8b\x28\xc5"
+	"\x62\xff\x9c\x39\xd6\x73\x10\xad"
+	"\x4a\xe7\x84\x21\xbe\x5b\xf8\x95"
+	"\x32\xcf\x6c\x09\xa6\x43\xe0\x7d"
+	"\x1a\xb7\x54\xf1\x8e\x2b\xc8\x65"
+	"\x02\x9f\x3c\xd9\x76\x13\xb0\x4d"
+	"\xea\x87\x24\xc1\x5e\xfb\x98\x35"
+	"\xd2\x6f\x0c\xa9\x46\xe3\x80\x1d"
+	"\xba\x57\xf4\x91\x2e\xcb\x68\x05"
+	"\xa2\x3f\xdc\x79\x16\xb3\x50\xed"
+	"\x8a\x27\xc4\x61\xfe\x9b\x38\xd5"
+	"\x72\x0f\xac\x49\xe6\x83\x20\xbd"
+	"\x5a\xf7\x94\x31\xce\x6b\x08\xa5"
+	"\x42\xdf\x7c\x19\xb6\x53\xf0\x8d"
+	"\x2a\xc7\x64\x01\x9e\x3b\xd8\x75"
+	"\x12\xaf\x4c\xe9\x86\x23\xc0\x5d"
+	"\xfa\x97\x34\xd1\x6e\x0b\xa8\x45"
+	"\xe2\x7f\x1c\xb9\x56\xf3\x90\x2d"
+	"\xca\x67\x04\xa1\x3e\xdb\x78\x15"
+	"\xb2\x4f\xec\x89\x26\xc3\x60\xfd"
+	"\x9a\x37\xd4\x71\x0e\xab\x48\xe5"
+	"\x82\x1f\xbc\x59\xf6\x93\x30\xcd"
+	"\x6a\x07\xa4\x41\xde\x7b\x18\xb5"
+	"\x52\xef\x8c\x29\xc6\x63\x00\x9d"
+	"\x3a\xd7\x74\x11\xae\x4b\xe8\x85"
+	"\x22\xbf\x5c\xf9\x96\x33\xd0\x6d"
+	"\x0a\xa7\x44\xe1\x7e\x1b\xb8\x55"
+	"\xf2\x8f\x2c\xc9\x66\x03\xa0\x3d"
+	"\xda\x77\x14\xb1\x4e\xeb\x88\x25"
+	"\xc2\x5f\xfc\x99\x36\xd3\x70\x0d"
+	"\xaa\x47\xe4\x81\x1e\xbb\x58\xf5"
+	"\x92\x2f\xcc\x69\x06\xa3\x40\xdd"
+	"\x7a\x17\xb4\x51\xee\x8b\x28\xc5"
+	"\x62\xff\x9c\x39\xd6\x73\x10\xad"
+	"\x4a\xe7\x84\x21\xbe\x5b\xf8\x95"
+	"\x32\xcf\x6c\x09\xa6\x43\xe0\x7d"
+	"\x1a\xb7\x54\xf1\x8e\x2b\xc8\x65"
+	"\x02\x9f\x3c\xd9\x76\x13\xb0\x4d"
+	"\xea\x87\x24\xc1\x5e\xfb\x98\x35"
+	"\xd2\x6f\x0c\xa9\x46\xe3\x80\x1d"
+	"\xba\x57\xf4\x91\x2e\xcb\x68\x05"
+	"\xa2\x3f\xdc\x79\x16\xb3\x50\xed"
+	"\x8a\x27\xc4\x61\xfe\x9b\x38\xd5"
+	"\x72\x0f\xac\x49\xe6\x83\x20\xbd"
+	"\x5a\xf7\x94\x31\xce\x6b\x08\xa5"
+	"\x42\xdf\x7c\x19\xb6\x53\xf0\x8d"
+	"\x2a\xc7\x64\x01\x9e\x3b\xd8\x75"
+	"\x12\xaf\x4c\xe9\x86\x23\xc0\x5d"
+	"\xfa\x97\x34\xd1\x6e\x0b\xa8\x45"
+	"\xe2\x7f\x1c\xb9\x56\xf3\x90\x2d"
+	"\xca\x67\x04\xa1\x3e\xdb\x78\x15"
+	"\xb2\x4f\xec\x89\x26\xc3\x60\xfd"
+	"\x9a\x37\xd4\x71\x0e\xab\x48\xe5"
+	"\x82\x1f\xbc\x59\xf6\x93\x30\xcd"
+	"\x6a\x07\xa4\x41\xde\x7b\x18\xb5"
+	"\x52\xef\x8c\x29\xc6\x63\x00\x9d"
+	"\x3a\xd7\x74\x11\xae\x4b\xe8\x85"
+	"\x22\xbf\x5c\xf9\x96\x33\xd0\x6d"
+	"\x0a\xa7\x44\xe1\x7e\x1b\xb8\x55"
+	"\xf2\x8f\x2c\xc9\x66\x03\xa0\x3d"
+	"\xda\x77\x14\xb1\x4e\xeb\x88\x25"
+	"\xc2\x5f\xfc\x99\x36\xd3\x70\x0d"
+	"\xaa\x47\xe4\x81\x1e\xbb\x58\xf5"
+	"\x92\x2f\xcc\x69\x06\xa3\x40\xdd"
+	"\x7a\x17\xb4\x51\xee\x8b\x28\xc5"
+	"\x62\xff\x9c\x39\xd6\x73\x10\xad"
+	"\x4a\xe7\x84\x21\xbe\x5b\xf8\x95"
+	"\x32\xcf\x6c\x09\xa6\x43\xe0\x7d"
+	"\x1a\xb7\x54\xf1\x8e\x2b\xc8\x65"
+	"\x02\x9f\x3c\xd9\x76\x13\xb0\x4d"
+	"\xea\x87\x24\xc1\x5e\xfb\x98\x35"
+	"\xd2\x6f\x0c\xa9\x46\xe3\x80\x1d"
+	"\xba\x57\xf4\x91\x2e\xcb\x68\x05"
+	"\xa2\x3f\xdc\x79\x16\xb3\x50\xed"
+	"\x8a\x27\xc4\x61\xfe\x9b\x38\xd5"
+	"\x72\x0f\xac\x49\xe6\x83\x20\xbd"
+	"\x5a\xf7\x94\x31\xce\x6b\x08\xa5"
+	"\x42\xdf\x7c\x19\xb6\x53\xf0\x8d"
+	"\x2a\xc7\x64\x01\x9e\x3b\xd8\x75"
+	"\x12\xaf\x4c\xe9\x86\x23\xc0\x5d"
+	"\xfa\x97\x34\xd1\x6e\x0b\xa8\x45"
+	"\xe2\x7f\x1c\xb9\x56\xf3\x90\x2d"
+	"\xca\x67\x04\xa1\x3e\xdb\x78\x15"
+	"\xb2\x4f\xec\x89\x26\xc3\x60\xfd"
+	"\x9a\x37\xd4\x71\x0e\xab\x48\xe5"
+	"\x82\x1f\xbc\x59\xf6\x93\x30\xcd"
+	"\x6a\x07\xa4\x41\xde\x7b\x18\xb5"
+	"\x52\xef\x8c\x29\xc6\x63\x00\x9d"
+	"\x3a\xd7\x74\x11\xae\x4b\xe8\x85"
+	"\x22\xbf\x5c\xf9\x96\x33\xd0\x6d"
+	"\x0a\xa7\x44\xe1\x7e\x1b\xb8\x55"
+	"\xf2\x8f\x2c\xc9\x66\x03\xa0\x3d"
+	"\xda\x77\x14\xb1\x4e\xeb\x88\x25"
+	"\xc2\x5f\xfc\x99\x36\xd3\x70\x0d"
+	"\xaa\x47\xe4\x81\x1e\xbb\x58\xf5"
+	"\x92\x2f\xcc\x69\x06\xa3\x40\xdd"
+	"\x7a\x17\xb4\x51\xee\x8b\x28\xc5"
+	"\x62\xff\x9c\x39\xd6\x73\x10\xad"
+	"\x4a\xe7\x84\x21\xbe\x5b\xf8\x95"
+	"\x32\xcf\x6c\x09\xa6\x43\xe0\x7d"
+	"\x1a\xb7\x54\xf1\x8e\x2b\xc8\x65"
+	"\x02\x9f\x3c\xd9\x76\x13\xb0\x4d"
+	"\xea\x87\x24\xc1\x5e\xfb\x98\x35"
+	"\xd2\x6f\x0c\xa9\x46\xe3\x80\x1d"
+	"\xba\x57\xf4\x91\x2e\xcb\x68\x05";
+
+#define CRC32_TEST_VECTORS 11
+
+static struct hash_testvec crc32_tv_template[] = {
+	{
+		.psize = 0,
+		.digest = "\x00\x00\x00\x00",
+	},
+	{
+		.key = "\x87\xa9\xcb\xed",
+		.ksize = 4,
+		.psize = 0,
+		.digest = "\x87\xa9\xcb\xed",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x01\x02\x03\x04\x05\x06\x07\x08"
+			     "\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+			     "\x11\x12\x13\x14\x15\x16\x17\x18"
+			     "\x19\x1a\x1b\x1c\x1d\x1e\x1f\x20"
+			     "\x21\x22\x23\x24\x25\x26\x27\x28",
+		.psize = 40,
+		.digest = "\x3a\xdf\x4b\xb0",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x29\x2a\x2b\x2c\x2d\x2e\x2f\x30"
+			     "\x31\x32\x33\x34\x35\x36\x37\x38"
+			     "\x39\x3a\x3b\x3c\x3d\x3e\x3f\x40"
+			     "\x41\x42\x43\x44\x45\x46\x47\x48"
+			     "\x49\x4a\x4b\x4c\x4d\x4e\x4f\x50",
+		.psize = 40,
+		.digest = "\xa9\x7a\x7f\x7b",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x51\x52\x53\x54\x55\x56\x57\x58"
+			     "\x59\x5a\x5b\x5c\x5d\x5e\x5f\x60"
+			     "\x61\x62\x63\x64\x65\x66\x67\x68"
+			     "\x69\x6a\x6b\x6c\x6d\x6e\x6f\x70"
+			     "\x71\x72\x73\x74\x75\x76\x77\x78",
+		.psize = 40,
+		.digest = "\xba\xd3\xf8\x1c",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x79\x7a\x7b\x7c\x7d\x7e\x7f\x80"
+			     "\x81\x82\x83\x84\x85\x86\x87\x88"
+			     "\x89\x8a\x8b\x8c\x8d\x8e\x8f\x90"
+			     "\x91\x92\x93\x94\x95\x96\x97\x98"
+			     "\x99\x9a\x9b\x9c\x9d\x9e\x9f\xa0",
+		.psize = 40,
+		.digest = "\xa8\xa9\xc2\x02",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\xa1\xa2\xa3\xa4\xa5\xa6\xa7\xa8"
+			     "\xa9\xaa\xab\xac\xad\xae\xaf\xb0"
+			     "\xb1\xb2\xb3\xb4\xb5\xb6\xb7\xb8"
+			     "\xb9\xba\xbb\xbc\xbd\xbe\xbf\xc0"
+			     "\xc1\xc2\xc3\xc4\xc5\xc6\xc7\xc8",
+		.psize = 40,
+		.digest = "\x27\xf0\x57\xe2",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\xc9\xca\xcb\xcc\xcd\xce\xcf\xd0"
+			     "\xd1\xd2\xd3\xd4\xd5\xd6\xd7\xd8"
+			     "\xd9\xda\xdb\xdc\xdd\xde\xdf\xe0"
+			     "\xe1\xe2\xe3\xe4\xe5\xe6\xe7\xe8"
+			     "\xe9\xea\xeb\xec\xed\xee\xef\xf0",
+		.psize = 40,
+		.digest = "\x49\x78\x10\x08",
+	},
+	{
+		.key = "\x80\xea\xd3\xf1",
+		.ksize = 4,
+		.plaintext = "\x29\x2a\x2b\x2c\x2d\x2e\x2f\x30"
+			     "\x31\x32\x33\x34\x35\x36\x37\x38"
+			     "\x39\x3a\x3b\x3c\x3d\x3e\x3f\x40"
+			     "\x41\x42\x43\x44\x45\x46\x47\x48"
+			     "\x49\x4a\x4b\x4c\x4d\x4e\x4f\x50",
+		.psize = 40,
+		.digest = "\x9a\xb1\xdc\xf0",
+	},
+	{
+		.key = "\xf3\x4a\x1d\x5d",
+		.ksize = 4,
+		.plaintext = "\x51\x52\x53\x54\x55\x56\x57\x58"
+			     "\x59\x5a\x5b\x5c\x5d\x5e\x5f\x60"
+			     "\x61\x62\x63\x64\x65\x66\x67\x68"
+			     "\x69\x6a\x6b\x6c\x6d\x6e\x6f\x70"
+			     "\x71\x72\x73\x74\x75\x76\x77\x78",
+		.psize = 40,
+		.digest = "\xb4\x97\xcc\xd4",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = crc32_long_string,
+		.psize = 1000,
+		.digest = "\x72\xa7\x7f\x4f",
+	},
+};
+
 /*
  * CRC32C test vectors
  */
-#define CRC32C_TEST_VECTORS 14
+#define CRC32C_TEST_VECTORS 15
 
 static struct hash_testvec crc32c_tv_template[] = {
 	{
@@ -14858,6 +15700,13 @@ static struct hash_testvec crc32c_tv_template[] = {
 		.np = 2,
 		.tap = { 31, 209 }
 	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = crc32_long_string,
+		.psize = 1000,
+		.digest = "\x86\xfb\x0a\xc0",
+	},
 };
 
 #endif	/* _CRYPTO_TESTMGR_H */
@@ -111,6 +111,9 @@ extern void bus_remove_driver(struct device_driver *drv);
 
 extern void driver_detach(struct device_driver *drv);
 extern int driver_probe_device(struct device_driver *drv, struct device *dev);
+extern bool driver_allows_async_probing(struct device_driver *drv);
+extern void driver_attach_async(struct device_driver *drv);
+extern void driver_wait_async_probe(void);
 extern void driver_deferred_probe_del(struct device *dev);
 static inline int driver_match_device(struct device_driver *drv,
 				      struct device *dev)
@@ -24,6 +24,7 @@
 #include <linux/wait.h>
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
+#include <linux/ktime.h>
 #include <linux/pinctrl/devinfo.h>
 
 #include "base.h"
@@ -355,6 +356,9 @@ int driver_probe_done(void)
  */
 void wait_for_device_probe(void)
 {
+	/* wait for the asynchronous attaches, also between two probes */
+	driver_wait_async_probe();
+
 	/* wait for the known devices to complete their probing */
 	wait_event(probe_waitqueue, atomic_read(&probe_count) == 0);
 	async_synchronize_full();
@@ -486,6 +490,105 @@ int driver_attach(struct device_driver *drv)
 }
 EXPORT_SYMBOL_GPL(driver_attach);
 
+/*
+ * Asynchronous probing.
+ *
+ * Drivers that opt in are bound to the devices already on their bus from
+ * the async domain, so that their probes, which often just sit out
+ * hardware delays, overlap with each other and with the remaining
+ * initcalls.  async_synchronize_full() doesn't wait for this domain, so
+ * wait_for_device_probe() waits for it explicitly.
+ */
+static ASYNC_DOMAIN(async_probe_domain);
+
+#define ASYNC_DRV_NAMES_MAX_LEN	256
+static char async_probe_drv_names[ASYNC_DRV_NAMES_MAX_LEN];
+
+static int __init save_async_options(char *buf)
+{
+	if (strlen(buf) >= ASYNC_DRV_NAMES_MAX_LEN)
+		printk(KERN_WARNING
+		       "Too long list of driver names for 'driver_async_probe'!\n");
+
+	strlcpy(async_probe_drv_names, buf, ASYNC_DRV_NAMES_MAX_LEN);
+	return 1;
+}
+__setup("driver_async_probe=", save_async_options);
+
+/* is @name in the comma separated "driver_async_probe=" list, or is it "*" */
+static bool driver_async_probe_requested(const char *name)
+{
+	const char *p = async_probe_drv_names;
+	size_t len = strlen(name);
+
+	while (*p) {
+		size_t n = strcspn(p, ",");
+
+		if ((n == 1 && *p == '*') || (n == len && !strncmp(p, name, n)))
+			return true;
+		p += n;
+		if (*p == ',')
+			p++;
+	}
+
+	return false;
+}
+
+bool driver_allows_async_probing(struct device_driver *drv)
+{
+	switch (drv->probe_type) {
+	case PROBE_PREFER_ASYNCHRONOUS:
+		return true;
+
+	case PROBE_FORCE_SYNCHRONOUS:
+		return false;
+
+	default:
+		return driver_async_probe_requested(drv->name);
+	}
+}
+
+static void __driver_attach_async(void *data, async_cookie_t cookie)
+{
+	struct device_driver *drv = data;
+	ktime_t calltime, rettime;
+	int ret;
+
+	calltime = ktime_get();
+	ret = driver_attach(drv);
+	rettime = ktime_get();
+
+	if (initcall_debug) {
+		printk(KERN_DEBUG "async probe of driver %s returned %d after %lld usecs\n",
+		       drv->name, ret,
+		       (long long)ktime_to_ns(ktime_sub(rettime, calltime)) >> 10);
+		initcall_record(NULL, drv->name, ktime_to_ns(calltime),
+				ktime_to_ns(rettime), ret);
+	}
+}
+
+/**
+ * driver_attach_async - bind a driver to its devices on the async domain.
+ * @drv: driver.
+ *
+ * The caller must call driver_wait_async_probe() before the driver
+ * goes away.
+ */
+void driver_attach_async(struct device_driver *drv)
+{
+	pr_debug("bus: '%s': probing driver %s asynchronously\n",
+		 drv->bus->name, drv->name);
+	async_schedule_domain(__driver_attach_async, drv, &async_probe_domain);
+}
+
+/**
+ * driver_wait_async_probe - wait for the pending asynchronous probes.
+ */
+void driver_wait_async_probe(void)
+{
+	async_synchronize_full_domain(&async_probe_domain);
+}
+
 /*
  * __device_release_driver() must be called with @dev lock held.
  * When called for a USB interface, @dev->parent lock must be held as well.
@@ -20,9 +20,10 @@
 #include "diagfwd_hsic.h"
 #include "diagmem.h"
 #include "diag_dci.h"
+#include "diag_ring.h"
 
 #define DEBUG_BUF_SIZE	4096
-static struct dentry *diag_dbgfs_dent;
+struct dentry *diag_dbgfs_dent;
 static int diag_dbgfs_table_index;
 static int diag_dbgfs_finished;
 static int diag_dbgfs_dci_data_index;
@@ -525,6 +526,49 @@ static ssize_t diag_dbgfs_read_mempool(struct file *file, char __user *ubuf,
 }
 #endif
 
+static ssize_t diag_dbgfs_read_ring(struct file *file, char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	struct diag_ring *ring;
+	char *buf;
+	int ret;
+	unsigned int buf_size;
+
+	buf = kzalloc(sizeof(char) * DEBUG_BUF_SIZE, GFP_KERNEL);
+	if (ZERO_OR_NULL_PTR(buf)) {
+		pr_err("diag: %s, Error allocating memory\n", __func__);
+		return -ENOMEM;
+	}
+	buf_size = ksize(buf);
+
+	ring = diag_ring_get();
+	if (ring) {
+		ret = scnprintf(buf, buf_size,
+			"size: %u\n"
+			"head: %u\n"
+			"tail: %u\n"
+			"records: %lu\n"
+			"bytes: %llu\n"
+			"dropped: %lu\n"
+			"wakeups: %lu\n",
+			ring->size,
+			ACCESS_ONCE(ring->head),
+			ACCESS_ONCE(ring->ctl->tail),
+			ring->records,
+			ring->bytes,
+			ring->dropped,
+			ring->wakeups);
+		diag_ring_put(ring);
+	} else {
+		ret = scnprintf(buf, buf_size, "no ring\n");
+	}
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, ret);
+
+	kfree(buf);
+	return ret;
+}
+
 #ifdef CONFIG_DIAGFWD_BRIDGE_CODE
 static ssize_t diag_dbgfs_read_bridge(struct file *file, char __user *ubuf,
 				    size_t count, loff_t *ppos)
@@ -672,6 +716,10 @@ const struct file_operations diag_dbgfs_dcistats_ops = {
 	.read = diag_dbgfs_read_dcistats,
 };
 
+const struct file_operations diag_dbgfs_ring_ops = {
+	.read = diag_dbgfs_read_ring,
+};
+
 void diag_debugfs_init(void)
 {
 	diag_dbgfs_dent = debugfs_create_dir("diag", 0);
@@ -693,6 +741,9 @@ void diag_debugfs_init(void)
 	debugfs_create_file("dci_stats", 0444, diag_dbgfs_dent, 0,
 		&diag_dbgfs_dcistats_ops);
 
+	debugfs_create_file("ring", 0444, diag_dbgfs_dent, 0,
+		&diag_dbgfs_ring_ops);
+
 #ifdef CONFIG_DIAGFWD_BRIDGE_CODE
 	debugfs_create_file("bridge", 0444, diag_dbgfs_dent, 0,
 		&diag_dbgfs_bridge_ops);
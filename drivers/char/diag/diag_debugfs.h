@@ -13,6 +13,10 @@
 #ifndef DIAG_DEBUGFS_H
 #define DIAG_DEBUGFS_H
 
+struct dentry;
+
+extern struct dentry *diag_dbgfs_dent;
+
 void diag_debugfs_init(void);
 void diag_debugfs_cleanup(void);
 
@@ -0,0 +1,253 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/spinlock.h>
+#include "diagchar.h"
+#include "diag_ring.h"
+
+/* the ring peripheral data goes to in memory device mode */
+static struct diag_ring *diag_md_ring;
+static DEFINE_SPINLOCK(diag_md_ring_lock);
+
+struct diag_ring *diag_ring_create(unsigned int size)
+{
+	struct diag_ring *ring;
+
+	ring = kzalloc(sizeof(struct diag_ring), GFP_KERNEL);
+	if (!ring)
+		return NULL;
+
+	ring->ctl = vmalloc_user(PAGE_SIZE + size);
+	if (!ring->ctl) {
+		kfree(ring);
+		return NULL;
+	}
+	ring->data = (unsigned char *)ring->ctl + PAGE_SIZE;
+	ring->size = size;
+	ring->ctl->magic = DIAG_RING_MAGIC;
+	ring->ctl->size = size;
+
+	kref_init(&ring->kref);
+	mutex_init(&ring->lock);
+	init_waitqueue_head(&ring->wait_q);
+	return ring;
+}
+
+static void diag_ring_release(struct kref *kref)
+{
+	struct diag_ring *ring = container_of(kref, struct diag_ring, kref);
+
+	vfree(ring->ctl);
+	kfree(ring);
+}
+
+void diag_ring_put(struct diag_ring *ring)
+{
+	if (ring)
+		kref_put(&ring->kref, diag_ring_release);
+}
+
+int diag_ring_attach(struct diag_ring *ring)
+{
+	int err = 0;
+
+	spin_lock(&diag_md_ring_lock);
+	if (diag_md_ring) {
+		err = -EBUSY;
+	} else {
+		kref_get(&ring->kref);
+		diag_md_ring = ring;
+	}
+	spin_unlock(&diag_md_ring_lock);
+	return err;
+}
+
+void diag_ring_detach(struct diag_ring *ring)
+{
+	int attached = 0;
+
+	spin_lock(&diag_md_ring_lock);
+	if (diag_md_ring == ring) {
+		diag_md_ring = NULL;
+		attached = 1;
+	}
+	spin_unlock(&diag_md_ring_lock);
+
+	if (attached)
+		diag_ring_put(ring);
+}
+
+/* Returns the attached ring with a reference held, or NULL */
+struct diag_ring *diag_ring_get(void)
+{
+	struct diag_ring *ring;
+
+	spin_lock(&diag_md_ring_lock);
+	ring = diag_md_ring;
+	if (ring)
+		kref_get(&ring->kref);
+	spin_unlock(&diag_md_ring_lock);
+	return ring;
+}
+
+/*
+ * Reserve room for a record of len bytes and return where its payload
+ * goes, or NULL if the ring is full and the record has to be dropped.
+ * Records never wrap: if the end of the data area is too close, the
+ * record goes to its start behind a pad record.  Must be called with
+ * ring->lock held and followed by at most one diag_ring_commit().
+ */
+void *diag_ring_reserve(struct diag_ring *ring, unsigned int len)
+{
+	struct diag_ring_rec *rec;
+	unsigned int off, need, used, tail;
+
+	off = ring->head & (ring->size - 1);
+	need = ALIGN(sizeof(struct diag_ring_rec) + len, DIAG_RING_REC_ALIGN);
+	ring->pad = (off + need > ring->size) ? ring->size - off : 0;
+
+	/* A tail that is not behind head only hurts its own reader */
+	tail = ACCESS_ONCE(ring->ctl->tail);
+	used = ring->head - tail;
+	if (need > ring->size || used > ring->size ||
+	    ring->pad + need > ring->size - used) {
+		ring->dropped++;
+		ring->ctl->dropped = ring->dropped;
+		ring->lost = 1;
+		return NULL;
+	}
+
+	rec = (struct diag_ring_rec *)(ring->data + (ring->pad ? 0 : off));
+	return rec + 1;
+}
+
+void diag_ring_commit(struct diag_ring *ring, unsigned int len,
+		      int peripheral)
+{
+	struct diag_ring_rec *rec;
+	unsigned int off, wake_bytes;
+
+	off = ring->head & (ring->size - 1);
+	if (ring->pad) {
+		rec = (struct diag_ring_rec *)(ring->data + off);
+		rec->len = ring->pad - sizeof(struct diag_ring_rec);
+		rec->peripheral = 0;
+		rec->flags = DIAG_RING_REC_PAD;
+		ring->head += ring->pad;
+		ring->pad = 0;
+		off = 0;
+	}
+
+	rec = (struct diag_ring_rec *)(ring->data + off);
+	rec->len = len;
+	rec->peripheral = peripheral;
+	rec->flags = ring->lost ? DIAG_RING_REC_LOSS : 0;
+	ring->lost = 0;
+	ring->head += ALIGN(sizeof(struct diag_ring_rec) + len,
+			    DIAG_RING_REC_ALIGN);
+	ring->records++;
+	ring->bytes += len;
+
+	/* The record must be visible before the head that covers it */
+	smp_wmb();
+	ring->ctl->head = ring->head;
+
+	wake_bytes = ACCESS_ONCE(ring->ctl->wake_bytes);
+	if (!wake_bytes || wake_bytes > ring->size)
+		wake_bytes = ring->size / 2;
+	if (ring->head - ring->woken >= wake_bytes)
+		diag_ring_kick(ring);
+}
+
+int diag_ring_write(struct diag_ring *ring, const void *buf,
+		    unsigned int len, int peripheral)
+{
+	void *dest;
+
+	mutex_lock(&ring->lock);
+	dest = diag_ring_reserve(ring, len);
+	if (dest) {
+		memcpy(dest, buf, len);
+		diag_ring_commit(ring, len, peripheral);
+	}
+	diag_ring_kick(ring);
+	mutex_unlock(&ring->lock);
+
+	return dest ? 0 : -ENOSPC;
+}
+
+/*
+ * Wake the reader if it has anything to read.  Called with ring->lock held
+ * by producers once they have nothing more to queue for now.
+ */
+void diag_ring_kick(struct diag_ring *ring)
+{
+	unsigned int head = ACCESS_ONCE(ring->head);
+
+	ring->woken = head;
+	if (head == ACCESS_ONCE(ring->ctl->tail))
+		return;
+
+	/* Order the head store against a poller adding itself to wait_q */
+	smp_mb();
+	if (waitqueue_active(&ring->wait_q)) {
+		wake_lock_timeout(&driver->wake_lock, HZ / 2);
+		ring->wakeups++;
+		wake_up_interruptible(&ring->wait_q);
+	}
+}
+
+unsigned int diag_ring_poll(struct diag_ring *ring, struct file *file,
+			    poll_table *wait)
+{
+	poll_wait(file, &ring->wait_q, wait);
+	if (ACCESS_ONCE(ring->head) != ACCESS_ONCE(ring->ctl->tail))
+		return POLLIN | POLLRDNORM;
+	return 0;
+}
+
+static void diag_ring_vm_open(struct vm_area_struct *vma)
+{
+	struct diag_ring *ring = vma->vm_private_data;
+
+	kref_get(&ring->kref);
+}
+
+static void diag_ring_vm_close(struct vm_area_struct *vma)
+{
+	diag_ring_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct diag_ring_vm_ops = {
+	.open = diag_ring_vm_open,
+	.close = diag_ring_vm_close,
+};
+
+int diag_ring_mmap(struct diag_ring *ring, struct vm_area_struct *vma)
+{
+	int err;
+
+	if (vma->vm_pgoff)
+		return -EINVAL;
+
+	err = remap_vmalloc_range(vma, ring->ctl, 0);
+	if (err)
+		return err;
+
+	vma->vm_ops = &diag_ring_vm_ops;
+	vma->vm_private_data = ring;
+	kref_get(&ring->kref);
+	return 0;
+}
@@ -0,0 +1,72 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef DIAG_RING_H
+#define DIAG_RING_H
+
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/diagchar.h>
+
+#define DIAG_RING_MAX_SIZE	(16 * 1024 * 1024)
+
+/*
+ * A memory device client's ring.  Producers take lock, reserve room for
+ * a record, fill in the payload in place and commit it; head is only
+ * published to the reader on commit.
+ */
+struct diag_ring {
+	struct kref kref;
+	struct mutex lock;
+	struct diag_ring_ctl *ctl;
+	unsigned char *data;
+	unsigned int size;
+	unsigned int head;
+	unsigned int pad;
+	unsigned int woken;
+	int lost;
+	wait_queue_head_t wait_q;
+	/* statistics */
+	unsigned long records;
+	unsigned long long bytes;
+	unsigned long dropped;
+	unsigned long wakeups;
+};
+
+struct diag_ring *diag_ring_create(unsigned int size);
+void diag_ring_put(struct diag_ring *ring);
+int diag_ring_attach(struct diag_ring *ring);
+void diag_ring_detach(struct diag_ring *ring);
+struct diag_ring *diag_ring_get(void);
+
+void *diag_ring_reserve(struct diag_ring *ring, unsigned int len);
+void diag_ring_commit(struct diag_ring *ring, unsigned int len,
+		      int peripheral);
+int diag_ring_write(struct diag_ring *ring, const void *buf,
+		   unsigned int len, int peripheral);
+void diag_ring_kick(struct diag_ring *ring);
+
+unsigned int diag_ring_poll(struct diag_ring *ring, struct file *file,
+			    poll_table *wait);
+int diag_ring_mmap(struct diag_ring *ring, struct vm_area_struct *vma);
+
+#ifdef CONFIG_DIAG_RING_BENCH
+void diag_ring_bench_init(void);
+void diag_ring_bench_exit(void);
+#else
+static inline void diag_ring_bench_init(void) { }
+static inline void diag_ring_bench_exit(void) { }
+#endif
+
+#endif
@@ -0,0 +1,291 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Memory device ring benchmark.
+ *
+ * A stand-in peripheral writes pkt_size byte log packets at rate_kbps
+ * (0 for as fast as it can) into a fifo_size byte FIFO, the way a modem
+ * writes into its SMD FIFO, and drops them when the FIFO is full.  Like
+ * diag_read_smd_work, a work item drains the FIFO into the ring of the
+ * memory device client, HDLC encoding the packets on the way if hdlc is
+ * set.  Writing "run" to the debugfs file runs the source for duration_ms,
+ * reading it gives the results of the last run: the packets offered, lost
+ * at the FIFO and at the ring, and the rate they reached the ring at.
+ *
+ * Without hdlc, every packet starts with a 32 bit sequence number so a
+ * reader such as tools/diag/diagring can check for gaps.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/kfifo.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/delay.h>
+#include <linux/workqueue.h>
+#include <asm/unaligned.h>
+#include <asm/uaccess.h>
+#include "diagchar.h"
+#include "diagfwd.h"
+#include "diag_debugfs.h"
+#include "diag_ring.h"
+
+#define BENCH_RESULTS_SZ	PAGE_SIZE
+#define BENCH_MAX_PKT		MAX_IN_BUF_SIZE
+#define BENCH_HDLC_OVERHEAD	5
+
+static uint bench_rate_kbps = 40000;
+module_param(bench_rate_kbps, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_pkt_size = 512;
+module_param(bench_pkt_size, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_fifo_size = 8192;
+module_param(bench_fifo_size, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_duration_ms = 5000;
+module_param(bench_duration_ms, uint, S_IRUGO | S_IWUSR);
+
+static uint bench_hdlc;
+module_param(bench_hdlc, uint, S_IRUGO | S_IWUSR);
+
+static struct dentry *bench_dent;
+static DEFINE_MUTEX(bench_lock);
+static char *bench_results;
+static size_t bench_results_len;
+
+static struct workqueue_struct *bench_wq;
+static struct work_struct bench_drain_work;
+static struct kfifo bench_fifo;
+static unsigned char *bench_pkt;
+static unsigned char *bench_scratch;
+static struct diag_smd_info bench_smd_info = {
+	.peripheral = MODEM_DATA,
+};
+
+/* run parameters and counters, fixed for the duration of a run */
+static unsigned int bench_len, bench_encode;
+static unsigned long bench_no_ring, bench_ring_dropped, bench_delivered;
+
+static void bench_drain_work_fn(struct work_struct *work)
+{
+	struct diag_ring *ring = diag_ring_get();
+	void *buf;
+
+	if (!ring) {
+		while (kfifo_out(&bench_fifo, bench_scratch, bench_len))
+			bench_no_ring++;
+		return;
+	}
+
+	mutex_lock(&ring->lock);
+	while (kfifo_len(&bench_fifo) >= bench_len) {
+		if (bench_encode) {
+			kfifo_out(&bench_fifo, bench_scratch, bench_len);
+			if (diag_ring_write_hdlc(ring, &bench_smd_info,
+						 bench_scratch, bench_len))
+				bench_ring_dropped++;
+			else
+				bench_delivered++;
+			continue;
+		}
+
+		buf = diag_ring_reserve(ring, bench_len);
+		if (buf) {
+			kfifo_out(&bench_fifo, buf, bench_len);
+			diag_ring_commit(ring, bench_len, MODEM_DATA);
+			bench_delivered++;
+		} else {
+			kfifo_out(&bench_fifo, bench_scratch, bench_len);
+			bench_ring_dropped++;
+		}
+	}
+	diag_ring_kick(ring);
+	mutex_unlock(&ring->lock);
+
+	diag_ring_put(ring);
+}
+
+/*
+ * Fill in the next packet.  With hdlc it is framed the way peripherals
+ * that leave the encoding to the apps side send it.
+ */
+static void bench_fill(u32 seq)
+{
+	unsigned char *payload = bench_pkt;
+	unsigned int len = bench_len;
+
+	if (bench_encode) {
+		len -= BENCH_HDLC_OVERHEAD;
+		bench_pkt[0] = CONTROL_CHAR;
+		bench_pkt[1] = 1;
+		put_unaligned(len, (u16 *)(bench_pkt + 2));
+		bench_pkt[bench_len - 1] = CONTROL_CHAR;
+		payload += 4;
+	}
+	put_unaligned(seq, (u32 *)payload);
+}
+
+static int bench_run(void)
+{
+	unsigned long offered = 0, fifo_dropped = 0;
+	s64 start, now, end, due, elapsed;
+	u64 bytes = 0, rate;
+	unsigned int i;
+	size_t len;
+
+	bench_len = bench_pkt_size;
+	bench_encode = bench_hdlc;
+	if (bench_len < sizeof(u32) + BENCH_HDLC_OVERHEAD ||
+	    bench_len > BENCH_MAX_PKT || bench_fifo_size > 4 * BENCH_MAX_PKT)
+		return -EINVAL;
+
+	if (kfifo_alloc(&bench_fifo, bench_fifo_size, GFP_KERNEL))
+		return -ENOMEM;
+	if (kfifo_size(&bench_fifo) < bench_len) {
+		kfifo_free(&bench_fifo);
+		return -EINVAL;
+	}
+
+	/* something log-like, with the odd byte that needs escaping */
+	for (i = 0; i < bench_len; i++)
+		bench_pkt[i] = i * 7;
+	bench_no_ring = 0;
+	bench_ring_dropped = 0;
+	bench_delivered = 0;
+
+	start = ktime_to_ns(ktime_get());
+	end = start + (s64)bench_duration_ms * NSEC_PER_MSEC;
+	for (now = start; now < end; now = ktime_to_ns(ktime_get())) {
+		if (bench_rate_kbps) {
+			due = start + div_u64(bytes * 8 * NSEC_PER_MSEC,
+					      bench_rate_kbps);
+			if (due - now > NSEC_PER_MSEC / 10) {
+				usleep_range(div_u64(due - now, NSEC_PER_USEC),
+					     div_u64(due - now, NSEC_PER_USEC)
+					     + 100);
+				continue;
+			}
+		}
+
+		bench_fill(offered);
+		offered++;
+		bytes += bench_len;
+		if (kfifo_avail(&bench_fifo) < bench_len) {
+			fifo_dropped++;
+		} else {
+			kfifo_in(&bench_fifo, bench_pkt, bench_len);
+			queue_work(bench_wq, &bench_drain_work);
+		}
+		if (!bench_rate_kbps)
+			cond_resched();
+	}
+	elapsed = ktime_to_ns(ktime_get()) - start;
+	flush_workqueue(bench_wq);
+	kfifo_free(&bench_fifo);
+
+	rate = div64_u64((u64)bench_delivered * bench_len * NSEC_PER_SEC,
+			 max_t(s64, elapsed, 1));
+	len = scnprintf(bench_results, BENCH_RESULTS_SZ,
+			"pkt_size %u, rate_kbps %u, fifo %u, hdlc %u, %lld ms\n"
+			"offered:      %lu\n"
+			"fifo dropped: %lu\n"
+			"ring dropped: %lu\n"
+			"no ring:      %lu\n"
+			"delivered:    %lu (%llu KB/s)\n",
+			bench_len, bench_rate_kbps, bench_fifo_size,
+			bench_encode, div_s64(elapsed, NSEC_PER_MSEC),
+			offered, fifo_dropped, bench_ring_dropped,
+			bench_no_ring, bench_delivered, div_u64(rate, 1024));
+	bench_results_len = len;
+	return 0;
+}
+
+static ssize_t bench_read(struct file *file, char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&bench_lock);
+	ret = simple_read_from_buffer(buf, count, ppos, bench_results,
+				      bench_results_len);
+	mutex_unlock(&bench_lock);
+	return ret;
+}
+
+static ssize_t bench_write(struct file *file, const char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	char cmd[16];
+	size_t len = min(count, sizeof(cmd) - 1);
+	int ret;
+
+	if (copy_from_user(cmd, buf, len))
+		return -EFAULT;
+	cmd[len] = 0;
+
+	mutex_lock(&bench_lock);
+	if (!strcmp(strim(cmd), "run"))
+		ret = bench_run();
+	else
+		ret = -EINVAL;
+	mutex_unlock(&bench_lock);
+	return ret < 0 ? ret : count;
+}
+
+static const struct file_operations bench_ops = {
+	.owner = THIS_MODULE,
+	.read = bench_read,
+	.write = bench_write,
+};
+
+void diag_ring_bench_init(void)
+{
+	bench_results = kzalloc(BENCH_RESULTS_SZ, GFP_KERNEL);
+	bench_pkt = kmalloc(BENCH_MAX_PKT, GFP_KERNEL);
+	bench_scratch = kmalloc(BENCH_MAX_PKT, GFP_KERNEL);
+	bench_wq = create_singlethread_workqueue("diag_ring_bench");
+	if (!bench_results || !bench_pkt || !bench_scratch || !bench_wq)
+		goto fail;
+	INIT_WORK(&bench_drain_work, bench_drain_work_fn);
+
+	if (IS_ERR_OR_NULL(diag_dbgfs_dent))
+		goto fail;
+	bench_dent = debugfs_create_file("ring_bench", 0644,
+					 diag_dbgfs_dent, NULL, &bench_ops);
+	if (IS_ERR_OR_NULL(bench_dent)) {
+		pr_err("diag: %s, unable to create debugfs\n", __func__);
+		goto fail;
+	}
+	return;
+
+fail:
+	bench_dent = NULL;
+	diag_ring_bench_exit();
+}
+
+void diag_ring_bench_exit(void)
+{
+	debugfs_remove(bench_dent);
+	bench_dent = NULL;
+	if (bench_wq)
+		destroy_workqueue(bench_wq);
+	bench_wq = NULL;
+	kfree(bench_scratch);
+	bench_scratch = NULL;
+	kfree(bench_pkt);
+	bench_pkt = NULL;
+	kfree(bench_results);
+	bench_results = NULL;
+}
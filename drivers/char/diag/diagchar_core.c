@@ -22,6 +22,7 @@
 #include <linux/platform_device.h>
 #include <linux/sched.h>
 #include <linux/ratelimit.h>
+#include <linux/log2.h>
 #ifdef CONFIG_DIAG_OVER_USB
 #include <mach/usbdiag.h>
 #endif
@@ -32,6 +33,7 @@
 #include "diagfwd.h"
 #include "diagfwd_cntl.h"
 #include "diag_dci.h"
+#include "diag_ring.h"
 #ifdef CONFIG_DIAG_SDIO_PIPE
 #include "diagfwd_sdio.h"
 #endif
@@ -57,6 +59,7 @@ MODULE_VERSION("1.0");
 struct diagchar_dev *driver;
 struct diagchar_priv {
 	int pid;
+	struct diag_ring *ring;
 };
  
 static unsigned int itemsize = 4096; 
@@ -330,8 +333,10 @@ void diag_add_client(int i, struct file *file)
 	driver->client_map[i].pid = current->tgid;
 	diagpriv_data = kmalloc(sizeof(struct diagchar_priv),
 							GFP_KERNEL);
-	if (diagpriv_data)
+	if (diagpriv_data) {
 		diagpriv_data->pid = current->tgid;
+		diagpriv_data->ring = NULL;
+	}
 	file->private_data = diagpriv_data;
 	strlcpy(driver->client_map[i].name, current->comm, 20);
 	driver->client_map[i].name[19] = '\0';
@@ -428,6 +433,12 @@ static int diag_remove_client_entry(struct file *file)
 
 	diagpriv_data = file->private_data;
 
+	if (diagpriv_data->ring) {
+		diag_ring_detach(diagpriv_data->ring);
+		diag_ring_put(diagpriv_data->ring);
+		diagpriv_data->ring = NULL;
+	}
+
 	diag_dci_deinit_client();
 	
 	mutex_lock(&driver->diagchar_mutex);
@@ -1136,6 +1147,38 @@ int diag_switch_logging(unsigned long ioarg)
 	return success;
 }
 
+static int diagchar_ring_init(struct file *file, unsigned int size)
+{
+	struct diagchar_priv *diagpriv_data = file->private_data;
+	struct diag_ring *ring;
+	int err;
+
+	if (!diagpriv_data)
+		return -EINVAL;
+	if (size < PAGE_SIZE || size > DIAG_RING_MAX_SIZE ||
+	    !is_power_of_2(size))
+		return -EINVAL;
+
+	mutex_lock(&driver->diagchar_mutex);
+	if (diagpriv_data->ring) {
+		err = -EBUSY;
+		goto out;
+	}
+	ring = diag_ring_create(size);
+	if (!ring) {
+		err = -ENOMEM;
+		goto out;
+	}
+	err = diag_ring_attach(ring);
+	if (err)
+		diag_ring_put(ring);
+	else
+		diagpriv_data->ring = ring;
+out:
+	mutex_unlock(&driver->diagchar_mutex);
+	return err;
+}
+
 long diagchar_ioctl(struct file *filp,
 			   unsigned int iocmd, unsigned long ioarg)
 {
@@ -1317,7 +1360,9 @@ long diagchar_ioctl(struct file *filp,
 
 		result = 1;
 		break;
-
+	case DIAG_IOCTL_RING_INIT:
+		result = diagchar_ring_init(filp, (unsigned int)ioarg);
+		break;
 	}
 	return result;
 }
@@ -2490,10 +2535,43 @@ int mask_request_validate(unsigned char mask_buf[])
 	return 0;
 }
 
+static unsigned int diagchar_poll(struct file *file, poll_table *wait)
+{
+	struct diagchar_priv *diagpriv_data = file->private_data;
+	struct diag_ring *ring;
+	unsigned int mask = 0;
+	int i;
+
+	if (!diagpriv_data)
+		return POLLERR;
+
+	poll_wait(file, &driver->wait_q, wait);
+	for (i = 0; i < driver->num_clients; i++)
+		if (driver->client_map[i].pid == diagpriv_data->pid &&
+		    driver->data_ready[i])
+			mask |= POLLIN | POLLRDNORM;
+
+	ring = ACCESS_ONCE(diagpriv_data->ring);
+	if (ring)
+		mask |= diag_ring_poll(ring, file, wait);
+	return mask;
+}
+
+static int diagchar_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct diagchar_priv *diagpriv_data = file->private_data;
+
+	if (!diagpriv_data || !diagpriv_data->ring)
+		return -ENODEV;
+	return diag_ring_mmap(diagpriv_data->ring, vma);
+}
+
 static const struct file_operations diagcharfops = {
 	.owner = THIS_MODULE,
 	.read = diagchar_read,
 	.write = diagchar_write,
+	.poll = diagchar_poll,
+	.mmap = diagchar_mmap,
 	.unlocked_ioctl = diagchar_ioctl,
 	.open = diagchar_open,
 	.release = diagchar_close
@@ -2675,6 +2753,7 @@ static int __init diagchar_init(void)
 		INIT_WORK(&(driver->diag_drain_work), diag_drain_work_fn);
 		diag_real_time_info_init();
 		diag_debugfs_init();
+		diag_ring_bench_init();
 		diag_masks_init();
 		diagfwd_init();
 #ifdef CONFIG_DIAGFWD_BRIDGE_CODE
@@ -2732,6 +2811,7 @@ static int __init diagchar_init(void)
 	return 0;
 
 fail:
+	diag_ring_bench_exit();
 	diag_debugfs_cleanup();
 	diagchar_cleanup();
 	diagfwd_exit();
@@ -2753,6 +2833,7 @@ static void diagchar_exit(void)
 	diag_masks_exit();
 	diag_sdio_fn(EXIT);
 	diagfwd_bridge_fn(EXIT);
+	diag_ring_bench_exit();
 	diag_debugfs_cleanup();
 	diagchar_cleanup();
 	printk(KERN_INFO "done diagchar exit\n");
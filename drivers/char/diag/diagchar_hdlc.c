@@ -20,6 +20,8 @@
 #include <linux/uaccess.h>
 #include <linux/ratelimit.h>
 #include <linux/crc-ccitt.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
 #include "diagchar_hdlc.h"
 #include "diagchar.h"
 
@@ -31,6 +33,37 @@ MODULE_LICENSE("GPL v2");
 #define CRC_16_L_STEP(xx_crc, xx_c) \
 	crc_ccitt_byte(xx_crc, xx_c)
 
+#define HDLC_REPEAT_BYTE(x)	((~0UL / 0xff) * (x))
+#define HDLC_HAS_BYTE(v, x) \
+	((((v) ^ HDLC_REPEAT_BYTE(x)) - HDLC_REPEAT_BYTE(0x01)) & \
+	 ~((v) ^ HDLC_REPEAT_BYTE(x)) & HDLC_REPEAT_BYTE(0x80))
+
+/*
+ * Length of the run of bytes at @src, at most @len, that go through HDLC
+ * unchanged. Once @src is aligned the bytes are tested a word at a time.
+ */
+static unsigned int diag_hdlc_plain_run(const uint8_t *src, unsigned int len)
+{
+	const uint8_t *p = src, *end = src + len;
+	unsigned long v;
+
+	while (p < end && ((unsigned long)p & (sizeof(long) - 1))) {
+		if (*p == CONTROL_CHAR || *p == ESC_CHAR)
+			return p - src;
+		p++;
+	}
+
+	for (; end - p >= sizeof(long); p += sizeof(long)) {
+		v = *(const unsigned long *)p;
+		if (HDLC_HAS_BYTE(v, CONTROL_CHAR) | HDLC_HAS_BYTE(v, ESC_CHAR))
+			break;
+	}
+
+	while (p < end && *p != CONTROL_CHAR && *p != ESC_CHAR)
+		p++;
+	return p - src;
+}
+
 void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 		      struct diag_hdlc_dest_type *enc)
 {
@@ -42,6 +75,7 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 	unsigned char src_byte = 0;
 	enum diag_send_state_enum_type state;
 	unsigned int used = 0;
+	unsigned int run;
 
 	if (src_desc && enc) {
 
@@ -67,34 +101,35 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 			   of 2 dest bytes for an escaped byte */
 			while (src <= src_last && dest <= dest_last) {
 
-				src_byte = *src++;
-
-				if ((src_byte == CONTROL_CHAR) ||
-				    (src_byte == ESC_CHAR)) {
-
-					/* If the escape character is not the
-					   last byte */
-					if (dest != dest_last) {
-						crc = CRC_16_L_STEP(crc,
-								    src_byte);
+				src_byte = *src;
+
+				if ((src_byte != CONTROL_CHAR) &&
+				    (src_byte != ESC_CHAR)) {
+					/* Copy up to the next byte to escape */
+					run = diag_hdlc_plain_run(src,
+						min(src_last - src,
+						    dest_last - dest) + 1);
+					memcpy(dest, src, run);
+					crc = crc_ccitt(crc, src, run);
+					src += run;
+					dest += run;
+					used += run;
+					continue;
+				}
 
-						*dest++ = ESC_CHAR;
-						used++;
+				/* If the escape character is not the
+				   last byte */
+				if (dest == dest_last)
+					break;
 
-						*dest++ = src_byte
-							  ^ ESC_MASK;
-						used++;
-					} else {
+				src++;
+				crc = CRC_16_L_STEP(crc, src_byte);
 
-						src--;
-						break;
-					}
+				*dest++ = ESC_CHAR;
+				used++;
 
-				} else {
-					crc = CRC_16_L_STEP(crc, src_byte);
-					*dest++ = src_byte;
-					used++;
-				}
+				*dest++ = src_byte ^ ESC_MASK;
+				used++;
 			}
 
 			if (src > src_last) {
@@ -170,7 +205,8 @@ int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc)
 	unsigned int src_length = 0, dest_length = 0;
 
 	unsigned int len = 0;
-	unsigned int i;
+	unsigned int i = 0;
+	unsigned int run;
 	uint8_t src_byte;
 
 	int pkt_bnd = 0;
@@ -190,13 +226,24 @@ int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc)
 		dest_ptr = &dest_ptr[hdlc->dest_idx];
 		dest_length = hdlc->dest_size - hdlc->dest_idx;
 
-		for (i = 0; i < src_length; i++) {
+		/* The escape was the last byte of the previous chunk */
+		if (hdlc->escaping) {
+			dest_ptr[len++] = src_ptr[i++] ^ ESC_MASK;
+			hdlc->escaping = 0;
+		}
+
+		while (i < src_length && len < dest_length) {
 
 			src_byte = src_ptr[i];
 
-			if (hdlc->escaping) {
-				dest_ptr[len++] = src_byte ^ ESC_MASK;
-				hdlc->escaping = 0;
+			if ((src_byte != CONTROL_CHAR) &&
+			    (src_byte != ESC_CHAR)) {
+				/* Copy up to the next escaped byte */
+				run = diag_hdlc_plain_run(&src_ptr[i],
+					min(src_length - i, dest_length - len));
+				memcpy(&dest_ptr[len], &src_ptr[i], run);
+				i += run;
+				len += run;
 			} else if (src_byte == ESC_CHAR) {
 				if (i == (src_length - 1)) {
 					hdlc->escaping = 1;
@@ -205,23 +252,19 @@ int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc)
 				} else {
 					dest_ptr[len++] = src_ptr[++i]
 							  ^ ESC_MASK;
+					i++;
 				}
-			} else if (src_byte == CONTROL_CHAR) {
-				if (msg_start && i == 0 && src_length > 1)
+			} else {
+				if (msg_start && i == 0 && src_length > 1) {
+					i++;
 					continue;
+				}
 				/* Byte 0x7E will be considered
 					as end of packet */
 				dest_ptr[len++] = src_byte;
 				i++;
 				pkt_bnd = 1;
 				break;
-			} else {
-				dest_ptr[len++] = src_byte;
-			}
-
-			if (len >= dest_length) {
-				i++;
-				break;
 			}
 		}
 
@@ -42,6 +42,7 @@
 #include "diag_dci.h"
 #include "diag_masks.h"
 #include "diagfwd_bridge.h"
+#include "diag_ring.h"
 
 #define STM_CMD_VERSION_OFFSET	4
 #define STM_CMD_MASK_OFFSET	5
@@ -598,6 +599,126 @@ static int diag_smd_resize_buf(struct diag_smd_info *smd_info, void **buf,
 	return success;
 }
 
+/*
+ * Read the pkt_len byte packet at the head of the channel, the first len
+ * bytes of it into buf and the rest, or all of it if buf is NULL, into
+ * the bit bucket.  Waits for the remote side to write the rest of a
+ * partial packet.  Returns -ENODEV if the channel goes away meanwhile.
+ */
+static int diag_smd_read_pkt(struct diag_smd_info *smd_info, void *buf,
+			     int len, int pkt_len)
+{
+	int total_recd = 0, r;
+
+	while (total_recd < pkt_len) {
+		r = smd_read_avail(smd_info->ch);
+		if (!r) {
+			wait_event(driver->smd_wait_q,
+				((smd_info->ch == 0) ||
+				smd_read_avail(smd_info->ch)));
+			if (!smd_info->ch)
+				return -ENODEV;
+			continue;
+		}
+
+		r = min(r, pkt_len - total_recd);
+		if (buf && total_recd < len) {
+			r = min(r, len - total_recd);
+			smd_read(smd_info->ch, buf + total_recd, r);
+		} else {
+			smd_read(smd_info->ch, NULL, r);
+		}
+		total_recd += r;
+	}
+
+	return total_recd;
+}
+
+/*
+ * HDLC encode the total_recd bytes of raw peripheral data in buf straight
+ * into the next record of the ring.  Called with ring->lock held.
+ */
+int diag_ring_write_hdlc(struct diag_ring *ring,
+			 struct diag_smd_info *smd_info, void *buf,
+			 int total_recd)
+{
+	int write_length = 2 * total_recd + 3;
+	void *write_buf;
+
+	write_buf = diag_ring_reserve(ring, write_length);
+	if (!write_buf)
+		return -ENOSPC;
+
+	if (!diag_add_hdlc_encoding(smd_info, buf, total_recd, write_buf,
+				    &write_length))
+		return -EBADMSG;
+
+	diag_ring_commit(ring, write_length, smd_info->peripheral);
+	return 0;
+}
+
+/*
+ * In memory device mode with a client ring, move every packet waiting on
+ * the channel into the ring: read it in place, or HDLC encode it there
+ * from buf_in_1_raw if the apps side does the encoding.  Nothing is left
+ * in buf_in_1/2 for read() to copy out and the channel is drained in one
+ * go instead of two packets at a time.  Returns 0 if the data has to take
+ * the legacy path.
+ */
+static int diag_smd_read_to_ring(struct diag_smd_info *smd_info)
+{
+	struct diag_ring *ring;
+	void *buf;
+	unsigned int buf_size;
+	int pkt_len, len;
+
+	if (driver->logging_mode != MEMORY_DEVICE_MODE)
+		return 0;
+	if (smd_info->type != SMD_DATA_TYPE &&
+	    (smd_info->type != SMD_CMD_TYPE ||
+	     !driver->separate_cmdrsp[smd_info->peripheral]))
+		return 0;
+	/* buf_in_1_raw still waits for read() from before the ring */
+	if (smd_info->encode_hdlc && smd_info->in_busy_1)
+		return 0;
+
+	ring = diag_ring_get();
+	if (!ring)
+		return 0;
+
+	mutex_lock(&ring->lock);
+	while (smd_info->ch) {
+		pkt_len = smd_cur_packet_size(smd_info->ch);
+		if (!pkt_len)
+			break;
+
+		if (smd_info->encode_hdlc) {
+			buf = smd_info->buf_in_1_raw;
+			buf_size = smd_info->buf_in_1_raw_size;
+			if (pkt_len > buf_size)
+				diag_smd_resize_buf(smd_info, &buf, &buf_size,
+						    pkt_len);
+			len = min_t(int, pkt_len, buf_size);
+			if (diag_smd_read_pkt(smd_info, buf, len, pkt_len) < 0)
+				break;
+			diag_ring_write_hdlc(ring, smd_info, buf, len);
+		} else {
+			buf = diag_ring_reserve(ring, pkt_len);
+			if (diag_smd_read_pkt(smd_info, buf, pkt_len,
+					      pkt_len) < 0)
+				break;
+			if (buf)
+				diag_ring_commit(ring, pkt_len,
+						 smd_info->peripheral);
+		}
+	}
+	diag_ring_kick(ring);
+	mutex_unlock(&ring->lock);
+
+	diag_ring_put(ring);
+	return 1;
+}
+
 void diag_smd_send_req(struct diag_smd_info *smd_info)
 {
 	void *buf = NULL, *temp_buf = NULL;
@@ -615,6 +736,9 @@ void diag_smd_send_req(struct diag_smd_info *smd_info)
 			__func__);
 		return;
 	}
+
+	if (diag_smd_read_to_ring(smd_info))
+		return;
 	
 	if (smd_info->type == SMD_DATA_TYPE) {
 		if (smd_info->in_busy_1 && smd_info->in_busy_2) {
@@ -841,10 +965,19 @@ static int diag_write_to_usb(struct usb_diag_ch *ch,
 int diag_device_write(void *buf, int data_type, struct diag_request *write_ptr)
 {
 	int i, err = 0, index;
+	struct diag_ring *ring;
 	index = 0;
 
 	if (driver->logging_mode == MEMORY_DEVICE_MODE) {
 		if (data_type == APPS_DATA) {
+			ring = diag_ring_get();
+			if (ring) {
+				diag_ring_write(ring, buf, driver->used,
+						APPS_DATA);
+				diag_ring_put(ring);
+				diagmem_free(driver, buf, POOL_TYPE_HDLC);
+				return 0;
+			}
 			for (i = 0; i < driver->buf_tbl_size; i++)
 				if (driver->buf_tbl[i].length == 0) {
 					driver->buf_tbl[i].buf = buf;
@@ -19,6 +19,8 @@
 #define RESET_AND_NO_QUEUE 0
 #define RESET_AND_QUEUE 1
 
+struct diag_ring;
+
 #define CHK_OVERFLOW(bufStart, start, end, length) \
 	((((bufStart) <= (start)) && ((end) - (start) >= (length)) && (length > 0)) ? 1 : 0)
 
@@ -56,6 +58,12 @@ void diag_reset_smd_data(int queue);
 int diag_apps_responds(void);
 void diag_update_pkt_buffer(unsigned char *buf, int type);
 int diag_process_stm_cmd(unsigned char *buf, unsigned char *dest_buf);
+int diag_add_hdlc_encoding(struct diag_smd_info *smd_info, void *buf,
+			   int total_recd, uint8_t *encode_buf,
+			   int *encoded_length);
+int diag_ring_write_hdlc(struct diag_ring *ring,
+			 struct diag_smd_info *smd_info, void *buf,
+			 int total_recd);
 #ifdef CONFIG_DIAG_OVER_USB
 int diagfwd_connect(void);
 int diagfwd_disconnect(void);
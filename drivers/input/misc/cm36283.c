@@ -2072,6 +2072,7 @@ static struct i2c_driver cm36283_driver = {
 	.driver = {
 		.name = CM36283_I2C_NAME,
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.pm = &cm36283_pm,
 		.of_match_table = cm36283_match_table,
 	},
@@ -1026,6 +1026,7 @@ static struct i2c_driver kxtj9_driver = {
 	.driver = {
 		.name	= DEVICE_NAME,
 		.owner	= THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = kxtj9_match_table,
 		.pm	= &kxtj9_pm_ops,
 	},
@@ -980,6 +980,7 @@ static struct i2c_driver mpu3050_i2c_driver = {
 	.driver	= {
 		.name	= "mpu3050",
 		.owner	= THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.pm	= &mpu3050_pm,
 		.of_match_table = mpu3050_of_match,
 	},
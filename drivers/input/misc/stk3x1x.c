@@ -2559,6 +2559,7 @@ static struct i2c_driver stk_ps_driver =
     .driver = {
         .name = DEVICE_NAME,
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = stk_match_table,
     },
     .probe = stk3x1x_probe,
@@ -1777,6 +1777,7 @@ static struct slim_driver sitar_slim_driver = {
 	.driver = {
 		.name = "sitar-slim",
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = wcd9xxx_slim_probe,
 	.remove = wcd9xxx_slim_remove,
@@ -1793,6 +1794,7 @@ static struct slim_driver sitar1p1_slim_driver = {
 	.driver = {
 		.name = "sitar1p1-slim",
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = wcd9xxx_slim_probe,
 	.remove = wcd9xxx_slim_remove,
@@ -1810,6 +1812,7 @@ static struct slim_driver tabla_slim_driver = {
 	.driver = {
 		.name = "tabla-slim",
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = wcd9xxx_slim_probe,
 	.remove = wcd9xxx_slim_remove,
@@ -1827,6 +1830,7 @@ static struct slim_driver tabla2x_slim_driver = {
 	.driver = {
 		.name = "tabla2x-slim",
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = wcd9xxx_slim_probe,
 	.remove = wcd9xxx_slim_remove,
@@ -1844,6 +1848,7 @@ static struct slim_driver taiko_slim_driver = {
 	.driver = {
 		.name = "taiko-slim",
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = wcd9xxx_slim_probe,
 	.remove = wcd9xxx_slim_remove,
@@ -1864,6 +1869,7 @@ static struct slim_driver tapan_slim_driver = {
 	.driver = {
 		.name = "tapan-slim",
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = wcd9xxx_slim_probe,
 	.remove = wcd9xxx_slim_remove,
@@ -6971,6 +6971,7 @@ static struct platform_driver msmsdcc_driver = {
 	.remove		= msmsdcc_remove,
 	.driver		= {
 		.name	= "msm_sdcc",
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.pm	= &msmsdcc_dev_pm_ops,
 		.of_match_table = msmsdcc_dt_match,
 	},
@@ -866,6 +866,7 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 	u32			trbs_left;
 	u32			max;
 	unsigned int		last_one = 0;
+	unsigned int		start_slot;
 
 	BUILD_BUG_ON_NOT_POWER_OF_2(DWC3_TRB_NUM);
 
@@ -896,6 +897,7 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 	if ((trbs_left <= 1) && usb_endpoint_xfer_isoc(dep->endpoint.desc))
 		return;
 
+	start_slot = dep->free_slot;
 	list_for_each_entry_safe(req, n, &dep->request_list, list) {
 		unsigned	length;
 		dma_addr_t	dma;
@@ -904,8 +906,27 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 			struct usb_request *request = &req->request;
 			struct scatterlist *sg = request->sg;
 			struct scatterlist *s;
+			struct dwc3_trb	*trb;
 			int		i;
 
+			/*
+			 * Leave a request that does not fit behind the ones
+			 * already prepared for the next transfer, rather than
+			 * cut it short at the last TRB.  The TRB prepared
+			 * last in this pass then has to end the transfer, or
+			 * no XferComplete would come to kick the endpoint.
+			 */
+			if (request->num_mapped_sgs > trbs_left &&
+					!list_empty(&dep->req_queued)) {
+				if (dep->free_slot != start_slot &&
+				    !usb_endpoint_xfer_isoc(dep->endpoint.desc)) {
+					trb = &dep->trb_pool[(dep->free_slot - 1)
+							& DWC3_TRB_MASK];
+					trb->ctrl |= DWC3_TRB_CTRL_LST;
+				}
+				break;
+			}
+
 			for_each_sg(sg, s, request->num_mapped_sgs, i) {
 				unsigned chain = true;
 
@@ -2655,6 +2676,8 @@ int __devinit dwc3_gadget_init(struct dwc3 *dwc)
 	dwc->gadget.speed		= USB_SPEED_UNKNOWN;
 	dwc->gadget.dev.parent		= dwc->dev;
 	dwc->gadget.sg_supported	= true;
+	/* a request is started in one transfer, one TRB per entry */
+	dwc->gadget.max_sgs		= DWC3_TRB_NUM - 1;
 
 	dma_set_coherent_mask(&dwc->gadget.dev, dwc->dev->coherent_dma_mask);
 
@@ -980,6 +980,7 @@ static int dummy_udc_probe(struct platform_device *pdev)
 	dum->gadget.name = gadget_name;
 	dum->gadget.ops = &dummy_ops;
 	dum->gadget.max_speed = USB_SPEED_SUPER;
+	dum->gadget.sg_supported = 1;
 
 	dev_set_name(&dum->gadget.dev, "gadget");
 	dum->gadget.dev.parent = &pdev->dev;
@@ -1232,6 +1233,32 @@ static int dummy_urb_dequeue(struct usb_hcd *hcd, struct urb *urb, int status)
 	return rc;
 }
 
+/* copy len bytes between buf and the scatterlist of req, offset bytes in */
+static void dummy_copy_req_sg(struct dummy_request *req, u32 offset,
+		void *buf, u32 len, bool to_req)
+{
+	struct sg_mapping_iter miter;
+	u32 n;
+
+	sg_miter_start(&miter, req->req.sg, req->req.num_sgs, SG_MITER_ATOMIC |
+			(to_req ? SG_MITER_TO_SG : SG_MITER_FROM_SG));
+	while (len && sg_miter_next(&miter)) {
+		if (offset >= miter.length) {
+			offset -= miter.length;
+			continue;
+		}
+		n = min_t(u32, len, miter.length - offset);
+		if (to_req)
+			memcpy(miter.addr + offset, buf, n);
+		else
+			memcpy(buf, miter.addr + offset, n);
+		buf += n;
+		len -= n;
+		offset = 0;
+	}
+	sg_miter_stop(&miter);
+}
+
 static int dummy_perform_transfer(struct urb *urb, struct dummy_request *req,
 		u32 len)
 {
@@ -1248,7 +1275,10 @@ static int dummy_perform_transfer(struct urb *urb, struct dummy_request *req,
 
 	if (!urb->num_sgs) {
 		ubuf = urb->transfer_buffer + urb->actual_length;
-		if (to_host)
+		if (req->req.num_sgs)
+			dummy_copy_req_sg(req, req->req.actual, ubuf, len,
+					!to_host);
+		else if (to_host)
 			memcpy(ubuf, rbuf, len);
 		else
 			memcpy(rbuf, ubuf, len);
@@ -1275,12 +1305,15 @@ static int dummy_perform_transfer(struct urb *urb, struct dummy_request *req,
 		ubuf = miter->addr;
 		this_sg = min_t(u32, len, miter->length);
 		miter->consumed = this_sg;
-		trans += this_sg;
 
-		if (to_host)
+		if (req->req.num_sgs)
+			dummy_copy_req_sg(req, req->req.actual + trans, ubuf,
+					this_sg, !to_host);
+		else if (to_host)
 			memcpy(ubuf, rbuf, this_sg);
 		else
 			memcpy(rbuf, ubuf, this_sg);
+		trans += this_sg;
 		len -= this_sg;
 
 		if (!len)
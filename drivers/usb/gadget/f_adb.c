@@ -35,6 +35,29 @@
 #define ADB_BULK_BUFFER_SIZE           4096
 
 #define TX_REQ_MAX 4
+#define RX_REQ_MAX 4
+#define ADB_REQ_MAX_DEPTH 32
+
+/*
+ * Bulk request sizes and queue depths, taken when the function is bound.
+ * Sizes are rounded down to a multiple of 1024 and halved down to
+ * ADB_BULK_BUFFER_SIZE while the requests cannot be allocated.
+ */
+static unsigned int adb_tx_req_len = ADB_BULK_BUFFER_SIZE;
+module_param(adb_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_tx_req_len, "Size of the ADB IN requests");
+
+static unsigned int adb_rx_req_len = ADB_BULK_BUFFER_SIZE;
+module_param(adb_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_req_len, "Size of the ADB OUT requests");
+
+static unsigned int adb_tx_reqs = TX_REQ_MAX;
+module_param(adb_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_tx_reqs, "Number of ADB IN requests");
+
+static unsigned int adb_rx_reqs = RX_REQ_MAX;
+module_param(adb_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_reqs, "Number of ADB OUT requests");
 
 static const char adb_shortname[] = "android_adb";
 
@@ -54,11 +77,19 @@ struct adb_dev {
 	atomic_t open_excl;
 
 	struct list_head tx_idle;
+	struct list_head rx_idle;
+	struct list_head rx_busy;
+	struct list_head rx_done;
+
+	unsigned int tx_req_len;
+	unsigned int rx_req_len;
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
+
+	/* completed OUT request being copied out, and how far */
 	struct usb_request *rx_req;
-	int rx_done;
+	unsigned int rx_offset;
 	int read_err;
 	int write_err;
 };
@@ -254,8 +285,8 @@ static void adb_complete_in(struct usb_ep *ep, struct usb_request *req)
 static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
+	unsigned long flags;
 
-	dev->rx_done = 1;
 	if (req->status != 0 && req->status != -ECONNRESET)
 		atomic_set(&dev->error, 1);
 
@@ -263,17 +294,54 @@ static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 		if (req->status != -ESHUTDOWN)
 			printk(KERN_INFO "[USB] %s: warning (%d)\n", __func__, req->status);
 	}
+
+	spin_lock_irqsave(&dev->lock, flags);
+	list_move_tail(&req->list, req->status ? &dev->rx_idle : &dev->rx_done);
+	spin_unlock_irqrestore(&dev->lock, flags);
 	wake_up(&dev->read_wq);
 }
 
+static unsigned int adb_req_len(unsigned int len)
+{
+	return max_t(unsigned int, rounddown(len, 1024), ADB_BULK_BUFFER_SIZE);
+}
+
+/*
+ * Allocate nr requests of *len bytes onto head, halving *len while that
+ * fails and it is larger than ADB_BULK_BUFFER_SIZE.
+ */
+static int adb_alloc_requests(struct adb_dev *dev, struct usb_ep *ep,
+		struct list_head *head, unsigned int nr, unsigned int *len,
+		void (*complete)(struct usb_ep *, struct usb_request *))
+{
+	struct usb_request *req;
+	unsigned int i;
+
+	for (;;) {
+		for (i = 0; i < nr; i++) {
+			req = adb_request_new(ep, *len);
+			if (!req)
+				break;
+			req->complete = complete;
+			adb_req_put(dev, head, req);
+		}
+		if (i == nr)
+			return 0;
+
+		while ((req = adb_req_get(dev, head)))
+			adb_request_free(req, ep);
+		if (*len <= ADB_BULK_BUFFER_SIZE)
+			return -ENOMEM;
+		*len = adb_req_len(*len / 2);
+	}
+}
+
 static int adb_create_bulk_endpoints(struct adb_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc)
 {
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *req;
 	struct usb_ep *ep;
-	int i;
 
 	DBG(cdev, "create_bulk_endpoints dev: %p\n", dev);
 
@@ -296,19 +364,18 @@ static int adb_create_bulk_endpoints(struct adb_dev *dev,
 	dev->ep_out = ep;
 
 	
-	req = adb_request_new(dev->ep_out, ADB_BULK_BUFFER_SIZE);
-	if (!req)
+	dev->rx_req_len = adb_req_len(adb_rx_req_len);
+	if (adb_alloc_requests(dev, dev->ep_out, &dev->rx_idle,
+			clamp_t(unsigned int, adb_rx_reqs, 1, ADB_REQ_MAX_DEPTH),
+			&dev->rx_req_len, adb_complete_out))
 		goto fail;
-	req->complete = adb_complete_out;
-	dev->rx_req = req;
-
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, ADB_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
-		req->complete = adb_complete_in;
-		adb_req_put(dev, &dev->tx_idle, req);
-	}
+	dev->tx_req_len = adb_req_len(adb_tx_req_len);
+	if (adb_alloc_requests(dev, dev->ep_in, &dev->tx_idle,
+			clamp_t(unsigned int, adb_tx_reqs, 1, ADB_REQ_MAX_DEPTH),
+			&dev->tx_req_len, adb_complete_in))
+		goto fail;
+	DBG(cdev, "%s: rx %u, tx %u\n", __func__, dev->rx_req_len,
+			dev->tx_req_len);
 
 	return 0;
 
@@ -317,15 +384,81 @@ fail:
 	return -1;
 }
 
+/*
+ * Queue OUT requests for the next len bytes, as many as are idle.  adb
+ * does not end its transfers with a ZLP, so a request may only be longer
+ * than what is left of them if that ends short in it.
+ */
+static int adb_queue_rx(struct adb_dev *dev, size_t len)
+{
+	struct usb_request *req;
+	int ret;
+
+	while (len > 0 && (req = adb_req_get(dev, &dev->rx_idle))) {
+		if (len < dev->rx_req_len && len % 512 == 0)
+			req->length = len;
+		else
+			req->length = dev->rx_req_len;
+		len -= min_t(size_t, len, req->length);
+
+		adb_req_put(dev, &dev->rx_busy, req);
+		ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+		if (ret < 0) {
+			pr_debug("adb_read: failed to queue req %p (%d)\n",
+					req, ret);
+			spin_lock_irq(&dev->lock);
+			list_move_tail(&req->list, &dev->rx_idle);
+			spin_unlock_irq(&dev->lock);
+			return ret;
+		}
+		pr_debug("rx %p queue\n", req);
+	}
+	return 0;
+}
+
+/* Dequeue the OUT requests in flight, the caller being the only reader */
+static void adb_rx_cancel(struct adb_dev *dev)
+{
+	struct usb_request *reqs[ADB_REQ_MAX_DEPTH], *req;
+	int i, n = 0;
+
+	spin_lock_irq(&dev->lock);
+	list_for_each_entry(req, &dev->rx_busy, list)
+		reqs[n++] = req;
+	spin_unlock_irq(&dev->lock);
+
+	for (i = 0; i < n; i++)
+		usb_ep_dequeue(dev->ep_out, reqs[i]);
+}
+
+/* Drop what was received and not read */
+static void adb_rx_flush(struct adb_dev *dev)
+{
+	struct usb_request *req;
+
+	adb_rx_cancel(dev);
+	if (dev->rx_req) {
+		adb_req_put(dev, &dev->rx_idle, dev->rx_req);
+		dev->rx_req = NULL;
+	}
+	while ((req = adb_req_get(dev, &dev->rx_done)))
+		adb_req_put(dev, &dev->rx_idle, req);
+}
+
 static int bugreport_debug;
 static void adb_read_timeout(void);
 
+/*
+ * OUT data is a stream: the requests for a read are queued together and
+ * copied out as they complete, what a read does not take is left for the
+ * next one.  A short packet ends a read.
+ */
 static ssize_t adb_read(struct file *fp, char __user *buf,
 				size_t count, loff_t *pos)
 {
 	struct adb_dev *dev = fp->private_data;
 	struct usb_request *req;
-	int r = count, xfer;
+	int r = 0, xfer;
 	int ret;
 
 	pr_debug("adb_read(%d)\n", count);
@@ -335,11 +468,6 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 		return -ENODEV;
 	}
 
-	if (count > ADB_BULK_BUFFER_SIZE) {
-		_adb_dev->read_err = 1;
-		return -EINVAL;
-	}
-
 	if (adb_lock(&dev->read_excl)) {
 		_adb_dev->read_err = 2;
 		return -EBUSY;
@@ -363,65 +491,81 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 		goto done;
 	}
 
-requeue_req:
-	
-	req = dev->rx_req;
-
-	if (count % 512 == 0)
-		req->length = count;
-	else
-		req->length = ADB_BULK_BUFFER_SIZE;
-	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
-	if (ret < 0) {
-		pr_debug("adb_read: failed to queue req %p (%d)\n", req, ret);
-		r = -EIO;
-		atomic_set(&dev->error, 1);
-		_adb_dev->read_err = 5;
-		goto done;
-	} else {
-		pr_debug("rx %p queue\n", req);
-	}
+	while (r < count) {
+		req = dev->rx_req;
+		if (!req) {
+			req = adb_req_get(dev, &dev->rx_done);
+			/* a ZLP ends nothing here */
+			if (req && req->actual == 0) {
+				adb_req_put(dev, &dev->rx_idle, req);
+				continue;
+			}
+			dev->rx_req = req;
+			dev->rx_offset = 0;
+		}
 
-	
-	ret = wait_event_interruptible(dev->read_wq, dev->rx_done ||
+		if (req) {
+			pr_debug("rx %p %d\n", req, req->actual);
+			xfer = min_t(size_t, req->actual - dev->rx_offset,
+					count - r);
+			if (copy_to_user(buf + r, req->buf + dev->rx_offset,
+					xfer)) {
+				r = -EFAULT;
+				_adb_dev->read_err = 9;
+				goto done;
+			}
+			r += xfer;
+			dev->rx_offset += xfer;
+			if (dev->rx_offset < req->actual)
+				break;
+
+			dev->rx_req = NULL;
+			adb_req_put(dev, &dev->rx_idle, req);
+			if (req->actual < req->length)
+				break;
+			continue;
+		}
+
+		if (list_empty(&dev->rx_busy)) {
+			ret = adb_queue_rx(dev, count - r);
+			if (ret < 0) {
+				r = -EIO;
+				atomic_set(&dev->error, 1);
+				_adb_dev->read_err = 5;
+				goto done;
+			}
+		}
+
+		ret = wait_event_interruptible(dev->read_wq,
+				!list_empty(&dev->rx_done) ||
 				atomic_read(&dev->error));
 
-	if (bugreport_debug) {
-		if (atomic_read(&dev->error)) {
-			r = -EIO;
-			_adb_dev->read_err = 6;
-			adb_read_timeout();
-			goto done;
+		if (bugreport_debug) {
+			if (atomic_read(&dev->error)) {
+				r = -EIO;
+				_adb_dev->read_err = 6;
+				adb_read_timeout();
+				goto done;
+			}
+			del_timer(&adb_read_timer);
 		}
-		del_timer(&adb_read_timer);
-	}
 
-	if (ret < 0) {
-		if (ret != -ERESTARTSYS) {
-			atomic_set(&dev->error, 1);
-			_adb_dev->read_err = 7;
-		} else {
-			_adb_dev->read_err = 8;
+		if (ret < 0) {
+			if (ret != -ERESTARTSYS) {
+				atomic_set(&dev->error, 1);
+				_adb_dev->read_err = 7;
+			} else {
+				_adb_dev->read_err = 8;
+			}
+			r = ret;
+			adb_rx_cancel(dev);
+			goto done;
 		}
-		r = ret;
-		usb_ep_dequeue(dev->ep_out, req);
-		goto done;
-	}
-	if (!atomic_read(&dev->error)) {
-		
-		if (req->actual == 0)
-			goto requeue_req;
-
-		pr_debug("rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer)) {
-			r = -EFAULT;
-			_adb_dev->read_err = 9;
+		if (atomic_read(&dev->error)) {
+			_adb_dev->read_err = 10;
+			r = -EIO;
+			goto done;
 		}
-	} else {
-		_adb_dev->read_err = 10;
-		r = -EIO;
 	}
 
 done:
@@ -486,8 +630,8 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > ADB_BULK_BUFFER_SIZE)
-				xfer = ADB_BULK_BUFFER_SIZE;
+			if (count > dev->tx_req_len)
+				xfer = dev->tx_req_len;
 			else
 				xfer = count;
 			if (copy_from_user(req->buf, buf, xfer)) {
@@ -539,6 +683,7 @@ static int adb_open(struct inode *ip, struct file *fp)
 	fp->private_data = _adb_dev;
 
 	
+	adb_rx_flush(_adb_dev);
 	atomic_set(&_adb_dev->error, 0);
 	_adb_dev->read_err = 0;
 	_adb_dev->write_err = 0;
@@ -677,7 +822,15 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	wake_up(&dev->read_wq);
 
-	adb_request_free(dev->rx_req, dev->ep_out);
+	adb_rx_flush(dev);
+	/*
+	 * The endpoints are disabled by now, so the UDC has given back every
+	 * request; any still on rx_busy missed its completion.
+	 */
+	while ((req = adb_req_get(dev, &dev->rx_busy)))
+		adb_request_free(req, dev->ep_out);
+	while ((req = adb_req_get(dev, &dev->rx_idle)))
+		adb_request_free(req, dev->ep_out);
 	while ((req = adb_req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 }
@@ -785,6 +938,9 @@ static int adb_setup(void)
 	
 
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->rx_idle);
+	INIT_LIST_HEAD(&dev->rx_busy);
+	INIT_LIST_HEAD(&dev->rx_done);
 
 	_adb_dev = dev;
 
@@ -21,6 +21,10 @@
 #include <linux/blkdev.h>
 #include <linux/pagemap.h>
 #include <linux/export.h>
+#include <linux/aio.h>
+#include <linux/mmu_context.h>
+#include <linux/scatterlist.h>
+#include <linux/uio.h>
 #include <asm/unaligned.h>
 
 #include <linux/usb/composite.h>
@@ -29,6 +33,12 @@
 
 #define FUNCTIONFS_MAGIC	0xa647361 /* Chosen by a honest dice roll ;) */
 
+/*
+ * Transfers of at least this many bytes go straight to or from the user
+ * pages if the controller can do scatter-gather.
+ */
+#define FFS_SG_MIN_LEN		(16 * 1024)
+
 
 /* Debugging ****************************************************************/
 
@@ -735,6 +745,185 @@ static const struct file_operations ffs_ep0_operations = {
 
 /* "Normal" endpoints operations ********************************************/
 
+/*
+ * One read or write on an endpoint file.  Synchronous ones live on the
+ * stack of the caller and use the endpoint's request, asynchronous ones
+ * get a request of their own and are completed by ffs_user_copy_worker().
+ */
+struct ffs_io_data {
+	bool aio;
+	bool read;
+
+	struct kiocb *kiocb;
+	const struct iovec *iovec;
+	unsigned long nr_segs;
+	size_t len;
+
+	struct mm_struct *mm;
+	struct work_struct work;
+
+	struct ffs_data *ffs;
+	struct usb_ep *ep;
+	struct usb_request *req;	/* P: ffs->eps_lock while queued */
+
+	/* either a bounce buffer or the pinned user pages */
+	char *buf;
+	struct page **pages;
+	struct scatterlist *sg;
+	unsigned nr_pages;
+};
+
+static int ffs_io_copy_from_user(struct ffs_io_data *io_data)
+{
+	char *to = io_data->buf;
+	unsigned long i;
+
+	for (i = 0; i < io_data->nr_segs; i++) {
+		const struct iovec *iov = &io_data->iovec[i];
+
+		if (unlikely(copy_from_user(to, iov->iov_base, iov->iov_len)))
+			return -EFAULT;
+		to += iov->iov_len;
+	}
+	return 0;
+}
+
+static ssize_t ffs_io_copy_to_user(struct ffs_io_data *io_data, size_t len)
+{
+	const char *from = io_data->buf;
+	ssize_t done = 0;
+	unsigned long i;
+
+	for (i = 0; i < io_data->nr_segs && len; i++) {
+		const struct iovec *iov = &io_data->iovec[i];
+		size_t n = min(len, iov->iov_len);
+
+		if (unlikely(copy_to_user(iov->iov_base, from, n)))
+			return done ? done : -EFAULT;
+		from += n;
+		len -= n;
+		done += n;
+	}
+	return done;
+}
+
+/*
+ * Pin the user pages of the transfer and describe them in io_data->sg.
+ * Buffers a controller writes to must be cache line aligned, so that no
+ * line is shared with data the DMA would clobber.  A transfer over more
+ * pages than the controller takes SG entries in a request, max_sgs if
+ * not 0, is left to the bounce buffer.
+ */
+static int ffs_io_pin_pages(struct ffs_io_data *io_data, unsigned max_sgs)
+{
+	unsigned long i, addr, end;
+	unsigned nr_pages = 0, n, off, seg;
+	struct scatterlist *sg;
+	int got;
+
+	for (i = 0; i < io_data->nr_segs; i++) {
+		addr = (unsigned long)io_data->iovec[i].iov_base;
+		end = addr + io_data->iovec[i].iov_len;
+		if (io_data->read && ((addr | end) & (L1_CACHE_BYTES - 1)))
+			return -EINVAL;
+		if (addr != end)
+			nr_pages += ((end - 1) >> PAGE_SHIFT) -
+				(addr >> PAGE_SHIFT) + 1;
+	}
+	if (!nr_pages || (max_sgs && nr_pages > max_sgs))
+		return -EINVAL;
+
+	io_data->pages = kmalloc(nr_pages * (sizeof(*io_data->pages) +
+				 sizeof(*io_data->sg)), GFP_KERNEL);
+	if (unlikely(!io_data->pages))
+		return -ENOMEM;
+	io_data->sg = (struct scatterlist *)(io_data->pages + nr_pages);
+	sg_init_table(io_data->sg, nr_pages);
+
+	sg = io_data->sg;
+	for (i = 0; i < io_data->nr_segs; i++) {
+		addr = (unsigned long)io_data->iovec[i].iov_base;
+		end = addr + io_data->iovec[i].iov_len;
+		if (addr == end)
+			continue;
+
+		n = ((end - 1) >> PAGE_SHIFT) - (addr >> PAGE_SHIFT) + 1;
+		got = get_user_pages_fast(addr & PAGE_MASK, n, io_data->read,
+					  io_data->pages + io_data->nr_pages);
+		if (got > 0)
+			io_data->nr_pages += got;
+		if (unlikely(got != n))
+			goto fail;
+
+		for (off = addr & ~PAGE_MASK; addr < end; off = 0) {
+			seg = min_t(unsigned long, end - addr, PAGE_SIZE - off);
+			sg_set_page(sg,
+				    io_data->pages[sg - io_data->sg], seg, off);
+			sg++;
+			addr += seg;
+		}
+	}
+	return 0;
+
+fail:
+	while (io_data->nr_pages)
+		put_page(io_data->pages[--io_data->nr_pages]);
+	kfree(io_data->pages);
+	io_data->pages = NULL;
+	return -EFAULT;
+}
+
+/* Get the data of a transfer ready, copying it in if it is a write */
+static int ffs_io_prepare(struct ffs_io_data *io_data,
+			  struct ffs_epfile *epfile)
+{
+	struct usb_gadget *gadget = epfile->ffs->gadget;
+
+	if (gadget && gadget->sg_supported && !epfile->isoc &&
+	    io_data->len >= FFS_SG_MIN_LEN &&
+	    !ffs_io_pin_pages(io_data, gadget->max_sgs))
+		return 0;
+
+	io_data->buf = kmalloc(io_data->len, GFP_KERNEL);
+	if (unlikely(!io_data->buf))
+		return -ENOMEM;
+	if (!io_data->read)
+		return ffs_io_copy_from_user(io_data);
+	return 0;
+}
+
+/* Release what ffs_io_prepare() got, ret being the result of the transfer */
+static void ffs_io_release(struct ffs_io_data *io_data, ssize_t ret)
+{
+	struct page *page;
+
+	while (io_data->nr_pages) {
+		page = io_data->pages[--io_data->nr_pages];
+		if (io_data->read && ret > 0)
+			set_page_dirty_lock(page);
+		put_page(page);
+	}
+	kfree(io_data->pages);
+	io_data->pages = NULL;
+	kfree(io_data->buf);
+	io_data->buf = NULL;
+}
+
+static void ffs_io_set_req(struct ffs_io_data *io_data,
+			   struct usb_request *req)
+{
+	if (io_data->pages) {
+		req->buf = NULL;
+		req->sg = io_data->sg;
+		req->num_sgs = io_data->nr_pages;
+	} else {
+		req->buf = io_data->buf;
+		req->sg = NULL;
+		req->num_sgs = 0;
+	}
+	req->length = io_data->len;
+}
+
 static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 {
 	ENTER();
@@ -745,12 +934,72 @@ static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 	}
 }
 
-static ssize_t ffs_epfile_io(struct file *file,
-			     char __user *buf, size_t len, int read)
+/*
+ * Finish an asynchronous transfer in process context: copy a read out
+ * in the submitter's mm, unpin the pages and complete the kiocb, which
+ * signals its eventfd if it has one.
+ */
+static void ffs_user_copy_worker(struct work_struct *work)
+{
+	struct ffs_io_data *io_data = container_of(work, struct ffs_io_data,
+						   work);
+	struct usb_request *req = io_data->req;
+	ssize_t ret = req->status ? req->status : req->actual;
+
+	if (io_data->read && ret > 0 && io_data->buf) {
+		use_mm(io_data->mm);
+		ret = ffs_io_copy_to_user(io_data, ret);
+		unuse_mm(io_data->mm);
+	}
+
+	/* from here on ffs_aio_cancel() leaves the request alone */
+	spin_lock_irq(&io_data->ffs->eps_lock);
+	io_data->kiocb->private = NULL;
+	spin_unlock_irq(&io_data->ffs->eps_lock);
+
+	ffs_io_release(io_data, ret);
+	aio_complete(io_data->kiocb, ret, ret);
+
+	usb_ep_free_request(io_data->ep, req);
+	kfree(io_data->iovec);
+	kfree(io_data);
+}
+
+static void ffs_epfile_async_io_complete(struct usb_ep *_ep,
+					 struct usb_request *req)
+{
+	struct ffs_io_data *io_data = req->context;
+
+	ENTER();
+
+	INIT_WORK(&io_data->work, ffs_user_copy_worker);
+	schedule_work(&io_data->work);
+}
+
+static int ffs_aio_cancel(struct kiocb *kiocb, struct io_event *e)
+{
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	struct ffs_io_data *io_data;
+	int value;
+
+	ENTER();
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	io_data = kiocb->private;
+	if (likely(io_data && io_data->ep && io_data->req))
+		value = usb_ep_dequeue(io_data->ep, io_data->req);
+	else
+		value = -EINVAL;
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	aio_put_req(kiocb);
+	return value;
+}
+
+static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 {
 	struct ffs_epfile *epfile = file->private_data;
 	struct ffs_ep *ep;
-	char *data = NULL;
 	ssize_t ret;
 	int halt;
 
@@ -782,23 +1031,17 @@ first_try:
 		}
 
 		/* Do we halt? */
-		halt = !read == !epfile->in;
-		if (halt && epfile->isoc) {
+		halt = !io_data->read == !epfile->in;
+		if (halt && (epfile->isoc || io_data->aio)) {
 			ret = -EINVAL;
 			goto error;
 		}
 
-		/* Allocate & copy */
-		if (!halt && !data) {
-			data = kzalloc(len, GFP_KERNEL);
-			if (unlikely(!data))
-				return -ENOMEM;
-
-			if (!read &&
-			    unlikely(__copy_from_user(data, buf, len))) {
-				ret = -EFAULT;
+		/* Allocate & copy, or pin the user pages */
+		if (!halt && !io_data->buf && !io_data->pages) {
+			ret = ffs_io_prepare(io_data, epfile);
+			if (unlikely(ret))
 				goto error;
-			}
 		}
 
 		/* We will be using request */
@@ -825,6 +1068,38 @@ first_try:
 			usb_ep_set_halt(ep->ep);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 		ret = -EBADMSG;
+	} else if (io_data->aio) {
+		/* Fire a request of its own, completed asynchronously */
+		struct usb_request *req;
+
+		req = usb_ep_alloc_request(ep->ep, GFP_ATOMIC);
+		if (unlikely(!req)) {
+			spin_unlock_irq(&epfile->ffs->eps_lock);
+			ret = -ENOMEM;
+			goto error_mutex;
+		}
+		ffs_io_set_req(io_data, req);
+		req->context  = io_data;
+		req->complete = ffs_epfile_async_io_complete;
+
+		io_data->ffs = epfile->ffs;
+		io_data->ep = ep->ep;
+		io_data->req = req;
+		io_data->kiocb->private = io_data;
+		io_data->kiocb->ki_cancel = ffs_aio_cancel;
+
+		ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
+		if (unlikely(ret)) {
+			io_data->kiocb->private = NULL;
+			io_data->kiocb->ki_cancel = NULL;
+			usb_ep_free_request(ep->ep, req);
+			spin_unlock_irq(&epfile->ffs->eps_lock);
+			goto error_mutex;
+		}
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+
+		mutex_unlock(&epfile->mutex);
+		return -EIOCBQUEUED;
 	} else {
 		/* Fire the request */
 		DECLARE_COMPLETION_ONSTACK(done);
@@ -832,8 +1107,7 @@ first_try:
 		struct usb_request *req = ep->req;
 		req->context  = &done;
 		req->complete = ffs_epfile_io_complete;
-		req->buf      = data;
-		req->length   = len;
+		ffs_io_set_req(io_data, req);
 
 		ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
 
@@ -846,15 +1120,15 @@ first_try:
 			usb_ep_dequeue(ep->ep, req);
 		} else {
 			ret = ep->status;
-			if (read && ret > 0 &&
-			    unlikely(copy_to_user(buf, data, ret)))
-				ret = -EFAULT;
+			if (io_data->read && ret > 0 && io_data->buf)
+				ret = ffs_io_copy_to_user(io_data, ret);
 		}
 	}
 
+error_mutex:
 	mutex_unlock(&epfile->mutex);
 error:
-	kfree(data);
+	ffs_io_release(io_data, ret);
 	return ret;
 }
 
@@ -862,17 +1136,81 @@ static ssize_t
 ffs_epfile_write(struct file *file, const char __user *buf, size_t len,
 		 loff_t *ptr)
 {
+	struct iovec iov = { .iov_base = (void __user *)buf, .iov_len = len };
+	struct ffs_io_data io_data = {
+		.read = false,
+		.iovec = &iov,
+		.nr_segs = 1,
+		.len = len,
+	};
+
 	ENTER();
 
-	return ffs_epfile_io(file, (char __user *)buf, len, 0);
+	return ffs_epfile_io(file, &io_data);
 }
 
 static ssize_t
 ffs_epfile_read(struct file *file, char __user *buf, size_t len, loff_t *ptr)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	struct ffs_io_data io_data = {
+		.read = true,
+		.iovec = &iov,
+		.nr_segs = 1,
+		.len = len,
+	};
+
+	ENTER();
+
+	return ffs_epfile_io(file, &io_data);
+}
+
+static ssize_t ffs_epfile_aio_rw(struct kiocb *kiocb, const struct iovec *iov,
+				 unsigned long nr_segs, bool read)
+{
+	struct ffs_io_data *io_data;
+	ssize_t ret;
+
+	io_data = kzalloc(sizeof(*io_data), GFP_KERNEL);
+	if (unlikely(!io_data))
+		return -ENOMEM;
+
+	io_data->iovec = kmemdup(iov, nr_segs * sizeof(*iov), GFP_KERNEL);
+	if (unlikely(!io_data->iovec)) {
+		kfree(io_data);
+		return -ENOMEM;
+	}
+	io_data->aio = true;
+	io_data->read = read;
+	io_data->kiocb = kiocb;
+	io_data->nr_segs = nr_segs;
+	io_data->len = iov_length(iov, nr_segs);
+	io_data->mm = current->mm;
+
+	ret = ffs_epfile_io(kiocb->ki_filp, io_data);
+	if (ret != -EIOCBQUEUED) {
+		kfree(io_data->iovec);
+		kfree(io_data);
+	}
+	return ret;
+}
+
+static ssize_t ffs_epfile_aio_write(struct kiocb *kiocb,
+				    const struct iovec *iov,
+				    unsigned long nr_segs, loff_t loff)
+{
+	ENTER();
+
+	return ffs_epfile_aio_rw(kiocb, iov, nr_segs, false);
+}
+
+static ssize_t ffs_epfile_aio_read(struct kiocb *kiocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t loff)
 {
 	ENTER();
 
-	return ffs_epfile_io(file, buf, len, 1);
+	return ffs_epfile_aio_rw(kiocb, iov, nr_segs, true);
 }
 
 static int
@@ -948,6 +1286,8 @@ static const struct file_operations ffs_epfile_operations = {
 	.open =		ffs_epfile_open,
 	.write =	ffs_epfile_write,
 	.read =		ffs_epfile_read,
+	.aio_write =	ffs_epfile_aio_write,
+	.aio_read =	ffs_epfile_aio_read,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
@@ -52,6 +52,7 @@
 #include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/limits.h>
+#include <linux/pagemap.h>
 #include <linux/rwsem.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -78,6 +79,19 @@ static const char fsg_string_interface[] = "Mass Storage";
 
 #include "storage_common.c"
 
+/* Largest pipeline buffer, kmalloc()ed in one piece */
+#define FSG_MAX_BUFLEN		((u32)131072)
+
+static unsigned int fsg_buflen = FSG_BUFLEN;
+module_param_named(buflen, fsg_buflen, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(buflen, "Size of each pipeline buffer, taken at bind");
+
+static unsigned int fsg_write_behind = 1024 * 1024;
+module_param_named(write_behind, fsg_write_behind, uint,
+		   S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(write_behind,
+		 "Bytes of a sequential write after which their writeback is started, 0 to leave it to the flusher");
+
 #ifdef CONFIG_USB_CSW_HACK
 static int write_error_after_csw_sent;
 static int csw_hack_sent;
@@ -120,6 +134,7 @@ struct fsg_common {
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
 	struct fsg_buffhd	*buffhds;
+	u32			buflen;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -581,6 +596,74 @@ static void cd_data_to_raw(u8 *buf, int lba)
 
 
 
+/*
+ * Start reading all of a command's range from the backing file before
+ * the first buffer of it is filled, so that the block layer gets it as
+ * one request instead of one per buffer, and the later buffers are
+ * mostly read by the time the earlier ones are on the wire.
+ */
+static void fsg_lun_readahead(struct fsg_lun *curlun, loff_t offset, u32 len)
+{
+	struct file		*filp = curlun->filp;
+	struct address_space	*mapping = filp->f_mapping;
+	pgoff_t			index = offset >> PAGE_CACHE_SHIFT;
+	unsigned long		nr_pages;
+	struct page		*page;
+
+	if (!len || (filp->f_flags & O_DIRECT) || !mapping->a_ops->readpage)
+		return;
+	nr_pages = ((offset + len - 1) >> PAGE_CACHE_SHIFT) - index + 1;
+
+	page = find_get_page(mapping, index);
+	if (!page) {
+		page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+					  index, nr_pages);
+		return;
+	}
+	if (PageReadahead(page))
+		page_cache_async_readahead(mapping, &filp->f_ra, filp, page,
+					   index, nr_pages);
+	page_cache_release(page);
+}
+
+/*
+ * Write-behind for sequential writes: once fsg_write_behind bytes have
+ * been written in a row, start their writeback and wait for the window
+ * started before it.  That keeps the disk busy during a long write and
+ * bounds a LUN to about two windows of dirty data, rather than letting
+ * it fill the dirty limit and then stall in balance_dirty_pages() with
+ * the host waiting.  Random writes are left to the flusher.  When the
+ * window waited for failed, its start is returned in *err_offset.
+ */
+static int fsg_lun_write_behind(struct fsg_lun *curlun, loff_t offset,
+				size_t len, loff_t *err_offset)
+{
+	struct address_space	*mapping = curlun->filp->f_mapping;
+	int			rc = 0;
+
+	if (!fsg_write_behind)
+		return 0;
+
+	if (offset != curlun->wb_end)
+		curlun->wb_start = offset;
+	curlun->wb_end = offset + len;
+	if (curlun->wb_end - curlun->wb_start < fsg_write_behind)
+		return 0;
+
+	if (curlun->wb_prev_end > curlun->wb_prev_start)
+		rc = filemap_fdatawait_range(mapping, curlun->wb_prev_start,
+					     curlun->wb_prev_end - 1);
+	if (rc)
+		*err_offset = curlun->wb_prev_start;
+	filemap_fdatawrite_range(mapping, curlun->wb_start,
+				 curlun->wb_end - 1);
+
+	curlun->wb_prev_start = curlun->wb_start;
+	curlun->wb_prev_end = curlun->wb_end;
+	curlun->wb_start = curlun->wb_end;
+	return rc;
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -634,8 +717,13 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		
 
+	if (file_offset < curlun->file_length)
+		fsg_lun_readahead(curlun, file_offset,
+				  min((loff_t)amount_left,
+				      curlun->file_length - file_offset));
+
 	for (;;) {
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 
@@ -742,9 +830,12 @@ static int do_write(struct fsg_common *common)
 	int			get_some_more;
 	u32			amount_left_to_req, amount_left_to_write;
 	loff_t			usb_offset, file_offset, file_offset_tmp;
+	loff_t			write_start, wb_err_offset;
 	unsigned int		amount;
 	ssize_t			nwritten;
 	int			rc;
+	int			fua = 0;
+	int			wb_error = 0;
 
 #ifdef CONFIG_USB_CSW_HACK
 	int			i;
@@ -757,10 +848,6 @@ static int do_write(struct fsg_common *common)
 		curlun->sense_data = SS_WRITE_PROTECTED;
 		return -EINVAL;
 	}
-	spin_lock(&curlun->filp->f_lock);
-	curlun->filp->f_flags &= ~O_SYNC;	
-	spin_unlock(&curlun->filp->f_lock);
-
 	if (common->cmnd[0] == WRITE_6)
 		lba = get_unaligned_be24(&common->cmnd[1]);
 	else {
@@ -770,11 +857,12 @@ static int do_write(struct fsg_common *common)
 			curlun->sense_data = SS_INVALID_FIELD_IN_CDB;
 			return -EINVAL;
 		}
-		if (!curlun->nofua && (common->cmnd[1] & 0x08)) { 
-			spin_lock(&curlun->filp->f_lock);
-			curlun->filp->f_flags |= O_SYNC;
-			spin_unlock(&curlun->filp->f_lock);
-		}
+		/*
+		 * FUA: rather than writing every buffer O_SYNC, the range
+		 * of the whole command is synced once it is written.
+		 */
+		if (!curlun->nofua && (common->cmnd[1] & 0x08))
+			fua = 1;
 	}
 	if (lba >= curlun->num_sectors) {
 		curlun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
@@ -784,6 +872,7 @@ static int do_write(struct fsg_common *common)
 	
 	get_some_more = 1;
 	file_offset = usb_offset = ((loff_t) lba) << curlun->blkbits;
+	write_start = file_offset;
 	amount_left_to_req = common->data_size_from_cmnd;
 	amount_left_to_write = common->data_size_from_cmnd;
 
@@ -793,7 +882,7 @@ static int do_write(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY && get_some_more) {
 
-			amount = min(amount_left_to_req, FSG_BUFLEN);
+			amount = min(amount_left_to_req, common->buflen);
 
 			
 			if (usb_offset >= curlun->file_length) {
@@ -893,15 +982,23 @@ static int do_write(struct fsg_common *common)
 				     (int)nwritten, amount);
 				nwritten = round_down(nwritten, curlun->blksize);
 			}
+			if (nwritten > 0 && fsg_lun_write_behind(curlun,
+					file_offset, nwritten, &wb_err_offset)) {
+				LDBG(curlun, "write-behind error at %llu\n",
+				     (unsigned long long)wb_err_offset);
+				wb_error = 1;
+			}
 			file_offset += nwritten;
 			amount_left_to_write -= nwritten;
 			common->residue -= nwritten;
 
 			
-			if (nwritten < amount) {
+			if (nwritten < amount || wb_error) {
 				curlun->sense_data = SS_WRITE_ERROR;
-				curlun->sense_data_info =
-					file_offset >> curlun->blkbits;
+				/* this buffer is written, an earlier one not */
+				curlun->sense_data_info = (wb_error ?
+					wb_err_offset : file_offset) >>
+						curlun->blkbits;
 				curlun->info_valid = 1;
 #ifdef CONFIG_USB_CSW_HACK
 				write_error_after_csw_sent = 1;
@@ -920,7 +1017,12 @@ write_error:
 							BUF_STATE_BUSY)
 						break;
 				}
-				if (!amount_left_to_req && i == fsg_num_buffers) {
+				/*
+				 * A FUA write's status waits for the sync at
+				 * the end, so that a failing one is reported.
+				 */
+				if (!amount_left_to_req && i == fsg_num_buffers &&
+				    !fua) {
 					csw_hack_sent = 1;
 					send_status(common);
 				}
@@ -942,6 +1044,16 @@ write_error:
 			return rc;
 	}
 
+	if (fua && file_offset > write_start) {
+		rc = vfs_fsync_range(curlun->filp, write_start,
+				     file_offset - 1, 1);
+		if (rc) {
+			curlun->sense_data = SS_WRITE_ERROR;
+			curlun->sense_data_info = lba;
+			curlun->info_valid = 1;
+		}
+	}
+
 	return -EIO;		
 }
 
@@ -1011,7 +1123,7 @@ static int do_verify(struct fsg_common *common)
 
 	
 	while (amount_left > 0) {
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 		if (amount == 0) {
@@ -1528,7 +1640,7 @@ static int throw_away_data(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY
 		 && common->usb_amount_left > 0) {
-			amount = min(common->usb_amount_left, FSG_BUFLEN);
+			amount = min(common->usb_amount_left, common->buflen);
 
 			set_bulk_out_req_length(common, bh, amount);
 			if (!start_out_transfer(common, bh))
@@ -2638,6 +2750,8 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		common->free_storage_on_release = 0;
 	}
 
+	common->buflen = clamp_t(u32, rounddown(fsg_buflen, PAGE_SIZE),
+				 PAGE_SIZE, FSG_MAX_BUFLEN);
 	common->buffhds = kcalloc(fsg_num_buffers,
 				  sizeof *(common->buffhds), GFP_KERNEL);
 	if (!common->buffhds) {
@@ -2725,7 +2839,7 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		bh->next = bh + 1;
 		++bh;
 buffhds_first_it:
-		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
+		bh->buf = kmalloc(common->buflen, GFP_KERNEL);
 		if (unlikely(!bh->buf)) {
 			rc = -ENOMEM;
 			goto error_release;
@@ -2932,7 +3046,7 @@ static int fsg_bind(struct usb_configuration *c, struct usb_function *f)
 		unsigned	max_burst;
 
 		
-		max_burst = min_t(unsigned, FSG_BUFLEN / 1024, 15);
+		max_burst = min_t(unsigned, fsg->common->buflen / 1024, 15);
 
 		fsg_ss_bulk_in_desc.bEndpointAddress =
 			fsg_fs_bulk_in_desc.bEndpointAddress;
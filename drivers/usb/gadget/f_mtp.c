@@ -26,6 +26,10 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
+#include <linux/scatterlist.h>
+#include <linux/backing-dev.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 
@@ -51,6 +55,7 @@
 #define MTP_TX_REQ_MAX 4
 #define MTP_RX_REQ_MAX 8
 #define MTP_INTR_REQ_MAX 5
+#define MTP_REQ_MAX_DEPTH 32
 
 #define MTP_OS_STRING_ID   0xEE
 
@@ -65,6 +70,32 @@
 static int htc_mtp_performance_debug;
 static int htc_mtp_open_state;
 
+/*
+ * Bulk request sizes and queue depths, taken when the function is bound.
+ * Sizes are rounded down to a multiple of 1024 and halved down to
+ * MTP_BULK_BUFFER_SIZE while the requests cannot be allocated.
+ */
+static unsigned int mtp_tx_req_len = MTP_BULK_BUFFER_SIZE;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "Size of the MTP IN requests");
+
+static unsigned int mtp_rx_req_len = MTP_BULK_BUFFER_SIZE;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "Size of the MTP OUT requests");
+
+static unsigned int mtp_tx_reqs = MTP_TX_REQ_MAX;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "Number of MTP IN requests");
+
+static unsigned int mtp_rx_reqs = MTP_RX_REQ_MAX;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "Number of MTP OUT requests");
+
+/* send files from the page cache with SG requests if the UDC can */
+static bool mtp_tx_zcopy = true;
+module_param(mtp_tx_zcopy, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_zcopy, "Send files without copying them");
+
 static const char mtp_shortname[] = "mtp_usb";
 
 struct mtp_dev {
@@ -95,6 +126,12 @@ struct mtp_dev {
 	struct list_head tx_idle;
 	struct list_head intr_idle;
 
+	unsigned int tx_req_len;
+	unsigned int rx_req_len;
+	unsigned int tx_reqs;
+	unsigned int tx_sgs;
+	bool tx_zcopy;
+
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
@@ -337,6 +374,16 @@ struct mtp_device_status {
 	__le16	wCode;
 };
 
+/*
+ * Page cache pages an IN request points at, held until it completes.
+ * Only allocated for the IN requests if the UDC does scatter-gather.
+ */
+struct mtp_tx_pages {
+	unsigned int nr_pages;
+	struct page **pages;
+	struct scatterlist *sg;
+};
+
 static struct mtp_dev *_mtp_dev;
 
 static inline struct mtp_dev *func_to_mtp(struct usb_function *f)
@@ -350,7 +397,7 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 	if (!req)
 		return NULL;
 
-	
+	req->context = NULL;
 	req->buf = kmalloc(buffer_size, GFP_KERNEL);
 	if (!req->buf) {
 		usb_ep_free_request(ep, req);
@@ -363,6 +410,7 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 {
 	if (req) {
+		kfree(req->context);
 		kfree(req->buf);
 		usb_ep_free_request(ep, req);
 	}
@@ -410,6 +458,16 @@ static struct usb_request
 	return req;
 }
 
+static void mtp_tx_release_pages(struct usb_request *req)
+{
+	struct mtp_tx_pages *tp = req->context;
+
+	while (tp->nr_pages)
+		page_cache_release(tp->pages[--tp->nr_pages]);
+	req->sg = NULL;
+	req->num_sgs = 0;
+}
+
 static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
@@ -417,6 +475,9 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
+	if (req->num_sgs)
+		mtp_tx_release_pages(req);
+
 	mtp_req_put(dev, &dev->tx_idle, req);
 
 	wake_up(&dev->write_wq);
@@ -453,6 +514,78 @@ static void mtp_complete_intr(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->intr_wq);
 }
 
+static unsigned int mtp_req_len(unsigned int len)
+{
+	return max_t(unsigned int, rounddown(len, 1024), MTP_BULK_BUFFER_SIZE);
+}
+
+/*
+ * Allocate nr requests of *len bytes onto head, halving *len while that
+ * fails and it is larger than MTP_BULK_BUFFER_SIZE.
+ */
+static int mtp_alloc_requests(struct mtp_dev *dev, struct usb_ep *ep,
+		struct list_head *head, unsigned int nr, unsigned int *len,
+		void (*complete)(struct usb_ep *, struct usb_request *))
+{
+	struct usb_request *req;
+	unsigned int i;
+
+	for (;;) {
+		for (i = 0; i < nr; i++) {
+			req = mtp_request_new(ep, *len);
+			if (!req)
+				break;
+			req->complete = complete;
+			mtp_req_put(dev, head, req);
+		}
+		if (i == nr)
+			return 0;
+
+		while ((req = mtp_req_get(dev, head)))
+			mtp_request_free(req, ep);
+		if (*len <= MTP_BULK_BUFFER_SIZE)
+			return -ENOMEM;
+		*len = mtp_req_len(*len / 2);
+	}
+}
+
+/*
+ * Give every IN request room for the pages of a full request at any file
+ * offset plus the header, as far as the UDC takes that many SG entries,
+ * or leave zero-copy off if that fails.  A request needs at least the
+ * header and two pages, see mtp_tx_zcopy_len().
+ */
+static bool mtp_alloc_tx_pages(struct mtp_dev *dev)
+{
+	struct usb_request *req;
+	struct mtp_tx_pages *tp;
+	unsigned int max_sgs = dev->cdev->gadget->max_sgs;
+	unsigned int nents = dev->tx_req_len / PAGE_CACHE_SIZE + 2;
+
+	if (max_sgs && nents > max_sgs)
+		nents = max_sgs;
+	if (nents < 3)
+		return false;
+	dev->tx_sgs = nents;
+
+	list_for_each_entry(req, &dev->tx_idle, list) {
+		tp = kzalloc(sizeof(*tp) + nents * (sizeof(*tp->pages) +
+				sizeof(*tp->sg)), GFP_KERNEL);
+		if (!tp)
+			goto fail;
+		tp->sg = (struct scatterlist *)(tp + 1);
+		tp->pages = (struct page **)(tp->sg + nents);
+		req->context = tp;
+	}
+	return true;
+
+fail:
+	list_for_each_entry(req, &dev->tx_idle, list) {
+		kfree(req->context);
+		req->context = NULL;
+	}
+	return false;
+}
 
 static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
@@ -494,20 +627,22 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	
-	for (i = 0; i < MTP_TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-				goto fail;
-		req->complete = mtp_complete_in;
-		mtp_req_put(dev, &dev->tx_idle, req);
-	}
-	for (i = 0; i < MTP_RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-				goto fail;
-		req->complete = mtp_complete_out;
-		mtp_req_put(dev, &dev->rx_idle, req);
-	}
+	dev->tx_req_len = mtp_req_len(mtp_tx_req_len);
+	dev->tx_reqs = clamp_t(unsigned int, mtp_tx_reqs, 1, MTP_REQ_MAX_DEPTH);
+	if (mtp_alloc_requests(dev, dev->ep_in, &dev->tx_idle, dev->tx_reqs,
+			&dev->tx_req_len, mtp_complete_in))
+		goto fail;
+	dev->rx_req_len = mtp_req_len(mtp_rx_req_len);
+	if (mtp_alloc_requests(dev, dev->ep_out, &dev->rx_idle,
+			clamp_t(unsigned int, mtp_rx_reqs, 1, MTP_REQ_MAX_DEPTH),
+			&dev->rx_req_len, mtp_complete_out))
+		goto fail;
+	dev->tx_zcopy = mtp_tx_zcopy && cdev->gadget->sg_supported &&
+		mtp_alloc_tx_pages(dev);
+	DBG(cdev, "%s: tx %u x %u%s, rx %u\n", __func__, dev->tx_reqs,
+			dev->tx_req_len, dev->tx_zcopy ? " zero-copy" : "",
+			dev->rx_req_len);
+
 	for (i = 0; i < MTP_INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
 		if (!req)
@@ -562,7 +697,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 	spin_unlock_irq(&dev->lock);
 
 	
-	if (count > MTP_BULK_BUFFER_SIZE) {
+	if (count > dev->rx_req_len) {
 		file_xfer_zlp_flag = 1;
 		
 	}
@@ -592,7 +727,7 @@ requeue_req:
 			#if 0
 			req->length = dev->maxsize?dev->maxsize:512;
 			#endif
-			req->length = MTP_BULK_BUFFER_SIZE;
+			req->length = dev->rx_req_len;
 			DBG(cdev, "%s: queue request(%p) on %s\n", __func__, req, dev->ep_out->name);
 			ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
 			if (ret < 0) {
@@ -634,7 +769,7 @@ requeue_req:
 			}
 
 			
-			if (xfer < MTP_BULK_BUFFER_SIZE) {
+			if (xfer < dev->rx_req_len) {
 				dev->read_count = 0;
 				break;
 			}
@@ -731,8 +866,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -769,6 +904,109 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/*
+ * Whether a file can be sent straight from its page cache: a vfs_read()
+ * of it would only copy from there.
+ */
+static bool mtp_tx_can_zcopy(struct mtp_dev *dev, struct file *filp)
+{
+	struct inode *inode = filp->f_path.dentry->d_inode;
+
+	return dev->tx_zcopy && S_ISREG(inode->i_mode) &&
+		(filp->f_mode & FMODE_READ) && !(filp->f_flags & O_DIRECT) &&
+		filp->f_op->aio_read == generic_file_aio_read &&
+		filp->f_mapping->a_ops->readpage;
+}
+
+/*
+ * Keep the read-ahead window at least as deep as the IN queue, so the
+ * pages for the next requests are read while the queued ones go out.
+ */
+static void mtp_tx_readahead(struct mtp_dev *dev, struct file *filp)
+{
+	struct backing_dev_info *bdi = filp->f_mapping->backing_dev_info;
+	unsigned long pages = (dev->tx_reqs * dev->tx_req_len) >>
+				PAGE_CACHE_SHIFT;
+
+	spin_lock(&filp->f_lock);
+	filp->f_ra.ra_pages = max(bdi->ra_pages * 2, pages);
+	spin_unlock(&filp->f_lock);
+}
+
+/*
+ * Trim a zero-copy request of xfer bytes, hdr_size of them header, to the
+ * pages at offset it has SG entries for.  A trimmed request stays a
+ * multiple of the packet size, so that it does not end the transfer.
+ */
+static int mtp_tx_zcopy_len(struct mtp_dev *dev, loff_t offset,
+		int hdr_size, int xfer)
+{
+	unsigned int pages = dev->tx_sgs - (hdr_size ? 1 : 0);
+	int max = hdr_size + pages * PAGE_CACHE_SIZE -
+		(offset & ~PAGE_CACHE_MASK);
+
+	if (xfer <= max)
+		return xfer;
+	return rounddown(max, dev->ep_in->maxpacket);
+}
+
+/*
+ * Point req at the page cache pages holding len bytes of filp at *offset,
+ * after hdr_size bytes of header in req->buf, reading in any that are not
+ * cached the way a read would.  The pages are held until req completes.
+ */
+static int mtp_tx_map_pages(struct usb_request *req, struct file *filp,
+		loff_t *offset, int hdr_size, int len)
+{
+	struct mtp_tx_pages *tp = req->context;
+	struct address_space *mapping = filp->f_mapping;
+	pgoff_t index = *offset >> PAGE_CACHE_SHIFT;
+	pgoff_t last = (*offset + len - 1) >> PAGE_CACHE_SHIFT;
+	unsigned int poff = *offset & ~PAGE_CACHE_MASK;
+	unsigned int nents = last - index + 1 + (hdr_size ? 1 : 0);
+	struct scatterlist *sg = tp->sg;
+	struct page *page;
+	int left = len, n;
+
+	sg_init_table(tp->sg, nents);
+	if (hdr_size)
+		sg_set_buf(sg++, req->buf, hdr_size);
+
+	for (; index <= last; index++) {
+		page = find_get_page(mapping, index);
+		if (!page) {
+			page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+					index, last - index + 1);
+			page = find_get_page(mapping, index);
+		}
+		if (page && PageReadahead(page))
+			page_cache_async_readahead(mapping, &filp->f_ra, filp,
+					page, index, last - index + 1);
+		if (page && !PageUptodate(page)) {
+			page_cache_release(page);
+			page = NULL;
+		}
+		if (!page) {
+			page = read_mapping_page(mapping, index, filp);
+			if (IS_ERR(page)) {
+				mtp_tx_release_pages(req);
+				return PTR_ERR(page);
+			}
+		}
+		tp->pages[tp->nr_pages++] = page;
+
+		n = min_t(int, left, PAGE_CACHE_SIZE - poff);
+		sg_set_page(sg++, page, n, poff);
+		left -= n;
+		poff = 0;
+	}
+
+	req->sg = tp->sg;
+	req->num_sgs = nents;
+	*offset += len;
+	return len;
+}
+
 static void send_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
@@ -777,11 +1015,12 @@ static void send_file_work(struct work_struct *data)
 	struct usb_request *req = 0;
 	struct mtp_data_header *header;
 	struct file *filp;
-	loff_t offset;
+	loff_t offset, size = 0;
 	int64_t count;
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	bool zcopy;
 	long diff = 0;
 
 	
@@ -802,6 +1041,15 @@ static void send_file_work(struct work_struct *data)
 	if ((count & (dev->ep_in->maxpacket - 1)) == 0)
 		sendZLP = 1;
 
+	/* what vfs_read() would check for every chunk, once for all */
+	zcopy = mtp_tx_can_zcopy(dev, filp) &&
+		rw_verify_area(READ, filp, &offset,
+			dev->xfer_file_length) >= 0;
+	if (zcopy) {
+		size = i_size_read(filp->f_path.dentry->d_inode);
+		mtp_tx_readahead(dev, filp);
+	}
+
 	if (htc_mtp_performance_debug)
 		do_gettimeofday(&dev->st0);
 	while (count > 0 || sendZLP) {
@@ -823,8 +1071,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -838,8 +1086,15 @@ static void send_file_work(struct work_struct *data)
 					__cpu_to_le32(dev->xfer_transaction_id);
 		}
 
-		ret = vfs_read(filp, req->buf + hdr_size, xfer - hdr_size,
-								&offset);
+		/* copy the tail past the size sampled above, like a read */
+		if (zcopy && xfer - hdr_size >= PAGE_CACHE_SIZE &&
+				offset + xfer - hdr_size <= size) {
+			xfer = mtp_tx_zcopy_len(dev, offset, hdr_size, xfer);
+			ret = mtp_tx_map_pages(req, filp, &offset, hdr_size,
+					xfer - hdr_size);
+		} else
+			ret = vfs_read(filp, req->buf + hdr_size,
+					xfer - hdr_size, &offset);
 		if (ret < 0) {
 			r = ret;
 			break;
@@ -868,8 +1123,13 @@ static void send_file_work(struct work_struct *data)
 		printk(KERN_INFO "[USB][MTP]%s, total time:%ld\n", __func__, diff);
 	}
 
-	if (req)
+	if (req) {
+		if (req->num_sgs)
+			mtp_tx_release_pages(req);
 		mtp_req_put(dev, &dev->tx_idle, req);
+	}
+	if (zcopy)
+		file_accessed(filp);
 
 	DBG(cdev, "send_file_work returning %d\n", r);
 	
@@ -923,7 +1183,7 @@ requeue_req:
 			#if 0
 			req->length = dev->maxsize?dev->maxsize:512;
 			#endif
-			req->length = MTP_BULK_BUFFER_SIZE;
+			req->length = dev->rx_req_len;
 			DBG(cdev, "%s: queue request(%p) on %s\n", __func__, req, dev->ep_out->name);
 			ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
 			if (ret < 0) {
@@ -966,7 +1226,7 @@ requeue_req:
 			}
 
 			
-			if (xfer < MTP_BULK_BUFFER_SIZE) {
+			if (xfer < dev->rx_req_len) {
 				break;
 			}
 			continue;
@@ -206,6 +206,15 @@ struct fsg_lun {
 
 	unsigned int	blkbits;	/* Bits of logical block size of bound block device */
 	unsigned int	blksize;	/* logical block size of bound block device */
+
+	/*
+	 * Write-behind: [wb_start, wb_end) has been written but its
+	 * writeback not started, [wb_prev_start, wb_prev_end) has been
+	 * started but not waited for.
+	 */
+	loff_t		wb_start, wb_end;
+	loff_t		wb_prev_start, wb_prev_end;
+
 	struct device	dev;
 #ifdef CONFIG_USB_MSC_PROFILING
 	spinlock_t	lock;
@@ -232,33 +241,29 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
+/* Most pipeline buffers one can ask for */
+#define FSG_MAX_NUM_BUFFERS	32
+
+/*
+ * Number of buffers we will use.
+ * 2 is usually enough for good buffering pipeline, a slow or bursty
+ * backing file wants more.
+ */
 #ifdef CONFIG_USB_CSW_HACK
-#define fsg_num_buffers		4
+static unsigned int fsg_num_buffers = 4;
 #else
-#ifdef CONFIG_USB_GADGET_DEBUG_FILES
-
 static unsigned int fsg_num_buffers = CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS;
+#endif
 module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO);
 MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
 
-#else
-
-/*
- * Number of buffers we will use.
- * 2 is usually enough for good buffering pipeline
- */
-#define fsg_num_buffers	CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
-
-#endif /* CONFIG_USB_DEBUG */
-#endif /* CONFIG_USB_CSW_HACK */
-
 /* check if fsg_num_buffers is within a valid range */
 static inline int fsg_num_buffers_validate(void)
 {
-	if (fsg_num_buffers >= 2 && fsg_num_buffers <= 4)
+	if (fsg_num_buffers >= 2 && fsg_num_buffers <= FSG_MAX_NUM_BUFFERS)
 		return 0;
 	pr_err("fsg_num_buffers %u is out of range (%d to %d)\n",
-	       fsg_num_buffers, 2 ,4);
+	       fsg_num_buffers, 2, FSG_MAX_NUM_BUFFERS);
 	return -EINVAL;
 }
 
@@ -742,6 +747,8 @@ static void fsg_lun_close(struct fsg_lun *curlun)
 		LDBG(curlun, "close backing file\n");
 		fput(curlun->filp);
 		curlun->filp = NULL;
+		curlun->wb_start = curlun->wb_end = 0;
+		curlun->wb_prev_start = curlun->wb_prev_end = 0;
 	}
 }
 
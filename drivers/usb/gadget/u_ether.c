@@ -19,6 +19,7 @@
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/scatterlist.h>
 
 #include "u_ether.h"
 
@@ -26,8 +27,6 @@
 
 #define UETH__VERSION	"29-May-2008"
 
-static struct workqueue_struct	*uether_wq;
-
 struct eth_dev {
 	spinlock_t		lock;
 	struct gether		*port_usb;
@@ -42,8 +41,16 @@ struct eth_dev {
 	int			no_tx_req_used;
 	int			tx_skb_hold_count;
 	u32			tx_req_bufsize;
+	bool			tx_sg;		/* aggregating by eth_tx_agg */
 
 	struct sk_buff_head	rx_frames;
+	struct napi_struct	rx_napi;
+
+	/* finished skbs, freed or recycled by eth_poll() */
+	struct sk_buff_head	skb_done;
+	/* RX skbs for reuse, at most one per request */
+	struct sk_buff_head	rx_skb_pool;
+	unsigned		rx_skb_size;
 
 	unsigned		header_len;
 	unsigned int		ul_max_pkts_per_xfer;
@@ -54,7 +61,6 @@ struct eth_dev {
 						struct sk_buff_head *list);
 
 	struct work_struct	work;
-	struct work_struct	rx_work;
 
 	unsigned long		todo;
 #define	WORK_RX_MEMORY		0
@@ -76,6 +82,8 @@ struct eth_dev {
 
 #define RX_EXTRA	20	
 
+#define RX_NAPI_WEIGHT	64
+
 #define DEFAULT_QLEN	2	
 
 static unsigned qmult = 10;
@@ -251,6 +259,219 @@ static void defer_kevent(struct eth_dev *dev, int flag)
 static void rx_complete(struct usb_ep *ep, struct usb_request *req);
 static void tx_complete(struct usb_ep *ep, struct usb_request *req);
 
+/*
+ * Completions run with interrupts off, where skb_recycle_check() won't
+ * take an skb, so they hand what they are done with to eth_poll().
+ */
+static void eth_skb_done(struct eth_dev *dev, struct sk_buff *skb)
+{
+	skb_queue_tail(&dev->skb_done, skb);
+	napi_schedule(&dev->rx_napi);
+}
+
+static void eth_skb_recycle(struct eth_dev *dev, struct sk_buff *skb)
+{
+	if (dev->rx_skb_size &&
+	    skb_queue_len(&dev->rx_skb_pool) < qlen(dev->gadget) &&
+	    skb_recycle_check(skb, dev->rx_skb_size))
+		skb_queue_tail(&dev->rx_skb_pool, skb);
+	else
+		dev_kfree_skb_any(skb);
+}
+
+/*
+ * A TX request aggregating frames without copying them.  Each frame
+ * takes one scatterlist entry for its header and one each for the
+ * skb's linear part and pages; the skbs are kept until the transfer
+ * is done.  Only num_sgs bounds the list, no entry is marked as the
+ * end of it, so that the table can be refilled without clearing it.
+ * The list never has more entries than the UDC takes in a request.
+ */
+struct eth_tx_agg {
+	struct sk_buff_head	skbs;
+	u8			*headers;
+	unsigned		len;
+	unsigned		nents;
+	unsigned		max_nents;
+	u8			pad;
+	struct scatterlist	sg[0];
+};
+
+static unsigned eth_tx_agg_max_nents(struct eth_dev *dev)
+{
+	unsigned	max_nents;
+
+	max_nents = dev->dl_max_pkts_per_xfer * (MAX_SKB_FRAGS + 2) + 1;
+	if (dev->gadget->max_sgs && max_nents > dev->gadget->max_sgs)
+		max_nents = dev->gadget->max_sgs;
+	return max_nents;
+}
+
+/*
+ * Entries skb takes in an aggregate, header included, after linearizing
+ * it if it has a frag list or more pages than an empty one has room for.
+ * 0 if that fails.
+ */
+static unsigned eth_tx_agg_nents(struct eth_dev *dev, struct sk_buff *skb)
+{
+	if ((skb_has_frag_list(skb) || skb_shinfo(skb)->nr_frags + 3 >
+				eth_tx_agg_max_nents(dev)) &&
+	    __skb_linearize(skb))
+		return 0;
+	return skb_shinfo(skb)->nr_frags + 2;
+}
+
+/* Whether nents more entries fit in agg, leaving one for a pad byte */
+static bool eth_tx_agg_fits(struct eth_tx_agg *agg, unsigned nents)
+{
+	return agg->nents + nents < agg->max_nents;
+}
+
+static struct eth_tx_agg *eth_tx_agg_alloc(struct eth_dev *dev)
+{
+	unsigned		max_nents = eth_tx_agg_max_nents(dev);
+	struct eth_tx_agg	*agg;
+
+	agg = kzalloc(sizeof(*agg) + max_nents * sizeof(agg->sg[0]),
+		      GFP_ATOMIC);
+	if (!agg)
+		return NULL;
+	agg->headers = kmalloc(dev->dl_max_pkts_per_xfer * dev->header_len,
+			       GFP_ATOMIC);
+	if (!agg->headers) {
+		kfree(agg);
+		return NULL;
+	}
+	sg_init_table(agg->sg, max_nents);
+	agg->max_nents = max_nents;
+	skb_queue_head_init(&agg->skbs);
+	return agg;
+}
+
+static void eth_tx_agg_free(struct eth_tx_agg *agg)
+{
+	struct sk_buff	*skb;
+
+	if (!agg)
+		return;
+	while ((skb = __skb_dequeue(&agg->skbs)))
+		dev_kfree_skb_any(skb);
+	kfree(agg->headers);
+	kfree(agg);
+}
+
+/* The transfer of req is over, or never started: let go of its frames */
+static void eth_tx_agg_done(struct eth_dev *dev, struct usb_request *req)
+{
+	struct eth_tx_agg	*agg = req->context;
+	unsigned long		flags;
+
+	req->num_sgs = 0;
+	if (!agg)
+		return;
+	agg->len = 0;
+	agg->nents = 0;
+	if (skb_queue_empty(&agg->skbs))
+		return;
+
+	spin_lock_irqsave(&dev->skb_done.lock, flags);
+	skb_queue_splice_tail_init(&agg->skbs, &dev->skb_done);
+	spin_unlock_irqrestore(&dev->skb_done.lock, flags);
+	napi_schedule(&dev->rx_napi);
+}
+
+/* Add skb behind the header the link's wrap() left in port_usb->header */
+static int eth_tx_agg_add(struct eth_dev *dev, struct eth_tx_agg *agg,
+			  struct sk_buff *skb)
+{
+	u8	*header;
+	int	i;
+
+	if (skb_has_frag_list(skb) && __skb_linearize(skb))
+		return -ENOMEM;
+	if (!eth_tx_agg_fits(agg, skb_shinfo(skb)->nr_frags + 2))
+		return -ENOSPC;
+
+	header = agg->headers + skb_queue_len(&agg->skbs) * dev->header_len;
+	memcpy(header, dev->port_usb->header, dev->header_len);
+	sg_set_buf(&agg->sg[agg->nents++], header, dev->header_len);
+
+	if (skb_headlen(skb))
+		sg_set_buf(&agg->sg[agg->nents++], skb->data,
+			   skb_headlen(skb));
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
+		const skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+
+		sg_set_page(&agg->sg[agg->nents++], skb_frag_page(frag),
+			    skb_frag_size(frag), frag->page_offset);
+	}
+
+	agg->len += dev->header_len + skb->len;
+	__skb_queue_tail(&agg->skbs, skb);
+	return 0;
+}
+
+/* Point req at the frames of agg, length being one more for a pad byte */
+static void eth_tx_agg_seal(struct eth_tx_agg *agg, struct usb_request *req,
+			    unsigned length)
+{
+	if (length > agg->len)
+		sg_set_buf(&agg->sg[agg->nents++], &agg->pad, 1);
+	req->buf = NULL;
+	req->sg = agg->sg;
+	req->num_sgs = agg->nents;
+	req->length = length;
+}
+
+/*
+ * Send what req has aggregated so far, because the next frame would not
+ * fit in its scatterlist.  req is off tx_reqs and goes back there if it
+ * cannot be queued.
+ */
+static void eth_tx_agg_flush(struct eth_dev *dev, struct usb_request *req,
+			     struct usb_ep *in)
+{
+	unsigned	length = req->length;
+	unsigned long	flags;
+	int		retval;
+
+	if (dev->port_usb->is_fixed &&
+	    length == dev->port_usb->fixed_in_len &&
+	    (length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0) {
+		req->zero = 0;
+		length++;
+	}
+	eth_tx_agg_seal(req->context, req, length);
+	req->no_interrupt = 0;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	dev->no_tx_req_used++;
+	dev->tx_skb_hold_count = 0;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (!retval) {
+		dev->net->trans_start = jiffies;
+		return;
+	}
+
+	DBG(dev, "tx queue err %d\n", retval);
+	eth_tx_agg_done(dev, req);
+	req->length = 0;
+	dev->net->stats.tx_dropped++;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	dev->no_tx_req_used--;
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(dev->net);
+	list_add_tail(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
 static int
 rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 {
@@ -283,7 +504,14 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 		size = max_t(size_t, size, dev->port_usb->fixed_out_len);
 
 	pr_debug("%s: size: %d", __func__, size);
-	skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
+	dev->rx_skb_size = size + NET_IP_ALIGN;
+	skb = skb_dequeue(&dev->rx_skb_pool);
+	if (skb && skb_tailroom(skb) < size + NET_IP_ALIGN) {
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+	if (!skb)
+		skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
 	if (skb == NULL) {
 		DBG(dev, "no rx skb\n");
 		goto enomem;
@@ -367,7 +595,7 @@ quiesce:
 
 	default:
 		queue = 1;
-		dev_kfree_skb_any(skb);
+		skb_queue_tail(&dev->skb_done, skb);
 		dev->net->stats.rx_errors++;
 		DBG(dev, "rx status %d\n", status);
 		break;
@@ -379,7 +607,7 @@ clean:
 	spin_unlock(&dev->req_lock);
 
 	if (queue)
-		queue_work(uether_wq, &dev->rx_work);
+		napi_schedule(&dev->rx_napi);
 }
 
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
@@ -484,29 +712,31 @@ static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 	spin_unlock_irqrestore(&dev->req_lock, flags);
 }
 
-static void process_rx_w(struct work_struct *work)
+/*
+ * RX and TX cleanup in softirq context: frames go up through GRO,
+ * finished skbs are recycled for RX, and the OUT queue is refilled.
+ */
+static int eth_poll(struct napi_struct *napi, int budget)
 {
-	struct eth_dev	*dev = container_of(work, struct eth_dev, rx_work);
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, rx_napi);
 	struct sk_buff	*skb;
-	int		status = 0;
-	unsigned int uiCurMtu = 0;
+	unsigned int	uiCurMtu;
+	int		work = 0;
 
-	if (!dev->port_usb)
-		return;
+	while ((skb = skb_dequeue(&dev->skb_done)))
+		eth_skb_recycle(dev, skb);
 
 	uiCurMtu = dev->net->mtu + ETH_HLEN;
 	if ((uiCurMtu <= ETH_HLEN) || (uiCurMtu > ETH_FRAME_LEN_MAX))
 	    uiCurMtu = ETH_FRAME_LEN;
 
-	while ((skb = skb_dequeue(&dev->rx_frames))) {
-		if (status < 0
-				|| ETH_HLEN > skb->len
-			
-			    || skb->len > uiCurMtu) {
+	while (work < budget && (skb = skb_dequeue(&dev->rx_frames))) {
+		work++;
+		if (ETH_HLEN > skb->len || skb->len > uiCurMtu) {
 			dev->net->stats.rx_errors++;
 			dev->net->stats.rx_length_errors++;
 			DBG(dev, "rx length %d\n", skb->len);
-			dev_kfree_skb_any(skb);
+			eth_skb_recycle(dev, skb);
 			continue;
 		}
 		skb->protocol = eth_type_trans(skb, dev->net);
@@ -517,11 +747,19 @@ static void process_rx_w(struct work_struct *work)
         if (skb->len >= 1024)
             auto_perf_lock_enable(1);
 #endif
-		status = netif_rx_ni(skb);
+		napi_gro_receive(napi, skb);
 	}
 
-	if (netif_running(dev->net))
-		rx_fill(dev, GFP_KERNEL);
+	if (dev->port_usb && netif_running(dev->net))
+		rx_fill(dev, GFP_ATOMIC);
+
+	if (work < budget) {
+		napi_complete(napi);
+		if (!skb_queue_empty(&dev->rx_frames) ||
+		    !skb_queue_empty(&dev->skb_done))
+			napi_schedule(napi);
+	}
+	return work;
 }
 
 static void eth_work(struct work_struct *work)
@@ -546,6 +784,7 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	struct usb_ep *in;
 	int length;
 	int retval;
+	bool agg;
 
 	if (!ep->driver_data) {
 		usb_ep_free_request(ep, req);
@@ -576,10 +815,14 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	}
 	dev->net->stats.tx_packets++;
 
+	agg = req->num_sgs != 0;
+	if (agg)
+		eth_tx_agg_done(dev, req);
+
 	spin_lock(&dev->req_lock);
 	list_add_tail(&req->list, &dev->tx_reqs);
 
-	if (dev->port_usb->multi_pkt_xfer && !req->context) {
+	if (dev->port_usb->multi_pkt_xfer && (agg || !req->context)) {
 		dev->no_tx_req_used--;
 		req->length = 0;
 		in = dev->port_usb->in_ep;
@@ -605,11 +848,17 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 					length++;
 				}
 
-				new_req->length = length;
+				if (dev->tx_sg)
+					eth_tx_agg_seal(new_req->context,
+							new_req, length);
+				else
+					new_req->length = length;
 				retval = usb_ep_queue(in, new_req, GFP_ATOMIC);
 				switch (retval) {
 				default:
 					DBG(dev, "tx queue err %d\n", retval);
+					if (dev->tx_sg)
+						eth_tx_agg_done(dev, new_req);
 					new_req->length = 0;
 					spin_lock(&dev->req_lock);
 					list_add_tail(&new_req->list,
@@ -633,15 +882,15 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	} else {
 		skb = req->context;
 		
-		if (dev->port_usb->multi_pkt_xfer && dev->tx_req_bufsize) {
+		if (dev->port_usb->multi_pkt_xfer && dev->tx_req_bufsize &&
+		    !dev->tx_sg)
 			req->buf = kzalloc(dev->tx_req_bufsize, GFP_ATOMIC);
-			req->context = NULL;
-		} else {
+		else
 			req->buf = NULL;
-		}
+		req->context = NULL;
 
 		spin_unlock(&dev->req_lock);
-		dev_kfree_skb_any(skb);
+		eth_skb_done(dev, skb);
 	}
 
 	if (netif_carrier_ok(dev->net))
@@ -653,6 +902,32 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/*
+ * With a controller that does scatter-gather, aggregate frames in place
+ * instead of copying them into a buffer per request.  Requests on their
+ * way get theirs in eth_start_xmit() when they come back.
+ */
+static int alloc_tx_agg(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		req->context = eth_tx_agg_alloc(dev);
+		if (!req->context)
+			goto free_agg;
+	}
+	dev->tx_sg = true;
+	return 0;
+
+free_agg:
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		eth_tx_agg_free(req->context);
+		req->context = NULL;
+	}
+	dev->tx_req_bufsize = 0;
+	return -ENOMEM;
+}
+
 static int alloc_tx_buffer(struct eth_dev *dev)
 {
 	struct list_head	*act;
@@ -665,6 +940,10 @@ static int alloc_tx_buffer(struct eth_dev *dev)
 				+ 44
 				+ 22));
 
+	if (dev->gadget->sg_supported && dev->header_len &&
+	    eth_tx_agg_max_nents(dev) >= 3)
+		return alloc_tx_agg(dev);
+
 	list_for_each(act, &dev->tx_reqs) {
 		req = container_of(act, struct usb_request, list);
 		if (!req->buf) {
@@ -700,6 +979,8 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	struct usb_ep		*in;
 	u16			cdc_filter;
 	bool			multi_pkt_xfer = false;
+	struct eth_tx_agg	*agg;
+	unsigned		nents = 0;
 
 	if ((!skb) || (IS_ERR(skb)))
 		return NETDEV_TX_OK;
@@ -754,6 +1035,16 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		
 	}
 
+	if (multi_pkt_xfer && dev->tx_sg) {
+		nents = eth_tx_agg_nents(dev, skb);
+		if (!nents) {
+			dev_kfree_skb_any(skb);
+			dev->net->stats.tx_dropped++;
+			return NETDEV_TX_OK;
+		}
+	}
+
+again:
 	spin_lock_irqsave(&dev->req_lock, flags);
 	if (list_empty(&dev->tx_reqs)) {
 		spin_unlock_irqrestore(&dev->req_lock, flags);
@@ -768,6 +1059,16 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		netif_stop_queue(net);
 	spin_unlock_irqrestore(&dev->req_lock, flags);
 
+	/*
+	 * Close a request the frame does not fit in any more and take it to
+	 * the next one; the stack retries the frame if there is none yet.
+	 */
+	agg = req->context;
+	if (nents && agg && agg->len && !eth_tx_agg_fits(agg, nents)) {
+		eth_tx_agg_flush(dev, req, in);
+		goto again;
+	}
+
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->wrap) {
 		if (dev->port_usb)
@@ -778,7 +1079,25 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		}
 	}
 
-	if (multi_pkt_xfer) {
+	if (multi_pkt_xfer && dev->tx_sg) {
+		if (!req->context)
+			req->context = eth_tx_agg_alloc(dev);
+		retval = req->context ?
+			eth_tx_agg_add(dev, req->context, skb) : -ENOMEM;
+		spin_unlock_irqrestore(&dev->lock, flags);
+		if (retval) {
+			dev_kfree_skb_any(skb);
+			dev->net->stats.tx_dropped++;
+			spin_lock_irqsave(&dev->req_lock, flags);
+			if (list_empty(&dev->tx_reqs))
+				netif_start_queue(net);
+			list_add(&req->list, &dev->tx_reqs);
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			goto success;
+		}
+		req->length = ((struct eth_tx_agg *)req->context)->len;
+		length = req->length;
+	} else if (multi_pkt_xfer) {
 
 		pr_debug("req->length:%d header_len:%u\n"
 				"skb->len:%d skb->data_len:%d\n",
@@ -796,6 +1115,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		req->length += skb->len;
 		length = req->length;
 		dev_kfree_skb_any(skb);
+	}
+
+	if (multi_pkt_xfer) {
 
 		spin_lock_irqsave(&dev->req_lock, flags);
 		dev->tx_skb_hold_count++;
@@ -815,6 +1137,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		length = skb->len;
 		req->buf = skb->data;
 		req->context = skb;
+		req->num_sgs = 0;
 	}
 
 	
@@ -830,7 +1153,10 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		length++;
 	}
 
-	req->length = length;
+	if (multi_pkt_xfer && dev->tx_sg)
+		eth_tx_agg_seal(req->context, req, length);
+	else
+		req->length = length;
 
 	
 	if (gadget_is_dualspeed(dev->gadget) &&
@@ -863,7 +1189,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	if (retval) {
 		if (!multi_pkt_xfer)
 			dev_kfree_skb_any(skb);
-		else
+		else if (dev->tx_sg)
+			eth_tx_agg_done(dev, req);
+		if (multi_pkt_xfer)
 			req->length = 0;
 drop:
 		dev->net->stats.tx_dropped++;
@@ -896,8 +1224,11 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->rx_napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
+	/* anything that came in or finished while we were down */
+	napi_schedule(&dev->rx_napi);
 
 	spin_lock_irq(&dev->lock);
 	link = dev->port_usb;
@@ -919,6 +1250,7 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->rx_napi);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -1043,11 +1375,13 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	spin_lock_init(&dev->lock);
 	spin_lock_init(&dev->req_lock);
 	INIT_WORK(&dev->work, eth_work);
-	INIT_WORK(&dev->rx_work, process_rx_w);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	skb_queue_head_init(&dev->skb_done);
+	skb_queue_head_init(&dev->rx_skb_pool);
+	netif_napi_add(net, &dev->rx_napi, eth_poll, RX_NAPI_WEIGHT);
 
 	
 	dev->net = net;
@@ -1121,6 +1455,8 @@ struct eth_dev *dev = the_dev;
 
 	unregister_netdev(the_dev->net);
 	flush_work_sync(&the_dev->work);
+	skb_queue_purge(&the_dev->skb_done);
+	skb_queue_purge(&the_dev->rx_skb_pool);
 	free_netdev(the_dev->net);
 
 	the_dev = NULL;
@@ -1198,6 +1534,7 @@ struct net_device *gether_connect(struct gether *link)
 		dev->tx_skb_hold_count = 0;
 		dev->no_tx_req_used = 0;
 		dev->tx_req_bufsize = 0;
+		dev->tx_sg = false;
 		dev->port_usb = link;
 		link->ioport = dev;
 		if (netif_running(dev->net)) {
@@ -1253,7 +1590,10 @@ void gether_disconnect(struct gether *link)
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
-		if (link->multi_pkt_xfer) {
+		if (dev->tx_sg) {
+			eth_tx_agg_free(req->context);
+			req->context = NULL;
+		} else if (link->multi_pkt_xfer) {
 			kfree(req->buf);
 			req->buf = NULL;
 		}
@@ -1284,6 +1624,10 @@ void gether_disconnect(struct gether *link)
 	while ((skb = __skb_dequeue(&dev->rx_frames)))
 		dev_kfree_skb_any(skb);
 	spin_unlock(&dev->rx_frames.lock);
+	while ((skb = skb_dequeue(&dev->skb_done)))
+		dev_kfree_skb_any(skb);
+	while ((skb = skb_dequeue(&dev->rx_skb_pool)))
+		dev_kfree_skb_any(skb);
 
 	link->out_ep->driver_data = NULL;
 	link->out_ep->desc = NULL;
@@ -1299,22 +1643,5 @@ void gether_disconnect(struct gether *link)
 	spin_unlock(&dev->lock);
 }
 
-static int __init gether_init(void)
-{
-	uether_wq  = create_singlethread_workqueue("uether");
-	if (!uether_wq) {
-		pr_err("%s: Unable to create workqueue: uether\n", __func__);
-		return -ENOMEM;
-	}
-	return 0;
-}
-module_init(gether_init);
-
-static void __exit gether_exit(void)
-{
-	destroy_workqueue(uether_wq);
-
-}
-module_exit(gether_exit);
 MODULE_DESCRIPTION("ethernet over USB driver");
 MODULE_LICENSE("GPL v2");
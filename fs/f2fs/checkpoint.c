@@ -858,6 +858,78 @@ retry:
 	goto retry;
 }
 
+/*
+ * Start writeback of dirty dentry pages, each directory once, and unlike
+ * sync_dirty_inodes() neither waiting on pages under writeback nor for
+ * the list to run empty.
+ */
+static void preflush_dirty_dents(struct f2fs_sb_info *sbi)
+{
+	struct list_head *head = &sbi->inode_list[DIR_INODE];
+	int budget = get_pages(sbi, F2FS_DIRTY_DENTS);
+	struct f2fs_inode_info *fi;
+	struct inode *inode;
+
+	while (budget-- > 0 && !unlikely(f2fs_cp_error(sbi))) {
+		spin_lock(&sbi->inode_lock[DIR_INODE]);
+		if (list_empty(head)) {
+			spin_unlock(&sbi->inode_lock[DIR_INODE]);
+			break;
+		}
+		fi = list_first_entry(head, struct f2fs_inode_info, dirty_list);
+		/* behind the others, in case it gets dirty again */
+		list_move_tail(&fi->dirty_list, head);
+		inode = igrab(&fi->vfs_inode);
+		spin_unlock(&sbi->inode_lock[DIR_INODE]);
+
+		if (inode) {
+			filemap_flush(inode->i_mapping);
+			iput(inode);
+		}
+	}
+}
+
+/*
+ * Write back most dirty dentry and node pages while FS operations still
+ * run, so that block_operations() has little left to do with them blocked.
+ * Rounds go on while they make progress against the writers and more than
+ * cp_preflush_pages are dirty.
+ */
+static void prepare_checkpoint(struct f2fs_sb_info *sbi)
+{
+	struct blk_plug plug;
+	int dirty, last = INT_MAX;
+	int round;
+
+	/* node pages can't be written back during recovery */
+	if (is_sbi_flag_set(sbi, SBI_POR_DOING))
+		return;
+
+	blk_start_plug(&plug);
+	for (round = 0; round < DEF_CP_PREFLUSH_ROUNDS; round++) {
+		dirty = get_pages(sbi, F2FS_DIRTY_DENTS) +
+				get_pages(sbi, F2FS_DIRTY_NODES);
+		if (dirty <= sbi->cp_preflush_pages || dirty >= last ||
+				unlikely(f2fs_cp_error(sbi)))
+			break;
+		last = dirty;
+
+		if (get_pages(sbi, F2FS_DIRTY_DENTS))
+			preflush_dirty_dents(sbi);
+
+		if (get_pages(sbi, F2FS_DIRTY_NODES)) {
+			struct writeback_control wbc = {
+				.sync_mode = WB_SYNC_NONE,
+				.nr_to_write = get_pages(sbi, F2FS_DIRTY_NODES),
+				.for_reclaim = 0,
+			};
+
+			sync_node_pages(sbi, 0, &wbc);
+		}
+	}
+	blk_finish_plug(&plug);
+}
+
 /*
  * Freeze all the FS-operations for checkpoint.
  */
@@ -1110,6 +1182,16 @@ static int do_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 	return 0;
 }
 
+static ktime_t cp_phase_done(struct f2fs_sb_info *sbi, int phase,
+							ktime_t start)
+{
+	ktime_t now = ktime_get();
+
+	stat_update_cp_phase(sbi->stat_info, phase,
+				ktime_to_us(ktime_sub(now, start)));
+	return now;
+}
+
 /*
  * We guarantee that this checkpoint procedure will not fail.
  */
@@ -1117,6 +1199,7 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 {
 	struct f2fs_checkpoint *ckpt = F2FS_CKPT(sbi);
 	unsigned long long ckpt_ver;
+	ktime_t start, phase;
 	int err = 0;
 
 	mutex_lock(&sbi->cp_mutex);
@@ -1134,6 +1217,12 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 		goto out;
 	}
 
+	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "start pre-flush");
+
+	start = ktime_get();
+	prepare_checkpoint(sbi);
+	phase = cp_phase_done(sbi, CP_PHASE_PREFLUSH, start);
+
 	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "start block_ops");
 
 	err = block_operations(sbi);
@@ -1141,6 +1230,7 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 		goto out;
 
 	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "finish block_ops");
+	phase = cp_phase_done(sbi, CP_PHASE_BLOCK_OPS, phase);
 
 	f2fs_flush_merged_bios(sbi);
 
@@ -1155,12 +1245,15 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 	/* write cached NAT/SIT entries to NAT/SIT area */
 	flush_nat_entries(sbi);
 	flush_sit_entries(sbi, cpc);
+	phase = cp_phase_done(sbi, CP_PHASE_FLUSH_META, phase);
 
 	/* unlock all the fs_lock[] in do_checkpoint() */
 	err = do_checkpoint(sbi, cpc);
 
 	unblock_operations(sbi);
 	stat_inc_cp_count(sbi->stat_info);
+	cp_phase_done(sbi, CP_PHASE_COMMIT, phase);
+	cp_phase_done(sbi, CP_PHASE_TOTAL, start);
 
 	if (cpc->reason == CP_RECOVERY)
 		f2fs_msg(sbi->sb, KERN_NOTICE,
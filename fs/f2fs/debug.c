@@ -24,6 +24,13 @@
 #include "gc.h"
 
 static LIST_HEAD(f2fs_stat_list);
+static const char * const cp_phase_names[NR_CP_PHASE] = {
+	[CP_PHASE_PREFLUSH]	= "pre-flush",
+	[CP_PHASE_BLOCK_OPS]	= "block_ops",
+	[CP_PHASE_FLUSH_META]	= "nat/sit",
+	[CP_PHASE_COMMIT]	= "commit",
+	[CP_PHASE_TOTAL]	= "total",
+};
 static struct dentry *f2fs_debugfs_root;
 static DEFINE_MUTEX(f2fs_stat_mutex);
 
@@ -49,6 +56,11 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->ndirty_files = sbi->ndirty_inode[FILE_INODE];
 	si->inmem_pages = get_pages(sbi, F2FS_INMEM_PAGES);
 	si->wb_pages = get_pages(sbi, F2FS_WRITEBACK);
+	si->queued_discard = si->issued_discard = 0;
+	if (SM_I(sbi)->dcc_info) {
+		si->queued_discard = SM_I(sbi)->dcc_info->nr_queued;
+		si->issued_discard = SM_I(sbi)->dcc_info->nr_issued;
+	}
 	si->total_count = (int)sbi->user_block_count / sbi->blocks_per_seg;
 	si->rsvd_segs = reserved_segments(sbi);
 	si->overp_segs = overprovision_segments(sbi);
@@ -186,6 +198,12 @@ get_cache:
 	if (SM_I(sbi)->cmd_control_info)
 		si->cache_mem += sizeof(struct flush_cmd_control);
 
+	/* build discard thread and its commands */
+	if (SM_I(sbi)->dcc_info)
+		si->cache_mem += sizeof(struct discard_cmd_control) +
+			SM_I(sbi)->dcc_info->nr_cmds *
+					sizeof(struct discard_cmd);
+
 	/* free nids */
 	si->cache_mem += NM_I(sbi)->fcnt * sizeof(struct free_nid);
 	si->cache_mem += NM_I(sbi)->nat_cnt * sizeof(struct nat_entry);
@@ -274,6 +292,12 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->prefree_count, si->free_segs, si->free_secs);
 		seq_printf(s, "CP calls: %d (BG: %d)\n",
 				si->cp_count, si->bg_cp_count);
+		for (j = 0; j < NR_CP_PHASE; j++)
+			seq_printf(s, "  - %-10s avg: %8llu us, max: %8u us\n",
+				cp_phase_names[j], !si->cp_phase_count[j] ? 0 :
+				div_u64(si->cp_phase_total[j],
+					si->cp_phase_count[j]),
+				si->cp_phase_max[j]);
 		seq_printf(s, "GC calls: %d (BG: %d)\n",
 			   si->call_count, si->bg_gc);
 		seq_printf(s, "  - data segments : %d (%d)\n",
@@ -299,6 +323,8 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - inmem: %4d, wb: %4d\n",
 			   si->inmem_pages, si->wb_pages);
+		seq_printf(s, "  - discard: %4d queued, %4d issued\n",
+			   si->queued_discard, si->issued_discard);
 		seq_printf(s, "  - nodes: %4d in %4d\n",
 			   si->ndirty_node, si->node_pages);
 		seq_printf(s, "  - dents: %4d in dirs:%4d\n",
@@ -160,6 +160,8 @@ enum {
 		(BATCHED_TRIM_SEGMENTS(sbi) << (sbi)->log_blocks_per_seg)
 #define DEF_CP_INTERVAL			60	/* 60 secs */
 #define DEF_IDLE_INTERVAL		120	/* 2 mins */
+#define DEF_CP_PREFLUSH_PAGES		256	/* dirty pages left to block_ops */
+#define DEF_CP_PREFLUSH_ROUNDS		4	/* max. rounds of pre-flush */
 
 struct cp_control {
 	int reason;
@@ -169,6 +171,16 @@ struct cp_control {
 	__u64 trimmed;
 };
 
+/* phases of write_checkpoint(), for the timing statistics */
+enum {
+	CP_PHASE_PREFLUSH,	/* dentries and nodes, FS operations running */
+	CP_PHASE_BLOCK_OPS,	/* what is left, FS operations blocked */
+	CP_PHASE_FLUSH_META,	/* NAT and SIT entries */
+	CP_PHASE_COMMIT,	/* checkpoint pack, until unblocking */
+	CP_PHASE_TOTAL,		/* all of the above */
+	NR_CP_PHASE,
+};
+
 /*
  * For CP/NAT/SIT/SSA readahead
  */
@@ -604,6 +616,40 @@ struct flush_cmd_control {
 	struct llist_node *dispatch_list;	/* list for command dispatch */
 };
 
+/* for discard commands, merged and issued by the discard thread */
+#define DEF_MAX_DISCARD_ISSUE		8	/* # of discards in flight */
+#define DEF_DISCARD_WAKE_INTERVAL	100	/* ms between idle checks */
+
+enum {
+	D_PREP,			/* queued, not issued yet */
+	D_SUBMIT,		/* issued, in flight */
+	D_DONE,			/* completed, to be freed */
+};
+
+struct discard_cmd {
+	struct rb_node rb_node;		/* in the rb-tree ordered by address */
+	struct list_head list;		/* in the issue list once submitted */
+	struct completion wait;		/* completion of the discard bio */
+	spinlock_t lock;		/* protects D_SUBMIT -> D_DONE */
+	block_t blkaddr;		/* start block address of the discard */
+	block_t len;			/* # of blocks to be discarded */
+	int ref;			/* # of waiters on the discard */
+	int state;			/* D_PREP, D_SUBMIT or D_DONE */
+	int error;			/* result of the discard bio */
+};
+
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	wait_queue_head_t discard_wait_queue;	/* waiting queue for wake-up */
+	struct mutex cmd_lock;			/* lock for the rb-tree and lists */
+	struct rb_root root;			/* discard commands by address */
+	struct list_head issue_list;		/* submitted commands, in order */
+	unsigned int nr_cmds;			/* # of commands in the rb-tree */
+	unsigned int nr_queued;			/* # of commands not issued */
+	unsigned int nr_issued;			/* # of commands submitted */
+	block_t max_len;			/* max. blocks of one discard */
+};
+
 struct f2fs_sm_info {
 	struct sit_info *sit_info;		/* whole segment information */
 	struct free_segmap_info *free_info;	/* free segment information */
@@ -627,6 +673,10 @@ struct f2fs_sm_info {
 	int nr_discards;			/* # of discards in the list */
 	int max_discards;			/* max. discards to be issued */
 
+	/* for asynchronous discard, with the discard mount option */
+	struct discard_cmd_control *dcc_info;
+	unsigned int max_discard_issue;		/* max. discards in flight */
+
 	/* for batched trimming */
 	unsigned int trim_sections;		/* # of sections to trim */
 
@@ -761,6 +811,7 @@ struct f2fs_sb_info {
 	wait_queue_head_t cp_wait;
 	unsigned long last_time[MAX_TIME];	/* to store time in jiffies */
 	long interval_time[MAX_TIME];		/* to store thresholds */
+	unsigned int cp_preflush_pages;		/* pre-flush threshold */
 
 	struct inode_management im[MAX_INO_ENTRY];      /* manage inode cache */
 
@@ -1856,6 +1907,10 @@ void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
 void clear_prefree_segments(struct f2fs_sb_info *, struct cp_control *);
 void release_discard_addrs(struct f2fs_sb_info *);
 bool discard_next_dnode(struct f2fs_sb_info *, block_t);
+void f2fs_wait_discard_block(struct f2fs_sb_info *, block_t);
+void f2fs_flush_discard_cmds(struct f2fs_sb_info *);
+int create_discard_cmd_control(struct f2fs_sb_info *);
+void destroy_discard_cmd_control(struct f2fs_sb_info *);
 int npages_for_summary_flush(struct f2fs_sb_info *, bool);
 void allocate_new_segments(struct f2fs_sb_info *);
 int f2fs_trim_fs(struct f2fs_sb_info *, struct fstrim_range *);
@@ -1968,6 +2023,10 @@ struct f2fs_stat_info {
 	int nats, dirty_nats, sits, dirty_sits, fnids;
 	int total_count, utilization;
 	int bg_gc, inmem_pages, wb_pages;
+	int queued_discard, issued_discard;
+	unsigned int cp_phase_count[NR_CP_PHASE];
+	unsigned long long cp_phase_total[NR_CP_PHASE];	/* in usecs */
+	unsigned int cp_phase_max[NR_CP_PHASE];		/* in usecs */
 	int inline_xattr, inline_inode, inline_dir;
 	unsigned int valid_count, valid_node_count, valid_inode_count;
 	unsigned int bimodal, avg_vblocks;
@@ -1995,6 +2054,14 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 }
 
 #define stat_inc_cp_count(si)		((si)->cp_count++)
+#define stat_update_cp_phase(si, phase, us)				\
+	do {								\
+		unsigned int __us = (us);				\
+		(si)->cp_phase_count[phase]++;				\
+		(si)->cp_phase_total[phase] += __us;			\
+		if (__us > (si)->cp_phase_max[phase])			\
+			(si)->cp_phase_max[phase] = __us;		\
+	} while (0)
 #define stat_inc_bg_cp_count(si)	((si)->bg_cp_count++)
 #define stat_inc_call_count(si)		((si)->call_count++)
 #define stat_inc_bggc_count(sbi)	((sbi)->bg_gc++)
@@ -2078,6 +2145,7 @@ int __init f2fs_create_root_stats(void);
 void f2fs_destroy_root_stats(void);
 #else
 #define stat_inc_cp_count(si)
+#define stat_update_cp_phase(si, phase, us)
 #define stat_inc_bg_cp_count(si)
 #define stat_inc_call_count(si)
 #define stat_inc_bggc_count(si)
@@ -15,6 +15,7 @@
 #include <linux/prefetch.h>
 #include <linux/kthread.h>
 #include <linux/swap.h>
+#include <linux/freezer.h>
 #include <linux/timer.h>
 
 #include "f2fs.h"
@@ -26,6 +27,7 @@
 #define __reverse_ffz(x) __reverse_ffs(~(x))
 
 static struct kmem_cache *discard_entry_slab;
+static struct kmem_cache *discard_cmd_slab;
 static struct kmem_cache *sit_entry_set_slab;
 static struct kmem_cache *inmem_entry_slab;
 
@@ -647,6 +649,383 @@ static void locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno)
 	mutex_unlock(&dirty_i->seglist_lock);
 }
 
+/*
+ * Discard commands wait in an rb-tree by block address, merged with their
+ * neighbours, until the discard thread finds the device idle.  It keeps
+ * at most max_discard_issue of them in flight.  A queued command gives
+ * up a block as soon as it is allocated again; an issued one has to be
+ * waited for.
+ */
+static struct discard_cmd *__lookup_discard_cmd(struct discard_cmd_control *dcc,
+		block_t blkaddr, struct discard_cmd **prev,
+		struct discard_cmd **next)
+{
+	struct rb_node *node = dcc->root.rb_node;
+	struct discard_cmd *dc;
+
+	*prev = *next = NULL;
+	while (node) {
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		if (blkaddr < dc->blkaddr) {
+			*next = dc;
+			node = node->rb_left;
+		} else if (blkaddr >= dc->blkaddr + dc->len) {
+			*prev = dc;
+			node = node->rb_right;
+		} else {
+			return dc;
+		}
+	}
+	return NULL;
+}
+
+static struct discard_cmd *__create_discard_cmd(
+		struct discard_cmd_control *dcc, block_t blkaddr, block_t len)
+{
+	struct rb_node **p = &dcc->root.rb_node;
+	struct rb_node *parent = NULL;
+	struct discard_cmd *dc;
+
+	while (*p) {
+		parent = *p;
+		dc = rb_entry(parent, struct discard_cmd, rb_node);
+		if (blkaddr < dc->blkaddr)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	dc = f2fs_kmem_cache_alloc(discard_cmd_slab, GFP_NOFS);
+	INIT_LIST_HEAD(&dc->list);
+	init_completion(&dc->wait);
+	spin_lock_init(&dc->lock);
+	dc->blkaddr = blkaddr;
+	dc->len = len;
+	dc->ref = 0;
+	dc->state = D_PREP;
+	dc->error = 0;
+
+	rb_link_node(&dc->rb_node, parent, p);
+	rb_insert_color(&dc->rb_node, &dcc->root);
+	dcc->nr_cmds++;
+	dcc->nr_queued++;
+	return dc;
+}
+
+static void __remove_discard_cmd(struct f2fs_sb_info *sbi,
+				struct discard_cmd *dc)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (dc->state != D_PREP) {
+		list_del(&dc->list);
+		dcc->nr_issued--;
+		if (dc->error && dc->error != -EOPNOTSUPP)
+			f2fs_msg(sbi->sb, KERN_INFO,
+				"discard of %u blocks at %u failed: %d",
+				dc->len, dc->blkaddr, dc->error);
+	} else {
+		dcc->nr_queued--;
+	}
+	rb_erase(&dc->rb_node, &dcc->root);
+	dcc->nr_cmds--;
+	kmem_cache_free(discard_cmd_slab, dc);
+}
+
+/*
+ * The end_io sets D_DONE under dc->lock, cmd_lock being a mutex; taking
+ * dc->lock here also waits for it to be done with the command.
+ */
+static bool __discard_cmd_done(struct discard_cmd *dc)
+{
+	unsigned long flags;
+	bool done;
+
+	spin_lock_irqsave(&dc->lock, flags);
+	done = dc->state == D_DONE;
+	spin_unlock_irqrestore(&dc->lock, flags);
+	return done;
+}
+
+static void __put_discard_cmd(struct f2fs_sb_info *sbi, struct discard_cmd *dc)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	mutex_lock(&dcc->cmd_lock);
+	if (!--dc->ref && __discard_cmd_done(dc))
+		__remove_discard_cmd(sbi, dc);
+	mutex_unlock(&dcc->cmd_lock);
+}
+
+/* Queue [blkaddr, blkaddr + len) around what is already in the tree */
+static void __queue_discard_cmd(struct f2fs_sb_info *sbi,
+				block_t blkaddr, block_t len)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc, *prev, *next;
+	block_t end = blkaddr + len;
+
+	mutex_lock(&dcc->cmd_lock);
+	while (blkaddr < end) {
+		dc = __lookup_discard_cmd(dcc, blkaddr, &prev, &next);
+		if (dc) {
+			/* discarded already, or about to be */
+			blkaddr = dc->blkaddr + dc->len;
+			continue;
+		}
+
+		len = min(end, next ? next->blkaddr : end) - blkaddr;
+		len = min(len, dcc->max_len);
+
+		if (prev && prev->state == D_PREP &&
+				prev->blkaddr + prev->len == blkaddr &&
+				prev->len + len <= dcc->max_len) {
+			prev->len += len;
+			dc = prev;
+		} else {
+			dc = __create_discard_cmd(dcc, blkaddr, len);
+		}
+		blkaddr += len;
+
+		if (next && next->state == D_PREP &&
+				dc->blkaddr + dc->len == next->blkaddr &&
+				dc->len + next->len <= dcc->max_len) {
+			dc->len += next->len;
+			__remove_discard_cmd(sbi, next);
+		}
+	}
+	mutex_unlock(&dcc->cmd_lock);
+
+	wake_up(&dcc->discard_wait_queue);
+}
+
+/* Take blkaddr, being allocated, out of a queued command */
+static void __punch_discard_cmd(struct f2fs_sb_info *sbi,
+				struct discard_cmd *dc, block_t blkaddr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	block_t end = dc->blkaddr + dc->len;
+
+	if (dc->len == 1) {
+		__remove_discard_cmd(sbi, dc);
+	} else if (blkaddr == dc->blkaddr) {
+		dc->blkaddr++;
+		dc->len--;
+	} else if (blkaddr == end - 1) {
+		dc->len--;
+	} else {
+		dc->len = blkaddr - dc->blkaddr;
+		__create_discard_cmd(dcc, blkaddr + 1, end - blkaddr - 1);
+	}
+}
+
+void f2fs_wait_discard_block(struct f2fs_sb_info *sbi, block_t blkaddr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc, *prev, *next;
+	bool wait = false;
+
+	if (!dcc || !ACCESS_ONCE(dcc->nr_cmds))
+		return;
+
+	mutex_lock(&dcc->cmd_lock);
+	dc = __lookup_discard_cmd(dcc, blkaddr, &prev, &next);
+	if (dc && dc->state == D_PREP) {
+		__punch_discard_cmd(sbi, dc, blkaddr);
+	} else if (dc) {
+		dc->ref++;
+		wait = true;
+	}
+	mutex_unlock(&dcc->cmd_lock);
+
+	if (wait) {
+		wait_for_completion(&dc->wait);
+		__put_discard_cmd(sbi, dc);
+	}
+}
+
+static void f2fs_discard_end_io(struct bio *bio, int err)
+{
+	struct discard_cmd *dc = bio->bi_private;
+	unsigned long flags;
+
+	bio_put(bio);
+
+	/* every waiter, now or later, has to get through */
+	spin_lock_irqsave(&dc->lock, flags);
+	dc->error = err;
+	dc->state = D_DONE;
+	complete_all(&dc->wait);
+	spin_unlock_irqrestore(&dc->lock, flags);
+}
+
+static void __submit_discard_cmd(struct f2fs_sb_info *sbi,
+				struct discard_cmd *dc)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct bio *bio = f2fs_bio_alloc(1);
+
+	bio->bi_bdev = sbi->sb->s_bdev;
+	bio->bi_sector = SECTOR_FROM_BLOCK(dc->blkaddr);
+	bio->bi_size = dc->len << sbi->log_blocksize;
+	bio->bi_end_io = f2fs_discard_end_io;
+	bio->bi_private = dc;
+
+	dc->state = D_SUBMIT;
+	list_add_tail(&dc->list, &dcc->issue_list);
+	dcc->nr_queued--;
+	dcc->nr_issued++;
+
+	trace_f2fs_issue_discard(sbi->sb, dc->blkaddr, dc->len);
+	submit_bio(REQ_WRITE | REQ_DISCARD, bio);
+}
+
+/*
+ * Free finished commands and issue queued ones in address order, when
+ * the device is idle or with force, which also ignores the queue depth.
+ * Returns the oldest command still in flight, with a reference, when
+ * the queue depth holds back the rest, or with force while anything is
+ * in flight at all; NULL otherwise.
+ */
+static struct discard_cmd *__issue_discard_cmds(struct f2fs_sb_info *sbi,
+						bool force)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc, *tmp;
+	struct rb_node *node;
+	bool held = false;
+
+	mutex_lock(&dcc->cmd_lock);
+	list_for_each_entry_safe(dc, tmp, &dcc->issue_list, list)
+		if (!dc->ref && __discard_cmd_done(dc))
+			__remove_discard_cmd(sbi, dc);
+
+	for (node = rb_first(&dcc->root); node && dcc->nr_queued;
+						node = rb_next(node)) {
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		if (dc->state != D_PREP)
+			continue;
+		if (!force &&
+			dcc->nr_issued >= SM_I(sbi)->max_discard_issue) {
+			held = true;
+			break;
+		}
+		if (!force && !is_idle(sbi))
+			break;
+		__submit_discard_cmd(sbi, dc);
+	}
+
+	if (held || force) {
+		/* done ones are only left for their other waiters */
+		list_for_each_entry(dc, &dcc->issue_list, list) {
+			if (!__discard_cmd_done(dc)) {
+				dc->ref++;
+				mutex_unlock(&dcc->cmd_lock);
+				return dc;
+			}
+		}
+	}
+	mutex_unlock(&dcc->cmd_lock);
+	return NULL;
+}
+
+/* Issue every queued discard and wait for all, for FITRIM and umount */
+void f2fs_flush_discard_cmds(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd *dc;
+
+	if (!SM_I(sbi)->dcc_info)
+		return;
+
+	while ((dc = __issue_discard_cmds(sbi, true))) {
+		wait_for_completion(&dc->wait);
+		__put_discard_cmd(sbi, dc);
+	}
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	wait_queue_head_t *q = &dcc->discard_wait_queue;
+	struct discard_cmd *dc;
+
+	set_freezable();
+repeat:
+	if (kthread_should_stop())
+		return 0;
+	if (try_to_freeze())
+		goto repeat;
+
+	dc = __issue_discard_cmds(sbi, false);
+	if (dc) {
+		/* at the queue depth: go on once the oldest is done */
+		wait_for_completion(&dc->wait);
+		__put_discard_cmd(sbi, dc);
+		goto repeat;
+	}
+
+	if (ACCESS_ONCE(dcc->nr_queued))
+		/* the device is busy: look again in a while */
+		wait_event_interruptible_timeout(*q, kthread_should_stop(),
+				msecs_to_jiffies(DEF_DISCARD_WAKE_INTERVAL));
+	else
+		wait_event_interruptible(*q,
+			dcc->nr_queued || kthread_should_stop());
+	goto repeat;
+}
+
+int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct block_device *bdev = sbi->sb->s_bdev;
+	struct request_queue *q = bdev_get_queue(bdev);
+	dev_t dev = bdev->bd_dev;
+	struct discard_cmd_control *dcc;
+	unsigned int max_sectors;
+	int err = 0;
+
+	/* as blkdev_issue_discard() would split it */
+	max_sectors = min(q->limits.max_discard_sectors, UINT_MAX >> 9);
+	if (q->limits.discard_granularity)
+		max_sectors &= ~((q->limits.discard_granularity >> 9) - 1);
+	if (!blk_queue_discard(q) || !SECTOR_TO_BLOCK(max_sectors))
+		return 0;
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	mutex_init(&dcc->cmd_lock);
+	dcc->root = RB_ROOT;
+	INIT_LIST_HEAD(&dcc->issue_list);
+	dcc->max_len = SECTOR_TO_BLOCK(max_sectors);
+	SM_I(sbi)->dcc_info = dcc;
+	dcc->f2fs_issue_discard = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(dcc->f2fs_issue_discard)) {
+		err = PTR_ERR(dcc->f2fs_issue_discard);
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+		return err;
+	}
+
+	return err;
+}
+
+void destroy_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return;
+	if (dcc->f2fs_issue_discard)
+		kthread_stop(dcc->f2fs_issue_discard);
+	f2fs_flush_discard_cmds(sbi);
+	f2fs_bug_on(sbi, dcc->nr_cmds);
+	kfree(dcc);
+	SM_I(sbi)->dcc_info = NULL;
+}
+
 static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 				block_t blkstart, block_t blklen)
 {
@@ -663,6 +1042,11 @@ static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 		if (!f2fs_test_and_set_bit(offset, se->discard_map))
 			sbi->discard_blks--;
 	}
+
+	if (SM_I(sbi)->dcc_info) {
+		__queue_discard_cmd(sbi, blkstart, blklen);
+		return 0;
+	}
 	trace_f2fs_issue_discard(sbi->sb, blkstart, blklen);
 	return blkdev_issue_discard(sbi->sb->s_bdev, start, len, GFP_NOFS, 0);
 }
@@ -671,7 +1055,13 @@ bool discard_next_dnode(struct f2fs_sb_info *sbi, block_t blkaddr)
 {
 	int err = -EOPNOTSUPP;
 
-	if (test_opt(sbi, DISCARD)) {
+	/*
+	 * With asynchronous discard, rather than waiting for a discard of
+	 * one block, zero it along with the checkpoint's meta pages.
+	 */
+	if (SM_I(sbi)->dcc_info) {
+		f2fs_wait_discard_block(sbi, blkaddr);
+	} else if (test_opt(sbi, DISCARD)) {
 		struct seg_entry *se = get_seg_entry(sbi,
 				GET_SEGNO(sbi, blkaddr));
 		unsigned int offset = GET_BLKOFF_FROM_SEG0(sbi, blkaddr);
@@ -1346,6 +1736,9 @@ int f2fs_trim_fs(struct f2fs_sb_info *sbi, struct fstrim_range *range)
 		err = write_checkpoint(sbi, &cpc);
 		mutex_unlock(&sbi->gc_mutex);
 	}
+
+	/* the discards have been queued, trimmed means done */
+	f2fs_flush_discard_cmds(sbi);
 out:
 	range->len = F2FS_BLK_TO_BYTES(cpc.trimmed);
 	return err;
@@ -1440,6 +1833,9 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 
 	*new_blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
 
+	/* keep a queued or running discard off the block */
+	f2fs_wait_discard_block(sbi, *new_blkaddr);
+
 	/*
 	 * __add_sum_entry should be resided under the curseg_mutex
 	 * because, this function updates a summary entry in the
@@ -2463,6 +2859,7 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 	INIT_LIST_HEAD(&sm_info->discard_list);
 	sm_info->nr_discards = 0;
 	sm_info->max_discards = 0;
+	sm_info->max_discard_issue = DEF_MAX_DISCARD_ISSUE;
 
 	sm_info->trim_sections = DEF_BATCHED_TRIM_SECTIONS;
 
@@ -2474,6 +2871,12 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 			return err;
 	}
 
+	if (test_opt(sbi, DISCARD) && !f2fs_readonly(sbi->sb)) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			return err;
+	}
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -2589,6 +2992,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	if (!sm_info)
 		return;
 	destroy_flush_cmd_control(sbi);
+	destroy_discard_cmd_control(sbi);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
@@ -2604,10 +3008,15 @@ int __init create_segment_manager_caches(void)
 	if (!discard_entry_slab)
 		goto fail;
 
+	discard_cmd_slab = f2fs_kmem_cache_create("discard_cmd",
+			sizeof(struct discard_cmd));
+	if (!discard_cmd_slab)
+		goto destory_discard_entry;
+
 	sit_entry_set_slab = f2fs_kmem_cache_create("sit_entry_set",
 			sizeof(struct sit_entry_set));
 	if (!sit_entry_set_slab)
-		goto destory_discard_entry;
+		goto destroy_discard_cmd;
 
 	inmem_entry_slab = f2fs_kmem_cache_create("inmem_page_entry",
 			sizeof(struct inmem_pages));
@@ -2617,6 +3026,8 @@ int __init create_segment_manager_caches(void)
 
 destroy_sit_entry_set:
 	kmem_cache_destroy(sit_entry_set_slab);
+destroy_discard_cmd:
+	kmem_cache_destroy(discard_cmd_slab);
 destory_discard_entry:
 	kmem_cache_destroy(discard_entry_slab);
 fail:
@@ -2626,6 +3037,7 @@ fail:
 void destroy_segment_manager_caches(void)
 {
 	kmem_cache_destroy(sit_entry_set_slab);
+	kmem_cache_destroy(discard_cmd_slab);
 	kmem_cache_destroy(discard_entry_slab);
 	kmem_cache_destroy(inmem_entry_slab);
 }
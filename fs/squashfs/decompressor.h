@@ -23,31 +23,52 @@
  * decompressor.h
  */
 
+#include "page_actor.h"
+
 struct squashfs_decompressor {
 	void	*(*init)(struct squashfs_sb_info *, void *, int);
 	void	(*free)(void *);
-	int	(*decompress)(struct squashfs_sb_info *, void **,
-		struct buffer_head **, int, int, int, int, int);
+	int	(*decompress)(struct squashfs_sb_info *, void *,
+		struct buffer_head **, int, int, int,
+		struct squashfs_page_actor *);
 	int	id;
 	char	*name;
 	int	supported;
 };
 
-static inline void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
-	void *s)
+/*
+ * Decompressor parallelisation ("thread") operations.  These sit between
+ * squashfs_read_data() and the decompressor, and decide how many
+ * decompressor streams exist and how readers are mapped onto them.
+ */
+struct squashfs_decompressor_thread_ops {
+	void	*(*create)(struct squashfs_sb_info *, void *, int);
+	void	(*destroy)(struct squashfs_sb_info *);
+	int	(*decompress)(struct squashfs_sb_info *, struct buffer_head **,
+		int, int, int, struct squashfs_page_actor *);
+	int	(*max_decompressors)(void);
+	char	*name;
+};
+
+static inline void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
 {
-	if (msblk->decompressor)
-		msblk->decompressor->free(s);
+	if (msblk->thread_ops && msblk->stream)
+		msblk->thread_ops->destroy(msblk);
 }
 
 static inline int squashfs_decompress(struct squashfs_sb_info *msblk,
-	void **buffer, struct buffer_head **bh, int b, int offset, int length,
-	int srclength, int pages)
+	struct buffer_head **bh, int b, int offset, int length,
+	struct squashfs_page_actor *output)
 {
-	return msblk->decompressor->decompress(msblk, buffer, bh, b, offset,
-		length, srclength, pages);
+	return msblk->thread_ops->decompress(msblk, bh, b, offset, length,
+		output);
 }
 
+extern const struct squashfs_decompressor_thread_ops
+	squashfs_decompressor_single;
+extern const struct squashfs_decompressor_thread_ops
+	squashfs_decompressor_percpu;
+
 #ifdef CONFIG_SQUASHFS_XZ
 extern const struct squashfs_decompressor squashfs_xz_comp_ops;
 #endif
@@ -56,6 +77,10 @@ extern const struct squashfs_decompressor squashfs_xz_comp_ops;
 extern const struct squashfs_decompressor squashfs_lzo_comp_ops;
 #endif
 
+#ifdef CONFIG_SQUASHFS_LZ4
+extern const struct squashfs_decompressor squashfs_lz4_comp_ops;
+#endif
+
 #ifdef CONFIG_SQUASHFS_ZLIB
 extern const struct squashfs_decompressor squashfs_zlib_comp_ops;
 #endif
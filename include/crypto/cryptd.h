@@ -64,6 +64,8 @@ struct cryptd_aead *cryptd_alloc_aead(const char *alg_name,
 
 struct crypto_aead *cryptd_aead_child(struct cryptd_aead *tfm);
 
+bool cryptd_aead_queued(struct cryptd_aead *tfm);
+
 void cryptd_free_aead(struct cryptd_aead *tfm);
 
 #endif
@@ -57,6 +57,7 @@
 #define DIAG_IOCTL_REMOTE_DEV		32
 #define DIAG_IOCTL_VOTE_REAL_TIME	33
 #define DIAG_IOCTL_GET_REAL_TIME	34
+#define DIAG_IOCTL_RING_INIT		35
 #define DIAG_IOCTL_NONBLOCKING_TIMEOUT 64
 
 #define APQ8060_TOOLS_ID	4062
@@ -176,6 +177,45 @@ struct diagpkt_delay_params {
 	int *num_bytes_ptr;
 };
 
+/*
+ * Memory device ring.  DIAG_IOCTL_RING_INIT, with the size of the data
+ * area as argument (a power of two of at least a page), gives the client
+ * a ring for as long as it keeps the device open.  mmap() at offset 0
+ * maps a page of struct diag_ring_ctl followed by the data area.
+ *
+ * In memory device mode peripheral data is written to the ring instead
+ * of being returned by read().  Every record starts with a struct
+ * diag_ring_rec and is padded to DIAG_RING_REC_ALIGN.  The reader
+ * consumes records from tail up to head and hands the room back by
+ * storing the new tail, once per batch if it likes.  poll() reports
+ * POLLIN while head != tail; the driver wakes the reader at the end of
+ * each burst of data and whenever wake_bytes more have been queued
+ * (0 means half the ring).  head, tail and the size are byte counts that
+ * wrap at 2^32, offsets into the data area are taken modulo size.
+ */
+#define DIAG_RING_MAGIC		0x44524e47
+#define DIAG_RING_REC_ALIGN	8
+
+#define DIAG_RING_REC_PAD	0x0001	/* skip to the start of the data */
+#define DIAG_RING_REC_LOSS	0x0002	/* records were dropped before it */
+
+struct diag_ring_ctl {
+	uint32_t magic;
+	uint32_t size;
+	uint32_t wake_bytes;
+	uint32_t dropped;
+	uint32_t reserved0[12];
+	uint32_t head;		/* written by the driver */
+	uint32_t reserved1[15];
+	uint32_t tail;		/* written by the reader */
+};
+
+struct diag_ring_rec {
+	uint32_t len;
+	uint16_t peripheral;
+	uint16_t flags;
+};
+
 static const uint32_t msg_bld_masks_0[] = {
 	MSG_LVL_LOW,
 	MSG_LVL_MED,
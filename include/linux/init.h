@@ -93,6 +93,9 @@ void prepare_namespace(void);
 extern void (*late_time_init)(void);
 
 extern int initcall_debug;
+extern void initcall_record(initcall_t fn, const char *name,
+			    unsigned long long start_ns,
+			    unsigned long long end_ns, int ret);
 
 #endif
   
@@ -334,6 +334,8 @@ struct usb_gadget {
 	enum usb_device_speed		speed;
 	enum usb_device_speed		max_speed;
 	unsigned			sg_supported:1;
+	/* most SG entries one request may have, 0 if not limited */
+	unsigned			max_sgs;
 	unsigned			is_otg:1;
 	unsigned			is_a_peripheral:1;
 	unsigned			b_hnp_enable:1;
@@ -8,6 +8,8 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/async.h>
+#include <linux/ktime.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -569,7 +571,7 @@ static void __init clean_rootfs(void)
 }
 #endif
 
-static int __init populate_rootfs(void)
+static void __init do_populate_rootfs(void *unused, async_cookie_t cookie)
 {
 	char *err = unpack_to_rootfs(__initramfs_start, __initramfs_size);
 	if (err)
@@ -582,7 +584,7 @@ static int __init populate_rootfs(void)
 			initrd_end - initrd_start);
 		if (!err) {
 			free_initrd();
-			return 0;
+			return;
 		} else {
 			clean_rootfs();
 			unpack_to_rootfs(__initramfs_start, __initramfs_size);
@@ -606,6 +608,53 @@ static int __init populate_rootfs(void)
 		free_initrd();
 #endif
 	}
+}
+
+static int __initdata initramfs_async = 1;
+
+static int __init initramfs_async_setup(char *str)
+{
+	get_option(&str, &initramfs_async);
+	return 1;
+}
+__setup("initramfs_async=", initramfs_async_setup);
+
+/*
+ * Unpacking a large compressed initramfs is pure CPU work that nothing
+ * needs until the first userspace program runs, so it is done in the
+ * background while the device and late initcalls probe the hardware.
+ * Everything that might look at rootfs calls wait_for_initramfs() first.
+ */
+static ASYNC_DOMAIN_EXCLUSIVE(initramfs_domain);
+static async_cookie_t initramfs_cookie;
+
+void wait_for_initramfs(void)
+{
+	/* nothing to wait for before rootfs_initcall */
+	if (!initramfs_cookie)
+		return;
+	async_synchronize_cookie_domain(initramfs_cookie + 1, &initramfs_domain);
+}
+
+static void __init populate_rootfs_async(void *unused, async_cookie_t cookie)
+{
+	ktime_t calltime, rettime;
+
+	calltime = ktime_get();
+	do_populate_rootfs(unused, cookie);
+	rettime = ktime_get();
+
+	if (initcall_debug)
+		initcall_record(NULL, "populate_rootfs", ktime_to_ns(calltime),
+				ktime_to_ns(rettime), 0);
+}
+
+static int __init populate_rootfs(void)
+{
+	initramfs_cookie = async_schedule_domain(populate_rootfs_async, NULL,
+						 &initramfs_domain);
+	if (!initramfs_async)
+		wait_for_initramfs();
 	return 0;
 }
 rootfs_initcall(populate_rootfs);
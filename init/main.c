@@ -69,6 +69,8 @@
 #include <linux/slab.h>
 #include <linux/perf_event.h>
 #include <linux/random.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -591,6 +593,123 @@ core_param(initcall_debug, initcall_debug, int, 0644);
 
 static char msgbuf[64];
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * With initcall_debug, the start and end of every initcall and of every
+ * asynchronous driver probe during boot are kept for the initcall_times
+ * file in debugfs.  The sum of the durations against the wall clock time
+ * from the first start to the last end shows what running probes in
+ * parallel saves.  Module loads after boot are not recorded: the list
+ * would grow with every one of them and their init functions go away.
+ */
+struct initcall_time {
+	struct list_head list;
+	initcall_t fn;
+	const char *name;
+	unsigned long long start_ns;
+	unsigned long long end_ns;
+	int ret;
+};
+
+static LIST_HEAD(initcall_times);
+static DEFINE_MUTEX(initcall_times_lock);
+
+void initcall_record(initcall_t fn, const char *name,
+		     unsigned long long start_ns, unsigned long long end_ns,
+		     int ret)
+{
+	struct initcall_time *t;
+
+	if (system_state != SYSTEM_BOOTING)
+		return;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return;
+
+	if (name) {
+		t->name = kstrdup(name, GFP_KERNEL);
+		if (!t->name) {
+			kfree(t);
+			return;
+		}
+	}
+	t->fn = fn;
+	t->start_ns = start_ns;
+	t->end_ns = end_ns;
+	t->ret = ret;
+
+	mutex_lock(&initcall_times_lock);
+	list_add_tail(&t->list, &initcall_times);
+	mutex_unlock(&initcall_times_lock);
+}
+
+static int initcall_times_show(struct seq_file *m, void *v)
+{
+	unsigned long long first = ULLONG_MAX, last = 0, work = 0;
+	struct initcall_time *t;
+	unsigned int count = 0;
+
+	seq_printf(m, "#    start_us       end_us      usecs  ret  initcall\n");
+
+	mutex_lock(&initcall_times_lock);
+	list_for_each_entry(t, &initcall_times, list) {
+		unsigned long long usecs = (t->end_ns - t->start_ns) >> 10;
+
+		seq_printf(m, "%12llu %12llu %10llu %4d  ",
+			   t->start_ns >> 10, t->end_ns >> 10, usecs, t->ret);
+		if (t->fn)
+			seq_printf(m, "%pF\n", t->fn);
+		else
+			seq_printf(m, "%s\n", t->name);
+
+		first = min(first, t->start_ns);
+		last = max(last, t->end_ns);
+		/* waiting for the asynchronous probes is not work */
+		if (t->fn || strcmp(t->name, "wait_for_device_probe"))
+			work += t->end_ns - t->start_ns;
+		count++;
+	}
+	mutex_unlock(&initcall_times_lock);
+
+	if (count)
+		seq_printf(m, "# boot: %u calls, %llu usecs of work in "
+			   "%llu usecs\n", count, work >> 10,
+			   (last - first) >> 10);
+
+	return 0;
+}
+
+static int initcall_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, initcall_times_show, NULL);
+}
+
+static const struct file_operations initcall_times_fops = {
+	.open		= initcall_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init initcall_times_init(void)
+{
+	if (!initcall_debug)
+		return 0;
+
+	debugfs_create_file("initcall_times", S_IRUSR, NULL, NULL,
+			    &initcall_times_fops);
+	return 0;
+}
+late_initcall(initcall_times_init);
+#else
+void initcall_record(initcall_t fn, const char *name,
+		     unsigned long long start_ns, unsigned long long end_ns,
+		     int ret)
+{
+}
+#endif
+
 static int __init_or_module do_one_initcall_debug(initcall_t fn)
 {
 	ktime_t calltime, delta, rettime;
@@ -611,6 +730,9 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 		printk(KERN_DEBUG "initcall %pF returned %d after %lld usecs\n", fn,
 			ret, duration);
 
+	initcall_record(fn, NULL, ktime_to_ns(calltime), ktime_to_ns(rettime),
+			ret);
+
 	return ret;
 }
 
@@ -695,12 +817,50 @@ static void __init do_initcall_level(int level)
 		do_one_initcall(*fn);
 }
 
+/*
+ * Drivers that probe asynchronously must be done before the late
+ * initcalls, which among other things start deferred probing and expect
+ * to find all devices known so far bound.
+ */
+static void __init wait_for_async_probe(void)
+{
+	ktime_t calltime, rettime;
+
+	calltime = ktime_get();
+	wait_for_device_probe();
+	rettime = ktime_get();
+
+	if (initcall_debug)
+		initcall_record(NULL, "wait_for_device_probe",
+				ktime_to_ns(calltime), ktime_to_ns(rettime), 0);
+}
+
+/*
+ * The initramfs is unpacked in the background; this is the point where
+ * the boot has to wait for it, right before rootfs is first looked at.
+ */
+static void __init wait_for_rootfs(void)
+{
+	ktime_t calltime, rettime;
+
+	calltime = ktime_get();
+	wait_for_initramfs();
+	rettime = ktime_get();
+
+	if (initcall_debug)
+		initcall_record(NULL, "wait_for_initramfs",
+				ktime_to_ns(calltime), ktime_to_ns(rettime), 0);
+}
+
 static void __init do_initcalls(void)
 {
 	int level;
 
-	for (level = 0; level < ARRAY_SIZE(initcall_levels) - 1; level++)
+	for (level = 0; level < ARRAY_SIZE(initcall_levels) - 1; level++) {
+		if (initcall_levels[level] == __initcall7_start)
+			wait_for_async_probe();
 		do_initcall_level(level);
+	}
 }
 
 static void __init do_basic_setup(void)
@@ -787,7 +947,8 @@ static int __init kernel_init(void * unused)
 
 	do_basic_setup();
 
-	
+	wait_for_rootfs();
+
 	if (sys_open((const char __user *) "/dev/console", O_RDWR, 0) < 0)
 		printk(KERN_WARNING "Warning: unable to open an initial console.\n");
 
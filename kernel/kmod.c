@@ -33,6 +33,7 @@
 #include <linux/mount.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
+#include <linux/initrd.h>
 #include <linux/resource.h>
 #include <linux/notifier.h>
 #include <linux/suspend.h>
@@ -211,6 +212,9 @@ static int ____call_usermodehelper(void *data)
 
 	commit_creds(new);
 
+	/* the helper may live in an initramfs that is still being unpacked */
+	wait_for_initramfs();
+
 	retval = kernel_execve(sub_info->path,
 			       (const char *const *)sub_info->argv,
 			       (const char *const *)sub_info->envp);
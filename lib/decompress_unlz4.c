@@ -31,6 +31,147 @@
 #define LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE (8 << 20)
 #define ARCHIVE_MAGICNUMBER 0x184C2102
 
+#if !defined(PREBOOT) && defined(CONFIG_SMP)
+#include <linux/async.h>
+#include <linux/cpumask.h>
+#include <linux/kernel.h>
+
+/*
+ * The chunks of the legacy format are compressed independently of each
+ * other, so when the whole input is in memory and the output goes to a
+ * flush function, as it does for the initramfs, a batch of chunks can be
+ * decompressed on several CPUs at once and then flushed in order.  The
+ * batch size bounds the memory used for output buffers, and a buffer is
+ * only allocated once there is a chunk for it: an initramfs of a single
+ * chunk needs none besides the caller's.
+ */
+#define UNLZ4_MAX_PARALLEL	4
+
+struct unlz4_chunk {
+	u8 *inp;
+	size_t chunksize;
+	u8 *outp;
+	size_t dest_len;
+	int hdrlen;		/* magic and length words in front of it */
+	int ret;
+};
+
+static ASYNC_DOMAIN_EXCLUSIVE(unlz4_domain);
+
+static void INIT unlz4_one_chunk(void *data, async_cookie_t cookie)
+{
+	struct unlz4_chunk *c = data;
+
+	c->dest_len = LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE;
+	c->ret = lz4_decompress_unknownoutputsize(c->inp, c->chunksize,
+						   c->outp, &c->dest_len);
+}
+
+/*
+ * Takes the next chunk, and the magic words in front of it, off the
+ * input.  It is checked as the serial loop checks it, and also against
+ * the input left, before anything reads it: returns the error or NULL.
+ */
+static char * INIT unlz4_take_chunk(struct unlz4_chunk *c, u8 **inp,
+				    int *size)
+{
+	c->hdrlen = 0;
+	do {
+		if (*size < 4)
+			return "data corrupted";
+		c->chunksize = get_unaligned_le32(*inp);
+		*inp += 4;
+		*size -= 4;
+		c->hdrlen += 4;
+	} while (c->chunksize == ARCHIVE_MAGICNUMBER);
+
+	if (c->chunksize >
+	    lz4_compressbound(LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE))
+		return "chunk length is longer than allocated";
+	if (c->chunksize > (size_t)*size)
+		return "data corrupted";
+
+	c->inp = *inp;
+	*inp += c->chunksize;
+	*size -= c->chunksize;
+	return NULL;
+}
+
+/*
+ * Returns 0 on success, -1 on error and 1 if there is no point in going
+ * parallel, in which case nothing has been consumed.  As in the serial
+ * loop, the chunks in front of a bad one are flushed before it fails.
+ */
+static int INIT unlz4_parallel(u8 *inp, int size,
+			       int (*flush) (void *, unsigned int),
+			       u8 *outp, int *posp,
+			       void (*error) (char *x))
+{
+	struct unlz4_chunk c[UNLZ4_MAX_PARALLEL];
+	int nr = min_t(int, num_online_cpus(), UNLZ4_MAX_PARALLEL);
+	bool done = false;
+	char *msg = NULL;
+	int ret = -1;
+	int i, n;
+
+	if (nr < 2)
+		return 1;
+
+	c[0].outp = outp;
+	for (i = 1; i < UNLZ4_MAX_PARALLEL; i++)
+		c[i].outp = NULL;
+
+	while (!done) {
+		for (n = 0; n < nr && !done; ) {
+			if (!c[n].outp) {
+				c[n].outp = large_malloc(
+					LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE);
+				/* go on with the buffers there are */
+				if (!c[n].outp) {
+					nr = n;
+					break;
+				}
+			}
+
+			msg = unlz4_take_chunk(&c[n], &inp, &size);
+			if (msg || !size)
+				done = true;
+			if (!msg)
+				n++;
+		}
+
+		for (i = 0; i < n; i++)
+			async_schedule_domain(unlz4_one_chunk, &c[i],
+					      &unlz4_domain);
+		async_synchronize_full_domain(&unlz4_domain);
+
+		for (i = 0; i < n; i++) {
+			if (posp)
+				*posp += c[i].hdrlen;
+			if (c[i].ret < 0) {
+				error("Decoding failed");
+				goto out;
+			}
+			if (flush(c[i].outp, c[i].dest_len) != c[i].dest_len)
+				goto out;
+			if (posp)
+				*posp += c[i].chunksize;
+		}
+	}
+
+	if (msg) {
+		error(msg);
+		goto out;
+	}
+	ret = 0;
+out:
+	for (i = 1; i < UNLZ4_MAX_PARALLEL; i++)
+		if (c[i].outp)
+			large_free(c[i].outp);
+	return ret;
+}
+#endif
+
 STATIC inline int INIT unlz4(u8 *input, int in_len,
 				int (*fill) (void *, unsigned int),
 				int (*flush) (void *, unsigned int),
@@ -98,6 +239,14 @@ STATIC inline int INIT unlz4(u8 *input, int in_len,
 	if (posp)
 		*posp += 4;
 
+#if !defined(PREBOOT) && defined(CONFIG_SMP)
+	if (input && flush && !output) {
+		ret = unlz4_parallel(inp, size, flush, outp, posp, error);
+		if (ret <= 0)
+			goto exit_2;
+	}
+#endif
+
 	for (;;) {
 
 		if (fill)
@@ -47,6 +47,47 @@
 
 #include "lz4defs.h"
 
+/*
+ * Matches at offset 1 or 2 (and 4 on 64-bit) repeat a pattern of a word
+ * or less, runs of zeroes in zram pages being the common case.  Such a
+ * pattern is written a word at a time, which avoids the overlapping
+ * copy that would otherwise start bytewise.  Returns the end of the
+ * match, or NULL if the offset is a different one or the match reaches
+ * into the last COPYLENGTH bytes, which need the careful tail copy.
+ */
+static inline BYTE *lz4_pattern_copy(BYTE *op, const BYTE *ref,
+				     size_t length, BYTE *const oend)
+{
+	BYTE *const end = op + length + MINMATCH;
+	u32 pat;
+
+	if (end > oend - COPYLENGTH)
+		return NULL;
+
+	switch (op - ref) {
+	case 1:
+		pat = ref[0] * 0x01010101U;
+		break;
+	case 2:
+		pat = A16(ref);
+		pat |= pat << 16;
+		break;
+	case 4:
+		pat = A32(ref);
+		break;
+	default:
+		return NULL;
+	}
+
+	do {
+		PUT4(&pat, op);
+		op += 4;
+		PUT4(&pat, op);
+		op += 4;
+	} while (op < end);
+	return end;
+}
+
 static int lz4_uncompress(const char *source, char *dest, int osize)
 {
 	const BYTE *ip = (const BYTE *) source;
@@ -120,6 +161,11 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 #else
 			const int dec64 = 0;
 #endif
+			cpy = lz4_pattern_copy(op, ref, length, oend);
+			if (cpy) {
+				op = cpy;
+				continue;
+			}
 			op[0] = ref[0];
 			op[1] = ref[1];
 			op[2] = ref[2];
@@ -139,7 +185,8 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 			/* Error: request to write beyond destination buffer */
 			if (cpy > oend)
 				goto _output_error;
-			LZ4_SECURECOPY(ref, op, (oend - COPYLENGTH));
+			if (op < oend - COPYLENGTH)
+				LZ4_WILDCOPY16(ref, op, (oend - COPYLENGTH));
 			while (op < cpy)
 				*op++ = *ref++;
 			op = cpy;
@@ -151,7 +198,7 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 				goto _output_error;
 			continue;
 		}
-		LZ4_SECURECOPY(ref, op, cpy);
+		LZ4_WILDCOPY16(ref, op, cpy);
 		op = cpy; /* correction */
 	}
 	/* end of decoding */
@@ -250,6 +297,11 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 #else
 			const int dec64 = 0;
 #endif
+				cpy = lz4_pattern_copy(op, ref, length, oend);
+				if (cpy) {
+					op = cpy;
+					continue;
+				}
 				op[0] = ref[0];
 				op[1] = ref[1];
 				op[2] = ref[2];
@@ -268,7 +320,8 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 			if (cpy > oend)
 				goto _output_error; /* write outside of buf */
 
-			LZ4_SECURECOPY(ref, op, (oend - COPYLENGTH));
+			if (op < oend - COPYLENGTH)
+				LZ4_WILDCOPY16(ref, op, (oend - COPYLENGTH));
 			while (op < cpy)
 				*op++ = *ref++;
 			op = cpy;
@@ -280,7 +333,7 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 				goto _output_error;
 			continue;
 		}
-		LZ4_SECURECOPY(ref, op, cpy);
+		LZ4_WILDCOPY16(ref, op, cpy);
 		op = cpy; /* correction */
 	}
 	/* end of decoding */
@@ -25,9 +25,7 @@
 typedef struct _U16_S { u16 v; } U16_S;
 typedef struct _U32_S { u32 v; } U32_S;
 typedef struct _U64_S { u64 v; } U64_S;
-#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)		\
-	|| defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6	\
-	&& defined(ARM_EFFICIENT_UNALIGNED_ACCESS)
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
 
 #define A16(x) (((U16_S *)(x))->v)
 #define A32(x) (((U32_S *)(x))->v)
@@ -35,6 +33,29 @@ typedef struct _U64_S { u64 v; } U64_S;
 
 #define PUT4(s, d) (A32(d) = A32(s))
 #define PUT8(s, d) (A64(d) = A64(s))
+#define LZ4_WRITE_LITTLEENDIAN_16(p, v)	\
+	do {	\
+		A16(p) = v; \
+		p += 2; \
+	} while (0)
+#elif defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 7
+/*
+ * ARMv7 does unaligned ldr/ldrh/str/strh in hardware, but not ldrd/ldm.
+ * Accesses through packed structures let the compiler use single loads
+ * and stores instead of the byte-by-byte accessors of <asm/unaligned.h>.
+ * 64-bit accesses are never needed on 32-bit ARM.
+ */
+typedef struct _U16_P { u16 v; } __attribute__((packed)) U16_P;
+typedef struct _U32_P { u32 v; } __attribute__((packed)) U32_P;
+
+#define A64(x) get_unaligned((u64 *)(x))
+#define A32(x) (((U32_P *)(x))->v)
+#define A16(x) (((U16_P *)(x))->v)
+
+#define PUT4(s, d) (A32(d) = A32(s))
+#define PUT8(s, d) \
+	put_unaligned(get_unaligned((const u64 *) s), (u64 *) d)
+
 #define LZ4_WRITE_LITTLEENDIAN_16(p, v)	\
 	do {	\
 		A16(p) = v; \
@@ -148,6 +169,19 @@ typedef struct _U64_S { u64 v; } U64_S;
 		LZ4_COPYPACKET(s, d);	\
 	} while (d < e)
 
+/*
+ * Like LZ4_WILDCOPY, but two packets per iteration, checking d against e
+ * after each, so the overrun past e stays below COPYLENGTH as the callers'
+ * bounds checks assume.  The first packet is always copied.
+ */
+#define LZ4_WILDCOPY16(s, d, e)			\
+	do {					\
+		LZ4_COPYPACKET(s, d);		\
+		if ((d) >= (e))			\
+			break;			\
+		LZ4_COPYPACKET(s, d);		\
+	} while ((d) < (e))
+
 #define LZ4_BLINDCOPY(s, d, l)	\
 	do {	\
 		u8 *e = (d) + l;	\
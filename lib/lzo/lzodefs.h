@@ -33,10 +33,18 @@
 #define LZO_USE_CTZ32	1
 #endif
 
+/*
+ * Version 1 of the bitstream (LZO-RLE) starts with the bytes 17, 1, which
+ * a version 0 compressor never emits, and uses the M4 instruction with
+ * the otherwise maximal distance 0xbfff to encode runs of zeroes.
+ */
+#define LZO_VERSION	1
+
 #define M1_MAX_OFFSET	0x0400
 #define M2_MAX_OFFSET	0x0800
 #define M3_MAX_OFFSET	0x4000
-#define M4_MAX_OFFSET	0xbfff
+#define M4_MAX_OFFSET_V0	0xbfff
+#define M4_MAX_OFFSET_V1	0xbffe
 
 #define M1_MIN_LEN	2
 #define M1_MAX_LEN	2
@@ -52,6 +60,9 @@
 #define M3_MARKER	32
 #define M4_MARKER	16
 
+#define MIN_ZERO_RUN_LENGTH	4
+#define MAX_ZERO_RUN_LENGTH	(2047 + MIN_ZERO_RUN_LENGTH)
+
 #define lzo_dict_t      unsigned short
 #define D_BITS		13
 #define D_SIZE		(1u << D_BITS)
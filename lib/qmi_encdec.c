@@ -18,6 +18,10 @@
 #include <linux/errno.h>
 #include <linux/io.h>
 #include <linux/string.h>
+#include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
+#include <linux/rculist.h>
 #include <linux/qmi_encdec.h>
 
 #include "qmi_encdec_priv.h"
@@ -25,6 +29,9 @@
 #define TLV_LEN_SIZE sizeof(uint16_t)
 #define TLV_TYPE_SIZE sizeof(uint8_t)
 
+#define QMI_ENCDEC_MAX_LEVEL 8
+#define QMI_PLAN_HASH_BITS 6
+
 #ifdef CONFIG_QMI_ENCDEC_DEBUG
 
 #define qmi_encdec_dump(prefix_str, buf, buf_len) do { \
@@ -80,45 +87,133 @@
 
 #endif
 
-static int _qmi_kernel_encode(struct elem_info *ei_array,
-			      void *out_buf, void *in_c_struct,
-			      uint32_t out_buf_len, int enc_level);
-
-static int _qmi_kernel_decode(struct elem_info *ei_array,
-			      void *out_c_struct,
-			      void *in_buf, uint32_t in_buf_len,
-			      int dec_level);
+/*
+ * Descriptors are not interpreted from their elem_info arrays on each
+ * message.  The first use compiles an array, and those it nests, into a
+ * plan: a flat array of ops, with the index to continue at when an
+ * element is left out and a table from TLV type to op.
+ *
+ * Plans are cached, keyed by element info array, for arrays in the data
+ * of the kernel or of a module, which is where generated descriptors
+ * live.  The plans of a module are dropped when it is unloaded.  Other
+ * arrays may not outlive the call and are compiled for each message.
+ */
+static struct hlist_head qmi_plan_hash[1 << QMI_PLAN_HASH_BITS];
+static DEFINE_MUTEX(qmi_plan_lock);
 
 /**
- * qmi_calc_max_msg_len() - Calculate the maximum length of a QMI message
+ * qmi_count_ops() - Count the ops needed to compile a structure
  * @ei_array: Struct info array describing the structure.
  * @level: Level to identify the depth of the nested structures.
  *
- * @return: expected maximum length of the QMI message or 0 on failure.
+ * @return: number of ops, including those of the nested structures and
+ *          the QMI_EOTI ends, < 0 on error.
  */
-static int qmi_calc_max_msg_len(struct elem_info *ei_array,
-				int level)
+static int qmi_count_ops(struct elem_info *ei_array, int level)
 {
-	int max_msg_len = 0;
 	struct elem_info *temp_ei;
+	int nr_ops = 1, rc;
 
-	if (!ei_array)
-		return max_msg_len;
+	if (!ei_array || level > QMI_ENCDEC_MAX_LEVEL)
+		return -EINVAL;
 
 	for (temp_ei = ei_array; temp_ei->data_type != QMI_EOTI; temp_ei++) {
-		/* Flag to identify the optional element is not encoded */
-		if (temp_ei->data_type == QMI_OPT_FLAG)
+		nr_ops++;
+		if (temp_ei->data_type == QMI_STRUCT) {
+			rc = qmi_count_ops(temp_ei->ei_array, level + 1);
+			if (rc < 0)
+				return rc;
+			nr_ops += rc;
+		}
+		if (nr_ops > USHRT_MAX)
+			return -E2BIG;
+	}
+	return nr_ops;
+}
+
+/**
+ * qmi_compile_ops() - Compile a structure into ops
+ * @plan: Plan being compiled.
+ * @ei_array: Struct info array describing the structure.
+ * @next_op: Index of the first unused op, advanced past the ops used.
+ * @level: Level to identify the depth of the nested structures.
+ *
+ * @return: maximum encoded length of the structure, < 0 on error.
+ *
+ * The ops of a structure are contiguous and end with a QMI_EOTI op.  The
+ * ops of its nested structures follow.
+ */
+static int qmi_compile_ops(struct qmi_plan *plan, struct elem_info *ei_array,
+			   unsigned int *next_op, int level)
+{
+	unsigned int first = *next_op, nr = 0, i, j;
+	struct elem_info *temp_ei;
+	struct qmi_op *op;
+	uint64_t max_msg_len = 0, size;
+	int rc;
+
+	while (ei_array[nr].data_type != QMI_EOTI)
+		nr++;
+	*next_op += nr + 1;
+
+	for (i = 0; i < nr; i++) {
+		temp_ei = &ei_array[i];
+		op = &plan->ops[first + i];
+		op->data_type = temp_ei->data_type;
+		op->is_array = temp_ei->is_array;
+		op->tlv_type = temp_ei->tlv_type;
+		op->elem_len = temp_ei->elem_len;
+		op->elem_size = temp_ei->elem_size;
+		op->offset = temp_ei->offset;
+
+		/* Left out elements are skipped up to the next TLV type */
+		for (j = i + 1; j < nr; j++)
+			if (ei_array[j].tlv_type != temp_ei->tlv_type)
+				break;
+		op->skip = first + j;
+
+		size = (uint64_t)temp_ei->elem_len * temp_ei->elem_size;
+		if (size > INT_MAX)
+			goto inval;
+
+		switch (temp_ei->data_type) {
+		case QMI_OPT_FLAG:
 			continue;
 
-		if (temp_ei->data_type == QMI_DATA_LEN) {
-			max_msg_len += (temp_ei->elem_size == sizeof(uint8_t) ?
-					sizeof(uint8_t) : sizeof(uint16_t));
+		case QMI_DATA_LEN:
+			if (temp_ei->elem_size > sizeof(uint32_t))
+				goto inval;
+			op->len_size = temp_ei->elem_size == sizeof(uint8_t) ?
+					sizeof(uint8_t) : sizeof(uint16_t);
+			/*
+			 * Inside a structure an empty array still has its
+			 * length encoded, only the array is skipped.
+			 */
+			if (level > 1)
+				op->skip = first + min(i + 2, nr);
+			max_msg_len += op->len_size;
 			continue;
-		} else if (temp_ei->data_type == QMI_STRUCT) {
-			max_msg_len += qmi_calc_max_msg_len(temp_ei->ei_array,
-							    (level + 1));
-		} else {
-			max_msg_len += (temp_ei->elem_len * temp_ei->elem_size);
+
+		case QMI_UNSIGNED_1_BYTE:
+		case QMI_UNSIGNED_2_BYTE:
+		case QMI_UNSIGNED_4_BYTE:
+		case QMI_UNSIGNED_8_BYTE:
+		case QMI_SIGNED_2_BYTE_ENUM:
+		case QMI_SIGNED_4_BYTE_ENUM:
+			max_msg_len += size;
+			break;
+
+		case QMI_STRUCT:
+			op->sub = *next_op;
+			rc = qmi_compile_ops(plan, temp_ei->ei_array, next_op,
+					     level + 1);
+			if (rc < 0)
+				return rc;
+			max_msg_len += (uint64_t)temp_ei->elem_len * rc;
+			break;
+
+		default:
+			goto inval;
 		}
 
 		/*
@@ -128,165 +223,175 @@ static int qmi_calc_max_msg_len(struct elem_info *ei_array,
 		if (level == 1)
 			max_msg_len += (TLV_TYPE_SIZE + TLV_LEN_SIZE);
 	}
+	plan->ops[first + nr].data_type = QMI_EOTI;
+
+	if (max_msg_len > INT_MAX)
+		return -EINVAL;
 	return max_msg_len;
+
+inval:
+	pr_err("%s: Invalid element %u, data type %d\n",
+		__func__, i, ei_array[i].data_type);
+	return -EINVAL;
 }
 
 /**
- * qmi_verify_max_msg_len() - Verify the maximum length of a QMI message
- * @desc: Pointer to structure descriptor.
+ * qmi_compile() - Compile a struct info array into a plan
+ * @ei_array: Struct info array describing the message.
  *
- * @return: true if the maximum message length embedded in structure
- *          descriptor matches the calculated value, else false.
+ * @return: the plan on success, ERR_PTR() on error.
  */
-bool qmi_verify_max_msg_len(struct msg_desc *desc)
+static struct qmi_plan *qmi_compile(struct elem_info *ei_array)
 {
-	int calc_max_msg_len;
+	struct qmi_plan *plan;
+	unsigned int next_op = 0, i;
+	int nr_ops, rc;
+
+	nr_ops = qmi_count_ops(ei_array, 1);
+	if (nr_ops < 0)
+		return ERR_PTR(nr_ops);
+
+	plan = kzalloc(sizeof(*plan) + nr_ops * sizeof(struct qmi_op),
+		       GFP_KERNEL);
+	if (!plan)
+		return ERR_PTR(-ENOMEM);
+	plan->ei_array = ei_array;
+	plan->nr_ops = nr_ops;
+
+	rc = qmi_compile_ops(plan, ei_array, &next_op, 1);
+	if (rc < 0) {
+		kfree(plan);
+		return ERR_PTR(rc);
+	}
+	plan->max_msg_len = rc;
 
-	if (!desc)
-		return false;
+	/* The first element of a TLV type is where its decoding starts */
+	for (i = 0; plan->ops[i].data_type != QMI_EOTI; i++)
+		if (!plan->tlv_index[plan->ops[i].tlv_type])
+			plan->tlv_index[plan->ops[i].tlv_type] = i + 1;
 
-	calc_max_msg_len = qmi_calc_max_msg_len(desc->ei_array, 1);
-	if (calc_max_msg_len != desc->max_msg_len) {
-		pr_err("%s: Calc. len %d != Passed len %d\n",
-			__func__, calc_max_msg_len, desc->max_msg_len);
-		return false;
-	}
-	return true;
+	return plan;
 }
 
-/**
- * qmi_kernel_encode() - Encode to QMI message wire format
- * @desc: Pointer to structure descriptor.
- * @out_buf: Buffer to hold the encoded QMI message.
- * @out_buf_len: Length of the out buffer.
- * @in_c_struct: C Structure to be encoded.
- *
- * @return: size of encoded message on success, < 0 for error.
- */
-int qmi_kernel_encode(struct msg_desc *desc,
-		      void *out_buf, uint32_t out_buf_len,
-		      void *in_c_struct)
+static struct hlist_head *qmi_plan_bucket(struct elem_info *ei_array)
 {
-	int enc_level = 1;
-	int ret, calc_max_msg_len;
+	return &qmi_plan_hash[hash_ptr(ei_array, QMI_PLAN_HASH_BITS)];
+}
 
-	if (!desc || !desc->ei_array)
-		return -EINVAL;
+/* Called under rcu_read_lock() or qmi_plan_lock */
+static struct qmi_plan *qmi_lookup_plan(struct elem_info *ei_array)
+{
+	struct qmi_plan *plan;
+	struct hlist_node *pos;
 
-	if (!out_buf || !in_c_struct)
-		return -EINVAL;
+	hlist_for_each_entry_rcu(plan, pos, qmi_plan_bucket(ei_array), node)
+		if (plan->ei_array == ei_array)
+			return plan;
+	return NULL;
+}
 
-	if (desc->max_msg_len < out_buf_len)
-		return -ETOOSMALL;
+static bool qmi_plan_cacheable(struct elem_info *ei_array)
+{
+	unsigned long addr = (unsigned long)ei_array;
+	struct module *mod;
+	bool ret;
 
-	ret = _qmi_kernel_encode(desc->ei_array, out_buf,
-				 in_c_struct, out_buf_len, enc_level);
-	if (ret == -ETOOSMALL) {
-		calc_max_msg_len = qmi_calc_max_msg_len(desc->ei_array, 1);
-		pr_err("%s: Calc. len %d != Out buf len %d\n",
-			__func__, calc_max_msg_len, out_buf_len);
-	}
+	if (core_kernel_data(addr))
+		return true;
+
+	preempt_disable();
+	mod = __module_address(addr);
+	ret = mod && within_module_core(addr, mod);
+	preempt_enable();
 	return ret;
 }
-EXPORT_SYMBOL(qmi_kernel_encode);
 
 /**
- * qmi_encode_basic_elem() - Encodes elements of basic/primary data type
- * @buf_dst: Buffer to store the encoded information.
- * @buf_src: Buffer containing the elements to be encoded.
- * @elem_len: Number of elements, in the buf_src, to be encoded.
- * @elem_size: Size of a single instance of the element to be encoded.
+ * qmi_get_plan() - Get the plan of a message descriptor
+ * @desc: Pointer to structure descriptor.
  *
- * @return: number of bytes of encoded information.
+ * @return: the plan on success, ERR_PTR() on error.
  *
- * This function encodes the "elem_len" number of data elements, each of
- * size "elem_size" bytes from the source buffer "buf_src" and stores the
- * encoded information in the destination buffer "buf_dst". The elements are
- * of primary data type which include uint8_t - uint64_t or similar. This
- * function returns the number of bytes of encoded information.
+ * The first call for a descriptor compiles its plan and may sleep.  The
+ * plan stays valid until qmi_put_plan(), which must follow in the same
+ * context as the RCU read lock is held in between.
  */
-static int qmi_encode_basic_elem(void *buf_dst, void *buf_src,
-				 uint32_t elem_len, uint32_t elem_size)
+static struct qmi_plan *qmi_get_plan(struct msg_desc *desc)
 {
-	uint32_t i, rc = 0;
+	struct qmi_plan *plan, *new;
+
+	rcu_read_lock();
+	plan = qmi_lookup_plan(desc->ei_array);
+	if (plan)
+		return plan;
+	rcu_read_unlock();
+
+	might_sleep();
+	new = qmi_compile(desc->ei_array);
+	if (IS_ERR(new))
+		return new;
+
+	if (!qmi_plan_cacheable(desc->ei_array)) {
+		rcu_read_lock();
+		return new;
+	}
 
-	for (i = 0; i < elem_len; i++) {
-		QMI_ENCDEC_ENCODE_N_BYTES(buf_dst, buf_src, elem_size);
-		rc += elem_size;
+	mutex_lock(&qmi_plan_lock);
+	plan = qmi_lookup_plan(desc->ei_array);
+	if (!plan) {
+		new->cached = true;
+		hlist_add_head_rcu(&new->node,
+				   qmi_plan_bucket(desc->ei_array));
+		plan = new;
 	}
+	rcu_read_lock();
+	mutex_unlock(&qmi_plan_lock);
 
-	return rc;
+	if (plan != new)
+		kfree(new);
+	return plan;
 }
 
-/**
- * qmi_encode_struct_elem() - Encodes elements of struct data type
- * @ei_array: Struct info array descibing the struct element.
- * @buf_dst: Buffer to store the encoded information.
- * @buf_src: Buffer containing the elements to be encoded.
- * @elem_len: Number of elements, in the buf_src, to be encoded.
- * @out_buf_len: Available space in the encode buffer.
- * @enc_level: Depth of the nested structure from the main structure.
- *
- * @return: Mumber of bytes of encoded information, on success.
- *          < 0 on error.
- *
- * This function encodes the "elem_len" number of struct elements, each of
- * size "ei_array->elem_size" bytes from the source buffer "buf_src" and
- * stores the encoded information in the destination buffer "buf_dst". The
- * elements are of struct data type which includes any C structure. This
- * function returns the number of bytes of encoded information.
- */
-static int qmi_encode_struct_elem(struct elem_info *ei_array,
-				  void *buf_dst, void *buf_src,
-				  uint32_t elem_len, uint32_t out_buf_len,
-				  int enc_level)
+static void qmi_put_plan(struct qmi_plan *plan)
 {
-	int i, rc, encoded_bytes = 0;
-	struct elem_info *temp_ei = ei_array;
-
-	for (i = 0; i < elem_len; i++) {
-		rc = _qmi_kernel_encode(temp_ei->ei_array, buf_dst, buf_src,
-					(out_buf_len - encoded_bytes),
-					enc_level);
-		if (rc < 0) {
-			pr_err("%s: STRUCT Encode failure\n", __func__);
-			return rc;
-		}
-		buf_dst = buf_dst + rc;
-		buf_src = buf_src + temp_ei->elem_size;
-		encoded_bytes += rc;
-	}
-
-	return encoded_bytes;
+	rcu_read_unlock();
+	if (!plan->cached)
+		kfree(plan);
 }
 
 /**
- * skip_to_next_elem() - Skip to next element in the structure to be encoded
- * @ei_array: Struct info describing the element to be skipped.
- *
- * @return: Struct info of the next element that can be encoded.
+ * qmi_verify_max_msg_len() - Verify the maximum length of a QMI message
+ * @desc: Pointer to structure descriptor.
  *
- * This function is used while encoding optional elements. If the flag
- * corresponding to an optional element is not set, then encoding the
- * optional element can be skipped. This function can be used to perform
- * that operation.
+ * @return: true if the maximum message length embedded in structure
+ *          descriptor matches the calculated value, else false.
  */
-static struct elem_info *skip_to_next_elem(struct elem_info *ei_array)
+bool qmi_verify_max_msg_len(struct msg_desc *desc)
 {
-	struct elem_info *temp_ei = ei_array;
-	uint8_t tlv_type;
+	struct qmi_plan *plan;
+	int calc_max_msg_len;
 
-	do {
-		tlv_type = temp_ei->tlv_type;
-		temp_ei = temp_ei + 1;
-	} while (tlv_type == temp_ei->tlv_type);
+	if (!desc || !desc->ei_array)
+		return false;
 
-	return temp_ei;
+	plan = qmi_get_plan(desc);
+	if (IS_ERR(plan))
+		return false;
+	calc_max_msg_len = plan->max_msg_len;
+	qmi_put_plan(plan);
+
+	if (calc_max_msg_len != desc->max_msg_len) {
+		pr_err("%s: Calc. len %d != Passed len %d\n",
+			__func__, calc_max_msg_len, desc->max_msg_len);
+		return false;
+	}
+	return true;
 }
 
 /**
- * _qmi_kernel_encode() - Core Encode Function
- * @ei_array: Struct info array describing the structure to be encoded.
+ * qmi_encode_ops() - Core Encode Function
+ * @plan: Plan of the message being encoded.
+ * @op: First op of the structure to be encoded.
  * @out_buf: Buffer to hold the encoded QMI message.
  * @in_c_struct: Pointer to the C structure to be encoded.
  * @out_buf_len: Available space in the encode buffer.
@@ -296,118 +401,113 @@ static struct elem_info *skip_to_next_elem(struct elem_info *ei_array)
  * @return: Number of bytes of encoded information, on success.
  *          < 0 on error.
  */
-static int _qmi_kernel_encode(struct elem_info *ei_array,
-			      void *out_buf, void *in_c_struct,
-			      uint32_t out_buf_len, int enc_level)
+static int qmi_encode_ops(struct qmi_plan *plan, struct qmi_op *op,
+			  void *out_buf, void *in_c_struct,
+			  uint32_t out_buf_len, int enc_level)
 {
-	struct elem_info *temp_ei = ei_array;
-	uint8_t opt_flag_value = 0;
-	uint32_t data_len_value = 0, data_len_sz;
-	uint8_t *buf_dst = (uint8_t *)out_buf;
-	uint8_t *tlv_pointer;
-	uint32_t tlv_len;
-	uint8_t tlv_type;
+	uint8_t *buf_dst = out_buf;
+	uint8_t *tlv_pointer = out_buf;
+	uint32_t data_len_value = 0;
+	uint32_t tlv_len = 0;
 	uint32_t encoded_bytes = 0;
+	uint8_t tlv_type;
 	void *buf_src;
-	int encode_tlv = 0;
-	int rc;
+	uint32_t i;
+	int rc, ret;
 
-	tlv_pointer = buf_dst;
-	tlv_len = 0;
-	buf_dst = buf_dst + (TLV_LEN_SIZE + TLV_TYPE_SIZE);
+	/* Type & Length info. is only prepended at the top level */
+	if (enc_level == 1)
+		buf_dst += (TLV_LEN_SIZE + TLV_TYPE_SIZE);
 
-	while (temp_ei->data_type != QMI_EOTI) {
-		buf_src = in_c_struct + temp_ei->offset;
-		tlv_type = temp_ei->tlv_type;
+	while (op->data_type != QMI_EOTI) {
+		buf_src = in_c_struct + op->offset;
+		tlv_type = op->tlv_type;
 
-		if (temp_ei->is_array == NO_ARRAY) {
+		if (op->is_array == NO_ARRAY) {
 			data_len_value = 1;
-		} else if (temp_ei->is_array == STATIC_ARRAY) {
-			data_len_value = temp_ei->elem_len;
-		} else if (data_len_value <= 0 ||
-			    temp_ei->elem_len < data_len_value) {
+		} else if (op->is_array == STATIC_ARRAY) {
+			data_len_value = op->elem_len;
+		} else if (!data_len_value || op->elem_len < data_len_value) {
 			pr_err("%s: Invalid data length\n", __func__);
 			return -EINVAL;
 		}
 
-		switch (temp_ei->data_type) {
+		switch (op->data_type) {
 		case QMI_OPT_FLAG:
-			rc = qmi_encode_basic_elem(&opt_flag_value, buf_src,
-						   1, sizeof(uint8_t));
-			if (opt_flag_value)
-				temp_ei = temp_ei + 1;
+			if (*(uint8_t *)buf_src)
+				op = op + 1;
 			else
-				temp_ei = skip_to_next_elem(temp_ei);
-			break;
+				op = plan->ops + op->skip;
+			continue;
 
 		case QMI_DATA_LEN:
-			memcpy(&data_len_value, buf_src, temp_ei->elem_size);
-			data_len_sz = temp_ei->elem_size == sizeof(uint8_t) ?
-					sizeof(uint8_t) : sizeof(uint16_t);
+			data_len_value = 0;
+			memcpy(&data_len_value, buf_src, op->elem_size);
 			/* Check to avoid out of range buffer access */
-			if ((data_len_sz + encoded_bytes + TLV_LEN_SIZE +
+			if ((op->len_size + encoded_bytes + TLV_LEN_SIZE +
 			    TLV_TYPE_SIZE) > out_buf_len) {
 				pr_err("%s: Too Small Buffer @DATA_LEN\n",
 					__func__);
 				return -ETOOSMALL;
 			}
-			rc = qmi_encode_basic_elem(buf_dst, &data_len_value,
-						   1, data_len_sz);
-			if (data_len_value) {
-				UPDATE_ENCODE_VARIABLES(temp_ei, buf_dst,
-					encoded_bytes, tlv_len, encode_tlv, rc);
-				encode_tlv = 0;
-			} else {
-				temp_ei = skip_to_next_elem(temp_ei);
+			/* An empty array at the top level has no TLV at all */
+			if (!data_len_value && enc_level == 1) {
+				op = plan->ops + op->skip;
+				continue;
+			}
+			memcpy(buf_dst, &data_len_value, op->len_size);
+			buf_dst += op->len_size;
+			encoded_bytes += op->len_size;
+			tlv_len += op->len_size;
+			if (data_len_value)
+				op = op + 1;
+			else
+				op = plan->ops + op->skip;
+			continue;
+
+		case QMI_STRUCT:
+			rc = 0;
+			for (i = 0; i < data_len_value; i++) {
+				ret = qmi_encode_ops(plan, plan->ops + op->sub,
+					buf_dst + rc, buf_src + i * op->elem_size,
+					(out_buf_len - encoded_bytes - rc),
+					(enc_level + 1));
+				if (ret < 0) {
+					pr_err("%s: STRUCT Encode failure\n",
+						__func__);
+					return ret;
+				}
+				rc += ret;
 			}
 			break;
 
-		case QMI_UNSIGNED_1_BYTE:
-		case QMI_UNSIGNED_2_BYTE:
-		case QMI_UNSIGNED_4_BYTE:
-		case QMI_UNSIGNED_8_BYTE:
-		case QMI_SIGNED_2_BYTE_ENUM:
-		case QMI_SIGNED_4_BYTE_ENUM:
+		default:
+			rc = data_len_value * op->elem_size;
 			/* Check to avoid out of range buffer access */
-			if (((data_len_value * temp_ei->elem_size) +
-			    encoded_bytes + TLV_LEN_SIZE + TLV_TYPE_SIZE) >
-			    out_buf_len) {
+			if ((rc + encoded_bytes + TLV_LEN_SIZE +
+			    TLV_TYPE_SIZE) > out_buf_len) {
 				pr_err("%s: Too Small Buffer @data_type:%d\n",
-					__func__, temp_ei->data_type);
+					__func__, op->data_type);
 				return -ETOOSMALL;
 			}
-			rc = qmi_encode_basic_elem(buf_dst, buf_src,
-				data_len_value, temp_ei->elem_size);
+			memcpy(buf_dst, buf_src, rc);
 			QMI_ENCODE_LOG_ELEM(enc_level, data_len_value,
-				temp_ei->elem_size, buf_src);
-			UPDATE_ENCODE_VARIABLES(temp_ei, buf_dst,
-				encoded_bytes, tlv_len, encode_tlv, rc);
+				op->elem_size, buf_src);
 			break;
-
-		case QMI_STRUCT:
-			rc = qmi_encode_struct_elem(temp_ei, buf_dst, buf_src,
-				data_len_value, (out_buf_len - encoded_bytes),
-				(enc_level + 1));
-			if (rc < 0)
-				return rc;
-			UPDATE_ENCODE_VARIABLES(temp_ei, buf_dst,
-				encoded_bytes, tlv_len, encode_tlv, rc);
-			break;
-
-		default:
-			pr_err("%s: Unrecognized data type\n", __func__);
-			return -EINVAL;
-
 		}
 
-		if (encode_tlv && enc_level == 1) {
+		buf_dst += rc;
+		encoded_bytes += rc;
+		tlv_len += rc;
+		op = op + 1;
+
+		if (enc_level == 1) {
 			QMI_ENCDEC_ENCODE_TLV(tlv_type, tlv_len, tlv_pointer);
 			QMI_ENCODE_LOG_TLV(tlv_type, tlv_len);
 			encoded_bytes += (TLV_TYPE_SIZE + TLV_LEN_SIZE);
 			tlv_pointer = buf_dst;
 			tlv_len = 0;
 			buf_dst = buf_dst + TLV_LEN_SIZE + TLV_TYPE_SIZE;
-			encode_tlv = 0;
 		}
 	}
 	QMI_ENCODE_LOG_MSG(out_buf, encoded_bytes);
@@ -415,136 +515,48 @@ static int _qmi_kernel_encode(struct elem_info *ei_array,
 }
 
 /**
- * qmi_kernel_decode() - Decode to C Structure format
+ * qmi_kernel_encode() - Encode to QMI message wire format
  * @desc: Pointer to structure descriptor.
- * @out_c_struct: Buffer to hold the decoded C structure.
- * @in_buf: Buffer containg the QMI message to be decoded.
- * @in_buf_len: Length of the incoming QMI message.
+ * @out_buf: Buffer to hold the encoded QMI message.
+ * @out_buf_len: Length of the out buffer.
+ * @in_c_struct: C Structure to be encoded.
  *
- * @return: 0 on success, < 0 on error.
+ * @return: size of encoded message on success, < 0 for error.
  */
-int qmi_kernel_decode(struct msg_desc *desc, void *out_c_struct,
-		      void *in_buf, uint32_t in_buf_len)
+int qmi_kernel_encode(struct msg_desc *desc,
+		      void *out_buf, uint32_t out_buf_len,
+		      void *in_c_struct)
 {
-	int dec_level = 1;
-	int rc = 0;
+	struct qmi_plan *plan;
+	int ret;
 
 	if (!desc || !desc->ei_array)
 		return -EINVAL;
 
-	if (!out_c_struct || !in_buf || !in_buf_len)
-		return -EINVAL;
-
-	if (desc->max_msg_len < in_buf_len)
+	if (!out_buf || !in_c_struct)
 		return -EINVAL;
 
-	rc = _qmi_kernel_decode(desc->ei_array, out_c_struct,
-				in_buf, in_buf_len, dec_level);
-	if (rc < 0)
-		return rc;
-	else
-		return 0;
-}
-EXPORT_SYMBOL(qmi_kernel_decode);
-
-/**
- * qmi_decode_basic_elem() - Decodes elements of basic/primary data type
- * @buf_dst: Buffer to store the decoded element.
- * @buf_src: Buffer containing the elements in QMI wire format.
- * @elem_len: Number of elements to be decoded.
- * @elem_size: Size of a single instance of the element to be decoded.
- *
- * @return: Total size of the decoded data elements, in bytes.
- *
- * This function decodes the "elem_len" number of elements in QMI wire format,
- * each of size "elem_size" bytes from the source buffer "buf_src" and stores
- * the decoded elements in the destination buffer "buf_dst". The elements are
- * of primary data type which include uint8_t - uint64_t or similar. This
- * function returns the number of bytes of decoded information.
- */
-static int qmi_decode_basic_elem(void *buf_dst, void *buf_src,
-				 uint32_t elem_len, uint32_t elem_size)
-{
-	uint32_t i, rc = 0;
-
-	for (i = 0; i < elem_len; i++) {
-		QMI_ENCDEC_DECODE_N_BYTES(buf_dst, buf_src, elem_size);
-		rc += elem_size;
-	}
-
-	return rc;
-}
+	if (desc->max_msg_len < out_buf_len)
+		return -ETOOSMALL;
 
-/**
- * qmi_decode_struct_elem() - Decodes elements of struct data type
- * @ei_array: Struct info array descibing the struct element.
- * @buf_dst: Buffer to store the decoded element.
- * @buf_src: Buffer containing the elements in QMI wire format.
- * @elem_len: Number of elements to be decoded.
- * @tlv_len: Total size of the encoded inforation corresponding to
- *           this struct element.
- * @dec_level: Depth of the nested structure from the main structure.
- *
- * @return: Total size of the decoded data elements, on success.
- *          < 0 on error.
- *
- * This function decodes the "elem_len" number of elements in QMI wire format,
- * each of size "(tlv_len/elem_len)" bytes from the source buffer "buf_src"
- * and stores the decoded elements in the destination buffer "buf_dst". The
- * elements are of struct data type which includes any C structure. This
- * function returns the number of bytes of decoded information.
- */
-static int qmi_decode_struct_elem(struct elem_info *ei_array, void *buf_dst,
-				  void *buf_src, uint32_t elem_len,
-				  uint32_t tlv_len, int dec_level)
-{
-	int i, rc, decoded_bytes = 0;
-	struct elem_info *temp_ei = ei_array;
-
-	for (i = 0; i < elem_len; i++) {
-		rc = _qmi_kernel_decode(temp_ei->ei_array, buf_dst, buf_src,
-					(tlv_len/elem_len), dec_level);
-		if (rc < 0)
-			return rc;
-		if (rc != (tlv_len/elem_len)) {
-			pr_err("%s: Fault in decoding\n", __func__);
-			return -EFAULT;
-		}
-		buf_src = buf_src + rc;
-		buf_dst = buf_dst + temp_ei->elem_size;
-		decoded_bytes += rc;
-	}
+	plan = qmi_get_plan(desc);
+	if (IS_ERR(plan))
+		return PTR_ERR(plan);
 
-	return decoded_bytes;
-}
-
-/**
- * find_ei() - Find element info corresponding to TLV Type
- * @ei_array: Struct info array of the message being decoded.
- * @type: TLV Type of the element being searched.
- *
- * @return: Pointer to struct info, if found
- *
- * Every element that got encoded in the QMI message will have a type
- * information associated with it. While decoding the QMI message,
- * this function is used to find the struct info regarding the element
- * that corresponds to the type being decoded.
- */
-static struct elem_info *find_ei(struct elem_info *ei_array,
-				   uint32_t type)
-{
-	struct elem_info *temp_ei = ei_array;
-	while (temp_ei->data_type != QMI_EOTI) {
-		if (temp_ei->tlv_type == (uint8_t)type)
-			return temp_ei;
-		temp_ei = temp_ei + 1;
-	}
-	return NULL;
+	ret = qmi_encode_ops(plan, plan->ops, out_buf, in_c_struct,
+			     out_buf_len, 1);
+	if (ret == -ETOOSMALL)
+		pr_err("%s: Calc. len %d != Out buf len %d\n",
+			__func__, plan->max_msg_len, out_buf_len);
+	qmi_put_plan(plan);
+	return ret;
 }
+EXPORT_SYMBOL(qmi_kernel_encode);
 
 /**
- * _qmi_kernel_decode() - Core Decode Function
- * @ei_array: Struct info array describing the structure to be decoded.
+ * qmi_decode_ops() - Core Decode Function
+ * @plan: Plan of the message being decoded.
+ * @op: First op of the structure to be decoded, unused at the top level.
  * @out_c_struct: Buffer to hold the decoded C struct
  * @in_buf: Buffer containing the QMI message to be decoded
  * @in_buf_len: Length of the QMI message to be decoded
@@ -553,97 +565,198 @@ static struct elem_info *find_ei(struct elem_info *ei_array,
  *
  * @return: Number of bytes of decoded information, on success
  *          < 0 on error.
+ *
+ * At the top level the TLVs are decoded until the end of the message.  A
+ * nested structure ends with its last element, and @in_buf_len is only
+ * the space left for it.
  */
-static int _qmi_kernel_decode(struct elem_info *ei_array,
-			      void *out_c_struct,
-			      void *in_buf, uint32_t in_buf_len,
-			      int dec_level)
+static int qmi_decode_ops(struct qmi_plan *plan, struct qmi_op *op,
+			  void *out_c_struct, void *in_buf,
+			  uint32_t in_buf_len, int dec_level)
 {
-	struct elem_info *temp_ei = ei_array;
 	uint8_t opt_flag_value = 1;
-	uint32_t data_len_value = 0, data_len_sz = 0;
-	/* ++ fix Klocwork */
-	uint8_t *buf_dst = 0;
-	/* -- fix Klocwork */
+	uint32_t data_len_value = 0;
+	uint8_t *buf_src = in_buf;
 	uint8_t *tlv_pointer;
-	uint32_t tlv_len = 0;
-	uint32_t tlv_type;
+	uint32_t tlv_len, tlv_type;
 	uint32_t decoded_bytes = 0;
-	void *buf_src = in_buf;
-	int rc;
+	uint32_t limit = in_buf_len;
+	void *buf_dst;
+	uint32_t i;
+	int rc, ret;
 
 	QMI_DECODE_LOG_MSG(in_buf, in_buf_len);
-	while (decoded_bytes < in_buf_len) {
+	for (;;) {
 		if (dec_level == 1) {
+			if (decoded_bytes >= in_buf_len)
+				break;
+			if ((in_buf_len - decoded_bytes) <
+			    (TLV_TYPE_SIZE + TLV_LEN_SIZE))
+				goto fault;
 			tlv_pointer = buf_src;
 			QMI_ENCDEC_DECODE_TLV(&tlv_type,
 					      &tlv_len, tlv_pointer);
 			QMI_DECODE_LOG_TLV(tlv_type, tlv_len);
 			buf_src += (TLV_TYPE_SIZE + TLV_LEN_SIZE);
 			decoded_bytes += (TLV_TYPE_SIZE + TLV_LEN_SIZE);
-			temp_ei = find_ei(ei_array, tlv_type);
-			if (!temp_ei) {
+			if (!plan->tlv_index[tlv_type]) {
 				pr_err("%s: Inval element info\n", __func__);
 				return -EINVAL;
 			}
+			op = plan->ops + plan->tlv_index[tlv_type] - 1;
+			/* The elements of a TLV may not run past it */
+			limit = min(in_buf_len, decoded_bytes + tlv_len);
+		} else if (op->data_type == QMI_EOTI) {
+			break;
 		}
 
-		buf_dst = out_c_struct + temp_ei->offset;
-		if (temp_ei->data_type == QMI_OPT_FLAG) {
+		buf_dst = out_c_struct + op->offset;
+		if (op->data_type == QMI_OPT_FLAG) {
 			memcpy(buf_dst, &opt_flag_value, sizeof(uint8_t));
-			temp_ei = temp_ei + 1;
-			buf_dst = out_c_struct + temp_ei->offset;
+			op = op + 1;
+			buf_dst = out_c_struct + op->offset;
 		}
 
-		if (temp_ei->data_type == QMI_DATA_LEN) {
-			data_len_sz = temp_ei->elem_size == sizeof(uint8_t) ?
-					sizeof(uint8_t) : sizeof(uint16_t);
-			rc = qmi_decode_basic_elem(&data_len_value, buf_src,
-						   1, data_len_sz);
+		if (op->data_type == QMI_DATA_LEN) {
+			if (op->len_size > (limit - decoded_bytes))
+				goto fault;
+			data_len_value = 0;
+			memcpy(&data_len_value, buf_src, op->len_size);
 			memcpy(buf_dst, &data_len_value, sizeof(uint32_t));
-			temp_ei = temp_ei + 1;
-			buf_dst = out_c_struct + temp_ei->offset;
-			UPDATE_DECODE_VARIABLES(buf_src, decoded_bytes, rc);
+			buf_src += op->len_size;
+			decoded_bytes += op->len_size;
+			op = op + 1;
+			buf_dst = out_c_struct + op->offset;
 		}
 
-		if (temp_ei->is_array == NO_ARRAY) {
+		if (op->is_array == NO_ARRAY) {
 			data_len_value = 1;
-		} else if (temp_ei->is_array == STATIC_ARRAY) {
-			data_len_value = temp_ei->elem_len;
-		} else if (data_len_value > temp_ei->elem_len) {
+		} else if (op->is_array == STATIC_ARRAY) {
+			data_len_value = op->elem_len;
+		} else if (data_len_value > op->elem_len) {
 			pr_err("%s: Data len %d > max spec %d\n",
-				__func__, data_len_value, temp_ei->elem_len);
+				__func__, data_len_value, op->elem_len);
 			return -ETOOSMALL;
 		}
 
-		switch (temp_ei->data_type) {
+		switch (op->data_type) {
 		case QMI_UNSIGNED_1_BYTE:
 		case QMI_UNSIGNED_2_BYTE:
 		case QMI_UNSIGNED_4_BYTE:
 		case QMI_UNSIGNED_8_BYTE:
 		case QMI_SIGNED_2_BYTE_ENUM:
 		case QMI_SIGNED_4_BYTE_ENUM:
-			rc = qmi_decode_basic_elem(buf_dst, buf_src,
-				data_len_value, temp_ei->elem_size);
+			rc = data_len_value * op->elem_size;
+			if (rc > (limit - decoded_bytes))
+				goto fault;
+			memcpy(buf_dst, buf_src, rc);
 			QMI_DECODE_LOG_ELEM(dec_level, data_len_value,
-				temp_ei->elem_size, buf_dst);
-			UPDATE_DECODE_VARIABLES(buf_src, decoded_bytes, rc);
+				op->elem_size, buf_dst);
 			break;
 
 		case QMI_STRUCT:
-			rc = qmi_decode_struct_elem(temp_ei, buf_dst, buf_src,
-				data_len_value, tlv_len, (dec_level + 1));
-			if (rc < 0)
-				return rc;
-			UPDATE_DECODE_VARIABLES(buf_src, decoded_bytes, rc);
+			rc = 0;
+			for (i = 0; i < data_len_value; i++) {
+				ret = qmi_decode_ops(plan, plan->ops + op->sub,
+					buf_dst + i * op->elem_size,
+					buf_src + rc,
+					(limit - decoded_bytes - rc),
+					(dec_level + 1));
+				if (ret < 0)
+					return ret;
+				rc += ret;
+			}
 			break;
+
 		default:
 			pr_err("%s: Unrecognized data type\n", __func__);
 			return -EINVAL;
 		}
-		temp_ei = temp_ei + 1;
+		buf_src += rc;
+		decoded_bytes += rc;
+		op = op + 1;
 	}
 	return decoded_bytes;
+
+fault:
+	pr_err("%s: Fault in decoding\n", __func__);
+	return -EFAULT;
 }
+
+/**
+ * qmi_kernel_decode() - Decode to C Structure format
+ * @desc: Pointer to structure descriptor.
+ * @out_c_struct: Buffer to hold the decoded C structure.
+ * @in_buf: Buffer containg the QMI message to be decoded.
+ * @in_buf_len: Length of the incoming QMI message.
+ *
+ * @return: 0 on success, < 0 on error.
+ */
+int qmi_kernel_decode(struct msg_desc *desc, void *out_c_struct,
+		      void *in_buf, uint32_t in_buf_len)
+{
+	struct qmi_plan *plan;
+	int rc;
+
+	if (!desc || !desc->ei_array)
+		return -EINVAL;
+
+	if (!out_c_struct || !in_buf || !in_buf_len)
+		return -EINVAL;
+
+	if (desc->max_msg_len < in_buf_len)
+		return -EINVAL;
+
+	plan = qmi_get_plan(desc);
+	if (IS_ERR(plan))
+		return PTR_ERR(plan);
+
+	rc = qmi_decode_ops(plan, plan->ops, out_c_struct,
+			    in_buf, in_buf_len, 1);
+	qmi_put_plan(plan);
+	if (rc < 0)
+		return rc;
+	else
+		return 0;
+}
+EXPORT_SYMBOL(qmi_kernel_decode);
+
+#ifdef CONFIG_MODULES
+static int qmi_plan_module_notify(struct notifier_block *nb,
+				  unsigned long action, void *data)
+{
+	struct module *mod = data;
+	struct qmi_plan *plan;
+	struct hlist_node *pos, *n;
+	int i;
+
+	if (action != MODULE_STATE_GOING)
+		return NOTIFY_DONE;
+
+	mutex_lock(&qmi_plan_lock);
+	for (i = 0; i < ARRAY_SIZE(qmi_plan_hash); i++)
+		hlist_for_each_entry_safe(plan, pos, n, &qmi_plan_hash[i],
+					  node) {
+			if (!within_module_core((unsigned long)plan->ei_array,
+						mod))
+				continue;
+			hlist_del_rcu(&plan->node);
+			kfree_rcu(plan, rcu);
+		}
+	mutex_unlock(&qmi_plan_lock);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block qmi_plan_module_nb = {
+	.notifier_call = qmi_plan_module_notify,
+};
+
+static int __init qmi_encdec_init(void)
+{
+	return register_module_notifier(&qmi_plan_module_nb);
+}
+module_init(qmi_encdec_init);
+#endif
+
 MODULE_DESCRIPTION("QMI kernel enc/dec");
 MODULE_LICENSE("GPL v2");
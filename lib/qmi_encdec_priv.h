@@ -19,6 +19,7 @@
 #include <linux/list.h>
 #include <linux/socket.h>
 #include <linux/gfp.h>
+#include <linux/rcupdate.h>
 #include <linux/qmi_encdec.h>
 
 #define QMI_ENCDEC_ENCODE_TLV(type, length, p_dst) do { \
@@ -33,34 +34,53 @@
 	*p_length |= ((uint8_t)*p_src) << 8; \
 } while (0)
 
-#define QMI_ENCDEC_ENCODE_N_BYTES(p_dst, p_src, size) \
-do { \
-	memcpy(p_dst, p_src, size); \
-	p_dst = (uint8_t *)p_dst + size; \
-	p_src = (uint8_t *)p_src + size; \
-} while (0)
-
-#define QMI_ENCDEC_DECODE_N_BYTES(p_dst, p_src, size) \
-do { \
-	memcpy(p_dst, p_src, size); \
-	p_dst = (uint8_t *)p_dst + size; \
-	p_src = (uint8_t *)p_src + size; \
-} while (0)
-
-#define UPDATE_ENCODE_VARIABLES(temp_si, buf_dst, \
-				encoded_bytes, tlv_len, encode_tlv, rc) \
-do { \
-	buf_dst = (uint8_t *)buf_dst + rc; \
-	encoded_bytes += rc; \
-	tlv_len += rc; \
-	temp_si = temp_si + 1; \
-	encode_tlv = 1; \
-} while (0)
+/**
+ * qmi_op - One element of a compiled descriptor
+ * @data_type: Data type of the element, QMI_EOTI ends a structure.
+ * @is_array: Array type of the element.
+ * @tlv_type: TLV type of the element.
+ * @len_size: Size of a QMI_DATA_LEN on the wire, 1 or 2 bytes.
+ * @skip: Index of the op to continue at when an optional element or
+ *        an empty variable length array is left out.
+ * @sub: Index of the first op of the nested structure, QMI_STRUCT only.
+ * @elem_len: Array length of the element.
+ * @elem_size: Size of a single instance of the element.
+ * @offset: Offset of the element in the C structure.
+ */
+struct qmi_op {
+	uint8_t data_type;
+	uint8_t is_array;
+	uint8_t tlv_type;
+	uint8_t len_size;
+	uint16_t skip;
+	uint16_t sub;
+	uint32_t elem_len;
+	uint32_t elem_size;
+	uint32_t offset;
+};
 
-#define UPDATE_DECODE_VARIABLES(buf_src, decoded_bytes, rc) \
-do { \
-	buf_src = (uint8_t *)buf_src + rc; \
-	decoded_bytes += rc; \
-} while (0)
+/**
+ * qmi_plan - Compiled form of an elem_info array
+ * @node: Link in the plan cache.
+ * @rcu: To free the plan once no encoder or decoder can be using it.
+ * @ei_array: Element info array the plan was compiled from.
+ * @cached: Whether the plan is in the cache.
+ * @max_msg_len: Maximum length of a message, as qmi_verify_max_msg_len().
+ * @nr_ops: Number of entries in @ops.
+ * @tlv_index: Index + 1 of the first op of each top level TLV type, 0 for
+ *             types that are not part of the message.
+ * @ops: The elements of the message followed by those of the nested
+ *       structures, each ending with a QMI_EOTI op.
+ */
+struct qmi_plan {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	struct elem_info *ei_array;
+	bool cached;
+	int max_msg_len;
+	unsigned int nr_ops;
+	uint16_t tlv_index[256];
+	struct qmi_op ops[0];
+};
 
 #endif
@@ -0,0 +1,269 @@
+/*
+ * diagring: read the diag memory device ring
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * Gets a ring of -s bytes from /dev/diag and consumes its records for -t
+ * seconds, sleeping in poll() when it is empty and handing the room back
+ * once per batch of at least -b bytes (or when it runs dry).  -d sleeps
+ * that many microseconds per batch to play a slow reader, -m switches diag
+ * to memory device mode first.
+ *
+ * -r instead starts a run of the diag ring_bench stand-in peripheral
+ * through debugfs and reads until it is over, then prints its results.
+ * Its packets start with a sequence number that -c checks for gaps, which
+ * only holds without its hdlc option.
+ *
+ * Reported are the records and bytes read and their rate, the records the
+ * driver had to drop for lack of room, the wakeups and the batches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "diagchar.h"
+
+#define BENCH_PATH "/sys/kernel/debug/diag/ring_bench"
+
+static const char *opt_dev = "/dev/diag";
+static unsigned int opt_size = 1024 * 1024;
+static unsigned int opt_batch = 64 * 1024;
+static unsigned int opt_delay_us;
+static double opt_seconds = 5.0;
+static int opt_check, opt_run_bench, opt_memory_device;
+
+struct stats {
+	unsigned long long records, bytes;
+	unsigned long loss_marks, gaps, wakeups, batches, pads;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Consume every record between tail and head.  Returns the new tail,
+ * which the caller stores once it has read at least a batch.
+ */
+static uint32_t consume(volatile struct diag_ring_ctl *ctl,
+			const unsigned char *data, uint32_t tail,
+			struct stats *st, uint32_t *next_seq)
+{
+	uint32_t head = ctl->head, mask = ctl->size - 1, seq;
+	const struct diag_ring_rec *rec;
+
+	/* read the records only after the head that covers them */
+	__sync_synchronize();
+	while (tail != head) {
+		rec = (const struct diag_ring_rec *)(data + (tail & mask));
+		tail += (sizeof(*rec) + rec->len + DIAG_RING_REC_ALIGN - 1) &
+			~(DIAG_RING_REC_ALIGN - 1);
+		if (rec->flags & DIAG_RING_REC_PAD) {
+			st->pads++;
+			continue;
+		}
+		if (rec->flags & DIAG_RING_REC_LOSS)
+			st->loss_marks++;
+		if (opt_check && rec->len >= sizeof(seq)) {
+			memcpy(&seq, rec + 1, sizeof(seq));
+			if (st->records && seq != *next_seq)
+				st->gaps++;
+			*next_seq = seq + 1;
+		}
+		st->records++;
+		st->bytes += rec->len;
+	}
+	return tail;
+}
+
+static pid_t start_bench(void)
+{
+	pid_t pid = fork();
+	int fd;
+
+	if (pid)
+		return pid;
+
+	/* let the reader get to poll() first */
+	usleep(100000);
+	fd = open(BENCH_PATH, O_RDWR);
+	if (fd < 0 || write(fd, "run", 3) != 3) {
+		perror(BENCH_PATH);
+		_exit(1);
+	}
+	_exit(0);
+}
+
+static void print_bench(void)
+{
+	char buf[1024];
+	ssize_t len;
+	int fd = open(BENCH_PATH, O_RDONLY);
+
+	if (fd < 0)
+		return;
+	len = read(fd, buf, sizeof(buf) - 1);
+	if (len > 0) {
+		buf[len] = 0;
+		printf("\n%s", buf);
+	}
+	close(fd);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-s ring_bytes] [-b batch_bytes] [-d delay_us]\n"
+		"          [-t seconds] [-c] [-r] [-m] [-D device]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	volatile struct diag_ring_ctl *ctl;
+	struct pollfd pfd;
+	struct stats st;
+	unsigned char *map;
+	static unsigned char legacy[65536];
+	uint32_t tail, acked, next_seq = 0, dropped0;
+	double start, end, elapsed;
+	pid_t bench = 0;
+	int fd, c, status;
+
+	while ((c = getopt(argc, argv, "s:b:d:t:crmD:")) != -1) {
+		switch (c) {
+		case 's':
+			opt_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			opt_batch = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			opt_delay_us = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_seconds = strtod(optarg, NULL);
+			break;
+		case 'c':
+			opt_check = 1;
+			break;
+		case 'r':
+			opt_run_bench = 1;
+			break;
+		case 'm':
+			opt_memory_device = 1;
+			break;
+		case 'D':
+			opt_dev = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	fd = open(opt_dev, O_RDWR);
+	if (fd < 0) {
+		perror(opt_dev);
+		return 1;
+	}
+	if (opt_memory_device &&
+	    ioctl(fd, DIAG_IOCTL_SWITCH_LOGGING, MEMORY_DEVICE_MODE) < 0) {
+		perror("DIAG_IOCTL_SWITCH_LOGGING");
+		return 1;
+	}
+	if (ioctl(fd, DIAG_IOCTL_RING_INIT, opt_size) < 0) {
+		perror("DIAG_IOCTL_RING_INIT");
+		return 1;
+	}
+	map = mmap(NULL, getpagesize() + opt_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	ctl = (volatile struct diag_ring_ctl *)map;
+	if (ctl->magic != DIAG_RING_MAGIC || ctl->size != opt_size) {
+		fprintf(stderr, "bad ring header\n");
+		return 1;
+	}
+	/* a batch is the least we read before waking up again */
+	ctl->wake_bytes = opt_batch < opt_size ? opt_batch : 0;
+
+	memset(&st, 0, sizeof(st));
+	tail = acked = ctl->tail;
+	dropped0 = ctl->dropped;
+	if (opt_run_bench)
+		bench = start_bench();
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	start = now();
+	end = start + opt_seconds;
+	while (bench || now() < end) {
+		if (tail == ctl->head) {
+			/* caught up: give back what we have, then sleep */
+			if (acked != tail) {
+				ctl->tail = acked = tail;
+				st.batches++;
+			}
+			if (bench && waitpid(bench, &status, WNOHANG) == bench)
+				break;
+			if (poll(&pfd, 1, 100) <= 0)
+				continue;
+			st.wakeups++;
+			if (tail == ctl->head) {
+				/* masks and the like still come by read() */
+				if (read(fd, legacy, sizeof(legacy)) < 0 &&
+				    errno != EINTR)
+					break;
+				continue;
+			}
+		}
+
+		tail = consume(ctl, map + getpagesize(), tail, &st,
+			       &next_seq);
+		if (tail - acked >= opt_batch) {
+			/* done with the records before handing them back */
+			__sync_synchronize();
+			ctl->tail = acked = tail;
+			st.batches++;
+			if (opt_delay_us)
+				usleep(opt_delay_us);
+		}
+	}
+	ctl->tail = tail;
+	elapsed = now() - start;
+
+	printf("ring %u bytes, batch %u bytes, delay %u us, %.2f s\n",
+	       opt_size, opt_batch, opt_delay_us, elapsed);
+	printf("records:  %llu (%.0f/s)\n", st.records, st.records / elapsed);
+	printf("bytes:    %llu (%.1f MB/s)\n", st.bytes,
+	       st.bytes / elapsed / 1e6);
+	printf("dropped:  %u (%lu loss marks%s", ctl->dropped - dropped0,
+	       st.loss_marks, opt_check ? ", " : ")\n");
+	if (opt_check)
+		printf("%lu sequence gaps)\n", st.gaps);
+	printf("wakeups:  %lu\nbatches:  %lu\npads:     %lu\n", st.wakeups,
+	       st.batches, st.pads);
+	if (bench)
+		print_bench();
+
+	munmap(map, getpagesize() + opt_size);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,360 @@
+/*
+ * hdlcbench: check and measure the diag HDLC encoder and decoder in userspace
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * Packets of random binary data, of log-like data with few bytes to escape
+ * and of nothing but bytes to escape are encoded and decoded with
+ * drivers/char/diag/diagchar_hdlc.c, whole and in random fragments of the
+ * output and input buffers, and have to come back with a valid CRC.  With
+ * REF= (see the Makefile) every call is repeated on the code of the other
+ * tree, which has to leave the same bytes and state behind.  Then the
+ * throughput of encoding, decoding and CRC checking is given in MB/s of
+ * packet data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <linux/crc-ccitt.h>
+#include "../../drivers/char/diag/diagchar_hdlc.h"
+
+#ifdef HAVE_REF
+void ref_diag_hdlc_encode(struct diag_send_desc_type *src_desc,
+			  struct diag_hdlc_dest_type *enc);
+int ref_diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc);
+int ref_crc_check(uint8_t *buf, uint16_t len);
+u16 ref_crc_ccitt(u16 crc, const u8 *buffer, size_t len);
+#endif
+
+#define CONTROL_CHAR	0x7E
+#define MAX_PKT		8192
+#define ENC_SIZE	(2 * MAX_PKT + 1024)
+
+enum { RANDOM, LOG, ESCAPES, NR_KINDS };
+static const char * const kind_names[] = { "random", "log", "escapes" };
+
+static unsigned int opt_iters = 20000;
+static unsigned int opt_seed = 1;
+static double opt_seconds = 0.5;
+
+static unsigned int rnd(unsigned int n)
+{
+	return n ? (unsigned int)random() % n : 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fail(const char *what, unsigned int iter)
+{
+	fprintf(stderr, "iteration %u: %s\n", iter, what);
+	exit(1);
+}
+
+static void gen_pkt(uint8_t *pkt, unsigned int len, int kind)
+{
+	static const char text[] = "diag: modem log 0x7d event 1234 ok\n";
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		switch (kind) {
+		case RANDOM:
+			pkt[i] = random();
+			break;
+		case LOG:
+			pkt[i] = rnd(64) ? text[i % (sizeof(text) - 1)] :
+				 (rnd(2) ? CONTROL_CHAR : ESC_CHAR);
+			break;
+		default:
+			pkt[i] = rnd(2) ? CONTROL_CHAR : ESC_CHAR;
+			break;
+		}
+	}
+}
+
+static u16 crc_bytewise(const uint8_t *buf, unsigned int len)
+{
+	u16 crc = 0xffff;
+
+	while (len--)
+		crc = crc_ccitt_byte(crc, *buf++);
+	return crc;
+}
+
+/* encode a whole packet with enough room, returns the encoded length */
+static unsigned int encode(void (*fn)(struct diag_send_desc_type *,
+				      struct diag_hdlc_dest_type *),
+			   const uint8_t *pkt, unsigned int len, uint8_t *buf)
+{
+	struct diag_send_desc_type send = { pkt, pkt + len - 1,
+					    DIAG_STATE_START, 1 };
+	/* every byte and both CRC bytes escaped, and the terminator */
+	struct diag_hdlc_dest_type enc = { buf, buf + 2 * len + 4, 0 };
+
+	fn(&send, &enc);
+	return (uint8_t *)enc.dest - buf;
+}
+
+/*
+ * Encode into output windows of random size, as diagchar_core.c does when
+ * a buffer fills up, checking the reference after every call.
+ */
+static unsigned int encode_fragments(const uint8_t *pkt, unsigned int len,
+				     uint8_t *buf, unsigned int iter)
+{
+	struct diag_send_desc_type send = { pkt, pkt + len - 1,
+					    DIAG_STATE_START, 1 };
+	struct diag_hdlc_dest_type enc = { buf, NULL, 0 };
+#ifdef HAVE_REF
+	static uint8_t ref_buf[ENC_SIZE];
+	struct diag_send_desc_type ref_send = send;
+	struct diag_hdlc_dest_type ref_enc = { ref_buf, NULL, 0 };
+#endif
+	unsigned int pos = 0, w;
+
+	while (send.state != DIAG_STATE_COMPLETE) {
+		w = 1 + rnd(rnd(4) ? 16 : 512);
+		if (pos + w > ENC_SIZE)
+			fail("encoder does not finish", iter);
+		enc.dest = buf + pos;
+		enc.dest_last = buf + pos + w - 1;
+		diag_hdlc_encode(&send, &enc);
+#ifdef HAVE_REF
+		ref_enc.dest = ref_buf + pos;
+		ref_enc.dest_last = ref_buf + pos + w - 1;
+		ref_diag_hdlc_encode(&ref_send, &ref_enc);
+		if ((uint8_t *)enc.dest - buf !=
+		    (uint8_t *)ref_enc.dest - ref_buf ||
+		    enc.crc != ref_enc.crc || send.pkt != ref_send.pkt ||
+		    send.state != ref_send.state ||
+		    memcmp(buf + pos, ref_buf + pos,
+			   (uint8_t *)enc.dest - (buf + pos)))
+			fail("fragmented encode differs from reference", iter);
+#endif
+		pos = (uint8_t *)enc.dest - buf;
+	}
+	return pos;
+}
+
+/*
+ * Decode from input chunks and into output space of random sizes,
+ * as diagfwd.c does, checking the reference after every call.  Returns
+ * the decoded length.
+ */
+static unsigned int decode_fragments(uint8_t *enc, unsigned int enc_len,
+				     uint8_t *out, unsigned int iter)
+{
+	struct diag_hdlc_decode_type hdlc = { 0 };
+#ifdef HAVE_REF
+	static uint8_t ref_out[ENC_SIZE];
+	struct diag_hdlc_decode_type ref;
+	int ref_ret;
+#endif
+	unsigned int src = 0, dst = 0, chunk, room;
+	int ret;
+
+	while (src < enc_len) {
+		chunk = 1 + rnd(rnd(4) ? 32 : enc_len);
+		/* a lone CONTROL_CHAR would end the packet */
+		if (!src && chunk < 2)
+			chunk = 2;
+		if (chunk > enc_len - src)
+			chunk = enc_len - src;
+		room = 1 + rnd(rnd(4) ? 32 : enc_len);
+
+		hdlc.src_ptr = enc;
+		hdlc.src_idx = src;
+		hdlc.src_size = src + chunk;
+		hdlc.dest_ptr = out;
+		hdlc.dest_idx = dst;
+		hdlc.dest_size = dst + room;
+#ifdef HAVE_REF
+		ref = hdlc;
+		ref.dest_ptr = ref_out;
+		ref_ret = ref_diag_hdlc_decode(&ref);
+#endif
+		ret = diag_hdlc_decode(&hdlc);
+#ifdef HAVE_REF
+		if (ret != ref_ret || hdlc.src_idx != ref.src_idx ||
+		    hdlc.dest_idx != ref.dest_idx ||
+		    hdlc.escaping != ref.escaping ||
+		    memcmp(out + dst, ref_out + dst, hdlc.dest_idx - dst))
+			fail("fragmented decode differs from reference", iter);
+#endif
+		src = hdlc.src_idx;
+		dst = hdlc.dest_idx;
+		if (ret)
+			break;
+	}
+	return dst;
+}
+
+static void check(void)
+{
+	static uint8_t pkt[MAX_PKT], enc[ENC_SIZE], enc2[ENC_SIZE];
+	static uint8_t out[ENC_SIZE];
+	unsigned int iter, len, enc_len, out_len, off;
+
+	for (iter = 0; iter < opt_iters; iter++) {
+		len = 1 + rnd(rnd(4) ? 256 : MAX_PKT);
+		gen_pkt(pkt, len, rnd(NR_KINDS));
+
+		/* crc_ccitt() at every alignment and length */
+		off = rnd(8);
+		if (off < len &&
+		    crc_ccitt(0xffff, pkt + off, len - off) !=
+		    crc_bytewise(pkt + off, len - off))
+			fail("crc_ccitt differs from the bytewise CRC", iter);
+
+		enc_len = encode(diag_hdlc_encode, pkt, len, enc);
+#ifdef HAVE_REF
+		if (encode(ref_diag_hdlc_encode, pkt, len, enc2) != enc_len ||
+		    memcmp(enc, enc2, enc_len))
+			fail("encode differs from reference", iter);
+#endif
+		if (encode_fragments(pkt, len, enc2, iter) != enc_len ||
+		    memcmp(enc, enc2, enc_len))
+			fail("fragmented encode differs", iter);
+
+		/* a leading CONTROL_CHAR is skipped, as from the host */
+		if (rnd(2)) {
+			memmove(enc + 1, enc, enc_len++);
+			enc[0] = CONTROL_CHAR;
+		}
+		out_len = decode_fragments(enc, enc_len, out, iter);
+		if (out_len != len + 3 || memcmp(out, pkt, len) ||
+		    crc_check(out, out_len))
+			fail("decode does not give back the packet", iter);
+#ifdef HAVE_REF
+		if (ref_crc_check(out, out_len))
+			fail("reference CRC check fails", iter);
+#endif
+	}
+	printf("%u packets checked\n", opt_iters);
+}
+
+struct impl {
+	const char *name;
+	void (*encode)(struct diag_send_desc_type *src_desc,
+		       struct diag_hdlc_dest_type *enc);
+	int (*decode)(struct diag_hdlc_decode_type *hdlc);
+	int (*crc_check)(uint8_t *buf, uint16_t len);
+};
+
+static const struct impl impls[] = {
+	{ "tree", diag_hdlc_encode, diag_hdlc_decode, crc_check },
+#ifdef HAVE_REF
+	{ "ref", ref_diag_hdlc_encode, ref_diag_hdlc_decode, ref_crc_check },
+#endif
+};
+
+enum { ENCODE, DECODE, CRC_CHECK };
+
+static void decode_all(int (*fn)(struct diag_hdlc_decode_type *),
+		       struct diag_hdlc_decode_type *hdlc, uint8_t *enc,
+		       unsigned int enc_len, uint8_t *out)
+{
+	memset(hdlc, 0, sizeof(*hdlc));
+	hdlc->src_ptr = enc;
+	hdlc->src_size = enc_len;
+	hdlc->dest_ptr = out;
+	hdlc->dest_size = ENC_SIZE;
+	fn(hdlc);
+}
+
+static double bench(const struct impl *im, int op, const uint8_t *pkt,
+		    unsigned int len)
+{
+	static uint8_t enc[ENC_SIZE], out[ENC_SIZE];
+	struct diag_hdlc_decode_type hdlc;
+	unsigned long rounds = 0;
+	double start, elapsed;
+	unsigned int enc_len, out_len, i;
+
+	enc_len = encode(diag_hdlc_encode, pkt, len, enc);
+	decode_all(diag_hdlc_decode, &hdlc, enc, enc_len, out);
+	out_len = hdlc.dest_idx;
+
+	start = now();
+	do {
+		for (i = 0; i < 100; i++) {
+			if (op == ENCODE)
+				encode(im->encode, pkt, len, enc);
+			else if (op == DECODE)
+				decode_all(im->decode, &hdlc, enc, enc_len,
+					   out);
+			else
+				im->crc_check(out, out_len);
+		}
+		rounds += 100;
+		elapsed = now() - start;
+	} while (elapsed < opt_seconds);
+
+	return (double)len * rounds / elapsed / (1 << 20);
+}
+
+static void run_benchmarks(void)
+{
+	static const unsigned int sizes[] = { 64, 512, 4096 };
+	static uint8_t pkt[MAX_PKT];
+	unsigned int k, s, j;
+
+	printf("%-8s %6s %6s %10s %10s %10s\n", "data", "size", "impl",
+	       "enc_MB/s", "dec_MB/s", "crc_MB/s");
+	for (k = 0; k < NR_KINDS; k++) {
+		for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			gen_pkt(pkt, sizes[s], k);
+			for (j = 0; j < sizeof(impls) / sizeof(impls[0]); j++)
+				printf("%-8s %6u %6s %10.1f %10.1f %10.1f\n",
+				       kind_names[k], sizes[s], impls[j].name,
+				       bench(&impls[j], ENCODE, pkt, sizes[s]),
+				       bench(&impls[j], DECODE, pkt, sizes[s]),
+				       bench(&impls[j], CRC_CHECK, pkt,
+					     sizes[s]));
+		}
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-n packets] [-s seed] [-t seconds]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:t:")) != -1) {
+		switch (c) {
+		case 'n':
+			opt_iters = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			opt_seed = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_seconds = strtod(optarg, NULL);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	srandom(opt_seed);
+	check();
+	run_benchmarks();
+	return 0;
+}
@@ -0,0 +1,15 @@
+#ifndef _TOOLS_DIAG_ASM_BYTEORDER_H
+#define _TOOLS_DIAG_ASM_BYTEORDER_H
+
+#include <linux/kernel.h>
+
+static inline u32 le32_to_cpup(const __le32 *p)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return *p;
+#else
+	return __builtin_bswap32(*p);
+#endif
+}
+
+#endif
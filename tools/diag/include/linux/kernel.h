@@ -0,0 +1,25 @@
+#ifndef _TOOLS_DIAG_LINUX_KERNEL_H
+#define _TOOLS_DIAG_LINUX_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef uint32_t __le32;
+
+#define min(x, y)	((x) < (y) ? (x) : (y))
+
+#define pr_err_ratelimited(fmt, ...)	do { } while (0)
+#define pr_debug(fmt, ...)		do { } while (0)
+
+#define EXPORT_SYMBOL(sym)
+#define MODULE_LICENSE(s)
+#define MODULE_DESCRIPTION(s)
+
+#endif
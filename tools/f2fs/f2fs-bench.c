@@ -0,0 +1,316 @@
+/*
+ * f2fs-bench.c -- write, fsync and checkpoint latency under concurrent writers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Runs in a directory of a mounted f2fs for -t seconds:
+ *
+ *  - -w writer threads, each appending -s bytes to a file of its own and
+ *    fsync()ing it, timing every write and fsync;
+ *  - a churn thread creating and unlinking -c files of -S bytes in turn,
+ *    which leaves invalid blocks and prefree segments, hence discards, to
+ *    every checkpoint;
+ *  - a sync thread calling syncfs() every -i milliseconds, each call being
+ *    a checkpoint, timing them;
+ *  - with -T, a trim thread calling FITRIM on the whole device every -T
+ *    milliseconds, timing them, which waits for every queued discard
+ *    while the others allocate blocks that may be under discard.
+ *
+ * Then it prints the 50th, 99th percentile and maximum of each latency.
+ * A checkpoint blocks FS operations for a while, which shows as the tail
+ * of the write latency; the checkpoint phases are timed in the "CP calls"
+ * part of /sys/kernel/debug/f2fs/status.  To compare with checkpoints
+ * that don't pre-flush, raise /sys/fs/f2fs/<dev>/cp_preflush_pages above
+ * any dirty page count, e.g. to 4294967295.
+ *
+ * To run it with discard support, on a loop device over a file:
+ *
+ *	truncate -s 2G /tmp/f2fs.img
+ *	losetup /dev/loop0 /tmp/f2fs.img
+ *	mkfs.f2fs /dev/loop0
+ *	mount -t f2fs -o discard /dev/loop0 /mnt
+ *	f2fs-bench -t 60 -T 500 /mnt
+ *	umount /mnt
+ *
+ * and /sys/kernel/debug/f2fs/status to watch the discard queue too.  The
+ * umount issues and waits for whatever discards are still queued.
+ *
+ * usage: f2fs-bench [-w writers] [-s fsync_size] [-c churn_files]
+ *		     [-S churn_size] [-i sync_ms] [-T trim_ms] [-t seconds] dir
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -O2 -pthread -o f2fs-bench f2fs-bench.c */
+
+#define _GNU_SOURCE /* for syncfs */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <linux/fs.h>
+
+#define MAX_SAMPLES	(1 << 20)
+
+struct lat {
+	pthread_mutex_t lock;
+	unsigned long nr;
+	double *us;
+};
+
+static const char *dir;
+static unsigned writers = 4, churn_files = 64, sync_ms = 1000, seconds = 30;
+static unsigned trim_ms;
+static size_t fsync_size = 4096, churn_size = 1 << 20;
+static volatile int stop;
+static struct lat write_lat, fsync_lat, sync_lat, trim_lat;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static void record(struct lat *lat, double us)
+{
+	pthread_mutex_lock(&lat->lock);
+	if (lat->nr < MAX_SAMPLES)
+		lat->us[lat->nr++] = us;
+	pthread_mutex_unlock(&lat->lock);
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void *writer(void *arg)
+{
+	char name[4096], *buf;
+	double start;
+	int fd;
+
+	snprintf(name, sizeof(name), "%s/bench-w%lu", dir, (unsigned long)arg);
+	fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		die(name);
+	buf = malloc(fsync_size);
+	if (!buf)
+		die("malloc");
+	memset(buf, 0x5a, fsync_size);
+
+	while (!stop) {
+		start = now();
+		if (write(fd, buf, fsync_size) != (ssize_t)fsync_size)
+			die(name);
+		record(&write_lat, now() - start);
+
+		start = now();
+		if (fsync(fd))
+			die(name);
+		record(&fsync_lat, now() - start);
+
+		/* keep the file from filling the disk */
+		if (lseek(fd, 0, SEEK_CUR) >= 64 << 20) {
+			if (ftruncate(fd, 0) || lseek(fd, 0, SEEK_SET))
+				die(name);
+		}
+	}
+	close(fd);
+	unlink(name);
+	free(buf);
+	return NULL;
+}
+
+static void *churn(void *arg)
+{
+	char name[4096], *buf;
+	unsigned i = 0;
+	int fd;
+
+	buf = malloc(churn_size);
+	if (!buf)
+		die("malloc");
+	memset(buf, 0xa5, churn_size);
+
+	while (!stop) {
+		snprintf(name, sizeof(name), "%s/bench-c%u", dir,
+			 i % churn_files);
+		/* the file of churn_files ago goes, this one comes */
+		unlink(name);
+		fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			die(name);
+		if (write(fd, buf, churn_size) != (ssize_t)churn_size)
+			die(name);
+		close(fd);
+		i++;
+	}
+	for (i = 0; i < churn_files; i++) {
+		snprintf(name, sizeof(name), "%s/bench-c%u", dir, i);
+		unlink(name);
+	}
+	free(buf);
+	return NULL;
+}
+
+static void *syncer(void *arg)
+{
+	double start;
+	int fd;
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		die(dir);
+	while (!stop) {
+		usleep(sync_ms * 1000);
+		start = now();
+		if (syncfs(fd))
+			die("syncfs");
+		record(&sync_lat, now() - start);
+	}
+	close(fd);
+	return NULL;
+}
+
+static void *trimmer(void *arg)
+{
+	struct fstrim_range range;
+	double start;
+	int fd;
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		die(dir);
+	while (!stop) {
+		usleep(trim_ms * 1000);
+		memset(&range, 0, sizeof(range));
+		range.len = (__u64)-1;
+		start = now();
+		if (ioctl(fd, FITRIM, &range))
+			die("FITRIM");
+		record(&trim_lat, now() - start);
+	}
+	close(fd);
+	return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, struct lat *lat)
+{
+	if (!lat->nr) {
+		printf("%-8s no samples\n", name);
+		return;
+	}
+	qsort(lat->us, lat->nr, sizeof(double), cmp_double);
+	printf("%-8s %8lu calls  p50 %10.0f us  p99 %10.0f us  max %10.0f us\n",
+	       name, lat->nr, lat->us[lat->nr / 2],
+	       lat->us[lat->nr * 99 / 100], lat->us[lat->nr - 1]);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-w writers] [-s fsync_size] [-c churn_files]\n"
+		"          [-S churn_size] [-i sync_ms] [-T trim_ms] [-t seconds] dir\n"
+		"  -w  fsync()ing writer threads (default 4)\n"
+		"  -s  bytes written before each fsync (default 4096)\n"
+		"  -c  files the churn thread rotates through (default 64)\n"
+		"  -S  size of each churn file (default 1 MiB)\n"
+		"  -i  milliseconds between syncfs() calls (default 1000)\n"
+		"  -T  milliseconds between FITRIM calls (default none)\n"
+		"  -t  seconds to run (default 30)\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t *threads;
+	unsigned long i, nr_threads;
+	int c;
+
+	while ((c = getopt(argc, argv, "w:s:c:S:i:T:t:")) != -1) {
+		switch (c) {
+		case 'w':
+			writers = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			fsync_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			churn_files = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			churn_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			sync_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			trim_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !fsync_size || !churn_files ||
+	    !churn_size || !sync_ms || !seconds)
+		usage(argv[0]);
+	dir = argv[optind];
+
+	pthread_mutex_init(&write_lat.lock, NULL);
+	pthread_mutex_init(&fsync_lat.lock, NULL);
+	pthread_mutex_init(&sync_lat.lock, NULL);
+	pthread_mutex_init(&trim_lat.lock, NULL);
+	write_lat.us = malloc(MAX_SAMPLES * sizeof(double));
+	fsync_lat.us = malloc(MAX_SAMPLES * sizeof(double));
+	sync_lat.us = malloc(MAX_SAMPLES * sizeof(double));
+	trim_lat.us = malloc(MAX_SAMPLES * sizeof(double));
+	nr_threads = writers + 2 + !!trim_ms;
+	threads = calloc(nr_threads, sizeof(pthread_t));
+	if (!write_lat.us || !fsync_lat.us || !sync_lat.us || !trim_lat.us ||
+	    !threads)
+		die("malloc");
+
+	for (i = 0; i < writers; i++)
+		if (pthread_create(&threads[i], NULL, writer, (void *)i))
+			die("pthread_create");
+	if (pthread_create(&threads[writers], NULL, churn, NULL) ||
+	    pthread_create(&threads[writers + 1], NULL, syncer, NULL))
+		die("pthread_create");
+	if (trim_ms &&
+	    pthread_create(&threads[writers + 2], NULL, trimmer, NULL))
+		die("pthread_create");
+
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	report("write", &write_lat);
+	report("fsync", &fsync_lat);
+	report("syncfs", &sync_lat);
+	if (trim_ms)
+		report("FITRIM", &trim_lat);
+	return 0;
+}
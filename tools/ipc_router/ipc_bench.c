@@ -0,0 +1,299 @@
+/*
+ * ipc_bench: measure IPC Router over AF_MSM_IPC sockets
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * Messages of each size are bounced off an echo server (by default the one
+ * of the loopback transport, service 4096 instance 1) for a fixed time,
+ * with -w messages in flight.  Reported are the message rate, the round
+ * trip latency percentiles and the CPU time per message, both of this
+ * process and of the whole system, the latter including the router's
+ * kernel threads.  With debugfs mounted, the payload bytes IPC Router
+ * copied per message, counting both directions, are reported as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <linux/msm_ipc.h>
+
+#define MAX_MSG_SIZE 65536
+#define MAX_WINDOW 64
+
+static unsigned int opt_service = 4096;
+static unsigned int opt_instance = 1;
+static double opt_seconds = 1.0;
+static unsigned int opt_window = 1;
+static unsigned int sizes[32] = { 16, 64, 256, 1024, 4096, 16384, 65536 };
+static unsigned int nr_sizes = 7;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double process_cpu(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/* busy time of all CPUs from /proc/stat, in seconds */
+static double system_cpu(void)
+{
+	unsigned long long user, nice, sys, idle, iowait, irq, softirq;
+	FILE *f = fopen("/proc/stat", "r");
+	int n;
+
+	if (!f)
+		return 0;
+	n = fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu", &user, &nice,
+		   &sys, &idle, &iowait, &irq, &softirq);
+	fclose(f);
+	if (n != 7)
+		return 0;
+	return (double)(user + nice + sys + irq + softirq) /
+	       sysconf(_SC_CLK_TCK);
+}
+
+/* payload bytes copied by IPC Router so far, -1 if debugfs is not there */
+static long long bytes_copied(void)
+{
+	FILE *f = fopen("/sys/kernel/debug/msm_ipc_router/bytes_copied", "r");
+	long long n;
+
+	if (!f)
+		return -1;
+	if (fscanf(f, "%lld", &n) != 1)
+		n = -1;
+	fclose(f);
+	return n;
+}
+
+static int lookup_server(int fd, struct sockaddr_msm_ipc *addr)
+{
+	struct {
+		struct server_lookup_args args;
+		struct msm_ipc_server_info info;
+	} lookup;
+
+	memset(&lookup, 0, sizeof(lookup));
+	lookup.args.port_name.service = opt_service;
+	lookup.args.port_name.instance = opt_instance;
+	lookup.args.num_entries_in_array = 1;
+	if (ioctl(fd, IPC_ROUTER_IOCTL_LOOKUP_SERVER, &lookup) < 0 ||
+	    lookup.args.num_entries_found < 1)
+		return -1;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->family = AF_MSM_IPC;
+	addr->address.addrtype = MSM_IPC_ADDR_ID;
+	addr->address.addr.port_addr.node_id = lookup.info.node_id;
+	addr->address.addr.port_addr.port_id = lookup.info.port_id;
+	return 0;
+}
+
+/*
+ * Wait for the next echo.  RESUME_TX notifications from the router arrive
+ * as empty messages and are skipped.
+ */
+static ssize_t recv_echo(int fd, void *buf)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	ssize_t len;
+
+	for (;;) {
+		if (poll(&pfd, 1, 5000) <= 0)
+			return -1;
+		len = recvfrom(fd, buf, MAX_MSG_SIZE, 0, NULL, NULL);
+		if (len > 0)
+			return len;
+		if (len < 0 && errno != ENOMSG && errno != EAGAIN)
+			return -1;
+	}
+}
+
+/* wait for the RESUME_TX that lets us send again */
+static int wait_resume(int fd, void *buf)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	if (poll(&pfd, 1, 5000) <= 0)
+		return -1;
+	recvfrom(fd, buf, MAX_MSG_SIZE, 0, NULL, NULL);
+	return 0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int bench(int fd, const struct sockaddr_msm_ipc *addr,
+		 unsigned int size)
+{
+	static unsigned char buf[MAX_MSG_SIZE], rbuf[MAX_MSG_SIZE];
+	double sent[MAX_WINDOW], *rtt = NULL;
+	double start, end, pcpu, scpu;
+	long long copied;
+	unsigned long count = 0, alloc = 0, head = 0, tail = 0;
+	unsigned int inflight = 0;
+
+	pcpu = process_cpu();
+	scpu = system_cpu();
+	copied = bytes_copied();
+	start = now();
+	end = start + opt_seconds;
+
+	while (now() < end) {
+		while (inflight < opt_window) {
+			sent[head % MAX_WINDOW] = now();
+			if (sendto(fd, buf, size, 0,
+				   (const struct sockaddr *)addr,
+				   sizeof(*addr)) < 0) {
+				/* out of quota until the server resumes us */
+				if (errno != EAGAIN)
+					goto err;
+				if (inflight)
+					break;
+				if (wait_resume(fd, rbuf) < 0)
+					goto err;
+				continue;
+			}
+			head++;
+			inflight++;
+		}
+		if (recv_echo(fd, rbuf) != (ssize_t)size)
+			goto err;
+		inflight--;
+		if (count == alloc) {
+			alloc = alloc ? 2 * alloc : 4096;
+			rtt = realloc(rtt, alloc * sizeof(*rtt));
+			if (!rtt)
+				goto err;
+		}
+		rtt[count++] = now() - sent[tail++ % MAX_WINDOW];
+	}
+	while (inflight-- > 0)
+		recv_echo(fd, rbuf);
+	end = now();
+	pcpu = process_cpu() - pcpu;
+	scpu = system_cpu() - scpu;
+	if (copied >= 0)
+		copied = bytes_copied() - copied;
+	if (!count)
+		goto err;
+
+	qsort(rtt, count, sizeof(*rtt), cmp_double);
+	printf("%8u %10.0f %9.1f %9.1f %9.1f %9.1f %9.2f %9.2f", size,
+	       count / (end - start), rtt[0] * 1e6, rtt[count / 2] * 1e6,
+	       rtt[count * 99 / 100] * 1e6, rtt[count - 1] * 1e6,
+	       pcpu * 1e6 / count, scpu * 1e6 / count);
+	if (copied >= 0)
+		printf(" %9.0f\n", (double)copied / count);
+	else
+		printf(" %9s\n", "-");
+	free(rtt);
+	return 0;
+
+err:
+	fprintf(stderr, "%u bytes: %s\n", size,
+		errno ? strerror(errno) : "bad echo");
+	free(rtt);
+	return -1;
+}
+
+static void parse_sizes(char *arg)
+{
+	char *tok;
+
+	nr_sizes = 0;
+	for (tok = strtok(arg, ","); tok && nr_sizes < 32;
+	     tok = strtok(NULL, ","))
+		sizes[nr_sizes++] = strtoul(tok, NULL, 0);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-s service] [-i instance] [-t seconds] [-w window]\n"
+		"          [-b size[,size...]]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_msm_ipc addr;
+	unsigned int i;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "s:i:t:w:b:")) != -1) {
+		switch (c) {
+		case 's':
+			opt_service = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			opt_instance = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_seconds = strtod(optarg, NULL);
+			break;
+		case 'w':
+			opt_window = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			parse_sizes(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!opt_window || opt_window > MAX_WINDOW)
+		usage(argv[0]);
+	for (i = 0; i < nr_sizes; i++)
+		if (!sizes[i] || sizes[i] > MAX_MSG_SIZE)
+			usage(argv[0]);
+
+	fd = socket(AF_MSM_IPC, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	if (lookup_server(fd, &addr) < 0) {
+		fprintf(stderr, "server %u:%u not found\n", opt_service,
+			opt_instance);
+		return 1;
+	}
+
+	printf("server %u:%08x, window %u\n",
+	       addr.address.addr.port_addr.node_id,
+	       addr.address.addr.port_addr.port_id, opt_window);
+	printf("%8s %10s %9s %9s %9s %9s %9s %9s %9s\n", "size", "msgs/s",
+	       "min_us", "p50_us", "p99_us", "max_us", "proc_us", "sys_us",
+	       "copied_b");
+	for (i = 0; i < nr_sizes; i++)
+		if (bench(fd, &addr, sizes[i]) < 0)
+			return 1;
+
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef _TOOLS_LZ4_ASM_UNALIGNED_H
+#define _TOOLS_LZ4_ASM_UNALIGNED_H
+
+#include <linux/kernel.h>
+
+#define get_unaligned(p)						\
+	({ const struct { __typeof__(*(p)) v; } __attribute__((packed))	\
+	   *__p = (const void *)(p); __p->v; })
+#define put_unaligned(val, p)						\
+	do { struct { __typeof__(*(p)) v; } __attribute__((packed))	\
+	     *__p = (void *)(p); __p->v = (val); } while (0)
+
+static inline u16 get_unaligned_le16(const void *p)
+{
+	const u8 *b = p;
+
+	return b[0] | b[1] << 8;
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _TOOLS_LZ4_LINUX_MODULE_H
+#define _TOOLS_LZ4_LINUX_MODULE_H
+
+#define EXPORT_SYMBOL(sym)
+#define MODULE_LICENSE(s)
+#define MODULE_DESCRIPTION(s)
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * lz4bench: measure the kernel LZ4 decompressor in userspace
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * Each input file is cut into blocks (4096 bytes by default, the zram
+ * case; -b 8388608 gives the chunks of an lz4 compressed initramfs),
+ * compressed with lib/lz4/lz4_compress.c and then decompressed over and
+ * over.  The throughput is given in MB/s of decompressed data.  Every
+ * block is checked against the original before anything is timed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <linux/lz4.h>
+
+#ifdef HAVE_REF
+int ref_lz4_decompress(const unsigned char *src, size_t *src_len,
+		unsigned char *dest, size_t actual_dest_len);
+int ref_lz4_decompress_unknownoutputsize(const unsigned char *src,
+		size_t src_len, unsigned char *dest, size_t *dest_len);
+#endif
+
+struct block {
+	unsigned char *comp;
+	size_t comp_len;
+	size_t len;
+};
+
+struct decoder {
+	const char *name;
+	int (*decompress)(const unsigned char *src, size_t *src_len,
+			  unsigned char *dest, size_t actual_dest_len);
+	int (*decompress_unknown)(const unsigned char *src, size_t src_len,
+				  unsigned char *dest, size_t *dest_len);
+};
+
+static struct decoder decoders[] = {
+	{ "tree", lz4_decompress, lz4_decompress_unknownoutputsize },
+#ifdef HAVE_REF
+	{ "ref", ref_lz4_decompress, ref_lz4_decompress_unknownoutputsize },
+#endif
+};
+
+static size_t opt_block = 4096;
+static double opt_seconds = 1.0;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char *read_file(const char *path, size_t *len)
+{
+	unsigned char *buf;
+	struct stat st;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f || fstat(fileno(f), &st) < 0) {
+		perror(path);
+		exit(1);
+	}
+	buf = malloc(st.st_size + 1);
+	if (!buf || fread(buf, 1, st.st_size, f) != (size_t)st.st_size) {
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+	*len = st.st_size;
+	return buf;
+}
+
+static struct block *compress_blocks(const unsigned char *data, size_t len,
+				     unsigned int *nr, size_t *comp_total)
+{
+	void *wrkmem = malloc(LZ4_MEM_COMPRESS);
+	struct block *blocks;
+	unsigned int i;
+
+	*nr = (len + opt_block - 1) / opt_block;
+	blocks = calloc(*nr, sizeof(*blocks));
+	if (!wrkmem || !blocks) {
+		perror("malloc");
+		exit(1);
+	}
+
+	*comp_total = 0;
+	for (i = 0; i < *nr; i++) {
+		struct block *b = &blocks[i];
+
+		b->len = len - i * opt_block;
+		if (b->len > opt_block)
+			b->len = opt_block;
+		b->comp = malloc(lz4_compressbound(b->len));
+		if (!b->comp ||
+		    lz4_compress(data + i * opt_block, b->len, b->comp,
+				 &b->comp_len, wrkmem)) {
+			fprintf(stderr, "block %u: compression failed\n", i);
+			exit(1);
+		}
+		*comp_total += b->comp_len;
+	}
+
+	free(wrkmem);
+	return blocks;
+}
+
+static void verify(const struct decoder *d, const unsigned char *data,
+		   const struct block *blocks, unsigned int nr,
+		   unsigned char *out)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		const struct block *b = &blocks[i];
+		size_t in_len, out_len = opt_block;
+
+		if (d->decompress(b->comp, &in_len, out, b->len) ||
+		    in_len != b->comp_len ||
+		    memcmp(out, data + i * opt_block, b->len)) {
+			fprintf(stderr, "%s: block %u: lz4_decompress mismatch\n",
+				d->name, i);
+			exit(1);
+		}
+		if (d->decompress_unknown(b->comp, b->comp_len, out,
+					  &out_len) ||
+		    out_len != b->len ||
+		    memcmp(out, data + i * opt_block, b->len)) {
+			fprintf(stderr, "%s: block %u: lz4_decompress_unknownoutputsize mismatch\n",
+				d->name, i);
+			exit(1);
+		}
+	}
+}
+
+static double bench(const struct decoder *d, const struct block *blocks,
+		    unsigned int nr, size_t len, unsigned char *out,
+		    int unknown)
+{
+	double start, elapsed;
+	unsigned long rounds = 0;
+	unsigned int i;
+
+	start = now();
+	do {
+		for (i = 0; i < nr; i++) {
+			const struct block *b = &blocks[i];
+			size_t in_len, out_len = opt_block;
+
+			if (unknown)
+				d->decompress_unknown(b->comp, b->comp_len,
+						      out, &out_len);
+			else
+				d->decompress(b->comp, &in_len, out, b->len);
+		}
+		rounds++;
+		elapsed = now() - start;
+	} while (elapsed < opt_seconds);
+
+	return (double)len * rounds / elapsed / (1 << 20);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-b block size] [-t seconds] file...\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int j;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:t:")) != -1) {
+		switch (c) {
+		case 'b':
+			opt_block = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_seconds = strtod(optarg, NULL);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind == argc || !opt_block)
+		usage(argv[0]);
+
+	printf("%-24s %6s %10s %10s %10s\n", "file", "ratio", "decoder",
+	       "known", "unknown");
+
+	for (; optind < argc; optind++) {
+		const char *path = argv[optind];
+		struct block *blocks;
+		unsigned char *data, *out;
+		size_t len, comp_len;
+		unsigned int nr, i;
+
+		data = read_file(path, &len);
+		if (!len)
+			continue;
+		blocks = compress_blocks(data, len, &nr, &comp_len);
+		out = malloc(opt_block);
+		if (!out) {
+			perror("malloc");
+			exit(1);
+		}
+
+		for (j = 0; j < sizeof(decoders) / sizeof(decoders[0]); j++) {
+			const struct decoder *d = &decoders[j];
+
+			verify(d, data, blocks, nr, out);
+			printf("%-24.24s %6.3f %10s %10.1f %10.1f\n", path,
+			       (double)comp_len / len, d->name,
+			       bench(d, blocks, nr, len, out, 0),
+			       bench(d, blocks, nr, len, out, 1));
+		}
+
+		for (i = 0; i < nr; i++)
+			free(blocks[i].comp);
+		free(blocks);
+		free(out);
+		free(data);
+	}
+
+	return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef _TOOLS_LZO_ASM_UNALIGNED_H
+#define _TOOLS_LZO_ASM_UNALIGNED_H
+
+#include <linux/kernel.h>
+
+#define get_unaligned(p)						\
+	({ const struct { __typeof__(*(p)) v; } __attribute__((packed))	\
+	   *__p = (const void *)(p); __p->v; })
+#define put_unaligned(val, p)						\
+	do { struct { __typeof__(*(p)) v; } __attribute__((packed))	\
+	     *__p = (void *)(p); __p->v = (val); } while (0)
+
+static inline u16 get_unaligned_le16(const void *p)
+{
+	const u8 *b = p;
+
+	return b[0] | b[1] << 8;
+}
+
+static inline u32 get_unaligned_le32(const void *p)
+{
+	const u8 *b = p;
+
+	return b[0] | b[1] << 8 | b[2] << 16 | (u32)b[3] << 24;
+}
+
+static inline void put_unaligned_le32(u32 v, void *p)
+{
+	u8 *b = p;
+
+	b[0] = v;
+	b[1] = v >> 8;
+	b[2] = v >> 16;
+	b[3] = v >> 24;
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _TOOLS_LZO_LINUX_MODULE_H
+#define _TOOLS_LZO_LINUX_MODULE_H
+
+#define EXPORT_SYMBOL_GPL(sym)
+#define MODULE_LICENSE(s)
+#define MODULE_DESCRIPTION(s)
+
+#endif
@@ -0,0 +1,380 @@
+/*
+ * lzobench: check and measure the kernel LZO and LZO-RLE code in userspace
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * Each input is cut into pages (4096 bytes by default, the zram and swap
+ * case) and every page is compressed with lzo1x_1_compress() and with
+ * lzorle1x_1_compress() from lib/lzo, then decompressed with
+ * lzo1x_decompress_safe() and checked against the original before
+ * anything is timed.  Built with REF=<dir>, the version 0 output of
+ * every page is also checked against the decompressor of another tree,
+ * which has to keep accepting it.  The throughput is given in MB/s of
+ * uncompressed data.
+ *
+ * An input is a file, such as a dump of a swap partition or of a zram
+ * device, or one of these generated corpora of 1 MiB:
+ *
+ *	zero	pages of zeroes
+ *	sparse	zeroes with a few random words, like many anonymous pages
+ *	text	random sentences of C keywords
+ *	random	incompressible pages
+ *
+ * -r first runs random round trips at every length from 1 to the page
+ * size, on pages mixing the above, with both compressors.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <linux/lzo.h>
+
+#ifdef HAVE_REF
+int ref_lzo1x_decompress_safe(const unsigned char *src, size_t src_len,
+			      unsigned char *dst, size_t *dst_len);
+#endif
+
+#define CORPUS_SIZE	(1 << 20)
+
+struct block {
+	unsigned char *comp;
+	size_t comp_len;
+	size_t len;
+};
+
+struct compressor {
+	const char *name;
+	int (*compress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *wrkmem);
+};
+
+static struct compressor compressors[] = {
+	{ "lzo", lzo1x_1_compress },
+	{ "lzo-rle", lzorle1x_1_compress },
+};
+
+static size_t opt_block = 4096;
+static double opt_seconds = 1.0;
+static unsigned char wrkmem[LZO1X_1_MEM_COMPRESS];
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *xmalloc(size_t len)
+{
+	void *p = malloc(len);
+
+	if (!p) {
+		perror("malloc");
+		exit(1);
+	}
+	return p;
+}
+
+static unsigned char *read_file(const char *path, size_t *len)
+{
+	unsigned char *buf;
+	struct stat st;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f || fstat(fileno(f), &st) < 0) {
+		perror(path);
+		exit(1);
+	}
+	buf = xmalloc(st.st_size + 1);
+	if (fread(buf, 1, st.st_size, f) != (size_t)st.st_size) {
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+	*len = st.st_size;
+	return buf;
+}
+
+static void fill_sparse(unsigned char *p, size_t len)
+{
+	size_t i;
+
+	memset(p, 0, len);
+	for (i = 0; i + 8 <= len; i += 8)
+		if (rand() % 16 == 0)
+			memcpy(p + i, &(int [2]){ rand(), rand() }, 8);
+}
+
+static unsigned char *generate(const char *name, size_t *len)
+{
+	static const char *const words[] = {
+		"static", "int", "unsigned", "char", "const", "struct",
+		"return", "if", "else", "for", "while", "break", "sizeof",
+		"void", "size_t", "NULL", "(", ")", "{", "}", ";", "\n\t",
+	};
+	unsigned char *buf;
+	const char *w;
+	size_t i, n;
+
+	if (strcmp(name, "zero") && strcmp(name, "sparse") &&
+	    strcmp(name, "text") && strcmp(name, "random"))
+		return NULL;
+
+	buf = xmalloc(CORPUS_SIZE);
+	*len = CORPUS_SIZE;
+	if (!strcmp(name, "zero")) {
+		memset(buf, 0, CORPUS_SIZE);
+	} else if (!strcmp(name, "sparse")) {
+		fill_sparse(buf, CORPUS_SIZE);
+	} else if (!strcmp(name, "text")) {
+		for (i = 0; i < CORPUS_SIZE; i += n) {
+			w = words[rand() % (sizeof(words) / sizeof(words[0]))];
+			n = strlen(w) + 1;
+			if (n > CORPUS_SIZE - i)
+				n = CORPUS_SIZE - i;
+			memcpy(buf + i, w, n - 1);
+			buf[i + n - 1] = ' ';
+		}
+	} else {
+		for (i = 0; i < CORPUS_SIZE; i++)
+			buf[i] = rand();
+	}
+	return buf;
+}
+
+static void check(const char *what, const unsigned char *data, size_t len,
+		  const unsigned char *comp, size_t comp_len,
+		  int (*decompress)(const unsigned char *src, size_t src_len,
+				    unsigned char *dst, size_t *dst_len))
+{
+	unsigned char *out = xmalloc(len ? len : 1);
+	size_t out_len = len;
+
+	if (decompress(comp, comp_len, out, &out_len) != LZO_E_OK ||
+	    out_len != len || memcmp(out, data, len)) {
+		fprintf(stderr, "%s: round trip mismatch\n", what);
+		exit(1);
+	}
+	free(out);
+}
+
+static struct block *compress_blocks(const struct compressor *c,
+				     const unsigned char *data, size_t len,
+				     unsigned int *nr, size_t *comp_total)
+{
+	struct block *blocks;
+	unsigned int i;
+
+	*nr = (len + opt_block - 1) / opt_block;
+	blocks = calloc(*nr, sizeof(*blocks));
+	if (!blocks) {
+		perror("calloc");
+		exit(1);
+	}
+
+	*comp_total = 0;
+	for (i = 0; i < *nr; i++) {
+		struct block *b = &blocks[i];
+		const unsigned char *p = data + i * opt_block;
+
+		b->len = len - i * opt_block;
+		if (b->len > opt_block)
+			b->len = opt_block;
+		b->comp = xmalloc(lzo1x_worst_compress(b->len));
+		if (c->compress(p, b->len, b->comp, &b->comp_len, wrkmem)) {
+			fprintf(stderr, "%s: block %u: compression failed\n",
+				c->name, i);
+			exit(1);
+		}
+		check(c->name, p, b->len, b->comp, b->comp_len,
+		      lzo1x_decompress_safe);
+#ifdef HAVE_REF
+		if (c->compress == lzo1x_1_compress)
+			check("ref", p, b->len, b->comp, b->comp_len,
+			      ref_lzo1x_decompress_safe);
+#endif
+		*comp_total += b->comp_len;
+	}
+
+	return blocks;
+}
+
+static double bench_compress(const struct compressor *c,
+			     const unsigned char *data, size_t len,
+			     unsigned char *out)
+{
+	double start, elapsed;
+	unsigned long rounds = 0;
+	size_t off, n, out_len;
+
+	start = now();
+	do {
+		for (off = 0; off < len; off += opt_block) {
+			n = len - off < opt_block ? len - off : opt_block;
+			c->compress(data + off, n, out, &out_len, wrkmem);
+		}
+		rounds++;
+		elapsed = now() - start;
+	} while (elapsed < opt_seconds);
+
+	return (double)len * rounds / elapsed / (1 << 20);
+}
+
+static double bench_decompress(const struct block *blocks, unsigned int nr,
+			       size_t len, unsigned char *out)
+{
+	double start, elapsed;
+	unsigned long rounds = 0;
+	unsigned int i;
+
+	start = now();
+	do {
+		for (i = 0; i < nr; i++) {
+			size_t out_len = opt_block;
+
+			lzo1x_decompress_safe(blocks[i].comp,
+					      blocks[i].comp_len, out,
+					      &out_len);
+		}
+		rounds++;
+		elapsed = now() - start;
+	} while (elapsed < opt_seconds);
+
+	return (double)len * rounds / elapsed / (1 << 20);
+}
+
+/* every length, on pages that mix runs of zeroes, sparse words and noise */
+static void round_trips(void)
+{
+	unsigned char *page = xmalloc(opt_block);
+	unsigned char *comp = xmalloc(lzo1x_worst_compress(opt_block));
+	size_t len, i, k, comp_len;
+	unsigned int j;
+	char what[64];
+
+	for (len = 1; len <= opt_block; len++) {
+		for (i = 0; i < len; ) {
+			size_t n = rand() % 512 + 1;
+
+			if (n > len - i)
+				n = len - i;
+			switch (rand() % 3) {
+			case 0:
+				memset(page + i, 0, n);
+				break;
+			case 1:
+				fill_sparse(page + i, n);
+				break;
+			default:
+				for (k = 0; k < n; k++)
+					page[i + k] = rand();
+				break;
+			}
+			i += n;
+		}
+		for (j = 0; j < sizeof(compressors) / sizeof(compressors[0]);
+		     j++) {
+			const struct compressor *c = &compressors[j];
+
+			snprintf(what, sizeof(what), "%s: length %zu",
+				 c->name, len);
+			if (c->compress(page, len, comp, &comp_len, wrkmem)) {
+				fprintf(stderr, "%s: compression failed\n",
+					what);
+				exit(1);
+			}
+			check(what, page, len, comp, comp_len,
+			      lzo1x_decompress_safe);
+#ifdef HAVE_REF
+			if (c->compress == lzo1x_1_compress)
+				check(what, page, len, comp, comp_len,
+				      ref_lzo1x_decompress_safe);
+#endif
+		}
+	}
+	printf("round trips of 1 to %zu bytes: ok\n", opt_block);
+	free(page);
+	free(comp);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-b page size] [-t seconds] [-r] "
+		"file|zero|sparse|text|random...\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c, self_test = 0;
+	unsigned int j;
+
+	while ((c = getopt(argc, argv, "b:t:r")) != -1) {
+		switch (c) {
+		case 'b':
+			opt_block = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_seconds = strtod(optarg, NULL);
+			break;
+		case 'r':
+			self_test = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if ((optind == argc && !self_test) || !opt_block)
+		usage(argv[0]);
+
+	srand(1);
+	if (self_test)
+		round_trips();
+
+	if (optind < argc)
+		printf("%-24s %8s %6s %10s %10s\n", "input", "codec", "ratio",
+		       "compress", "decompress");
+
+	for (; optind < argc; optind++) {
+		const char *path = argv[optind];
+		unsigned char *data, *out;
+		size_t len, comp_len;
+
+		data = generate(path, &len);
+		if (!data)
+			data = read_file(path, &len);
+		if (!len)
+			continue;
+		out = xmalloc(lzo1x_worst_compress(opt_block));
+
+		for (j = 0; j < sizeof(compressors) / sizeof(compressors[0]);
+		     j++) {
+			const struct compressor *cp = &compressors[j];
+			struct block *blocks;
+			unsigned int nr, i;
+
+			blocks = compress_blocks(cp, data, len, &nr,
+						 &comp_len);
+			printf("%-24.24s %8s %6.3f %10.1f %10.1f\n", path,
+			       cp->name, (double)comp_len / len,
+			       bench_compress(cp, data, len, out),
+			       bench_decompress(blocks, nr, len, out));
+
+			for (i = 0; i < nr; i++)
+				free(blocks[i].comp);
+			free(blocks);
+		}
+		free(out);
+		free(data);
+	}
+
+	return 0;
+}
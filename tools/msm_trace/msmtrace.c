@@ -0,0 +1,285 @@
+/*
+ * msmtrace: decode the MSM binary event trace
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * Maps the ring of every CPU from the msm_trace debugfs directory, or from
+ * a directory of copies saved with cat, takes a consistent snapshot of the
+ * entries that were not overwritten while reading them, and prints them
+ * in timestamp order, one line per event:
+ *
+ *	<seconds>.<microseconds> cpu<n> <event>: <arguments>
+ *
+ * Event names and formats come from the events file in the same
+ * directory.  -n prints only the last <n> events, -r the raw argument
+ * values for events the events file does not know.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "msm_trace.h"
+
+#define MAX_EVENTS	65536
+#define MAX_FMT		256
+
+struct event_type {
+	char *name;
+	char *fmt;
+};
+
+struct event {
+	struct msm_trace_ent ent;
+	unsigned int cpu;
+};
+
+static struct event_type types[MAX_EVENTS];
+static struct event *events;
+static size_t nr_events, max_events;
+static int opt_raw;
+
+static void load_types(const char *dir)
+{
+	char path[4096], line[1024], name[256], *fmt;
+	unsigned int id;
+	FILE *f;
+	int n;
+
+	snprintf(path, sizeof(path), "%s/events", dir);
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\n")] = 0;
+		if (sscanf(line, "%u %255s %n", &id, name, &n) < 2 ||
+		    id >= MAX_EVENTS)
+			continue;
+		fmt = line + n;
+		types[id].name = strdup(name);
+		types[id].fmt = strdup(fmt);
+	}
+	fclose(f);
+}
+
+static void add_event(const struct msm_trace_ent *ent, unsigned int cpu)
+{
+	if (nr_events == max_events) {
+		max_events = max_events ? 2 * max_events : 4096;
+		events = realloc(events, max_events * sizeof(*events));
+		if (!events) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	events[nr_events].ent = *ent;
+	events[nr_events].cpu = cpu;
+	nr_events++;
+}
+
+/*
+ * Copy out the entries of one ring.  An entry is only taken if its seq is
+ * the one expected at its index both before and after copying it, i.e. it
+ * was neither being written nor overwritten meanwhile.
+ */
+static int read_ring(const char *path)
+{
+	volatile struct msm_trace_ctl *ctl;
+	volatile struct msm_trace_ent *ents, *e;
+	struct msm_trace_ent copy;
+	long page = sysconf(_SC_PAGESIZE);
+	uint32_t head, idx, first, seq;
+	size_t size;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	map = mmap(NULL, page, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	ctl = map;
+	if (ctl->magic != MSM_TRACE_MAGIC ||
+	    ctl->version != MSM_TRACE_VERSION ||
+	    ctl->ent_size != sizeof(struct msm_trace_ent) ||
+	    !ctl->nents || (ctl->nents & (ctl->nents - 1))) {
+		fprintf(stderr, "%s: not an msm_trace ring\n", path);
+		munmap(map, page);
+		close(fd);
+		return -1;
+	}
+	size = page + (size_t)ctl->nents * ctl->ent_size;
+	munmap(map, page);
+
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror(path);
+		return -1;
+	}
+	ctl = map;
+	ents = (volatile struct msm_trace_ent *)((char *)map + page);
+
+	head = ctl->head;
+	first = head > ctl->nents ? head - ctl->nents : 0;
+	for (idx = first; idx != head; idx++) {
+		e = &ents[idx & (ctl->nents - 1)];
+		seq = e->seq;
+		__sync_synchronize();
+		memcpy(&copy, (const void *)e, sizeof(copy));
+		__sync_synchronize();
+		if (seq != idx + 1 || e->seq != seq)
+			continue;
+		add_event(&copy, ctl->cpu);
+	}
+
+	munmap(map, size);
+	return 0;
+}
+
+static int cmp_event(const void *a, const void *b)
+{
+	const struct event *x = a, *y = b;
+
+	if (x->ent.ts != y->ent.ts)
+		return x->ent.ts < y->ent.ts ? -1 : 1;
+	if (x->cpu != y->cpu)
+		return x->cpu < y->cpu ? -1 : 1;
+	return x->ent.seq < y->ent.seq ? -1 : 1;
+}
+
+/*
+ * Make a format safe to hand four unsigned ints to: only d i u x X c with
+ * flags and a width pass, %p becomes 0x%08x, anything else is printed as
+ * is.
+ */
+static void safe_format(const char *fmt, char *out, size_t len)
+{
+	size_t o = 0, span;
+	int args = 0;
+
+	while (*fmt && o + 16 < len) {
+		if (*fmt != '%') {
+			out[o++] = *fmt++;
+			continue;
+		}
+		if (fmt[1] == '%') {
+			out[o++] = '%';
+			out[o++] = '%';
+			fmt += 2;
+			continue;
+		}
+		span = 1 + strspn(fmt + 1, "-+ #0123456789");
+		if (args < MSM_TRACE_MAX_ARGS && fmt[span] &&
+		    strchr("diuxXc", fmt[span]) && span + 1 < len - o - 16) {
+			memcpy(out + o, fmt, span + 1);
+			o += span + 1;
+			fmt += span + 1;
+			args++;
+		} else if (args < MSM_TRACE_MAX_ARGS && fmt[span] == 'p') {
+			memcpy(out + o, "0x%08x", 6);
+			o += 6;
+			fmt += span + 1;
+			args++;
+		} else {
+			out[o++] = '%';
+			out[o++] = '%';
+			fmt++;
+		}
+	}
+	out[o] = 0;
+}
+
+static void print_event(const struct event *ev)
+{
+	const struct msm_trace_ent *e = &ev->ent;
+	const struct event_type *t = &types[e->id];
+	char fmt[MAX_FMT];
+
+	printf("%5llu.%06llu cpu%u ", (unsigned long long)(e->ts / 1000000000),
+	       (unsigned long long)(e->ts % 1000000000 / 1000), ev->cpu);
+	if (!t->name) {
+		printf("event%u:", e->id);
+		if (opt_raw)
+			printf(" %08x %08x %08x %08x", e->args[0], e->args[1],
+			       e->args[2], e->args[3]);
+		putchar('\n');
+		return;
+	}
+	printf("%s: ", t->name);
+	safe_format(t->fmt, fmt, sizeof(fmt));
+	printf(fmt, e->args[0], e->args[1], e->args[2], e->args[3]);
+	putchar('\n');
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-n last_events] [-r] [dir]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = "/sys/kernel/debug/msm_trace";
+	char path[4096];
+	struct dirent *de;
+	size_t i, start = 0, last = 0;
+	DIR *d;
+	int c, rings = 0;
+
+	while ((c = getopt(argc, argv, "n:r")) != -1) {
+		switch (c) {
+		case 'n':
+			last = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			opt_raw = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind < argc)
+		dir = argv[optind];
+
+	/* rings first: events logged meanwhile may have new types */
+	d = opendir(dir);
+	if (!d) {
+		perror(dir);
+		return 1;
+	}
+	while ((de = readdir(d))) {
+		if (strncmp(de->d_name, "cpu", 3))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		if (!read_ring(path))
+			rings++;
+	}
+	closedir(d);
+	if (!rings) {
+		fprintf(stderr, "%s: no rings\n", dir);
+		return 1;
+	}
+	load_types(dir);
+
+	qsort(events, nr_events, sizeof(*events), cmp_event);
+	if (last && last < nr_events)
+		start = nr_events - last;
+	for (i = start; i < nr_events; i++)
+		print_event(&events[i]);
+	return 0;
+}
@@ -0,0 +1 @@
+#include <linux/kernel.h>
@@ -0,0 +1,102 @@
+#ifndef _TOOLS_QMI_LINUX_KERNEL_H
+#define _TOOLS_QMI_LINUX_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#define ETOOSMALL	525
+
+extern int qmi_verbose;
+extern int qmi_cache_plans;
+
+#define pr_err(fmt, ...) \
+	do { if (qmi_verbose) fprintf(stderr, fmt, ##__VA_ARGS__); } while (0)
+#define pr_debug(fmt, ...)	do { } while (0)
+
+#define min(x, y)		((x) < (y) ? (x) : (y))
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define __init
+#define might_sleep()		do { } while (0)
+#define preempt_disable()	do { } while (0)
+#define preempt_enable()	do { } while (0)
+
+#define GFP_KERNEL		0
+#define kzalloc(size, gfp)	calloc(1, size)
+#define kfree(p)		free(p)
+#define kfree_rcu(p, f)		free(p)
+
+#define MAX_ERRNO		4095
+#define ERR_PTR(err)		((void *)(long)(err))
+#define PTR_ERR(ptr)		((long)(ptr))
+#define IS_ERR(ptr)		((unsigned long)(ptr) >= (unsigned long)-MAX_ERRNO)
+
+struct rcu_head {
+	struct rcu_head *next;
+	void (*func)(struct rcu_head *head);
+};
+
+#define rcu_read_lock()		do { } while (0)
+#define rcu_read_unlock()	do { } while (0)
+
+struct hlist_head {
+	struct hlist_node *first;
+};
+
+struct hlist_node {
+	struct hlist_node *next, **pprev;
+};
+
+static inline void hlist_add_head_rcu(struct hlist_node *n,
+				      struct hlist_head *h)
+{
+	n->next = h->first;
+	n->pprev = &h->first;
+	if (h->first)
+		h->first->pprev = &n->next;
+	h->first = n;
+}
+
+#define hlist_for_each_entry_rcu(tpos, pos, head, member)		\
+	for (pos = (head)->first;					\
+	     pos && ((tpos = container_of(pos, __typeof__(*tpos),	\
+					  member)), 1);			\
+	     pos = pos->next)
+
+static inline unsigned long hash_ptr(const void *ptr, unsigned int bits)
+{
+	return ((unsigned long)ptr >> 4) & ((1UL << bits) - 1);
+}
+
+struct mutex {
+	int unused;
+};
+
+#define DEFINE_MUTEX(m)		struct mutex m
+#define mutex_lock(m)		((void)(m))
+#define mutex_unlock(m)		((void)(m))
+
+/* plans are cached when the descriptor looks like kernel data */
+struct module;
+#define core_kernel_data(addr)		((void)(addr), qmi_cache_plans)
+#define __module_address(addr)		((struct module *)NULL)
+#define within_module_core(addr, mod)	0
+
+#define EXPORT_SYMBOL(sym)
+#define MODULE_LICENSE(s)
+#define MODULE_DESCRIPTION(s)
+
+#endif
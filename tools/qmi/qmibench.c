@@ -0,0 +1,592 @@
+/*
+ * qmibench: check and measure the kernel QMI encoder/decoder in userspace
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * Random descriptors are generated, with optional TLVs, static and variable
+ * length arrays and nested structures, and random messages for each are
+ * encoded and decoded with lib/qmi_encdec.c.  Every message has to decode
+ * to what was encoded and to fail with -ETOOSMALL when the buffer is one
+ * byte short.  Truncated and corrupted messages have to be rejected or
+ * decoded within bounds.  With REF= (see the Makefile) the messages also
+ * go through the encoder and decoder of the other tree, which have to give
+ * the same results.  The old code misplaced nested structures when
+ * encoding and only decoded fixed size ones, so those messages are left
+ * out of the comparison.
+ *
+ * Then the ns per message to encode and decode are given for a few
+ * typical messages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <time.h>
+#include <linux/qmi_encdec.h>
+
+#ifdef HAVE_REF
+int ref_qmi_kernel_encode(struct msg_desc *desc, void *out_buf,
+			  uint32_t out_buf_len, void *in_c_struct);
+int ref_qmi_kernel_decode(struct msg_desc *desc, void *out_c_struct,
+			  void *in_buf, uint32_t in_buf_len);
+#endif
+
+#define MAX_EI		64
+#define MAX_MSG		(1 << 20)
+
+/* what the reference implementation can't be compared on */
+#define REF_NO_ENCODE	0x1
+#define REF_NO_DECODE	0x2
+#define LONG_LEN	0x4
+#define SHORT_LEN	0x8
+
+int qmi_verbose;
+int qmi_cache_plans = 1;
+
+static unsigned int opt_descs = 2000;
+static unsigned int opt_msgs = 20;
+static unsigned int opt_seed = 1;
+static double opt_seconds = 0.5;
+
+static unsigned int rnd(unsigned int n)
+{
+	return n ? (unsigned int)random() % n : 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t align(uint32_t off, uint32_t a)
+{
+	return (off + a - 1) & ~(a - 1);
+}
+
+static const struct {
+	enum elem_type type;
+	uint32_t size;
+} basic_types[] = {
+	{ QMI_UNSIGNED_1_BYTE, 1 },
+	{ QMI_UNSIGNED_2_BYTE, 2 },
+	{ QMI_UNSIGNED_4_BYTE, 4 },
+	{ QMI_UNSIGNED_8_BYTE, 8 },
+	{ QMI_SIGNED_2_BYTE_ENUM, 2 },
+	{ QMI_SIGNED_4_BYTE_ENUM, 4 },
+};
+
+/*
+ * Generate the elements of a structure, returning their array.  *size is
+ * the size of the C structure, *max_len its maximum encoded length and
+ * *var whether its encoded size varies.
+ */
+static struct elem_info *gen_struct(int level, uint32_t *size,
+				    uint32_t *max_len, int *var, int *flags)
+{
+	struct elem_info *ei = calloc(MAX_EI, sizeof(*ei));
+	unsigned int nr_tlv = level == 1 ? 1 + rnd(12) : 1 + rnd(4);
+	unsigned int n = 0, t, kind, i;
+	uint32_t off = 0, len = 0, sub_size, sub_len;
+	int sub_var = 0;
+
+	if (!ei) {
+		perror("calloc");
+		exit(1);
+	}
+	*var = 0;
+
+	for (t = 0; t < nr_tlv; t++) {
+		uint8_t tlv_type = 0;
+		uint32_t elem_size, elem_len = 1, data_len;
+		enum elem_type type;
+		enum array_type is_array;
+		struct elem_info *sub = NULL;
+
+		if (level == 1) {
+			tlv_type = rnd(3) ? 0x10 + t : 0x01 + t;
+			if (tlv_type >= 0x10) {
+				ei[n++] = (struct elem_info) {
+					QMI_OPT_FLAG, 1, 1, NO_ARRAY,
+					tlv_type, off, NULL };
+				off++;
+			}
+		}
+
+		kind = rnd(level < 3 ? 8 : 5);
+		i = rnd(ARRAY_SIZE(basic_types));
+		type = basic_types[i].type;
+		elem_size = basic_types[i].size;
+		if (kind >= 5) {
+			type = QMI_STRUCT;
+			sub = gen_struct(level + 1, &sub_size, &sub_len,
+					 &sub_var, flags);
+			elem_size = sub_size;
+			*flags |= REF_NO_ENCODE;
+			if (level > 1)
+				*flags |= REF_NO_DECODE;
+		}
+
+		if (kind % 5 == 0 || kind == 5) {
+			is_array = NO_ARRAY;
+		} else if (kind % 5 == 1 || kind == 6) {
+			is_array = STATIC_ARRAY;
+			elem_len = 1 + rnd(type == QMI_STRUCT ? 4 : 16);
+			if (type == QMI_STRUCT && sub_var)
+				*flags |= REF_NO_DECODE;
+		} else {
+			is_array = VAR_LEN_ARRAY;
+			if (type == QMI_STRUCT) {
+				elem_len = 1 + rnd(4);
+				*flags |= REF_NO_DECODE;
+			} else if (level == 1 && !rnd(4)) {
+				elem_len = 256 + rnd(1000);
+			} else {
+				elem_len = 1 + rnd(level == 1 ? 255 : 16);
+			}
+			data_len = elem_len > 255 ? 2 : 1;
+			*flags |= data_len == 2 ? LONG_LEN : SHORT_LEN;
+			off = align(off, 4);
+			ei[n++] = (struct elem_info) {
+				QMI_DATA_LEN, 1, data_len, NO_ARRAY,
+				tlv_type, off, NULL };
+			off += 4;
+			len += data_len;
+			*var = 1;
+		}
+		if (type == QMI_STRUCT && sub_var)
+			*var = 1;
+
+		off = align(off, type == QMI_STRUCT ? 8 : elem_size);
+		ei[n++] = (struct elem_info) { type, elem_len, elem_size,
+					       is_array, tlv_type, off, sub };
+		off += elem_len * elem_size;
+		len += elem_len * (type == QMI_STRUCT ? sub_len : elem_size);
+		if (level == 1)
+			len += 3;
+	}
+	ei[n].data_type = QMI_EOTI;
+
+	*size = align(off ? off : 1, 8);
+	*max_len = len;
+	return ei;
+}
+
+static void free_struct(struct elem_info *ei)
+{
+	struct elem_info *temp_ei;
+
+	for (temp_ei = ei; temp_ei->data_type != QMI_EOTI; temp_ei++)
+		if (temp_ei->data_type == QMI_STRUCT)
+			free_struct(temp_ei->ei_array);
+	free(ei);
+}
+
+/*
+ * Fill a C structure with a random message, in the form a decoder leaves
+ * it: whatever is not sent is zero.
+ */
+static void gen_msg(struct elem_info *ei, uint8_t *c, int level)
+{
+	uint32_t data_len = 0, n, i;
+	int flag = -1;
+
+	for (; ei->data_type != QMI_EOTI; ei++) {
+		uint8_t *p = c + ei->offset;
+
+		switch (ei->data_type) {
+		case QMI_OPT_FLAG:
+			flag = ei->offset;
+			*p = rnd(2);
+			if (!*p) {
+				while (ei[1].tlv_type == ei->tlv_type)
+					ei++;
+			}
+			continue;
+		case QMI_DATA_LEN:
+			data_len = rnd(4) ? rnd(ei[1].elem_len + 1) :
+			       (rnd(2) ? 0 : ei[1].elem_len);
+			memcpy(p, &data_len, sizeof(data_len));
+			if (data_len)
+				continue;
+			/* empty arrays are not sent at the top level */
+			if (level == 1 && flag >= 0)
+				c[flag] = 0;
+			ei++;
+			continue;
+		default:
+			break;
+		}
+
+		if (ei->is_array == NO_ARRAY)
+			n = 1;
+		else if (ei->is_array == STATIC_ARRAY)
+			n = ei->elem_len;
+		else
+			n = data_len;
+
+		if (ei->data_type == QMI_STRUCT) {
+			for (i = 0; i < n; i++)
+				gen_msg(ei->ei_array, p + i * ei->elem_size,
+					level + 1);
+		} else {
+			for (i = 0; i < n * ei->elem_size; i++)
+				p[i] = random();
+		}
+		if (level == 1)
+			flag = -1;
+	}
+}
+
+static void fail(const char *what, unsigned int d, unsigned int m, int ret)
+{
+	fprintf(stderr, "descriptor %u message %u: %s (%d)\n", d, m, what,
+		ret);
+	exit(1);
+}
+
+/* decode corrupted copies of a message, which must stay within bounds */
+static void corrupt(struct msg_desc *desc, uint8_t *msg, int len,
+		    uint8_t *out, uint32_t size)
+{
+	uint8_t *copy = malloc(len);
+	unsigned int i, j;
+
+	if (!copy) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < 8; i++) {
+		memcpy(copy, msg, len);
+		for (j = 0; j < 1 + rnd(4); j++)
+			copy[rnd(len)] = random();
+		memset(out, 0, size);
+		qmi_kernel_decode(desc, out, copy, i < 4 ? 1 + rnd(len) : len);
+	}
+	free(copy);
+}
+
+static void check(void)
+{
+	uint8_t *buf = malloc(MAX_MSG), *ref = malloc(MAX_MSG);
+	unsigned long nr_msgs = 0, nr_ref_enc = 0, nr_ref_dec = 0;
+	unsigned int d, m;
+
+	if (!buf || !ref) {
+		perror("malloc");
+		exit(1);
+	}
+
+	/* descriptors are freed and their addresses reused: no caching */
+	qmi_cache_plans = 0;
+	for (d = 0; d < opt_descs; d++) {
+		struct msg_desc desc = { 0 };
+		uint32_t size, max_len;
+		uint8_t *msg, *out;
+		int var, flags = 0, ret;
+
+		desc.ei_array = gen_struct(1, &size, &max_len, &var, &flags);
+		desc.max_msg_len = max_len;
+		if ((flags & (LONG_LEN | SHORT_LEN)) == (LONG_LEN | SHORT_LEN))
+			flags |= REF_NO_DECODE;
+		if (max_len > MAX_MSG) {
+			free_struct(desc.ei_array);
+			continue;
+		}
+		if (!qmi_verify_max_msg_len(&desc))
+			fail("maximum length", d, 0, max_len);
+
+		msg = malloc(size);
+		out = malloc(size);
+		if (!msg || !out) {
+			perror("malloc");
+			exit(1);
+		}
+
+		for (m = 0; m < opt_msgs; m++) {
+			memset(msg, 0, size);
+			gen_msg(desc.ei_array, msg, 1);
+
+			ret = qmi_kernel_encode(&desc, buf, max_len, msg);
+			if (ret < 0 || ret > (int)max_len)
+				fail("encode", d, m, ret);
+			memset(out, 0, size);
+			if (ret) {
+				if (qmi_kernel_decode(&desc, out, buf, ret) ||
+				    memcmp(out, msg, size))
+					fail("decode", d, m, ret);
+				if (qmi_kernel_encode(&desc, ref, ret - 1,
+						      msg) != -ETOOSMALL)
+					fail("short buffer", d, m, ret);
+				corrupt(&desc, buf, ret, out, size);
+			} else if (memcmp(out, msg, size)) {
+				fail("empty message", d, m, ret);
+			}
+			nr_msgs++;
+
+#ifdef HAVE_REF
+			if (!(flags & REF_NO_ENCODE)) {
+				memset(ref, 0, max_len);
+				if (ref_qmi_kernel_encode(&desc, ref, max_len,
+							  msg) != ret ||
+				    memcmp(ref, buf, ret))
+					fail("reference encode", d, m, ret);
+				nr_ref_enc++;
+			}
+			if (!(flags & REF_NO_DECODE) && ret) {
+				memset(out, 0, size);
+				if (ref_qmi_kernel_decode(&desc, out, buf,
+							  ret) ||
+				    memcmp(out, msg, size))
+					fail("reference decode", d, m, ret);
+				nr_ref_dec++;
+			}
+#endif
+		}
+
+		free(msg);
+		free(out);
+		free_struct(desc.ei_array);
+	}
+	qmi_cache_plans = 1;
+
+	printf("%lu messages checked, %lu encodings and %lu decodings "
+	       "against the reference\n", nr_msgs, nr_ref_enc, nr_ref_dec);
+	free(buf);
+	free(ref);
+}
+
+/* typical messages for the benchmark */
+struct resp_type {
+	uint16_t result;
+	uint16_t error;
+};
+
+struct resp_msg {
+	struct resp_type resp;
+	uint8_t opt1_valid;
+	uint32_t opt1;
+	uint8_t opt2_valid;
+	uint64_t opt2;
+};
+
+struct name_req_msg {
+	char ping[4];
+	uint8_t name_valid;
+	uint32_t name_len;
+	char name[255];
+};
+
+struct data_req_msg {
+	uint32_t data_len;
+	uint8_t data[8192];
+	uint8_t opt_valid;
+	uint32_t opt;
+};
+
+struct wide_msg {
+	struct {
+		uint8_t valid;
+		uint32_t val;
+	} tlv[16];
+};
+
+#define EI(type, len, size, array, tlv, off) \
+	{ type, len, size, array, tlv, off, NULL }
+#define EOTI	{ QMI_EOTI, 0, 0, NO_ARRAY, 0, 0, NULL }
+
+static struct elem_info resp_type_ei[] = {
+	EI(QMI_UNSIGNED_2_BYTE, 1, 2, NO_ARRAY, 0,
+	   offsetof(struct resp_type, result)),
+	EI(QMI_UNSIGNED_2_BYTE, 1, 2, NO_ARRAY, 0,
+	   offsetof(struct resp_type, error)),
+	EOTI,
+};
+
+static struct elem_info resp_msg_ei[] = {
+	{ QMI_STRUCT, 1, sizeof(struct resp_type), NO_ARRAY, 0x02,
+	  offsetof(struct resp_msg, resp), resp_type_ei },
+	EI(QMI_OPT_FLAG, 1, 1, NO_ARRAY, 0x10,
+	   offsetof(struct resp_msg, opt1_valid)),
+	EI(QMI_UNSIGNED_4_BYTE, 1, 4, NO_ARRAY, 0x10,
+	   offsetof(struct resp_msg, opt1)),
+	EI(QMI_OPT_FLAG, 1, 1, NO_ARRAY, 0x11,
+	   offsetof(struct resp_msg, opt2_valid)),
+	EI(QMI_UNSIGNED_8_BYTE, 1, 8, NO_ARRAY, 0x11,
+	   offsetof(struct resp_msg, opt2)),
+	EOTI,
+};
+
+static struct elem_info name_req_msg_ei[] = {
+	EI(QMI_UNSIGNED_1_BYTE, 4, 1, STATIC_ARRAY, 0x01,
+	   offsetof(struct name_req_msg, ping)),
+	EI(QMI_OPT_FLAG, 1, 1, NO_ARRAY, 0x10,
+	   offsetof(struct name_req_msg, name_valid)),
+	EI(QMI_DATA_LEN, 1, 1, NO_ARRAY, 0x10,
+	   offsetof(struct name_req_msg, name_len)),
+	EI(QMI_UNSIGNED_1_BYTE, 255, 1, VAR_LEN_ARRAY, 0x10,
+	   offsetof(struct name_req_msg, name)),
+	EOTI,
+};
+
+static struct elem_info data_req_msg_ei[] = {
+	EI(QMI_DATA_LEN, 1, 2, NO_ARRAY, 0x01,
+	   offsetof(struct data_req_msg, data_len)),
+	EI(QMI_UNSIGNED_1_BYTE, 8192, 1, VAR_LEN_ARRAY, 0x01,
+	   offsetof(struct data_req_msg, data)),
+	EI(QMI_OPT_FLAG, 1, 1, NO_ARRAY, 0x10,
+	   offsetof(struct data_req_msg, opt_valid)),
+	EI(QMI_UNSIGNED_4_BYTE, 1, 4, NO_ARRAY, 0x10,
+	   offsetof(struct data_req_msg, opt)),
+	EOTI,
+};
+
+static struct elem_info wide_msg_ei[33];
+
+static void init_wide_msg(struct wide_msg *msg)
+{
+	struct elem_info *ei = wide_msg_ei;
+	unsigned int i;
+
+	for (i = 0; i < 16; i++) {
+		*ei++ = (struct elem_info)EI(QMI_OPT_FLAG, 1, 1, NO_ARRAY,
+			0x10 + i, offsetof(struct wide_msg, tlv[i].valid));
+		*ei++ = (struct elem_info)EI(QMI_UNSIGNED_4_BYTE, 1, 4,
+			NO_ARRAY, 0x10 + i,
+			offsetof(struct wide_msg, tlv[i].val));
+		msg->tlv[i].valid = i & 1;
+		msg->tlv[i].val = i;
+	}
+	*ei = (struct elem_info)EOTI;
+}
+
+struct codec {
+	const char *name;
+	int (*encode)(struct msg_desc *desc, void *out_buf,
+		      uint32_t out_buf_len, void *in_c_struct);
+	int (*decode)(struct msg_desc *desc, void *out_c_struct,
+		      void *in_buf, uint32_t in_buf_len);
+};
+
+static struct codec codecs[] = {
+	{ "tree", qmi_kernel_encode, qmi_kernel_decode },
+#ifdef HAVE_REF
+	{ "ref", ref_qmi_kernel_encode, ref_qmi_kernel_decode },
+#endif
+};
+
+static double bench(const struct codec *c, struct msg_desc *desc, void *msg,
+		    size_t size, int decode)
+{
+	static uint8_t buf[MAX_MSG];
+	void *out = malloc(size);
+	unsigned long rounds = 0;
+	double start, elapsed;
+	unsigned int i;
+	int len;
+
+	len = qmi_kernel_encode(desc, buf, desc->max_msg_len, msg);
+	if (!out || len <= 0) {
+		fprintf(stderr, "benchmark message does not encode\n");
+		exit(1);
+	}
+
+	start = now();
+	do {
+		for (i = 0; i < 1000; i++) {
+			if (decode)
+				c->decode(desc, out, buf, len);
+			else
+				c->encode(desc, buf, desc->max_msg_len, msg);
+		}
+		rounds += 1000;
+		elapsed = now() - start;
+	} while (elapsed < opt_seconds);
+
+	free(out);
+	return elapsed * 1e9 / rounds;
+}
+
+static void run_benchmarks(void)
+{
+	static struct resp_msg resp = { { 1, 3 }, 1, 42, 0, 0 };
+	static struct name_req_msg name_req = { "ping", 1, 32, "client" };
+	static struct data_req_msg data_req = { 4096, { 0 }, 1, 7 };
+	static struct wide_msg wide;
+	struct {
+		const char *name;
+		struct msg_desc desc;
+		void *msg;
+		size_t size;
+	} msgs[] = {
+		{ "resp", { 0, 0, resp_msg_ei }, &resp, sizeof(resp) },
+		{ "name_req", { 0, 0, name_req_msg_ei }, &name_req,
+		  sizeof(name_req) },
+		{ "data_req", { 0, 0, data_req_msg_ei }, &data_req,
+		  sizeof(data_req) },
+		{ "wide", { 0, 0, wide_msg_ei }, &wide, sizeof(wide) },
+	};
+	unsigned int i, j;
+
+	init_wide_msg(&wide);
+	printf("%-10s %6s %10s %10s\n", "message", "codec", "enc_ns",
+	       "dec_ns");
+	for (i = 0; i < ARRAY_SIZE(msgs); i++) {
+		struct msg_desc *desc = &msgs[i].desc;
+
+		desc->max_msg_len = MAX_MSG;
+		for (j = 0; j < ARRAY_SIZE(codecs); j++)
+			printf("%-10s %6s %10.1f %10.1f\n", msgs[i].name,
+			       codecs[j].name,
+			       bench(&codecs[j], desc, msgs[i].msg,
+				     msgs[i].size, 0),
+			       bench(&codecs[j], desc, msgs[i].msg,
+				     msgs[i].size, 1));
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-d descriptors] [-m messages] [-s seed] "
+		"[-t seconds] [-v]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "d:m:s:t:v")) != -1) {
+		switch (c) {
+		case 'd':
+			opt_descs = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			opt_msgs = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			opt_seed = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_seconds = strtod(optarg, NULL);
+			break;
+		case 'v':
+			qmi_verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	srandom(opt_seed);
+	check();
+	run_benchmarks();
+	return 0;
+}
@@ -0,0 +1,312 @@
+/*
+ * squashfs-bench.c -- parallel random or sequential reads from a squashfs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Collects the regular files under dir, drops the page cache, then runs
+ * -j reader threads for -t seconds, each pread()ing -b bytes at random
+ * block aligned offsets of randomly chosen files.  Every read that misses
+ * the page cache decompresses a datablock, so with a large enough image
+ * this times the decompressor and, with several readers, how well they
+ * share it.  Prints the reads per second, the throughput and the 50th,
+ * 99th percentile and maximum read latency.
+ *
+ * With -s the readers instead take the files in turn and read each one
+ * from start to end, once, which is where decompressing straight into
+ * the page cache (SQUASHFS_FILE_DIRECT) saves the copy out of the cache.
+ * Use a larger -b, such as 131072, there.
+ *
+ * Both modes also print the CPU time, user and system, the process spent
+ * per MB read: the decompression runs in the readers' context.
+ *
+ * To compare decompressor thread modes and codecs, build one image per
+ * codec and mount it once per mode:
+ *
+ *	mksquashfs /system /tmp/lz4.img -comp lz4
+ *	mount -o loop,threads=single /tmp/lz4.img /mnt
+ *	squashfs-bench -j 4 /mnt
+ *	umount /mnt
+ *	mount -o loop,threads=percpu /tmp/lz4.img /mnt
+ *	squashfs-bench -j 4 /mnt
+ *
+ * and the same with -comp gzip, lzo and xz.  Dropping the page cache
+ * needs root; -n skips it.
+ *
+ * usage: squashfs-bench [-j readers] [-b read_size] [-t seconds] [-s] [-n]
+ *			 dir
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -O2 -pthread -o squashfs-bench squashfs-bench.c */
+
+#define _GNU_SOURCE /* for nftw FTW_PHYS */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SAMPLES	(1 << 20)
+
+struct file {
+	char *name;
+	off_t size;
+};
+
+static struct file *files;
+static unsigned nr_files, max_files;
+static unsigned readers = 4, seconds = 10;
+static size_t read_size = 4096;
+static int sequential, no_drop;
+static volatile int stop;
+static unsigned next_file;
+
+static pthread_mutex_t lat_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long nr_lat;
+static double *lat_us;
+static unsigned long long total_bytes;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static double cpu_us(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec * 1e6 + ru.ru_utime.tv_usec +
+	       ru.ru_stime.tv_sec * 1e6 + ru.ru_stime.tv_usec;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static int add_file(const char *name, const struct stat *st, int type,
+		    struct FTW *ftw)
+{
+	if (type != FTW_F || !S_ISREG(st->st_mode) ||
+	    st->st_size < (off_t)read_size)
+		return 0;
+	if (nr_files == max_files) {
+		max_files = max_files ? max_files * 2 : 1024;
+		files = realloc(files, max_files * sizeof(*files));
+		if (!files)
+			die("realloc");
+	}
+	files[nr_files].name = strdup(name);
+	if (!files[nr_files].name)
+		die("strdup");
+	files[nr_files++].size = st->st_size;
+	return 0;
+}
+
+static void drop_caches(void)
+{
+	int fd;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, "3", 1) != 1)
+		die("/proc/sys/vm/drop_caches");
+	close(fd);
+}
+
+static void record(double us)
+{
+	pthread_mutex_lock(&lat_lock);
+	if (nr_lat < MAX_SAMPLES)
+		lat_us[nr_lat++] = us;
+	pthread_mutex_unlock(&lat_lock);
+}
+
+static void *seq_reader(void *arg)
+{
+	unsigned long long bytes = 0;
+	double start;
+	ssize_t ret;
+	unsigned i;
+	char *buf;
+	int fd;
+
+	buf = malloc(read_size);
+	if (!buf)
+		die("malloc");
+
+	while (!stop) {
+		i = __sync_fetch_and_add(&next_file, 1);
+		if (i >= nr_files)
+			break;
+		fd = open(files[i].name, O_RDONLY);
+		if (fd < 0)
+			die(files[i].name);
+		do {
+			start = now();
+			ret = read(fd, buf, read_size);
+			if (ret < 0)
+				die(files[i].name);
+			record(now() - start);
+			bytes += ret;
+		} while (ret && !stop);
+		close(fd);
+	}
+
+	pthread_mutex_lock(&lat_lock);
+	total_bytes += bytes;
+	pthread_mutex_unlock(&lat_lock);
+	free(buf);
+	return NULL;
+}
+
+static void *reader(void *arg)
+{
+	unsigned seed = (unsigned long)arg * 2654435761u + time(NULL);
+	unsigned long long bytes = 0;
+	double start, us;
+	struct file *f;
+	off_t off;
+	char *buf;
+	int fd;
+
+	buf = malloc(read_size);
+	if (!buf)
+		die("malloc");
+
+	while (!stop) {
+		f = &files[rand_r(&seed) % nr_files];
+		off = ((off_t)rand_r(&seed) << 16 | (rand_r(&seed) & 0xffff)) %
+		      (f->size / read_size) * read_size;
+
+		fd = open(f->name, O_RDONLY);
+		if (fd < 0)
+			die(f->name);
+		start = now();
+		if (pread(fd, buf, read_size, off) != (ssize_t)read_size)
+			die(f->name);
+		us = now() - start;
+		close(fd);
+		bytes += read_size;
+		record(us);
+	}
+
+	pthread_mutex_lock(&lat_lock);
+	total_bytes += bytes;
+	pthread_mutex_unlock(&lat_lock);
+	free(buf);
+	return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-j readers] [-b read_size] [-t seconds] [-s] [-n] dir\n"
+		"  -j  reader threads (default 4)\n"
+		"  -b  bytes per read, also the offset alignment (default 4096)\n"
+		"  -t  seconds to run at most (default 10)\n"
+		"  -s  read every file once, sequentially, instead\n"
+		"  -n  don't drop the page cache first\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t *threads;
+	double start, elapsed, cpu;
+	unsigned long i;
+	int c;
+
+	while ((c = getopt(argc, argv, "j:b:t:sn")) != -1) {
+		switch (c) {
+		case 'j':
+			readers = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			read_size = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			sequential = 1;
+			break;
+		case 'n':
+			no_drop = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !readers || !read_size || !seconds)
+		usage(argv[0]);
+
+	if (nftw(argv[optind], add_file, 64, FTW_PHYS))
+		die(argv[optind]);
+	if (!nr_files) {
+		fprintf(stderr, "no files of %zu bytes or more under %s\n",
+			read_size, argv[optind]);
+		return 1;
+	}
+
+	lat_us = malloc(MAX_SAMPLES * sizeof(double));
+	threads = calloc(readers, sizeof(pthread_t));
+	if (!lat_us || !threads)
+		die("malloc");
+
+	if (!no_drop)
+		drop_caches();
+
+	start = now();
+	cpu = cpu_us();
+	for (i = 0; i < readers; i++)
+		if (pthread_create(&threads[i], NULL,
+				   sequential ? seq_reader : reader, (void *)i))
+			die("pthread_create");
+	/* sequential readers stop on their own once every file is read */
+	while (!stop && now() - start < seconds * 1e6 &&
+	       (!sequential || next_file < nr_files))
+		usleep(10000);
+	stop = 1;
+	for (i = 0; i < readers; i++)
+		pthread_join(threads[i], NULL);
+	elapsed = (now() - start) / 1e6;
+	cpu = cpu_us() - cpu;
+
+	if (!nr_lat) {
+		printf("no reads completed\n");
+		return 1;
+	}
+	qsort(lat_us, nr_lat, sizeof(double), cmp_double);
+	printf("%u files, %u %s readers, %zu byte reads\n", nr_files, readers,
+	       sequential ? "sequential" : "random", read_size);
+	printf("%.0f reads/s  %.1f MB/s  %.2f ms CPU/MB\n", nr_lat / elapsed,
+	       total_bytes / elapsed / 1e6,
+	       total_bytes ? cpu / 1e3 / (total_bytes / 1e6) : 0);
+	printf("latency  p50 %8.0f us  p99 %8.0f us  max %8.0f us\n",
+	       lat_us[nr_lat / 2], lat_us[nr_lat * 99 / 100],
+	       lat_us[nr_lat - 1]);
+	return 0;
+}
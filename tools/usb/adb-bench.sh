@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# time adb push and pull of a file through the adb gadget function
+#
+# To take the host controller and cable out of the numbers, run the device
+# side (adbd on the android gadget) on dummy_hcd and the adb host on the
+# same machine.  The adb function takes its request sizes and depths when
+# it is bound, e.g. to compare against the defaults:
+#
+#	P=/sys/module/g_android/parameters
+#	echo 65536 > $P/adb_rx_req_len; echo 8 > $P/adb_rx_reqs
+#	echo 65536 > $P/adb_tx_req_len; echo 8 > $P/adb_tx_reqs
+#
+# then re-enable the gadget and run this again.
+#
+# usage: adb-bench.sh [size_mb [runs [device_dir]]]
+#
+
+SIZE=${1:-64}
+RUNS=${2:-3}
+DIR=${3:-/data/local/tmp}
+ADB=${ADB:-adb}
+
+SRC=$(mktemp) || exit 1
+DST=$(mktemp) || exit 1
+trap 'rm -f $SRC $DST' EXIT
+
+dd if=/dev/urandom of=$SRC bs=1M count=$SIZE 2>/dev/null
+$ADB wait-for-device
+
+now ()
+{
+    date +%s.%N
+}
+
+report ()
+{
+    echo "$1 $2: $(echo "$SIZE / ($4 - $3)" | bc -l | cut -c1-8) MB/s"
+}
+
+i=0
+while [ $i -lt $RUNS ]; do
+    t0=$(now)
+    $ADB push $SRC $DIR/adb-bench.bin >/dev/null 2>&1 || { echo "push failed"; exit 1; }
+    t1=$(now)
+    $ADB pull $DIR/adb-bench.bin $DST >/dev/null 2>&1 || { echo "pull failed"; exit 1; }
+    t2=$(now)
+
+    if ! cmp -s $SRC $DST; then
+	echo "run $i: data differs"
+	exit 1
+    fi
+    report push $i $t0 $t1
+    report pull $i $t1 $t2
+    i=$((i + 1))
+done
+
+$ADB shell rm $DIR/adb-bench.bin
@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# iperf3 throughput of a USB ethernet gadget link, both directions
+#
+# Loads dummy_hcd and an ethernet gadget on this machine, moves the gadget
+# side interface into its own network namespace so that traffic has to
+# cross the USB link instead of the loopback, and runs iperf3 from the
+# host side to the gadget side and back.  The throughput and the CPU load
+# iperf3 sees on either end are printed for each direction.  Run as root.
+#
+# GADGET picks the module: g_ether (CDC ECM, or RNDIS when the host picks
+# that configuration, which is the one that aggregates frames), g_ncm or
+# g_multi.
+#
+# usage: ether-bench.sh [seconds [parallel streams]]
+#
+
+TIME=${1:-10}
+STREAMS=${2:-1}
+GADGET=${GADGET:-g_ether}
+NS=ether-bench
+DEV_IP=192.168.211.1
+HOST_IP=192.168.211.2
+
+cleanup ()
+{
+    [ -n "$SERVER" ] && kill $SERVER 2>/dev/null
+    ip netns del $NS 2>/dev/null
+    rmmod $GADGET 2>/dev/null
+    rmmod dummy_hcd 2>/dev/null
+}
+trap cleanup EXIT
+
+ifaces ()
+{
+    ls /sys/class/net
+}
+
+before=$(ifaces)
+modprobe dummy_hcd || exit 1
+modprobe $GADGET || exit 1
+sleep 3
+
+# two new interfaces: the gadget's, and the host's bound to a class driver
+DEV_IF=
+HOST_IF=
+for i in $(ifaces); do
+    echo "$before" | grep -qx "$i" && continue
+    if readlink /sys/class/net/$i/device/driver 2>/dev/null |
+       grep -q "cdc_ether\|cdc_ncm\|cdc_eem\|rndis_host"; then
+	HOST_IF=$i
+    else
+	DEV_IF=$i
+    fi
+done
+if [ -z "$DEV_IF" ] || [ -z "$HOST_IF" ]; then
+    echo "gadget and host interfaces not found"
+    exit 1
+fi
+
+ip netns add $NS || exit 1
+ip link set $DEV_IF netns $NS
+ip netns exec $NS ip addr add $DEV_IP/24 dev $DEV_IF
+ip netns exec $NS ip link set $DEV_IF up
+ip addr add $HOST_IP/24 dev $HOST_IF
+ip link set $HOST_IF up
+sleep 1
+
+ip netns exec $NS iperf3 -s -B $DEV_IP >/dev/null 2>&1 &
+SERVER=$!
+sleep 1
+
+report ()
+{
+    iperf3 -c $DEV_IP -B $HOST_IP -t $TIME -P $STREAMS -V $1 |
+	awk -v dir="$2" '
+	    /CPU Utilization/ { cpu = $0; sub(/.*CPU Utilization: */, "", cpu) }
+	    /receiver$/ { rx = $(NF - 2) " " $(NF - 1) }
+	    END { print dir ": " rx ", cpu " cpu }'
+}
+
+echo "$GADGET via $DEV_IF/$HOST_IF, $TIME s, $STREAMS stream(s)"
+report "" "host to gadget (gadget rx)"
+report -R "gadget to host (gadget tx)"
@@ -0,0 +1,547 @@
+/*
+ * ffs-aio-test.c -- asynchronous I/O source/sink for FunctionFS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * The same function as ffs-test, but instead of one blocking read or
+ * write at a time it keeps a number of requests queued on each endpoint
+ * with io_submit(), gets their completions through an eventfd and
+ * prints throughput and CPU use once a second.  Buffers are page
+ * aligned, so transfers of 16 KiB or more go straight to and from them
+ * on controllers that can do scatter-gather.
+ *
+ * To measure without real hardware, load dummy_hcd and g_ffs, mount
+ * functionfs, run this in the mount point and drive the device with
+ * testusb (usbtest bound to 1d6b:0105), e.g.
+ *
+ *	modprobe dummy_hcd; modprobe g_ffs
+ *	mount -t functionfs ffs /dev/ffs && cd /dev/ffs && ffs-aio-test &
+ *	testusb -a -t 1 -g 64 -s 65536 -c 10000	# IN
+ *	testusb -a -t 2 -g 64 -s 65536 -c 10000	# OUT
+ *
+ * usage: ffs-aio-test [-n requests] [-s size] [-q]
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o ffs-aio-test ffs-aio-test.c -lpthread */
+
+
+#define _DEFAULT_SOURCE /* for endian.h */
+#define _GNU_SOURCE /* for syscall() */
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/aio_abi.h>
+
+#include "../../include/linux/usb/functionfs.h"
+
+
+/******************** Little Endian Handling ********************************/
+
+/* constant expressions, for the static descriptors below */
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define cpu_to_le16(x)  (x)
+#define cpu_to_le32(x)  (x)
+#else
+#define cpu_to_le16(x)  ((((x) >> 8) & 0xffu) | (((x) & 0xffu) << 8))
+#define cpu_to_le32(x)  \
+	((((x) & 0xff000000u) >> 24) | (((x) & 0x00ff0000u) >>  8) | \
+	 (((x) & 0x0000ff00u) <<  8) | (((x) & 0x000000ffu) << 24))
+#endif
+#define le32_to_cpu(x)  le32toh(x)
+#define le16_to_cpu(x)  le16toh(x)
+
+
+/******************** Messages and Errors ***********************************/
+
+static const char argv0[] = "ffs-aio-test";
+
+static unsigned verbosity = 7;
+
+static void _msg(unsigned level, const char *fmt, ...)
+{
+	if (level < 2)
+		level = 2;
+	else if (level > 7)
+		level = 7;
+
+	if (level <= verbosity) {
+		static const char levels[8][6] = {
+			[2] = "crit:",
+			[3] = "err: ",
+			[4] = "warn:",
+			[5] = "note:",
+			[6] = "info:",
+			[7] = "dbg: "
+		};
+
+		int _errno = errno;
+		va_list ap;
+
+		fprintf(stderr, "%s: %s ", argv0, levels[level]);
+		va_start(ap, fmt);
+		vfprintf(stderr, fmt, ap);
+		va_end(ap);
+
+		if (fmt[strlen(fmt) - 1] != '\n') {
+			char buffer[128];
+			strerror_r(_errno, buffer, sizeof buffer);
+			fprintf(stderr, ": (-%d) %s\n", _errno, buffer);
+		}
+
+		fflush(stderr);
+	}
+}
+
+#define die(...)  (_msg(2, __VA_ARGS__), exit(1))
+#define err(...)   _msg(3, __VA_ARGS__)
+#define warn(...)  _msg(4, __VA_ARGS__)
+#define note(...)  _msg(5, __VA_ARGS__)
+#define info(...)  _msg(6, __VA_ARGS__)
+#define debug(...) _msg(7, __VA_ARGS__)
+
+#define die_on(cond, ...) do { \
+	if (cond) \
+		die(__VA_ARGS__); \
+	} while (0)
+
+
+/******************** Descriptors and Strings *******************************/
+
+static const struct {
+	struct usb_functionfs_descs_head header;
+	struct {
+		struct usb_interface_descriptor intf;
+		struct usb_endpoint_descriptor_no_audio sink;
+		struct usb_endpoint_descriptor_no_audio source;
+	} __attribute__((packed)) fs_descs, hs_descs;
+} __attribute__((packed)) descriptors = {
+	.header = {
+		.magic = cpu_to_le32(FUNCTIONFS_DESCRIPTORS_MAGIC),
+		.length = cpu_to_le32(sizeof descriptors),
+		.fs_count = cpu_to_le32(3),
+		.hs_count = cpu_to_le32(3),
+	},
+	.fs_descs = {
+		.intf = {
+			.bLength = sizeof descriptors.fs_descs.intf,
+			.bDescriptorType = USB_DT_INTERFACE,
+			.bNumEndpoints = 2,
+			.bInterfaceClass = USB_CLASS_VENDOR_SPEC,
+			.iInterface = 1,
+		},
+		.sink = {
+			.bLength = sizeof descriptors.fs_descs.sink,
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 1 | USB_DIR_IN,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			/* .wMaxPacketSize = autoconfiguration (kernel) */
+		},
+		.source = {
+			.bLength = sizeof descriptors.fs_descs.source,
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 2 | USB_DIR_OUT,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			/* .wMaxPacketSize = autoconfiguration (kernel) */
+		},
+	},
+	.hs_descs = {
+		.intf = {
+			.bLength = sizeof descriptors.fs_descs.intf,
+			.bDescriptorType = USB_DT_INTERFACE,
+			.bNumEndpoints = 2,
+			.bInterfaceClass = USB_CLASS_VENDOR_SPEC,
+			.iInterface = 1,
+		},
+		.sink = {
+			.bLength = sizeof descriptors.hs_descs.sink,
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 1 | USB_DIR_IN,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			.wMaxPacketSize = cpu_to_le16(512),
+		},
+		.source = {
+			.bLength = sizeof descriptors.hs_descs.source,
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 2 | USB_DIR_OUT,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			.wMaxPacketSize = cpu_to_le16(512),
+			.bInterval = 1, /* NAK every 1 uframe */
+		},
+	},
+};
+
+
+#define STR_INTERFACE_ "Source/Sink"
+
+static const struct {
+	struct usb_functionfs_strings_head header;
+	struct {
+		__le16 code;
+		const char str1[sizeof STR_INTERFACE_];
+	} __attribute__((packed)) lang0;
+} __attribute__((packed)) strings = {
+	.header = {
+		.magic = cpu_to_le32(FUNCTIONFS_STRINGS_MAGIC),
+		.length = cpu_to_le32(sizeof strings),
+		.str_count = cpu_to_le32(1),
+		.lang_count = cpu_to_le32(1),
+	},
+	.lang0 = {
+		cpu_to_le16(0x0409), /* en-us */
+		STR_INTERFACE_,
+	},
+};
+
+
+/******************** AIO Syscalls ******************************************/
+
+/* no libaio, the raw syscalls are all we need */
+
+static int io_setup(unsigned nr_events, aio_context_t *ctx)
+{
+	return syscall(__NR_io_setup, nr_events, ctx);
+}
+
+static int io_submit(aio_context_t ctx, long nr, struct iocb **iocbpp)
+{
+	return syscall(__NR_io_submit, ctx, nr, iocbpp);
+}
+
+static int io_getevents(aio_context_t ctx, long min_nr, long nr,
+			struct io_event *events, struct timespec *timeout)
+{
+	return syscall(__NR_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+
+
+/******************** Endpoints *********************************************/
+
+#define MAX_REQS	64
+
+static unsigned nr_reqs = 8;
+static size_t req_size = 64 * 1024;
+
+static struct endpoint {
+	const char *const filename;
+	const int opcode;
+
+	int fd;
+	struct iocb iocbs[MAX_REQS];
+	void *bufs[MAX_REQS];
+	char busy[MAX_REQS];
+
+	unsigned long long bytes;
+	unsigned long long reqs;
+} eps[] = {
+	{ "ep1", IOCB_CMD_PWRITE, -1, {{0}}, {0}, {0}, 0, 0 },	/* sink */
+	{ "ep2", IOCB_CMD_PREAD, -1, {{0}}, {0}, {0}, 0, 0 },	/* source */
+};
+
+#define NR_EPS	(sizeof eps / sizeof *eps)
+
+static aio_context_t ctx;
+static int aio_efd;		/* completions */
+static int ep0_efd;		/* ep0 events for the main loop */
+static volatile int enabled;
+
+static void init_ep(struct endpoint *ep, unsigned idx)
+{
+	unsigned i;
+	int ret;
+
+	/* only ever submitted from the main loop once enabled */
+	ep->fd = open(ep->filename, O_RDWR | O_NONBLOCK);
+	die_on(ep->fd < 0, "%s", ep->filename);
+
+	for (i = 0; i < nr_reqs; ++i) {
+		ret = posix_memalign(&ep->bufs[i], sysconf(_SC_PAGESIZE),
+				     req_size);
+		die_on(ret, "%s: posix_memalign", ep->filename);
+		/* the host side of testusb expects zeros by default */
+		memset(ep->bufs[i], 0, req_size);
+
+		ep->iocbs[i].aio_data = (uint64_t)idx << 32 | i;
+		ep->iocbs[i].aio_lio_opcode = ep->opcode;
+		ep->iocbs[i].aio_fildes = ep->fd;
+		ep->iocbs[i].aio_buf = (uintptr_t)ep->bufs[i];
+		ep->iocbs[i].aio_nbytes = req_size;
+		ep->iocbs[i].aio_flags = IOCB_FLAG_RESFD;
+		ep->iocbs[i].aio_resfd = aio_efd;
+	}
+}
+
+/* Queue every request of ep that is not queued yet */
+static void submit_ep(struct endpoint *ep)
+{
+	struct iocb *iocbpp[MAX_REQS];
+	unsigned i, n = 0;
+	int ret;
+
+	if (!enabled)
+		return;
+
+	for (i = 0; i < nr_reqs; ++i)
+		if (!ep->busy[i])
+			iocbpp[n++] = &ep->iocbs[i];
+
+	/* io_submit() takes them in order and stops at the first failure */
+	for (i = 0; i < n; ) {
+		ret = io_submit(ctx, n - i, iocbpp + i);
+		if (ret <= 0) {
+			if (errno == EAGAIN)
+				debug("%s: not enabled yet\n", ep->filename);
+			else
+				err("%s: io_submit", ep->filename);
+			break;
+		}
+		for (; ret; --ret, ++i)
+			ep->busy[iocbpp[i]->aio_data & 0xffffffff] = 1;
+	}
+}
+
+static void handle_events(void)
+{
+	struct io_event events[MAX_REQS * NR_EPS];
+	struct endpoint *ep;
+	uint64_t count;
+	int n, i;
+
+	if (read(aio_efd, &count, sizeof count) < 0 && errno != EAGAIN)
+		die("eventfd read");
+
+	while ((n = io_getevents(ctx, 0, MAX_REQS * NR_EPS, events,
+				 NULL)) > 0) {
+		for (i = 0; i < n; ++i) {
+			ep = &eps[events[i].data >> 32];
+			ep->busy[events[i].data & 0xffffffff] = 0;
+			if ((long)events[i].res >= 0) {
+				ep->bytes += events[i].res;
+				++ep->reqs;
+			} else if ((long)events[i].res != -ESHUTDOWN &&
+				   (long)events[i].res != -ECONNRESET) {
+				errno = -(long)events[i].res;
+				warn("%s: request", ep->filename);
+			}
+		}
+	}
+	die_on(n < 0, "io_getevents");
+}
+
+
+/******************** Statistics ********************************************/
+
+static double seconds(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void report(double elapsed)
+{
+	static unsigned long long last_bytes[NR_EPS], last_reqs[NR_EPS];
+	static double last_cpu;
+	struct rusage ru;
+	double cpu;
+	unsigned i;
+
+	getrusage(RUSAGE_SELF, &ru);
+	cpu = seconds(&ru.ru_utime) + seconds(&ru.ru_stime);
+
+	for (i = 0; i < NR_EPS; ++i) {
+		printf("%s %s %8.2f MB/s %7.0f req/s   ", eps[i].filename,
+		       eps[i].opcode == IOCB_CMD_PWRITE ? "in " : "out",
+		       (eps[i].bytes - last_bytes[i]) / elapsed / 1e6,
+		       (eps[i].reqs - last_reqs[i]) / elapsed);
+		last_bytes[i] = eps[i].bytes;
+		last_reqs[i] = eps[i].reqs;
+	}
+	printf("cpu %5.1f%%\n", 100 * (cpu - last_cpu) / elapsed);
+	fflush(stdout);
+	last_cpu = cpu;
+}
+
+
+/******************** ep0 ***************************************************/
+
+static void ep0_init(int fd)
+{
+	ssize_t ret;
+
+	info("ep0: writing descriptors\n");
+	ret = write(fd, &descriptors, sizeof descriptors);
+	die_on(ret < 0, "ep0: write: descriptors");
+
+	info("ep0: writing strings\n");
+	ret = write(fd, &strings, sizeof strings);
+	die_on(ret < 0, "ep0: write: strings");
+}
+
+/*
+ * ep0 cannot be polled, so it gets a thread of its own which wakes the
+ * main loop up through ep0_efd whenever the function is enabled.
+ */
+static void *ep0_thread(void *arg)
+{
+	static const char *const names[] = {
+		[FUNCTIONFS_BIND] = "BIND",
+		[FUNCTIONFS_UNBIND] = "UNBIND",
+		[FUNCTIONFS_ENABLE] = "ENABLE",
+		[FUNCTIONFS_DISABLE] = "DISABLE",
+		[FUNCTIONFS_SETUP] = "SETUP",
+		[FUNCTIONFS_SUSPEND] = "SUSPEND",
+		[FUNCTIONFS_RESUME] = "RESUME",
+	};
+	struct usb_functionfs_event events[4];
+	const uint64_t one = 1;
+	int fd = *(int *)arg;
+	ssize_t ret;
+	size_t n;
+
+	for (;;) {
+		ret = read(fd, events, sizeof events);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		die_on(ret <= 0, "ep0: read");
+
+		for (n = 0; n < ret / sizeof *events; ++n) {
+			if (events[n].type <= FUNCTIONFS_RESUME)
+				info("Event %s\n", names[events[n].type]);
+			else
+				info("Event %03u (unknown)\n", events[n].type);
+
+			switch (events[n].type) {
+			case FUNCTIONFS_ENABLE:
+				enabled = 1;
+				break;
+			case FUNCTIONFS_DISABLE:
+			case FUNCTIONFS_UNBIND:
+				enabled = 0;
+				break;
+			case FUNCTIONFS_SETUP:
+				/*
+				 * No control requests of our own: stall by
+				 * going the wrong way for the data stage.
+				 */
+				if (events[n].u.setup.bRequestType & USB_DIR_IN)
+					ret = read(fd, NULL, 0);
+				else
+					ret = write(fd, NULL, 0);
+				continue;
+			default:
+				continue;
+			}
+			if (write(ep0_efd, &one, sizeof one) < 0)
+				err("ep0: eventfd write");
+		}
+	}
+	return NULL;
+}
+
+
+/******************** Main **************************************************/
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: %s [-n requests] [-s size] [-q]\n"
+		"  -n  requests queued per endpoint (1-%d, default %u)\n"
+		"  -s  bytes per request (default %zu)\n"
+		"  -q  only print the statistics\n",
+		argv0, MAX_REQS, nr_reqs, req_size);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct pollfd fds[2];
+	struct timeval start, now;
+	pthread_t ep0_id;
+	uint64_t count;
+	unsigned i;
+	int ep0, opt, ret;
+
+	while ((opt = getopt(argc, argv, "n:s:q")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_reqs = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			req_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			verbosity = 4;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!nr_reqs || nr_reqs > MAX_REQS || !req_size)
+		usage();
+
+	ep0 = open("ep0", O_RDWR);
+	die_on(ep0 < 0, "ep0");
+	ep0_init(ep0);
+
+	die_on(io_setup(nr_reqs * NR_EPS, &ctx) < 0, "io_setup");
+	aio_efd = eventfd(0, EFD_NONBLOCK);
+	die_on(aio_efd < 0, "eventfd");
+	ep0_efd = eventfd(0, EFD_NONBLOCK);
+	die_on(ep0_efd < 0, "eventfd");
+
+	for (i = 0; i < NR_EPS; ++i)
+		init_ep(eps + i, i);
+
+	die_on(pthread_create(&ep0_id, NULL, ep0_thread, &ep0),
+	       "pthread_create(ep0)");
+
+	fds[0].fd = aio_efd;
+	fds[0].events = POLLIN;
+	fds[1].fd = ep0_efd;
+	fds[1].events = POLLIN;
+
+	gettimeofday(&start, NULL);
+	for (;;) {
+		ret = poll(fds, 2, 1000);
+		die_on(ret < 0 && errno != EINTR, "poll");
+
+		if (fds[1].revents & POLLIN)
+			if (read(ep0_efd, &count, sizeof count) < 0 &&
+			    errno != EAGAIN)
+				die("eventfd read");
+		if (fds[0].revents & POLLIN)
+			handle_events();
+
+		for (i = 0; i < NR_EPS; ++i)
+			submit_ep(eps + i);
+
+		gettimeofday(&now, NULL);
+		if (seconds(&now) - seconds(&start) >= 1.0) {
+			report(seconds(&now) - seconds(&start));
+			start = now;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * msc-bench.c -- sequential and random I/O against a mass storage LUN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Run on the host against the disk a mass storage gadget shows up as.
+ * It reads and, with -w, writes the disk with O_DIRECT, first
+ * sequentially in -b sized requests, then at random -r sized aligned
+ * offsets, for -t seconds each, and prints MB/s and requests/s of each
+ * pass.  -w destroys the data on the disk.
+ *
+ * To leave the host controller and cable out of the numbers, run the
+ * gadget on dummy_hcd on the same machine with a file-backed LUN, e.g.
+ *
+ *	dd if=/dev/zero of=/tmp/lun bs=1M count=256
+ *	modprobe dummy_hcd; modprobe g_mass_storage file=/tmp/lun
+ *	msc-bench -w /dev/sdX
+ *
+ * and compare g_mass_storage buflen=, num_buffers= and write_behind=
+ * settings (g_android takes the same ones).
+ *
+ * usage: msc-bench [-w] [-b seq_size] [-r rand_size] [-t seconds] disk
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o msc-bench msc-bench.c */
+
+#define _GNU_SOURCE /* for O_DIRECT */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <linux/fs.h>
+
+static int fd;
+static off_t disk_size;
+static unsigned seconds = 10;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Random offset aligned to size, with the request within the disk */
+static off_t random_offset(size_t size)
+{
+	unsigned long long slots = disk_size / size;
+
+	return (off_t)((((unsigned long long)random() << 31) ^ random()) %
+		       slots) * size;
+}
+
+static void run(const char *name, void *buf, size_t size, int write,
+		int rand)
+{
+	unsigned long long bytes = 0, reqs = 0;
+	double start, elapsed;
+	off_t offset = 0;
+	ssize_t ret;
+
+	start = now();
+	do {
+		if (rand)
+			offset = random_offset(size);
+		else if (offset + (off_t)size > disk_size)
+			offset = 0;
+
+		if (write)
+			ret = pwrite(fd, buf, size, offset);
+		else
+			ret = pread(fd, buf, size, offset);
+		if (ret != (ssize_t)size) {
+			fprintf(stderr, "%s @ %lld: %s\n", name,
+				(long long)offset,
+				ret < 0 ? strerror(errno) : "short");
+			exit(1);
+		}
+
+		offset += size;
+		bytes += size;
+		++reqs;
+		elapsed = now() - start;
+	} while (elapsed < seconds);
+
+	printf("%-12s %7zu B  %8.2f MB/s  %8.0f req/s\n", name, size,
+	       bytes / elapsed / 1e6, reqs / elapsed);
+	fflush(stdout);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-w] [-b seq_size] [-r rand_size] [-t seconds] disk\n"
+		"  -w  also write (destroys the data on disk)\n"
+		"  -b  sequential request size (default 65536)\n"
+		"  -r  random request size (default 4096)\n"
+		"  -t  seconds per pass (default 10)\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	size_t seq_size = 65536, rand_size = 4096;
+	int c, write = 0;
+	void *buf;
+
+	while ((c = getopt(argc, argv, "wb:r:t:")) != -1) {
+		switch (c) {
+		case 'w':
+			write = 1;
+			break;
+		case 'b':
+			seq_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rand_size = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !seq_size || !rand_size || !seconds ||
+	    seq_size % 512 || rand_size % 512)
+		usage(argv[0]);
+
+	fd = open(argv[optind], (write ? O_RDWR : O_RDONLY) | O_DIRECT);
+	if (fd < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (ioctl(fd, BLKGETSIZE64, &disk_size) < 0) {
+		disk_size = lseek(fd, 0, SEEK_END);
+		if (disk_size < 0) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	if (disk_size < (off_t)seq_size || disk_size < (off_t)rand_size) {
+		fprintf(stderr, "%s: too small\n", argv[optind]);
+		return 1;
+	}
+
+	if (posix_memalign(&buf, sysconf(_SC_PAGESIZE),
+			   seq_size > rand_size ? seq_size : rand_size)) {
+		perror("posix_memalign");
+		return 1;
+	}
+	memset(buf, 0x5a, seq_size > rand_size ? seq_size : rand_size);
+	srandom(getpid());
+
+	run("seq read", buf, seq_size, 0, 0);
+	if (write)
+		run("seq write", buf, seq_size, 1, 0);
+	run("rand read", buf, rand_size, 0, 1);
+	if (write)
+		run("rand write", buf, rand_size, 1, 1);
+
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,432 @@
+/*
+ * mtp-bench: measure MTP file transfer throughput from the host
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * Talks PTP/MTP to a device over libusb and times whole object transfers:
+ * GetObject of an object on the device (device to host, send_file_work in
+ * the MTP function) and SendObjectInfo/SendObject of a file of the given
+ * size, deleted afterwards (host to device, receive_file_work).  Each is
+ * repeated and the rate of every run printed in MB/s.
+ *
+ * To benchmark the gadget stack alone, load dummy_hcd, enable the mtp
+ * function of the android gadget on it and start the MTP responder (the
+ * platform's MtpServer), then run this on the same machine:
+ *
+ *	mtp-bench -g 0 -p 64 -n 5
+ *
+ * Whatever is changed in f_mtp (mtp_tx_req_len, mtp_rx_req_len,
+ * mtp_tx_reqs, mtp_rx_reqs, mtp_tx_zcopy) is picked up when the function
+ * is next bound.  Nothing else may have the MTP interface open.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <libusb-1.0/libusb.h>
+
+#define PTP_TYPE_COMMAND	1
+#define PTP_TYPE_DATA		2
+#define PTP_TYPE_RESPONSE	3
+
+#define PTP_OC_OPEN_SESSION	0x1002
+#define PTP_OC_CLOSE_SESSION	0x1003
+#define PTP_OC_GET_STORAGE_IDS	0x1004
+#define PTP_OC_GET_OBJECT_HANDLES 0x1007
+#define PTP_OC_GET_OBJECT	0x1009
+#define PTP_OC_DELETE_OBJECT	0x100B
+#define PTP_OC_SEND_OBJECT_INFO	0x100C
+#define PTP_OC_SEND_OBJECT	0x100D
+
+#define PTP_RC_OK		0x2001
+#define PTP_RC_SESSION_OPEN	0x201E
+#define PTP_OFC_UNDEFINED	0x3000
+
+#define HDR_SIZE		12
+#define BUF_SIZE		(1024 * 1024)
+#define TIMEOUT			10000
+
+static libusb_device_handle *handle;
+static unsigned char ep_in, ep_out;
+static int maxpacket = 512;
+static uint32_t transaction_id;
+static unsigned char *buf;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void put16(unsigned char *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+	put16(p, v);
+	put16(p + 2, v >> 16);
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static int bulk(unsigned char ep, unsigned char *data, int len, int *actual)
+{
+	int ret = libusb_bulk_transfer(handle, ep, data, len, actual, TIMEOUT);
+
+	if (ret)
+		fprintf(stderr, "bulk %s: %s\n", ep & 0x80 ? "in" : "out",
+			libusb_error_name(ret));
+	return ret;
+}
+
+static int send_command(uint16_t code, int nparams, const uint32_t *params)
+{
+	unsigned char cmd[HDR_SIZE + 5 * 4];
+	int i, actual;
+
+	put32(cmd, HDR_SIZE + nparams * 4);
+	put16(cmd + 4, PTP_TYPE_COMMAND);
+	put16(cmd + 6, code);
+	put32(cmd + 8, ++transaction_id);
+	for (i = 0; i < nparams; i++)
+		put32(cmd + HDR_SIZE + i * 4, params[i]);
+	return bulk(ep_out, cmd, HDR_SIZE + nparams * 4, &actual);
+}
+
+/* Returns the response code, its parameters go to params if not NULL */
+static int get_response(uint32_t *params)
+{
+	unsigned char resp[HDR_SIZE + 5 * 4];
+	int i, actual;
+
+	if (bulk(ep_in, resp, sizeof(resp), &actual))
+		return -1;
+	if (actual < HDR_SIZE || resp[4] != PTP_TYPE_RESPONSE) {
+		fprintf(stderr, "bad response\n");
+		return -1;
+	}
+	for (i = 0; params && HDR_SIZE + i * 4 < actual; i++)
+		params[i] = get32(resp + HDR_SIZE + i * 4);
+	return resp[6] | resp[7] << 8;
+}
+
+/*
+ * Send a data phase of len bytes: the container header and the first
+ * bytes of data, then the rest from data, or zeroes if it is NULL.
+ */
+static int send_data(uint16_t code, const unsigned char *data, uint64_t len)
+{
+	uint64_t total = HDR_SIZE + len, done = 0, off = 0;
+	int chunk, actual;
+
+	put32(buf, total > 0xffffffff ? 0xffffffff : total);
+	put16(buf + 4, PTP_TYPE_DATA);
+	put16(buf + 6, code);
+	put32(buf + 8, transaction_id);
+
+	while (done < total) {
+		chunk = total - done > BUF_SIZE ? BUF_SIZE : total - done;
+		if (!done) {
+			if (data)
+				memcpy(buf + HDR_SIZE, data, chunk - HDR_SIZE);
+			else
+				memset(buf + HDR_SIZE, 0, chunk - HDR_SIZE);
+			off = chunk - HDR_SIZE;
+		} else if (data) {
+			memcpy(buf, data + off, chunk);
+			off += chunk;
+		}
+		if (bulk(ep_out, buf, chunk, &actual))
+			return -1;
+		done += chunk;
+	}
+	if (!(total % maxpacket))
+		bulk(ep_out, buf, 0, &actual);
+	return 0;
+}
+
+/*
+ * Receive a data phase.  Up to max bytes of its payload are copied to data,
+ * the length of the payload is returned.
+ */
+static int64_t get_data(unsigned char *data, size_t max)
+{
+	uint64_t total = 0, done = 0;
+	int actual, n;
+
+	do {
+		if (bulk(ep_in, buf, BUF_SIZE, &actual))
+			return -1;
+		if (!done) {
+			if (actual < HDR_SIZE || buf[4] != PTP_TYPE_DATA) {
+				fprintf(stderr, "bad data phase\n");
+				return -1;
+			}
+			total = get32(buf);
+		}
+		if (data && done < max + HDR_SIZE) {
+			n = actual;
+			if (done + n > max + HDR_SIZE)
+				n = max + HDR_SIZE - done;
+			if (!done)
+				memcpy(data, buf + HDR_SIZE, n - HDR_SIZE);
+			else
+				memcpy(data + done - HDR_SIZE, buf, n);
+		}
+		done += actual;
+		/* objects of 4 GB and more end with the first short packet */
+	} while (actual == BUF_SIZE && (total == 0xffffffff || done < total));
+
+	/* a full last buffer did not take the ZLP */
+	if (actual == BUF_SIZE && !(done % maxpacket) &&
+	    bulk(ep_in, buf, BUF_SIZE, &actual))
+		return -1;
+
+	return done - HDR_SIZE;
+}
+
+static int transaction(uint16_t code, int nparams, const uint32_t *params,
+		       unsigned char *data, size_t max, uint32_t *resp_params)
+{
+	int rc;
+
+	if (send_command(code, nparams, params))
+		return -1;
+	if (data && get_data(data, max) < 0)
+		return -1;
+	rc = get_response(resp_params);
+	if (rc != PTP_RC_OK && !(code == PTP_OC_OPEN_SESSION &&
+				 rc == PTP_RC_SESSION_OPEN)) {
+		fprintf(stderr, "operation %04x: response %04x\n", code, rc);
+		return -1;
+	}
+	return 0;
+}
+
+static int first_of_array(uint16_t code, int nparams, const uint32_t *params,
+			  uint32_t *first)
+{
+	unsigned char data[8];
+
+	memset(data, 0, sizeof(data));
+	if (transaction(code, nparams, params, data, sizeof(data), NULL))
+		return -1;
+	if (!get32(data)) {
+		fprintf(stderr, "operation %04x: empty array\n", code);
+		return -1;
+	}
+	*first = get32(data + 4);
+	return 0;
+}
+
+static void report(const char *what, int run, uint64_t bytes, double secs)
+{
+	printf("%-4s %2d: %10llu bytes %8.3f s %8.2f MB/s\n", what, run,
+	       (unsigned long long)bytes, secs, bytes / secs / (1024 * 1024));
+}
+
+static int bench_get(uint32_t object, int runs)
+{
+	uint32_t params[3] = { 0xffffffff, 0, 0 };
+	double t0, t;
+	int64_t len;
+	int i;
+
+	if (!object && first_of_array(PTP_OC_GET_OBJECT_HANDLES, 3, params,
+				      &object))
+		return -1;
+
+	for (i = 0; i < runs; i++) {
+		t0 = now();
+		if (send_command(PTP_OC_GET_OBJECT, 1, &object))
+			return -1;
+		len = get_data(NULL, 0);
+		if (len < 0 || get_response(NULL) != PTP_RC_OK)
+			return -1;
+		t = now() - t0;
+		report("get", i, len, t);
+	}
+	return 0;
+}
+
+static int put_string(unsigned char *p, const char *s)
+{
+	int i, n = strlen(s) + 1;
+
+	p[0] = n;
+	for (i = 0; i < n; i++)
+		put16(p + 1 + i * 2, s[i]);
+	return 1 + n * 2;
+}
+
+static int bench_put(uint64_t size, int runs)
+{
+	unsigned char info[256];
+	uint32_t storage, params[2], resp[3];
+	double t0, t;
+	int i, n;
+
+	if (first_of_array(PTP_OC_GET_STORAGE_IDS, 0, NULL, &storage))
+		return -1;
+
+	for (i = 0; i < runs; i++) {
+		/* ObjectInfo dataset: fixed fields, then four strings */
+		memset(info, 0, sizeof(info));
+		put32(info, storage);
+		put16(info + 4, PTP_OFC_UNDEFINED);
+		put32(info + 8, size > 0xffffffff ? 0xffffffff : size);
+		put32(info + 38, 0xffffffff);
+		n = 52;
+		n += put_string(info + n, "mtp-bench.bin");
+		n += 3;
+
+		params[0] = storage;
+		params[1] = 0xffffffff;
+		if (send_command(PTP_OC_SEND_OBJECT_INFO, 2, params) ||
+		    send_data(PTP_OC_SEND_OBJECT_INFO, info, n) ||
+		    get_response(resp) != PTP_RC_OK)
+			return -1;
+
+		t0 = now();
+		if (send_command(PTP_OC_SEND_OBJECT, 0, NULL) ||
+		    send_data(PTP_OC_SEND_OBJECT, NULL, size) ||
+		    get_response(NULL) != PTP_RC_OK)
+			return -1;
+		t = now() - t0;
+		report("put", i, size, t);
+
+		if (transaction(PTP_OC_DELETE_OBJECT, 1, &resp[2], NULL, 0,
+				NULL))
+			return -1;
+	}
+	return 0;
+}
+
+static int find_interface(libusb_device *dev, int want)
+{
+	struct libusb_config_descriptor *config;
+	const struct libusb_interface_descriptor *alt;
+	const struct libusb_endpoint_descriptor *ep;
+	int i, j, found = -1;
+
+	if (libusb_get_active_config_descriptor(dev, &config))
+		return -1;
+	for (i = 0; i < config->bNumInterfaces && found < 0; i++) {
+		alt = &config->interface[i].altsetting[0];
+		if (want >= 0 ? alt->bInterfaceNumber != want :
+		    !(alt->bInterfaceClass == LIBUSB_CLASS_PTP &&
+		      alt->bInterfaceSubClass == 1 &&
+		      alt->bInterfaceProtocol == 1))
+			continue;
+		ep_in = ep_out = 0;
+		for (j = 0; j < alt->bNumEndpoints; j++) {
+			ep = &alt->endpoint[j];
+			if ((ep->bmAttributes & 3) != LIBUSB_TRANSFER_TYPE_BULK)
+				continue;
+			if (ep->bEndpointAddress & LIBUSB_ENDPOINT_IN)
+				ep_in = ep->bEndpointAddress;
+			else
+				ep_out = ep->bEndpointAddress;
+			maxpacket = ep->wMaxPacketSize;
+		}
+		if (ep_in && ep_out)
+			found = alt->bInterfaceNumber;
+	}
+	libusb_free_config_descriptor(config);
+	return found;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s -d vid:pid [-i interface] [-g object] [-p MB] [-n runs]\n"
+		"  -g  GetObject the object with this handle, 0 for the first\n"
+		"  -p  SendObject a file of this size, then delete it\n"
+		"  -i  interface number, if it is not PTP class (MTP in mac mode)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int vid = 0, pid = 0;
+	uint64_t put_size = 0;
+	uint32_t session = 1;
+	long get_object = -1;
+	int c, intf = -1, runs = 3, ret = 1;
+
+	while ((c = getopt(argc, argv, "d:i:g:p:n:")) != -1) {
+		switch (c) {
+		case 'd':
+			if (sscanf(optarg, "%x:%x", &vid, &pid) != 2)
+				usage(argv[0]);
+			break;
+		case 'i':
+			intf = atoi(optarg);
+			break;
+		case 'g':
+			get_object = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			put_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'n':
+			runs = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!vid || (get_object < 0 && !put_size))
+		usage(argv[0]);
+
+	buf = malloc(BUF_SIZE);
+	if (!buf || libusb_init(NULL))
+		return 1;
+	handle = libusb_open_device_with_vid_pid(NULL, vid, pid);
+	if (!handle) {
+		fprintf(stderr, "%04x:%04x: not found\n", vid, pid);
+		return 1;
+	}
+	intf = find_interface(libusb_get_device(handle), intf);
+	if (intf < 0) {
+		fprintf(stderr, "no MTP interface\n");
+		goto out;
+	}
+	libusb_set_auto_detach_kernel_driver(handle, 1);
+	if (libusb_claim_interface(handle, intf)) {
+		fprintf(stderr, "cannot claim interface %d\n", intf);
+		goto out;
+	}
+	printf("interface %d, in %02x, out %02x, max packet %d\n", intf, ep_in,
+	       ep_out, maxpacket);
+
+	if (transaction(PTP_OC_OPEN_SESSION, 1, &session, NULL, 0, NULL))
+		goto release;
+	if (get_object >= 0 && bench_get(get_object, runs))
+		goto close;
+	if (put_size && bench_put(put_size, runs))
+		goto close;
+	ret = 0;
+close:
+	transaction(PTP_OC_CLOSE_SESSION, 0, NULL, NULL, 0, NULL);
+release:
+	libusb_release_interface(handle, intf);
+out:
+	libusb_close(handle);
+	libusb_exit(NULL);
+	return ret;
+}